@@ -1 +1,3 @@
-#include "BaseShape.h"
\ No newline at end of file
+#include "BaseShape.h"
+
+std::atomic<int> BaseShape::objectCount = 0; // Lives with the core library so every front end and the server share one definition
\ No newline at end of file
@@ -1,16 +1,22 @@
 #pragma once
-#include <SFML/Graphics.hpp>
 #include <iostream> 
 #include <sstream>
+#include <string>
+#include <cmath>
+#include <atomic>
+#include "SimTypes.h"
 
 
 class BaseShape
 {
 protected:
+	sf::Vector2f position; // Center of the shape
 	sf::Vector2f oldPosition;  //Vector for X axis and Y axis
 	sf::Vector2f acceleration; //Vector for X axis and Y axis
 	sf::Vector2f velocity;
-	sf::Color color;
+	SimColor color;
+	SimColor outlineColor; // Only used by the front ends when drawing
+	float outlineThickness = 0;
 	float gravity; // float to not be too strong
 	double mass;//be as fat as you want brotha
 	double fps;//my worst enemy
@@ -19,12 +25,13 @@ protected:
 	std::string type = "BaseShape";
 
 public:
-	static int objectCount;
+	static std::atomic<int> objectCount; // Atomic, the server builds the worlds of its rooms on several threads
 
 	BaseShape() // must have deffult constructor for networking
-		: oldPosition(0.f, 0.f),
+		: position(0.f, 0.f),
+		oldPosition(0.f, 0.f),
 		acceleration(0.f, 0.f),
-		color(sf::Color::White),
+		color(255, 255, 255),
 		gravity(0.f),
 		mass(0.0),
 		fps(0.0),
@@ -35,7 +42,7 @@ public:
 		// This constructor sets default values
 	}
 
-	BaseShape(sf::Color color, float gravity, double mass, int objCount)
+	BaseShape(SimColor color, float gravity, double mass, int objCount)
 		: color(color), gravity(gravity), mass(mass)
 	{
 		linked = -1;
@@ -46,9 +53,12 @@ public:
 	}
 	// Copy constructor
 	BaseShape(const BaseShape& other)
-		: oldPosition(other.oldPosition),
+		: position(other.position),
+		oldPosition(other.oldPosition),
 		acceleration(other.acceleration),
 		color(other.color),
+		outlineColor(other.outlineColor),
+		outlineThickness(other.outlineThickness),
 		gravity(other.gravity),
 		mass(other.mass),
 		fps(other.fps),
@@ -74,7 +84,7 @@ public:
 	}
 
 	// Set shape color
-	virtual void setColor(sf::Color newColor) {}
+	void setColor(SimColor newColor) { color = newColor; }
 
 	//Set the mass of the circle
 	void SetMass(double newMass) { mass = newMass; }
@@ -84,9 +94,6 @@ public:
 	//Get the mass of the circle. if I will use it on your mother I will get an out of bounderies error!
 	double GetMass() { return mass; }
 
-	// Function to draw the circle
-	virtual void draw(sf::RenderWindow& window) {}
-
 	double Distance(BaseShape* otherShape) {
 		sf::Vector2f pos = GetPosition();       // Position of this shape
 		sf::Vector2f posOther = otherShape->GetPosition(); // Position of the other shape
@@ -106,9 +113,13 @@ public:
 		return std::sqrt(std::pow((y2 - y1), 2) + std::pow((x2 - x1), 2)); // Return distance
 	}
 
-	virtual sf::Vector2f GetPosition() const { return sf::Vector2f(-1, -1); }
+	sf::Vector2f GetPosition() const { return position; }
 
-	virtual std::string GetPositionStr() const { return ""; }
+	std::string GetPositionStr() const {
+		std::stringstream ss;
+		ss << "X=" << position.x << "Y=" << position.y;
+		return ss.str();
+	}
 
 	float GetGravity() {
 		return gravity;
@@ -118,7 +129,7 @@ public:
 		gravity = newGravity;
 	}
 
-	virtual void SetPosition(sf::Vector2f newPos) {}
+	void SetPosition(sf::Vector2f newPos) { position = newPos; }
 
 	void SetVelocity(const sf::Vector2f& newVelocity) { 
 		velocity = newVelocity; 
@@ -153,9 +164,16 @@ public:
 
 	int GetLinked() { return linked; }
 
-	virtual void SetOutline(sf::Color color, float thickness) {}
+	void SetOutline(SimColor color, float thickness) {
+		outlineColor = color;
+		outlineThickness = thickness;
+	}
 
-	sf::Color GetColor() { return color; }
+	SimColor GetOutlineColor() const { return outlineColor; }
+
+	float GetOutlineThickness() const { return outlineThickness; }
+
+	SimColor GetColor() const { return color; }
 
 	int GetID() { return id; };
 
@@ -173,8 +191,12 @@ public:
 		type = newType;
 	}
 
-	virtual sf::FloatRect GetGlobalBounds() {
-		return sf::FloatRect();
+	virtual ShapeKind GetKind() const {
+		return ShapeKind::Unknown;
+	}
+
+	virtual SimRect GetGlobalBounds() {
+		return SimRect();
 	}
 
 	virtual float GetEstimatedSize() {
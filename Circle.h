@@ -1,10 +1,9 @@
 #pragma once
-#include <SFML/Graphics.hpp>
 #include <iostream> 
 #include "BaseShape.h"
 
-// Base_Shape class inheriting from sf::Transformable
-class Circle :public BaseShape, public sf::CircleShape
+// Plain simulation circle, the front ends draw it (no sf::CircleShape so the core stays headless)
+class Circle :public BaseShape
 {
 protected:
 	float radius; //float to not be too big
@@ -13,13 +12,10 @@ public:
 	Circle() : BaseShape(), radius(0.0) {}; // must have deffult constructor for networking
 
 	// Constructor with radius, color, gravity, mass
-	Circle(sf::Color color, float gravity, double mass, float radius, int objCount)
+	Circle(SimColor color, float gravity, double mass, float radius, int objCount)
 		: BaseShape(color, gravity, mass, objCount), radius(radius)
 	{
-		setRadius(radius);
-		setFillColor(color);
-		setOrigin(radius, radius);
-		setPosition(radius, radius);
+		position = sf::Vector2f(radius, radius);
 		oldPosition = sf::Vector2f(radius, radius);
 		acceleration = sf::Vector2f(0, gravity * 100); //(x axis, y axis)
 		oldPosition = oldPosition - velocity * (1.f / 60.f);
@@ -27,32 +23,29 @@ public:
 	}
 
 	// Constructor with radius, color, gravity, mass, position
-	Circle(float radius, sf::Color color, sf::Vector2f pos, float gravity, double mass, sf::Vector2f initialVel, int objCount)
+	Circle(float radius, SimColor color, sf::Vector2f pos, float gravity, double mass, sf::Vector2f initialVel, int objCount)
 		: BaseShape(color, gravity, mass, objCount), radius(radius)
 	{
-		setRadius(radius);
-		setFillColor(color);
-		setOrigin(radius, radius);
-		setPosition(pos);
+		position = pos;
 		oldPosition = pos;
 		acceleration = sf::Vector2f(0, gravity * 100);//(x axis, y axis)
 		SetVelocity(initialVel);
 		oldPosition = oldPosition - velocity * (1.f / 60.f);
-		//SetOutline(sf::Color(255, 255, 255), 0.5);  // cool visual
+		//SetOutline(SimColor(255, 255, 255), 0.5);  // cool visual
 		type = "Circle";
 	}
 
 	//update the position based on verlet integration.
 	void updatePositionVerlet(float dt) override
 	{
-		sf::Vector2f currentPos = getPosition();
+		sf::Vector2f currentPos = position;
 		sf::Vector2f newPos = currentPos + (currentPos - oldPosition) + acceleration * (dt * dt);
 
 		// Update velocity
 		velocity = (newPos - oldPosition) / (2 * dt);
 
 		oldPosition = currentPos;
-		setPosition(newPos);
+		position = newPos;
 	}
 
 	//update the position based on euler integration.
@@ -60,7 +53,7 @@ public:
 	{
 		sf::Vector2f currentPos = GetPosition();
 		sf::Vector2f newPos = currentPos + velocity * dt;
-		setPosition(newPos);
+		position = newPos;
 		// Update velocity for the next frame
 		velocity = velocity + acceleration * dt;
 	}
@@ -97,7 +90,7 @@ public:
 			oldPosition.y = pos.y + (pos.y - oldPosition.y) * energyLossFactor;
 		}
 
-		setPosition(pos);
+		position = pos;
 	}
 
 	double DistanceOnly(Circle* otherShape) {
@@ -142,7 +135,7 @@ public:
 	}
 
 	//The collision handeling is done by seperating the two circles with a vector between the two of them, and the overlap of them. the speed that will be created is done by verlet integretion
-	void HandleCollision(Circle* otherCir) {
+	bool HandleCollision(Circle* otherCir) {
 		if (IsCollision(otherCir)) {
 			// Get positions of both circles
 			sf::Vector2f pos = GetPosition();
@@ -165,14 +158,16 @@ public:
 				posOther -= displacement * massRatio; // Move the other circle
 
 				// Update positions
-				setPosition(pos);
-				otherCir->setPosition(posOther);
+				position = pos;
+				otherCir->position = posOther;
+				return true;
 			}
 		}
+		return false;
 	}
 
 	//handeling collision with euler integretion, using momentum equations
-	void HandleCollisionElastic(Circle* otherCir, float elastic) {
+	bool HandleCollisionElastic(Circle* otherCir, float elastic) {
 		if (IsCollision(otherCir)) {
 			// Current positions
 			sf::Vector2f pos = GetPosition();
@@ -201,62 +196,33 @@ public:
 			// Update positions and oldPositions
 			oldPosition = pos;
 			otherCir->oldPosition = posOther;
-			setPosition(pos + newVelocity);//!This is the part that do the hit physicly accurate, we add the new velocity to the position like euler integration!
-			otherCir->setPosition(posOther + newVelocityOther);//!This is the part that do the hit physicly accurate, we add the new velocity to the position like euler integration!
+			position = pos + newVelocity;//!This is the part that do the hit physicly accurate, we add the new velocity to the position like euler integration!
+			otherCir->position = posOther + newVelocityOther;//!This is the part that do the hit physicly accurate, we add the new velocity to the position like euler integration!
 
 			// Separate circles to prevent sticking
 			float overlap = (radius + otherCir->radius) - distance;
 			sf::Vector2f separation = normal * (overlap / 2.0f);
-			setPosition(GetPosition() + separation);
-			otherCir->setPosition(otherCir->GetPosition() - separation);
+			position += separation;
+			otherCir->position -= separation;
+			return true;
 		}
+		return false;
 	}
 
 	//Set the radius to a new one, and centers the origin point according to the new radius
 	void SetRadiusAndCenter(int newRadius) {
-		setRadius(newRadius);
 		radius = newRadius;
-		setOrigin(sf::Vector2f(radius, radius));
-	}
-
-	// Set shape color
-	void setColor(sf::Color newColor) override
-	{
-		color = newColor;  // Update the member variable
-		setFillColor(newColor);
-	}
-
-	void SetPosition(sf::Vector2f newPos) override
-	{
-		setPosition(newPos);
 	}
 
 	void SetRadius(float newRadius)
 	{
-		setRadius(newRadius);
 		radius = newRadius;
-		setOrigin(sf::Vector2f(radius, radius));
 	}
 
-	float GetRadius() {
+	float GetRadius() const {
 		return radius;
 	}
 
-	sf::Vector2f GetPosition() const override {
-		return getPosition();
-	}
-
-	std::string GetPositionStr() const override {
-		std::stringstream ss;
-		ss << "X=" << GetPosition().x << "Y=" << GetPosition().y;
-		return ss.str();
-	}
-
-	void SetOutline(sf::Color color, float thickness) override {
-		setOutlineThickness(thickness);
-		setOutlineColor(color);
-	}
-
 	std::string ToString() const override {
 		std::stringstream ss;
 
@@ -268,17 +234,15 @@ public:
 		return ss.str();
 	}
 
-	sf::FloatRect GetGlobalBounds()  override {
-		return getGlobalBounds();
+	ShapeKind GetKind() const override {
+		return ShapeKind::Circle;
 	}
 
-	float GetEstimatedSize() override {
-		return radius;
+	SimRect GetGlobalBounds()  override {
+		return SimRect(position.x - radius, position.y - radius, radius * 2, radius * 2);
 	}
 
-	// Function to draw the circle
-	void draw(sf::RenderWindow& window)
-	{
-		window.draw(*this);
+	float GetEstimatedSize() override {
+		return radius;
 	}
 };
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <string>
 #include <deque>
 #include <mutex>
+#include <atomic>
 #include <SFML/Graphics.hpp>;
 #include <SFML/Window.hpp>
 #include "BaseShape.h"
@@ -14,21 +15,26 @@
 #include "Options.h"
 #include "UI.h"
 #include "HandleNetworkingClient.h"
+#include "OfflineRender.h"
+#include "Snapshot.h"
+#include "DeltaSnapshot.h"
+#include "SnapshotInterpolator.h"
+#include "SnapshotProxies.h"
+#include "DragPrediction.h"
 
 using boost::asio::ip::tcp;
 using boost::asio::ip::udp;
 
-int BaseShape::objectCount = 0;
 
 class Client : public HandleNetworkingClient, public PhysicsSimulationActions, public PhysicsSimulationVisual {
 public:
-	Client(sf::RenderWindow& window, boost::asio::io_context& io_context, const std::string& host, unsigned short tcp_port, unsigned short udp_port) :
+	Client(sf::RenderWindow& window, boost::asio::io_context& io_context, const std::string& host, unsigned short tcp_port, unsigned short udp_port, std::uint32_t room_id = 0) :
 		window(window),
 		settings(8),
 		objectList(lineLength),
 		PhysicsSimulationVisual(),
 		PhysicsSimulationActions(),
-		HandleNetworkingClient(io_context, host, tcp_port, udp_port)
+		HandleNetworkingClient(io_context, host, tcp_port, udp_port, room_id)
 	{
 		view = window.getDefaultView();  // Initialize view from window
 		initializeCursors();
@@ -45,22 +51,101 @@ public:
 		return screen;
 	}
 
-	void TranslateMessage(const std::string& message) override {
-		// Check if the message contains serialized shapes
-		if (message.length() > 1 && message[0] == '$') {
-			try {
-				std::vector<BaseShape*> shapes = Serialization::DeserializeShapes(message.substr(1));
+	void TranslateSnapshot(const std::uint8_t* payload, std::size_t size) override {
+		SnapshotReader reader;
+		if (!reader.Parse(payload, size)) {
+			return;
+		}
+		fullSnapshot.tick = reader.GetTick();
+		fullSnapshot.bodies.clear();
+		for (std::uint32_t i = 0; i < reader.GetBodyCount(); i++) {
+			fullSnapshot.bodies.push_back(reader.GetBody(i));
+		}
+		std::sort(fullSnapshot.bodies.begin(), fullSnapshot.bodies.end(),
+			[](const BodyRecord& a, const BodyRecord& b) { return a.id < b.id; });
+
+		std::lock_guard<std::mutex> lock(snapshotMutex);
+		proxies.Apply(fullSnapshot, objectList.objList);
+		lastSnapshotTick = reader.GetTick();
+	}
+
+	void TranslateDeltaSnapshot(const std::uint8_t* payload, std::size_t size) override {
+		DeltaSnapshotReader reader;
+		if (!reader.ParseHeader(payload, size)) {
+			return;
+		}
+
+		const SnapshotState* baseline = nullptr;
+		if (reader.HasBaseline()) {
+			if (waitingForFullSnapshot) {
+				return; // Already asked, these deltas are on a baseline we do not have
+			}
+			baseline = receivedSnapshots.Find(reader.GetBaselineTick());
+			if (baseline == nullptr) {
+				std::cout << "Missing snapshot baseline " << reader.GetBaselineTick() << ", asking for a full one" << std::endl;
+				waitingForFullSnapshot = true;
+				send_tcp_message("resync");
+				return;
+			}
+		}
+		if (!reader.Apply(baseline, decodedSnapshot, &snapshotQuantizer)) {
+			waitingForFullSnapshot = true;
+			send_tcp_message("resync");
+			return;
+		}
+		waitingForFullSnapshot = false;
+
+		std::lock_guard<std::mutex> lock(snapshotMutex);
+		if (!reader.HasBaseline()) {
+			viewReportNeeded = true;
+			if (reader.GetTick() < lastSnapshotTick) {
+				// The server started over, the old ticks would be interpolated with the new ones
+				receivedSnapshots.Clear();
+				interpolator.Reset();
+				dragPrediction.Clear();
+			}
+		}
+
+		// Into the history only now, the slot may have been the baseline. the swap keeps both vectors' memory
+		SnapshotState& received = receivedSnapshots.Push();
+		std::swap(received, decodedSnapshot);
+		send_tcp_message("ack:" + std::to_string(received.tick));
+		interpolator.OnSnapshot(received.tick, interpolationClock.getElapsedTime().asSeconds());
 
-				// Update the object list with the received shapes
-				objectList.objList = shapes;
+		// Updates the bodies in place, only created/removed ones take or give back a proxy
+		proxies.Apply(received, objectList.objList);
+		lastSnapshotTick = received.tick;
+		dragPrediction.Reconcile(receivedSnapshots, lastSnapshotTick);
+	}
 
+	// The ack comes over TCP, the snapshot it names may be here already or still on its way
+	void TranslateInputAck(std::uint32_t sequence, std::uint32_t tick) override {
+		std::lock_guard<std::mutex> lock(snapshotMutex);
+		dragPrediction.OnAck(sequence, tick);
+		dragPrediction.Reconcile(receivedSnapshots, lastSnapshotTick);
+	}
+
+	// Moves the bodies to where the jitter buffer says they are now, objList is in id order like the snapshots
+	// Called with snapshotMutex held
+	void ApplyInterpolation() {
+		if (!interpolator.Sample(receivedSnapshots, interpolationClock.getElapsedTime().asSeconds(), interpolatedSnapshot)) {
+			return;
+		}
+		std::size_t j = 0;
+		for (BaseShape* obj : objectList.objList) {
+			std::uint32_t id = static_cast<std::uint32_t>(obj->GetID());
+			while (j < interpolatedSnapshot.bodies.size() && interpolatedSnapshot.bodies[j].id < id) {
+				j++;
 			}
-			catch (const std::exception& e) {
-				std::cerr << "Error deserializing shapes: " << e.what() << std::endl;
+			if (j < interpolatedSnapshot.bodies.size() && interpolatedSnapshot.bodies[j].id == id) {
+				obj->SetPosition(interpolatedSnapshot.bodies[j].position);
 			}
 		}
+	}
+
+	void TranslateMessage(const std::string& message) override {
 		// Handle regular string messages
-		else if (message.starts_with("broadcast:")) {
+		if (message.starts_with("broadcast:")) {
 			std::string broadcastMessage = message.substr(10); // Remove "broadcast:" prefix
 			/*std::cout << "[Broadcast] " << broadcastMessage << std::endl;*/
 		}
@@ -105,6 +190,21 @@ private:
 	// Physics and simulation parameters
 	float lineLength = 45;
 	ObjectsList objectList;
+	WorldRenderer worldRenderer; // Draws objectList, the simulation itself does not know SFML graphics
+	std::uint32_t lastSnapshotTick = 0;
+	SnapshotHistory receivedSnapshots = SnapshotHistory(32); // Baselines the server can send deltas against
+	SnapshotState decodedSnapshot;
+	Quantizer snapshotQuantizer; // Keeps the size/mass/color tables the server sent
+	SnapshotInterpolator interpolator; // Draws between the snapshots, the server sends them at 20 Hz
+	SnapshotState interpolatedSnapshot;
+	SnapshotState fullSnapshot; // Scratch for the console's full snapshots
+	SnapshotProxyPool proxies; // Owns the free bodies, objectList.objList holds the ones in use
+	DragPrediction dragPrediction; // The dragged body is drawn where the mouse is, not where the last snapshot had it
+	sf::Clock interpolationClock;
+	std::mutex snapshotMutex; // receivedSnapshots, dragPrediction and objList, the io thread fills them and the render thread draws
+	bool waitingForFullSnapshot = false;
+	SimRect reportedView; // Last view sent to the server
+	std::atomic<bool> viewReportNeeded = false; // Set by a full snapshot, a new connection does not know the view yet
 	float deltaTime = 1.0f / 60.0f;
 	float elastic = 0.0;
 	int objCount = 0;
@@ -125,24 +225,22 @@ private:
 	bool freeze = false;
 	int typeOfLink = 1;
 	float textureResizer = 1.2;
-	// Object pointers for interaction
-	BaseShape* thisBallPointer = nullptr;
+	// Objects for interaction, by id: the bodies are proxies of the snapshots, the pool reuses and frees them
 	int previousBallID = -1;
 	int thisObjID = -1;
-	BaseShape* connecttableBallPointer = nullptr;
 	int connecttableObjID = -1;
 	int previousConnecttableObjID = -1;
 	// Visual settings
-	sf::Color ball_color = sf::Color(238, 238, 238);
-	sf::Color proton_color = sf::Color(255, 222, 33);
-	sf::Color electron_color = sf::Color(106, 102, 157);
+	SimColor ball_color = SimColor(238, 238, 238);
+	SimColor proton_color = SimColor(255, 222, 33);
+	SimColor electron_color = SimColor(106, 102, 157);
 	sf::Color ball_color2 = sf::Color(50, 5, 11);
 	sf::Color background_color = sf::Color(30, 30, 30);
 	sf::Color buttonColor = sf::Color(55, 58, 64);
 	sf::Color bb = sf::Color(44, 55, 100);
-	sf::Color explosion = sf::Color(205, 92, 8);
-	sf::Color outlineColor = sf::Color(255, 255, 255);
-	sf::Color previousColor = sf::Color(0, 0, 0);
+	SimColor explosion = SimColor(205, 92, 8);
+	SimColor outlineColor = SimColor(255, 255, 255);
+	SimColor previousColor = SimColor(0, 0, 0);
 	sf::Color sideMenuColor = sf::Color(23, 23, 23, 204);
 	//Textures:
 	sf::Texture addButtonTexture;
@@ -187,43 +285,49 @@ private:
 
 
 
+	// The body the left mouse holds, looked up again every time. Called with snapshotMutex held
+	BaseShape* HeldBody() {
+		return thisObjID != -1 ? objectList.FindByID(thisObjID) : nullptr;
+	}
+
 	//Local:
 	void handleMouseClick() override {
 		//Left click:
 		if (sf::Mouse::isButtonPressed(sf::Mouse::Left) && !leftMouseClickFlag) {
+			std::lock_guard<std::mutex> lock(snapshotMutex);
 			thisObjID = objectList.checkIfPointInObjectArea(currentMousePos);
-			thisBallPointer = objectList.FindByID(thisObjID);
+			BaseShape* held = HeldBody();
 
 			// Store the previous object before checking for a new one
 			if (previousBallID == -1) {
 				previousBallID = thisObjID;
 			}
 
-			if (thisObjID != -1) {
+			if (held != nullptr) {
 				leftMouseClickFlag = true; // Set flag if circle found
 				TouchedOnceLeftClick = true;
 
 				window.setMouseCursor(handCursor);
-				thisBallPointer->SetOutline(outlineColor, 5);
+				held->SetOutline(outlineColor, 5);
 				// Store the current color
-				previousColor = thisBallPointer->GetColor();
+				previousColor = held->GetColor();
 				// Darken the color
-				sf::Color currentColor = previousColor;
+				SimColor currentColor = previousColor;
 				currentColor.r = std::max(0, currentColor.r - 15);
 				currentColor.g = std::max(0, currentColor.g - 15);
 				currentColor.b = std::max(0, currentColor.b - 15);
-				thisBallPointer->setColor(currentColor);
+				held->setColor(currentColor);
 			}
 		}
 
 		//Right click:
 		else if (sf::Mouse::isButtonPressed(sf::Mouse::Right) && !rightMouseClickFlag) {
+			std::lock_guard<std::mutex> lock(snapshotMutex);
 			connecttableObjID = objectList.checkIfPointInObjectArea(currentMousePos); // Check if an object is within radius and get its ID
-			connecttableBallPointer = objectList.FindByID(connecttableObjID); // transfer from id to pointer
-			if (connecttableBallPointer != nullptr) { // Check if a circle was found
+			if (connecttableObjID != -1) { // Check if a circle was found
 				if (previousConnecttableObjID == -1)
 				{
-					previousConnecttableObjID = connecttableBallPointer->GetID();
+					previousConnecttableObjID = connecttableObjID;
 				}
 				rightMouseClickFlag = true; // Set flag if circle found
 				window.setMouseCursor(handCursor);
@@ -234,13 +338,20 @@ private:
 	void handleMouseRelase(sf::Event event) override {
 		//Left mouse button:
 		if (event.type == sf::Event::MouseButtonReleased) {
+			std::lock_guard<std::mutex> lock(snapshotMutex);
 			int releasedObjID = objectList.checkIfPointInObjectArea(currentMousePos);
 
+			if (leftMouseClickFlag && thisObjID != -1) {
+				dragPrediction.Release(static_cast<std::uint32_t>(thisObjID));
+			}
+
 			// Only reset visual state if we're releasing the same object we initially clicked
 			if (releasedObjID == thisObjID && thisObjID != -1) {
 				window.setMouseCursor(defaultCursor);
-				thisBallPointer->setColor(previousColor);
-				thisBallPointer->SetOutline(outlineColor, 0);
+				if (BaseShape* held = HeldBody()) {
+					held->setColor(previousColor);
+					held->SetOutline(outlineColor, 0);
+				}
 			}
 
 			leftMouseClickFlag = false;
@@ -257,9 +368,23 @@ private:
 	}
 
 	void handleMouseInteraction() override {
-		if (leftMouseClickFlag && thisBallPointer != nullptr) {
+		bool holding = false;
+		if (leftMouseClickFlag) {
+			std::lock_guard<std::mutex> lock(snapshotMutex);
+			holding = HeldBody() != nullptr; // Gone when it was deleted, or left the view
+		}
+		if (holding) {
 			// Set position of the found ball
-			send_udp_message("NEWP^" + thisBallPointer->GetIDStr() + "#" + Vector2fToString(currentMousePos));
+			Command command;
+			command.op = CommandOp::SetPosition;
+			command.body = static_cast<std::uint32_t>(thisObjID);
+			command.position = currentMousePos;
+			std::uint32_t sequence = send_command(command);
+			{
+				// Drawn there from this frame on, the server's answer only corrects it
+				std::lock_guard<std::mutex> lock(snapshotMutex);
+				dragPrediction.Predict(command.body, command.position, sequence, interpolationClock.getElapsedTime().asSeconds());
+			}
 
 			handleScaling();
 		}
@@ -328,15 +453,23 @@ private:
 		// ** General Actions **
 		keyActions.push_back({ sf::Keyboard::Escape, [&]() {
 			screen = "MAIN MENU";
+			{
+				std::lock_guard<std::mutex> lock(snapshotMutex);
+				proxies.ReleaseAll(objectList.objList);
+				dragPrediction.Clear();
+			}
 			objectList.DeleteAll();
 			objCount = 0;
 			disconnect_from_server();
 		} });
 
 		keyActions.push_back({ sf::Keyboard::BackSpace, [&]() {
-			if (leftMouseClickFlag) {
-				objectList.DeleteThisObj(thisBallPointer);
-				send_tcp_message("DEL^" + thisBallPointer->GetIDStr() + ";");
+			if (leftMouseClickFlag && thisObjID != -1) {
+				// Only asked for, the body is a proxy of the snapshots and the next one without it takes it away
+				Command command;
+				command.op = CommandOp::Delete;
+				command.body = static_cast<std::uint32_t>(thisObjID);
+				send_command(command, true);
 			}
 		} });
 
@@ -350,16 +483,25 @@ private:
 
 		// ** Object Creation **
 		keyActions.push_back({ sf::Keyboard::A, [&]() {
-			send_udp_message("CIR,10;"); // Add circles
+			Command command;
+			command.op = CommandOp::SpawnCircles;
+			command.value = 10;
+			send_command(command); // Add circles
 		} });
 
 		keyActions.push_back({ sf::Keyboard::T, [&]() {
-			send_udp_message("REC,10;"); // Add rectangles
+			Command command;
+			command.op = CommandOp::SpawnRectangles;
+			command.value = 10;
+			send_command(command); // Add rectangles
 		} });
 
 		keyActions.push_back({ sf::Keyboard::L, [&]() {
 			createPlanet();
-			send_udp_message("PLANET*" + Vector2fToString(currentMousePos) + ";");
+			Command command;
+			command.op = CommandOp::SpawnPlanet;
+			command.position = currentMousePos;
+			send_command(command);
 		} });
 
 		keyActions.push_back({ sf::Keyboard::Q, [&]() {
@@ -372,16 +514,26 @@ private:
 		} });
 
 		keyActions.push_back({ sf::Keyboard::F, [&]() {
-			send_udp_message("EXPLOSION:CIR*" + Vector2fToString(currentMousePos) + ";");
+			Command command;
+			command.op = CommandOp::Explosion;
+			command.value = static_cast<std::int32_t>(ExplosionShape::Circle);
+			command.position = currentMousePos;
+			send_command(command);
 		} });
 
 		keyActions.push_back({ sf::Keyboard::J, [&]() {
-			send_udp_message("EXPLOSION:REC*" + Vector2fToString(currentMousePos) + ";");
+			Command command;
+			command.op = CommandOp::Explosion;
+			command.value = static_cast<std::int32_t>(ExplosionShape::Rectangle);
+			command.position = currentMousePos;
+			send_command(command);
 		} });
 
 		// ** Linking and Simulation **
 		keyActions.push_back({ sf::Keyboard::H, [&]() {
-			send_udp_message("LINK:RND;");
+			Command command;
+			command.op = CommandOp::LinkRandom;
+			send_command(command);
 		} });
 
 		keyActions.push_back({ sf::Keyboard::Num0, [&]() {
@@ -415,7 +567,11 @@ private:
 
 		keyActions.push_back({ sf::Keyboard::K, [&]() {
 			createConnectedObjMode = !createConnectedObjMode;
-			previousBallID = thisBallPointer->GetID();
+			previousBallID = thisObjID;
+		} });
+
+		keyActions.push_back({ sf::Keyboard::O, [&]() {
+			worldRenderer.lodRenderer.ToggleEnabled(); // Level of detail rendering
 		} });
 
 		// ** Particle Type Switches **
@@ -439,7 +595,7 @@ private:
 
 	void ToggleChainMode() {
 		createChain = !createChain;
-		previousBallID = thisBallPointer->GetID();
+		previousBallID = thisObjID;
 	}
 
 	void handleKeyPress(sf::Event event) override {
@@ -457,23 +613,34 @@ private:
 
 	void handleScaling() override {
 		if (scaleFlag && (mouseFlagScroll == 1 || mouseFlagScroll == -1)) {
-			if (Circle* circle = dynamic_cast<Circle*>(thisBallPointer)) {
-				send_udp_message("SCALE@CIR@" + circle->GetIDStr() + "@" + std::to_string(mouseScrollPower) + "@" + std::to_string(mouseFlagScroll));
-			}
-			else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(thisBallPointer))
+			bool scalable = false;
 			{
-				send_udp_message("SCALE@REC@" + rectangle->GetIDStr() + "@" + std::to_string(mouseScrollPower) + "@" + std::to_string(mouseFlagScroll));
+				std::lock_guard<std::mutex> lock(snapshotMutex);
+				BaseShape* held = HeldBody();
+				scalable = dynamic_cast<Circle*>(held) || dynamic_cast<RectangleClass*>(held);
+			}
+			if (scalable) {
+				Command command;
+				command.op = CommandOp::Scale;
+				command.body = static_cast<std::uint32_t>(thisObjID);
+				command.value = mouseScrollPower;
+				command.direction = static_cast<std::int8_t>(mouseFlagScroll);
+				send_command(command);
 			}
 			mouseFlagScroll = 0;
 		}
 	}
 
 	void handleConnecting() override {
-		if (connectingMode && connecttableBallPointer->GetID() != previousConnecttableObjID)
+		if (connectingMode && connecttableObjID != -1 && connecttableObjID != previousConnecttableObjID)
 		{
-			std::cout << objectList.FindByID(previousConnecttableObjID)->GetIDStr() << "\n";
-			std::cout << objectList.FindByID(connecttableObjID)->GetIDStr() ;
-			send_tcp_message("LINK&" + objectList.FindByID(previousConnecttableObjID)->GetIDStr() + "&" + objectList.FindByID(connecttableObjID)->GetIDStr());
+			std::cout << previousConnecttableObjID << "\n";
+			std::cout << connecttableObjID;
+			Command command;
+			command.op = CommandOp::Link;
+			command.body = static_cast<std::uint32_t>(previousConnecttableObjID);
+			command.otherBody = static_cast<std::uint32_t>(connecttableObjID);
+			send_command(command, true);
 		}
 	}
 
@@ -508,8 +675,14 @@ private:
 		updateFPS();
 		window.clear(background_color);
 		window.setView(view);
-
-		MoveAndDrawObjects();
+		ReportView();
+		{
+			std::lock_guard<std::mutex> lock(snapshotMutex);
+			ApplyInterpolation();
+			double now = interpolationClock.getElapsedTime().asSeconds();
+			dragPrediction.Apply(objectList.objList, interpolator.RenderTick(now), now);
+			MoveAndDrawObjects();
+		}
 
 		window.setView(window.getDefaultView());
 		renderTexts();
@@ -525,8 +698,24 @@ private:
 		////std::cout << "\033[0m";
 	}
 
+	// The server only sends the bodies around this rectangle, so it is sent whenever the view moves or zooms
+	void ReportView() {
+		sf::Vector2f size = view.getSize();
+		sf::Vector2f corner = view.getCenter() - size / 2.f;
+		SimRect current(corner.x, corner.y, size.x, size.y);
+		bool resend = viewReportNeeded.exchange(false);
+		if (!resend && current.left == reportedView.left && current.top == reportedView.top &&
+			current.width == reportedView.width && current.height == reportedView.height) {
+			return;
+		}
+		reportedView = current;
+		float zoom = size.x / static_cast<float>(window.getSize().x);
+		send_tcp_message("view:" + std::to_string(current.left) + "," + std::to_string(current.top) + "," +
+			std::to_string(current.width) + "," + std::to_string(current.height) + "," + std::to_string(zoom));
+	}
+
 	void MoveAndDrawObjects() override {
-		objectList.DrawObjects(window, currentFPS, planetMode);
+		worldRenderer.Draw(window, objectList);
 	}
 
 	void initializeUI() override {
@@ -665,19 +854,64 @@ void Run(std::string& screen, Client& simulation, MainMenu& mainMenu, Settings&
 	}
 }
 
+// Offline render mode: Engine --render <frames> <png|ppm|raw> <output path> [circles]
+// Steps a scene at a fixed dt and writes every frame to disk, no window and no server
+int RunOfflineRender(int argc, char* argv[]) {
+	OfflineRenderSettings renderSettings;
+	if (argc > 2) renderSettings.frameCount = std::stoi(argv[2]);
+	if (argc > 3) {
+		std::string format = argv[3];
+		if (format == "ppm") renderSettings.format = FrameFormat::PPM;
+		else if (format == "raw") renderSettings.format = FrameFormat::RawStream;
+		else renderSettings.format = FrameFormat::PNG;
+	}
+	if (argc > 4) renderSettings.outputPath = argv[4];
+	int circles = argc > 5 ? std::stoi(argv[5]) : 2000;
+
+	OfflineRender offlineRender(renderSettings);
+	ObjectsList& scene = offlineRender.GetObjectList();
+	SimColor startColor(128, 0, 128); // purple
+	SimColor endColor(0, 0, 255); // blue
+	int columns = renderSettings.width / 20 - 2;
+	for (int i = 0; i < circles; i++) {
+		float t = static_cast<float>(i) / std::max(1, circles - 1);
+		SimColor color(startColor.r + (endColor.r - startColor.r) * t, startColor.g + (endColor.g - startColor.g) * t, startColor.b + (endColor.b - startColor.b) * t);
+		sf::Vector2f pos(20.f + (i % columns) * 20.f, 20.f + (i / columns) * 20.f);
+		scene.CreateNewCircle(1000, color, pos, sf::Vector2f(static_cast<float>(i % 7) - 3, 0));
+	}
+
+	return offlineRender.Run() ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc > 1 && std::string(argv[1]) == "--render") {
+		try {
+			return RunOfflineRender(argc, argv);
+		}
+		catch (const std::exception& error) {
+			std::cerr << "Error: " << error.what() << std::endl;
+			return 1;
+		}
+	}
 
-int main() {
 	try {
 		//NETWORKING:
 		const std::string server_ip = "127.0.0.1";  // or "localhost"
 		unsigned short tcp_port = 8080;
 		unsigned short udp_port = 8081;
+		std::uint32_t room_id = 0; // "--room <id>", the server runs many independent rooms
+		for (int i = 1; i + 1 < argc; i++) {
+			if (std::string(argv[i]) == "--room") {
+				room_id = static_cast<std::uint32_t>(std::stoul(argv[i + 1]));
+			}
+		}
 
 		std::cout << "Starting client..." << std::endl;
 		std::cout << "Attempting to connect to:" << std::endl;
 		std::cout << "Server IP: " << server_ip << std::endl;
 		std::cout << "TCP port: " << tcp_port << std::endl;
 		std::cout << "UDP port: " << udp_port << std::endl;
+		std::cout << "Room: " << room_id << std::endl;
 
 		boost::asio::io_context io_context;
 
@@ -693,7 +927,7 @@ int main() {
 		Settings settingsClass(window);
 		std::string screen = "START";
 
-		Client client(window, io_context, server_ip, tcp_port, udp_port);
+		Client client(window, io_context, server_ip, tcp_port, udp_port, room_id);
 		client.connect();
 
 		// start a thread to run the IO service
@@ -0,0 +1 @@
+#include "CommandProtocol.h"
\ No newline at end of file
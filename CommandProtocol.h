@@ -0,0 +1,464 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cmath>
+#include <charconv>
+#include <algorithm>
+#include <SFML/System/Vector2.hpp>
+#include "NetFrame.h"
+
+// Client -> server commands.
+// The clients send them binary: every command is an opcode, the id of the body it acts on and a payload whose
+// size only depends on the opcode, so the parser walks the message with a table and decodes straight into a
+// Command on the stack, no strings and no allocation. The old text commands ("CIR,10;", "NEWP^id#(x, y)") still
+// work for debugging by hand (netcat, the client console) and are parsed into the same Command.
+//
+// Message layout (little endian):
+//   u8 magic 0xB1 | u16 size of the commands | commands back to back
+//   command: u8 opcode | u32 body id (0 = none) | payload (CommandTable[opcode].payloadSize bytes)
+// A text message never starts with 0xB1, so the first byte tells the server which one it got.
+//
+// The unreliable commands are numbered (the client's input sequence, see DragPrediction.h). A message of them
+// starts with an InputSequence command that carries the newest number in it, the server acknowledges the newest
+// one it applied so the client knows which of its drags a snapshot already shows.
+
+enum class CommandOp : std::uint8_t {
+	None = 0,
+	SpawnCircles = 1,    // value = count                         "CIR,n"
+	SpawnRectangles = 2, // value = count                         "REC,n"
+	SpawnPlanet = 3,     // position                              "PLANET*(x, y)"
+	Explosion = 4,       // value = ExplosionShape, position      "EXPLOSION:CIR*(x, y)"
+	LinkRandom = 5,      //                                       "LINK:RND"
+	Link = 6,            // body, otherBody                       "LINK&id&id"
+	Delete = 7,          // body                                  "DEL^id"
+	SetPosition = 8,     // body, position                        "NEWP^id#(x, y)"
+	Scale = 9,           // body, value = power, direction (1/-1) "SCALE@type@id@power@direction"
+	InputSequence = 10,  // value = input sequence of the commands after it, never reaches the tick (no text form)
+	Count
+};
+
+enum class ExplosionShape : std::int32_t { Circle = 0, Rectangle = 1 };
+
+// One decoded command, the same for both formats. fixed size so it goes through the command ring as is
+struct Command
+{
+	CommandOp op = CommandOp::None;
+	std::int8_t direction = 0;
+	int clientID = 0;           // 0 = the server console / UDP
+	std::uint32_t body = 0;
+	std::uint32_t otherBody = 0;
+	std::int32_t value = 0;
+	sf::Vector2f position;
+	std::uint32_t sequence = 0; // The client's input number, 0 = none (reliable and text commands)
+};
+
+// Bodies one spawn command may ask for. The count comes off the network, one "CIR,100000000" would stall the room
+constexpr std::int32_t MaxSpawnCount = 100;
+
+// Whether the simulation can run a decoded command: positions it can use, spawn counts 1..MaxSpawnCount
+inline bool IsValidCommand(const Command& command) {
+	if (!std::isfinite(command.position.x) || !std::isfinite(command.position.y)) {
+		return false;
+	}
+	if (command.op == CommandOp::SpawnCircles || command.op == CommandOp::SpawnRectangles) {
+		return command.value >= 1 && command.value <= MaxSpawnCount;
+	}
+	return true;
+}
+
+// What follows the body id
+enum class CommandPayload : std::uint8_t {
+	None,          // 0 bytes
+	Value,         // i32 value
+	Position,      // f32 x | f32 y
+	ValuePosition, // i32 value | f32 x | f32 y
+	OtherBody,     // u32 other body id
+	Scale          // i32 value | i8 direction
+};
+
+struct CommandLayout
+{
+	const char* name;
+	CommandPayload payload;
+	std::uint8_t payloadSize;
+};
+
+// By opcode
+inline constexpr std::array<CommandLayout, static_cast<std::size_t>(CommandOp::Count)> CommandTable = { {
+	{ "NONE", CommandPayload::None, 0 },
+	{ "CIR", CommandPayload::Value, 4 },
+	{ "REC", CommandPayload::Value, 4 },
+	{ "PLANET", CommandPayload::Position, 8 },
+	{ "EXPLOSION", CommandPayload::ValuePosition, 12 },
+	{ "LINK:RND", CommandPayload::None, 0 },
+	{ "LINK", CommandPayload::OtherBody, 4 },
+	{ "DEL", CommandPayload::None, 0 },
+	{ "NEWP", CommandPayload::Position, 8 },
+	{ "SCALE", CommandPayload::Scale, 5 },
+	{ "SEQ", CommandPayload::Value, 4 }
+} };
+
+constexpr std::uint8_t CommandMagic = 0xB1;
+constexpr std::size_t CommandMessageHeaderSize = 3;
+constexpr std::size_t CommandHeaderSize = 5; // Opcode and body id
+constexpr std::size_t MaxCommandMessageSize = CommandMessageHeaderSize + 0xFFFF;
+
+inline bool IsBinaryCommandMessage(const std::uint8_t* data, std::size_t size) {
+	return size > 0 && data[0] == CommandMagic;
+}
+
+// Builds one command message, the buffer is kept between messages
+class CommandWriter
+{
+private:
+	std::vector<std::uint8_t> buffer;
+
+public:
+	CommandWriter() { Clear(); }
+
+	void Clear() {
+		buffer.assign(CommandMessageHeaderSize, 0);
+		buffer[0] = CommandMagic;
+	}
+
+	// false when the message is full or the opcode is unknown
+	bool Add(const Command& command) {
+		std::size_t index = static_cast<std::size_t>(command.op);
+		if (command.op == CommandOp::None || index >= CommandTable.size()) {
+			return false;
+		}
+		const CommandLayout& layout = CommandTable[index];
+		std::size_t offset = buffer.size();
+		if (offset + CommandHeaderSize + layout.payloadSize > MaxCommandMessageSize) {
+			return false;
+		}
+		buffer.resize(offset + CommandHeaderSize + layout.payloadSize);
+		std::uint8_t* out = buffer.data() + offset;
+		Wire::PutU8(out, static_cast<std::uint8_t>(command.op));
+		Wire::PutU32(out + 1, command.body);
+		out += CommandHeaderSize;
+		switch (layout.payload) {
+		case CommandPayload::None:
+			break;
+		case CommandPayload::Value:
+			Wire::PutU32(out, static_cast<std::uint32_t>(command.value));
+			break;
+		case CommandPayload::Position:
+			Wire::PutF32(out, command.position.x);
+			Wire::PutF32(out + 4, command.position.y);
+			break;
+		case CommandPayload::ValuePosition:
+			Wire::PutU32(out, static_cast<std::uint32_t>(command.value));
+			Wire::PutF32(out + 4, command.position.x);
+			Wire::PutF32(out + 8, command.position.y);
+			break;
+		case CommandPayload::OtherBody:
+			Wire::PutU32(out, command.otherBody);
+			break;
+		case CommandPayload::Scale:
+			Wire::PutU32(out, static_cast<std::uint32_t>(command.value));
+			Wire::PutU8(out + 4, static_cast<std::uint8_t>(command.direction));
+			break;
+		}
+		Wire::PutU16(buffer.data() + 1, static_cast<std::uint16_t>(buffer.size() - CommandMessageHeaderSize));
+		return true;
+	}
+
+	// The commands added after it are applied as input number sequence
+	bool AddSequence(std::uint32_t sequence) {
+		Command command;
+		command.op = CommandOp::InputSequence;
+		command.value = static_cast<std::int32_t>(sequence);
+		return Add(command);
+	}
+
+	bool Empty() const { return buffer.size() == CommandMessageHeaderSize; }
+
+	const std::vector<std::uint8_t>& Message() const { return buffer; }
+};
+
+// The server reads a datagram into this many bytes, a message sent in one must fit
+constexpr std::size_t MaxCommandDatagramSize = 1024;
+
+inline std::size_t EncodedCommandSize(CommandOp op) {
+	return CommandHeaderSize + CommandTable[static_cast<std::size_t>(op)].payloadSize;
+}
+
+// The unreliable commands of one client between two sends. A drag only needs where the body is now, so a newer
+// SetPosition of a body replaces the one waiting (and takes its input number along); the wheel ticks on a body add
+// up to one Scale. The newest goes to the end and the one it replaces is only marked, so nothing moves ahead of a
+// command that came between them (a Link or Delete of the body). Flush then packs everything into as few
+// datagrams as it fits in, each led by the newest input number in it
+class CommandCoalescer
+{
+private:
+	std::vector<Command> pending; // Scale keeps the signed sum of power * direction in value until Flush, op None: replaced
+	std::size_t coalesced = 0;
+
+	Command* FindPending(CommandOp op, std::uint32_t body) {
+		for (Command& command : pending) {
+			if (command.op == op && command.body == body) {
+				return &command;
+			}
+		}
+		return nullptr;
+	}
+
+public:
+	void Add(const Command& command) {
+		Command newest = command;
+		if (command.op == CommandOp::Scale) {
+			newest.value = command.value * (command.direction < 0 ? -1 : 1);
+		}
+		if (command.op == CommandOp::SetPosition || command.op == CommandOp::Scale) {
+			if (Command* waiting = FindPending(command.op, command.body)) {
+				newest.sequence = std::max(waiting->sequence, command.sequence);
+				if (command.op == CommandOp::Scale) {
+					newest.value += waiting->value;
+				}
+				waiting->op = CommandOp::None;
+				coalesced++;
+			}
+		}
+		pending.push_back(newest);
+	}
+
+	bool Empty() const { return pending.empty(); }
+	// Commands that were folded into another one, never sent
+	std::size_t Coalesced() const { return coalesced; }
+
+	// Calls send(const std::vector<std::uint8_t>&) with each message, every one fits a datagram
+	template<typename Send>
+	void Flush(CommandWriter& writer, Send&& send) {
+		pending.erase(std::remove_if(pending.begin(), pending.end(), [](const Command& command) {
+			return command.op == CommandOp::None || (command.op == CommandOp::Scale && command.value == 0); // Replaced, or up and down as much
+			}), pending.end());
+		for (Command& command : pending) {
+			if (command.op == CommandOp::Scale) {
+				command.direction = command.value < 0 ? -1 : 1;
+				command.value = std::abs(command.value);
+			}
+		}
+		// The commands of a datagram are known before it is written, its number is the newest of them
+		std::size_t first = 0;
+		while (first < pending.size()) {
+			std::size_t size = CommandMessageHeaderSize + EncodedCommandSize(CommandOp::InputSequence);
+			std::uint32_t sequence = 0;
+			std::size_t last = first;
+			for (; last < pending.size() && (last == first || size + EncodedCommandSize(pending[last].op) <= MaxCommandDatagramSize); last++) {
+				size += EncodedCommandSize(pending[last].op);
+				sequence = std::max(sequence, pending[last].sequence);
+			}
+			writer.Clear();
+			if (sequence != 0) {
+				writer.AddSequence(sequence);
+			}
+			for (std::size_t i = first; i < last; i++) {
+				writer.Add(pending[i]);
+			}
+			send(writer.Message());
+			first = last;
+		}
+		pending.clear();
+	}
+};
+
+// Bytes of the whole message (header included) when the header is there, 0 when more bytes are needed
+inline std::size_t BinaryCommandMessageSize(const std::uint8_t* data, std::size_t size) {
+	if (size < CommandMessageHeaderSize) {
+		return 0;
+	}
+	return CommandMessageHeaderSize + Wire::GetU16(data + 1);
+}
+
+// Calls visit(const Command&) for every command of a binary message, the ones IsValidCommand turns down are
+// skipped and counted in rejected. false when the message is cut or has an unknown opcode, the commands before
+// that were visited
+template<typename F>
+bool ParseCommands(const std::uint8_t* data, std::size_t size, int clientID, F&& visit, std::size_t* rejected = nullptr) {
+	if (!IsBinaryCommandMessage(data, size) || BinaryCommandMessageSize(data, size) != size) {
+		return false;
+	}
+	const std::uint8_t* in = data + CommandMessageHeaderSize;
+	const std::uint8_t* end = data + size;
+	std::uint32_t sequence = 0;
+	while (in < end) {
+		std::size_t index = Wire::GetU8(in);
+		if (index == 0 || index >= CommandTable.size()) {
+			return false;
+		}
+		const CommandLayout& layout = CommandTable[index];
+		if (static_cast<std::size_t>(end - in) < CommandHeaderSize + layout.payloadSize) {
+			return false;
+		}
+		Command command;
+		command.op = static_cast<CommandOp>(index);
+		command.clientID = clientID;
+		command.body = Wire::GetU32(in + 1);
+		in += CommandHeaderSize;
+		switch (layout.payload) {
+		case CommandPayload::None:
+			break;
+		case CommandPayload::Value:
+			command.value = static_cast<std::int32_t>(Wire::GetU32(in));
+			break;
+		case CommandPayload::Position:
+			command.position = sf::Vector2f(Wire::GetF32(in), Wire::GetF32(in + 4));
+			break;
+		case CommandPayload::ValuePosition:
+			command.value = static_cast<std::int32_t>(Wire::GetU32(in));
+			command.position = sf::Vector2f(Wire::GetF32(in + 4), Wire::GetF32(in + 8));
+			break;
+		case CommandPayload::OtherBody:
+			command.otherBody = Wire::GetU32(in);
+			break;
+		case CommandPayload::Scale:
+			command.value = static_cast<std::int32_t>(Wire::GetU32(in));
+			command.direction = static_cast<std::int8_t>(Wire::GetU8(in + 4));
+			break;
+		}
+		in += layout.payloadSize;
+		if (command.op == CommandOp::InputSequence) {
+			sequence = static_cast<std::uint32_t>(command.value);
+			continue;
+		}
+		command.sequence = sequence;
+		if (!IsValidCommand(command)) {
+			if (rejected) {
+				(*rejected)++;
+			}
+			continue;
+		}
+		visit(command);
+	}
+	return true;
+}
+
+// The text format, for debugging. Same grammar the server always read, without the string copies
+namespace CommandText
+{
+	inline std::string_view Trim(std::string_view text) {
+		while (!text.empty() && (text.front() == ' ' || text.front() == '\r' || text.front() == '\n')) {
+			text.remove_prefix(1);
+		}
+		while (!text.empty() && (text.back() == ' ' || text.back() == '\r' || text.back() == '\n')) {
+			text.remove_suffix(1);
+		}
+		return text;
+	}
+
+	// Cuts text at the first separator, returns what was before it
+	inline std::string_view Next(std::string_view& text, char separator) {
+		std::size_t end = text.find(separator);
+		std::string_view part = text.substr(0, end);
+		text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+		return part;
+	}
+
+	template<typename T>
+	bool Number(std::string_view text, T& value) {
+		text = Trim(text);
+		if (!text.empty() && text.front() == '+') {
+			text.remove_prefix(1);
+		}
+		auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+		return result.ec == std::errc() && result.ptr == text.data() + text.size();
+	}
+
+	// "(x, y)"
+	inline bool Vector(std::string_view text, sf::Vector2f& vector) {
+		text = Trim(text);
+		if (text.size() < 2 || text.front() != '(' || text.back() != ')') {
+			return false;
+		}
+		text = text.substr(1, text.size() - 2);
+		std::string_view x = Next(text, ',');
+		return Number(x, vector.x) && Number(text, vector.y) && std::isfinite(vector.x) && std::isfinite(vector.y);
+	}
+}
+
+// One text command (already cut at ';'). false when it is not one the server knows
+inline bool ParseTextCommand(std::string_view text, int clientID, Command& command) {
+	using namespace CommandText;
+	command = Command();
+	command.clientID = clientID;
+	text = Trim(text);
+
+	if (text.find('@') != std::string_view::npos) {
+		// SCALE@type@id@power@direction, the type is what the body already is
+		std::string_view event = Next(text, '@');
+		Next(text, '@');
+		std::string_view id = Next(text, '@');
+		std::string_view power = Next(text, '@');
+		int direction = 0;
+		if (event != "SCALE" || !Number(id, command.body) || !Number(power, command.value) || !Number(text, direction)) {
+			return false;
+		}
+		command.op = CommandOp::Scale;
+		command.direction = static_cast<std::int8_t>(direction);
+		return true;
+	}
+	if (text.find('^') != std::string_view::npos) {
+		std::string_view event = Next(text, '^');
+		if (event == "NEWP") {
+			std::string_view id = Next(text, '#');
+			command.op = CommandOp::SetPosition;
+			return Number(id, command.body) && Vector(text, command.position);
+		}
+		if (event == "DEL") {
+			command.op = CommandOp::Delete;
+			return Number(text, command.body);
+		}
+		return false;
+	}
+	if (text.find('&') != std::string_view::npos) {
+		std::string_view event = Next(text, '&');
+		std::string_view first = Next(text, '&');
+		command.op = CommandOp::Link;
+		return event == "LINK" && Number(first, command.body) && Number(text, command.otherBody);
+	}
+	if (text.find(':') != std::string_view::npos) {
+		std::string_view event = Next(text, ':');
+		if (event == "LINK" && Trim(text) == "RND") {
+			command.op = CommandOp::LinkRandom;
+			return true;
+		}
+		if (event == "EXPLOSION") {
+			std::string_view type = Trim(Next(text, '*'));
+			command.op = CommandOp::Explosion;
+			if (type == "CIR") {
+				command.value = static_cast<std::int32_t>(ExplosionShape::Circle);
+			}
+			else if (type == "REC") {
+				command.value = static_cast<std::int32_t>(ExplosionShape::Rectangle);
+			}
+			else {
+				return false;
+			}
+			return Vector(text, command.position);
+		}
+		return false;
+	}
+	if (text.find(',') != std::string_view::npos && text.find('(') == std::string_view::npos) {
+		std::string_view event = Next(text, ',');
+		if (event == "CIR") {
+			command.op = CommandOp::SpawnCircles;
+		}
+		else if (event == "REC") {
+			command.op = CommandOp::SpawnRectangles;
+		}
+		else {
+			return false;
+		}
+		return Number(text, command.value) && IsValidCommand(command);
+	}
+	if (text.find('*') != std::string_view::npos) {
+		std::string_view event = Next(text, '*');
+		command.op = CommandOp::SpawnPlanet;
+		return event == "PLANET" && Vector(text, command.position);
+	}
+	return false;
+}
@@ -0,0 +1 @@
+#include "CommandQueue.h"
\ No newline at end of file
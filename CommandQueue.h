@@ -0,0 +1,164 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <new>
+#include <unordered_set>
+#include "CommandProtocol.h"
+
+// Commands from the network threads to the simulation thread.
+// Bounded ring, many producers (the io threads) and one consumer (the simulation loop). Every slot has a sequence
+// number that says whose turn it is, so a producer only needs one compare-exchange on the write position and the
+// consumer none at all. Nobody waits on a lock, a full ring drops the command instead of blocking the io thread.
+template<typename T>
+class MpscRing
+{
+private:
+	struct Slot
+	{
+		std::atomic<std::size_t> sequence;
+		T value;
+	};
+
+	std::vector<Slot> slots;
+	std::size_t mask;
+	alignas(64) std::atomic<std::size_t> writePosition{ 0 }; // Own cache lines, the producers and the consumer
+	alignas(64) std::size_t readPosition = 0;                 // do not invalidate each other's
+
+public:
+	// capacity is rounded up to a power of two
+	MpscRing(std::size_t capacity = 4096) {
+		std::size_t size = 2;
+		while (size < capacity) {
+			size *= 2;
+		}
+		slots = std::vector<Slot>(size);
+		for (std::size_t i = 0; i < size; i++) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		mask = size - 1;
+	}
+
+	// Any thread. false when the ring is full
+	bool TryPush(const T& value) {
+		std::size_t position = writePosition.load(std::memory_order_relaxed);
+		while (true) {
+			Slot& slot = slots[position & mask];
+			std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+			if (difference == 0) {
+				if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					slot.value = value;
+					slot.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0) {
+				return false; // The consumer has not read this slot yet
+			}
+			else {
+				position = writePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Only the consumer thread
+	bool TryPop(T& value) {
+		Slot& slot = slots[readPosition & mask];
+		std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence != readPosition + 1) {
+			return false; // Empty, or the producer of this slot is still writing it
+		}
+		value = slot.value;
+		slot.sequence.store(readPosition + slots.size(), std::memory_order_release);
+		readPosition++;
+		return true;
+	}
+
+	std::size_t Capacity() const { return slots.size(); }
+};
+
+// The commands one tick drained. Only the newest SetPosition of a body matters, it is where the body ends up
+// this tick, so the older ones (from a client that sends faster than the server ticks, or several clients on one
+// body) are dropped before anything looks the body up
+class TickCommands
+{
+private:
+	std::vector<Command> commands;
+	std::unordered_set<std::uint32_t> moved; // Kept, so its buckets are reused every tick
+
+public:
+	void Clear() { commands.clear(); }
+	void Push(const Command& command) { commands.push_back(command); }
+	std::size_t Size() const { return commands.size(); }
+
+	// The number dropped. The rest keep their order
+	std::size_t DropSuperseded() {
+		moved.clear();
+		std::size_t dropped = 0;
+		for (auto it = commands.rbegin(); it != commands.rend(); ++it) {
+			if (it->op == CommandOp::SetPosition && !moved.insert(it->body).second) {
+				it->op = CommandOp::None;
+				dropped++;
+			}
+		}
+		return dropped;
+	}
+
+	template<typename F>
+	void ForEach(F&& visit) const {
+		for (const Command& command : commands) {
+			if (command.op != CommandOp::None) {
+				visit(command);
+			}
+		}
+	}
+};
+
+// How a message went into the ring
+struct PushResult
+{
+	std::size_t pushed = 0;
+	std::size_t dropped = 0; // Ring full
+	std::size_t invalid = 0; // Not a command the server knows or can run (IsValidCommand), or a broken binary message
+};
+
+// The commands of one text message (cut at ';') into the ring
+inline PushResult PushTextCommands(MpscRing<Command>& ring, std::string_view message, int clientID) {
+	PushResult result;
+	while (!message.empty()) {
+		std::string_view text = CommandText::Trim(CommandText::Next(message, ';'));
+		if (text.empty()) {
+			continue;
+		}
+		Command command;
+		if (!ParseTextCommand(text, clientID, command)) {
+			result.invalid++;
+		}
+		else if (ring.TryPush(command)) {
+			result.pushed++;
+		}
+		else {
+			result.dropped++;
+		}
+	}
+	return result;
+}
+
+// The commands of one binary message into the ring, decoded on the io thread
+inline PushResult PushBinaryCommands(MpscRing<Command>& ring, const std::uint8_t* data, std::size_t size, int clientID) {
+	PushResult result;
+	bool complete = ParseCommands(data, size, clientID, [&](const Command& command) {
+		if (ring.TryPush(command)) {
+			result.pushed++;
+		}
+		else {
+			result.dropped++;
+		}
+		}, &result.invalid);
+	if (!complete) {
+		result.invalid++;
+	}
+	return result;
+}
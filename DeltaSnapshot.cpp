@@ -0,0 +1 @@
+#include "DeltaSnapshot.h"
\ No newline at end of file
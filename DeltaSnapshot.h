@@ -0,0 +1,481 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+#include "NetFrame.h"
+#include "Snapshot.h"
+#include "Quantization.h"
+
+// Delta snapshots: only the bodies that were created, removed or changed since a baseline the client
+// acknowledged, with a bit mask of the fields that changed.
+//
+// Layout (little endian), after the NetFrame header:
+//   header, 24 bytes:
+//     u16 magic 'D''S' | u8 version | u8 0 | u32 tick | u32 baseline tick | u32 body count after applying |
+//     u32 entry count | u32 DeltaSnapshotFormat flags
+//   baseline tick is NoBaseline for a full snapshot (every body is an entry with every field)
+//   entries, sorted by id:
+//     u32 id | u8 DeltaField mask | the fields in the mask, in the order of the bits:
+//       Position f32 x, f32 y | Velocity f32 x, f32 y | Color u8 r, g, b | Size f32 x, f32 y | Mass f32 |
+//       KindAndLinked u8 kind, i8 linked
+//   Removed has no fields. a body that is not in the baseline must come with every field.
+//
+// With the Quantized flag the header is followed by the quantizer config and the table entries added since the
+// baseline (see Quantizer::WriteTables), and the entries are one bit stream:
+//   varint id - previous id | 7 bit mask (the fields, Removed is bit 6) | the fields in the config bit sizes,
+//   sizes/masses/colors as table indices. velocity and mass are left out when their bit size is 0.
+//   Position and velocity start with a bit, set when they are out of the config range and follow as f32 x, f32 y.
+
+struct DeltaSnapshotFormat
+{
+	static constexpr std::uint16_t Magic = 0x5344; // "DS"
+	static constexpr std::uint8_t Version = 3; // 2 added the flags, 3 the out of range bit of quantized entries
+	static constexpr std::uint32_t QuantizedFlag = 1;
+	static constexpr std::size_t HeaderSize = 24;
+	static constexpr std::size_t MaxEntrySize = 5 + 38; // id + mask + every field
+	static constexpr std::uint32_t NoBaseline = 0xFFFFFFFF;
+};
+
+// The whole world at one tick, bodies sorted by id so two states can be compared in one pass
+struct SnapshotState
+{
+	std::uint32_t tick = 0;
+	std::vector<BodyRecord> bodies;
+	QuantTableSizes tableSizes; // How far the quantizer tables were filled, for sending only the new entries
+
+	// With a quantizer the bodies are snapped to what the client decodes, so the deltas only carry real changes
+	void Capture(std::uint32_t newTick, const std::vector<BaseShape*>& objList, Quantizer* quantizer = nullptr) {
+		tick = newTick;
+		bodies.clear();
+		for (BaseShape* obj : objList) {
+			bodies.push_back(BodyRecord::FromShape(obj));
+		}
+		Finish(quantizer);
+	}
+
+	// The same from bodies that are records already (the merged world of the shards on the coordinator)
+	void CaptureRecords(std::uint32_t newTick, const std::vector<BodyRecord>& records, Quantizer* quantizer = nullptr) {
+		tick = newTick;
+		bodies.assign(records.begin(), records.end());
+		Finish(quantizer);
+	}
+
+private:
+	void Finish(Quantizer* quantizer) {
+		if (quantizer) {
+			for (BodyRecord& record : bodies) {
+				quantizer->Snap(record);
+			}
+			tableSizes = quantizer->GetTableSizes();
+		}
+		auto byID = [](const BodyRecord& a, const BodyRecord& b) { return a.id < b.id; };
+		if (!std::is_sorted(bodies.begin(), bodies.end(), byID)) { // objList is mostly in creation order already
+			std::sort(bodies.begin(), bodies.end(), byID);
+		}
+	}
+};
+
+// The last few states, the server keeps them as baselines and the client keeps them to apply deltas to.
+// The slots and their body vectors are reused, a full ring does not allocate
+class SnapshotHistory
+{
+private:
+	std::vector<SnapshotState> states;
+	std::vector<bool> used;
+	std::size_t next = 0;
+
+public:
+	SnapshotHistory(std::size_t capacity = 32) : states(capacity), used(capacity, false) {}
+
+	// The slot for a new state, it replaces the oldest one
+	SnapshotState& Push() {
+		SnapshotState& state = states[next];
+		used[next] = true;
+		next = (next + 1) % states.size();
+		return state;
+	}
+
+	const SnapshotState* Find(std::uint32_t tick) const {
+		for (std::size_t i = 0; i < states.size(); i++) {
+			if (used[i] && states[i].tick == tick) {
+				return &states[i];
+			}
+		}
+		return nullptr;
+	}
+
+	// The newest state at or before tick and the oldest one after it, nullptr when there is none
+	void FindAround(double tick, const SnapshotState*& before, const SnapshotState*& after) const {
+		before = nullptr;
+		after = nullptr;
+		for (std::size_t i = 0; i < states.size(); i++) {
+			if (!used[i]) {
+				continue;
+			}
+			const SnapshotState& state = states[i];
+			if (state.tick <= tick) {
+				if (!before || state.tick > before->tick) before = &state;
+			}
+			else if (!after || state.tick < after->tick) {
+				after = &state;
+			}
+		}
+	}
+
+	void Clear() {
+		std::fill(used.begin(), used.end(), false);
+		next = 0;
+	}
+};
+
+class DeltaSnapshotWriter
+{
+private:
+	FramePool pool;
+
+	static std::uint8_t ChangedFields(const BodyRecord& now, const BodyRecord& before) {
+		std::uint8_t mask = 0;
+		if (now.position != before.position) mask |= DeltaPosition;
+		if (now.velocity != before.velocity) mask |= DeltaVelocity;
+		if (now.color != before.color) mask |= DeltaColor;
+		if (now.size != before.size) mask |= DeltaSize;
+		if (now.mass != before.mass) mask |= DeltaMass;
+		if (now.kind != before.kind || now.linked != before.linked) mask |= DeltaKindAndLinked;
+		return mask;
+	}
+
+	static std::uint8_t* WriteEntry(std::uint8_t* out, const BodyRecord& record, std::uint8_t mask) {
+		Wire::PutU32(out, record.id);
+		Wire::PutU8(out + 4, mask);
+		out += 5;
+		if (mask & DeltaPosition) {
+			Wire::PutF32(out, record.position.x);
+			Wire::PutF32(out + 4, record.position.y);
+			out += 8;
+		}
+		if (mask & DeltaVelocity) {
+			Wire::PutF32(out, record.velocity.x);
+			Wire::PutF32(out + 4, record.velocity.y);
+			out += 8;
+		}
+		if (mask & DeltaColor) {
+			out[0] = record.color.r;
+			out[1] = record.color.g;
+			out[2] = record.color.b;
+			out += 3;
+		}
+		if (mask & DeltaSize) {
+			Wire::PutF32(out, record.size.x);
+			Wire::PutF32(out + 4, record.size.y);
+			out += 8;
+		}
+		if (mask & DeltaMass) {
+			Wire::PutF32(out, record.mass);
+			out += 4;
+		}
+		if (mask & DeltaKindAndLinked) {
+			out[0] = static_cast<std::uint8_t>(record.kind);
+			out[1] = static_cast<std::uint8_t>(record.linked);
+			out += 2;
+		}
+		return out;
+	}
+
+	static void WriteQuantizedEntry(BitWriter& writer, Quantizer& quantizer, const BodyRecord& record, std::uint8_t mask, std::uint32_t& previousID) {
+		writer.WriteVarint(record.id - previousID);
+		writer.Write((mask & DeltaAllFields) | ((mask & DeltaRemoved) ? 0x40 : 0), 7);
+		quantizer.WriteFields(writer, record, mask);
+		previousID = record.id;
+	}
+
+public:
+	// baseline nullptr = full snapshot. With a quantizer the states must have been captured with the same one.
+	// Returns the whole NetFrame, header included
+	SharedFrame Write(const SnapshotState& current, const SnapshotState* baseline, Quantizer* quantizer = nullptr) {
+		static const std::vector<BodyRecord> noBodies;
+		const std::vector<BodyRecord>& before = baseline ? baseline->bodies : noBodies;
+
+		std::shared_ptr<std::vector<std::uint8_t>> buffer = pool.Take();
+		std::size_t worstCase = NetFrame::HeaderSize + DeltaSnapshotFormat::HeaderSize +
+			(current.bodies.size() + before.size()) * DeltaSnapshotFormat::MaxEntrySize;
+		QuantTableSizes tablesBefore = baseline ? baseline->tableSizes : QuantTableSizes();
+		if (quantizer) {
+			worstCase += quantizer->TablesWireSize(tablesBefore, current.tableSizes);
+		}
+		buffer->resize(worstCase); // The pooled buffers keep their capacity, only the first ticks allocate
+
+		std::uint8_t* start = buffer->data() + NetFrame::HeaderSize;
+		std::uint8_t* out = start + DeltaSnapshotFormat::HeaderSize;
+		std::uint32_t entryCount = 0;
+
+		BitWriter bits(nullptr);
+		std::uint32_t previousID = 0;
+		if (quantizer) {
+			out = quantizer->WriteTables(out, tablesBefore, current.tableSizes);
+			bits = BitWriter(out);
+		}
+		auto writeEntry = [&](const BodyRecord& record, std::uint8_t mask) {
+			if (quantizer) {
+				WriteQuantizedEntry(bits, *quantizer, record, mask, previousID);
+			}
+			else {
+				out = WriteEntry(out, record, mask);
+			}
+			entryCount++;
+		};
+
+		// Both lists are sorted by id, one pass finds the created, removed and changed bodies
+		std::size_t i = 0;
+		std::size_t j = 0;
+		while (i < current.bodies.size() || j < before.size()) {
+			if (j == before.size() || (i < current.bodies.size() && current.bodies[i].id < before[j].id)) {
+				writeEntry(current.bodies[i], DeltaAllFields);
+				i++;
+			}
+			else if (i == current.bodies.size() || before[j].id < current.bodies[i].id) {
+				writeEntry(before[j], DeltaRemoved);
+				j++;
+			}
+			else {
+				std::uint8_t mask = ChangedFields(current.bodies[i], before[j]);
+				if (mask != 0) {
+					writeEntry(current.bodies[i], mask);
+				}
+				i++;
+				j++;
+			}
+		}
+
+		if (quantizer) {
+			out = bits.Finish();
+		}
+
+		std::size_t payloadSize = out - start;
+		Wire::PutU16(start, DeltaSnapshotFormat::Magic);
+		Wire::PutU8(start + 2, DeltaSnapshotFormat::Version);
+		Wire::PutU8(start + 3, 0);
+		Wire::PutU32(start + 4, current.tick);
+		Wire::PutU32(start + 8, baseline ? baseline->tick : DeltaSnapshotFormat::NoBaseline);
+		Wire::PutU32(start + 12, static_cast<std::uint32_t>(current.bodies.size()));
+		Wire::PutU32(start + 16, entryCount);
+		Wire::PutU32(start + 20, quantizer ? DeltaSnapshotFormat::QuantizedFlag : 0);
+		NetFrame::WriteHeader(buffer->data(), NetMessageType::DeltaSnapshot, static_cast<std::uint32_t>(payloadSize));
+		buffer->resize(NetFrame::HeaderSize + payloadSize);
+		return buffer;
+	}
+};
+
+// Reads a delta in two steps: ParseHeader() tells which baseline it needs, Apply() builds the new state
+class DeltaSnapshotReader
+{
+private:
+	const std::uint8_t* entries = nullptr;
+	const std::uint8_t* end = nullptr;
+	std::uint32_t tick = 0;
+	std::uint32_t baselineTick = DeltaSnapshotFormat::NoBaseline;
+	std::uint32_t bodyCount = 0;
+	std::uint32_t entryCount = 0;
+	std::uint32_t flags = 0;
+
+	static std::size_t FieldsSize(std::uint8_t mask) {
+		std::size_t size = 0;
+		if (mask & DeltaPosition) size += 8;
+		if (mask & DeltaVelocity) size += 8;
+		if (mask & DeltaColor) size += 3;
+		if (mask & DeltaSize) size += 8;
+		if (mask & DeltaMass) size += 4;
+		if (mask & DeltaKindAndLinked) size += 2;
+		return size;
+	}
+
+	static void ReadFields(const std::uint8_t* in, std::uint8_t mask, BodyRecord& record) {
+		if (mask & DeltaPosition) {
+			record.position = sf::Vector2f(Wire::GetF32(in), Wire::GetF32(in + 4));
+			in += 8;
+		}
+		if (mask & DeltaVelocity) {
+			record.velocity = sf::Vector2f(Wire::GetF32(in), Wire::GetF32(in + 4));
+			in += 8;
+		}
+		if (mask & DeltaColor) {
+			record.color = SimColor(in[0], in[1], in[2]);
+			in += 3;
+		}
+		if (mask & DeltaSize) {
+			record.size = sf::Vector2f(Wire::GetF32(in), Wire::GetF32(in + 4));
+			in += 8;
+		}
+		if (mask & DeltaMass) {
+			record.mass = Wire::GetF32(in);
+			in += 4;
+		}
+		if (mask & DeltaKindAndLinked) {
+			record.kind = static_cast<ShapeKind>(in[0]);
+			record.linked = static_cast<std::int8_t>(in[1]);
+		}
+	}
+
+public:
+	bool ParseHeader(const std::uint8_t* payload, std::size_t size) {
+		entries = nullptr;
+		if (size < DeltaSnapshotFormat::HeaderSize || Wire::GetU16(payload) != DeltaSnapshotFormat::Magic) {
+			std::cerr << "Not a delta snapshot" << std::endl;
+			return false;
+		}
+		std::uint8_t version = Wire::GetU8(payload + 2);
+		if (version < 1 || version > DeltaSnapshotFormat::Version) {
+			std::cerr << "Unsupported delta snapshot version " << static_cast<int>(Wire::GetU8(payload + 2)) << std::endl;
+			return false;
+		}
+		tick = Wire::GetU32(payload + 4);
+		baselineTick = Wire::GetU32(payload + 8);
+		bodyCount = Wire::GetU32(payload + 12);
+		entryCount = Wire::GetU32(payload + 16);
+		flags = version >= 2 ? Wire::GetU32(payload + 20) : 0;
+		if (IsQuantized() && version < 3) {
+			std::cerr << "Quantized delta snapshot of version " << static_cast<int>(version) << " is not supported" << std::endl;
+			return false;
+		}
+		entries = payload + DeltaSnapshotFormat::HeaderSize;
+		end = payload + size;
+		return true;
+	}
+
+	std::uint32_t GetTick() const { return tick; }
+
+	bool HasBaseline() const { return baselineTick != DeltaSnapshotFormat::NoBaseline; }
+
+	std::uint32_t GetBaselineTick() const { return baselineTick; }
+
+	bool IsQuantized() const { return (flags & DeltaSnapshotFormat::QuantizedFlag) != 0; }
+
+	// Merges the entries into the baseline (nullptr for a full snapshot). out must not be the baseline.
+	// A quantized delta needs the client's quantizer, it keeps the tables between snapshots
+	bool Apply(const SnapshotState* baseline, SnapshotState& out, Quantizer* quantizer = nullptr) const {
+		static const std::vector<BodyRecord> noBodies;
+		const std::vector<BodyRecord>& before = baseline ? baseline->bodies : noBodies;
+		out.tick = tick;
+		out.bodies.clear();
+
+		if (IsQuantized()) {
+			if (!quantizer) {
+				std::cerr << "Got a quantized delta snapshot without a quantizer" << std::endl;
+				return false;
+			}
+			return ApplyQuantized(before, out, *quantizer);
+		}
+
+		const std::uint8_t* in = entries;
+		std::size_t j = 0;
+		for (std::uint32_t e = 0; e < entryCount; e++) {
+			if (end - in < 5) {
+				std::cerr << "Delta snapshot is cut" << std::endl;
+				return false;
+			}
+			std::uint32_t id = Wire::GetU32(in);
+			std::uint8_t mask = Wire::GetU8(in + 4);
+			std::size_t fieldsSize = FieldsSize(mask);
+			if (static_cast<std::size_t>(end - in - 5) < fieldsSize) {
+				std::cerr << "Delta snapshot is cut" << std::endl;
+				return false;
+			}
+
+			// Baseline bodies before this id did not change
+			while (j < before.size() && before[j].id < id) {
+				out.bodies.push_back(before[j++]);
+			}
+			bool inBaseline = j < before.size() && before[j].id == id;
+
+			if (mask & DeltaRemoved) {
+				if (inBaseline) {
+					j++;
+				}
+			}
+			else if (inBaseline) {
+				BodyRecord record = before[j++];
+				ReadFields(in + 5, mask, record);
+				out.bodies.push_back(record);
+			}
+			else if ((mask & DeltaAllFields) == DeltaAllFields) {
+				BodyRecord record;
+				record.id = id;
+				ReadFields(in + 5, mask, record);
+				out.bodies.push_back(record);
+			}
+			else {
+				std::cerr << "Delta snapshot changes body " << id << " that is not in the baseline" << std::endl;
+				return false;
+			}
+			in += 5 + fieldsSize;
+		}
+		while (j < before.size()) {
+			out.bodies.push_back(before[j++]);
+		}
+
+		if (out.bodies.size() != bodyCount) {
+			std::cerr << "Delta snapshot gave " << out.bodies.size() << " bodies instead of " << bodyCount << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	// Same merge as Apply(), the entries are a bit stream
+	bool ApplyQuantized(const std::vector<BodyRecord>& before, SnapshotState& out, Quantizer& quantizer) const {
+		const std::uint8_t* tablesEnd = quantizer.ReadTables(entries, end);
+		if (!tablesEnd) {
+			std::cerr << "Delta snapshot has broken quantizer tables" << std::endl;
+			return false;
+		}
+		BitReader bits(tablesEnd, end);
+		std::uint32_t id = 0;
+		std::size_t j = 0;
+		for (std::uint32_t e = 0; e < entryCount; e++) {
+			id += bits.ReadVarint();
+			std::uint32_t packedMask = bits.Read(7);
+			std::uint8_t mask = static_cast<std::uint8_t>((packedMask & DeltaAllFields) | ((packedMask & 0x40) ? DeltaRemoved : 0));
+			if (bits.Failed()) {
+				std::cerr << "Delta snapshot is cut" << std::endl;
+				return false;
+			}
+
+			while (j < before.size() && before[j].id < id) {
+				out.bodies.push_back(before[j++]);
+			}
+			bool inBaseline = j < before.size() && before[j].id == id;
+
+			if (mask & DeltaRemoved) {
+				if (inBaseline) {
+					j++;
+				}
+				continue;
+			}
+			BodyRecord record;
+			if (inBaseline) {
+				record = before[j++];
+			}
+			else if ((mask & DeltaAllFields) == DeltaAllFields) {
+				record.id = id;
+			}
+			else {
+				std::cerr << "Delta snapshot changes body " << id << " that is not in the baseline" << std::endl;
+				return false;
+			}
+			if (!quantizer.ReadFields(bits, mask, record)) {
+				std::cerr << "Delta snapshot has a broken entry for body " << id << std::endl;
+				return false;
+			}
+			out.bodies.push_back(record);
+		}
+		while (j < before.size()) {
+			out.bodies.push_back(before[j++]);
+		}
+
+		if (out.bodies.size() != bodyCount) {
+			std::cerr << "Delta snapshot gave " << out.bodies.size() << " bodies instead of " << bodyCount << std::endl;
+			return false;
+		}
+		return true;
+	}
+};
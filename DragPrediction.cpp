@@ -0,0 +1 @@
+#include "DragPrediction.h"
\ No newline at end of file
@@ -0,0 +1,215 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <SFML/System/Vector2.hpp>
+#include "BaseShape.h"
+#include "DeltaSnapshot.h"
+
+// Client side prediction of the bodies this client drags. A dragged body is drawn where the mouse put it right
+// away instead of a round trip and a tick later, so a drag feels the same at any ping and server tick rate.
+// Every drag position goes out with an input sequence (CommandProtocol.h), the server answers with the newest one
+// it applied and the tick of the first snapshot that shows it (NetMessageType::InputAck).
+//
+// Reconciling: once that snapshot is here, the body in it is compared with where the acknowledged input put it.
+// The server has the last word (the physics moves a dragged body on, collisions push it, links hold it), so the
+// difference stays on top of the newer inputs as a correction, blended in over a few frames instead of snapping.
+// Drags are absolute positions, replaying the inputs that are not acknowledged yet is just taking the newest one.
+// After the release a body stays predicted until the interpolation draws the snapshot with its last input, then
+// it is the server's again without a jump.
+
+struct PredictionSettings
+{
+	float tolerance = 1;           // World units the server may be off before it is a correction (positions are quantized)
+	float correctionRate = 15;     // Per second, how fast a new correction is taken on
+	float giveUpSeconds = 1;       // A released body without an ack for this long goes back to the server
+	std::size_t maxPending = 256;  // Inputs waiting for an ack, then the oldest are forgotten (a server that does not ack)
+};
+
+class DragPrediction
+{
+private:
+	// A drag position sent and not acknowledged yet
+	struct Input
+	{
+		std::uint32_t sequence;
+		std::uint32_t body;
+		sf::Vector2f position;
+	};
+
+	// The newest acknowledged input of a body, compared with the snapshot of tick once that is here
+	struct Check
+	{
+		std::uint32_t tick;
+		std::uint32_t body;
+		sf::Vector2f position;
+	};
+
+	// A body drawn where this client predicts it
+	struct Track
+	{
+		std::uint32_t body = 0;
+		sf::Vector2f input;       // The newest position given
+		sf::Vector2f correction;  // Drawn at input + correction
+		sf::Vector2f target;      // Where correction is going, what the server showed last
+		bool held = true;
+		std::uint32_t lastSequence = 0;
+		std::uint32_t ackedSequence = 0;
+		std::uint32_t ackedTick = 0; // First snapshot with ackedSequence in it
+		double lastInput = 0;        // Local seconds
+	};
+
+	PredictionSettings settings;
+	std::vector<Input> pending; // Oldest first, the sequences only go up
+	std::vector<Check> checks;
+	std::vector<Track> tracks;
+	double lastApply = -1;
+	std::uint64_t reconciled = 0;
+	std::uint64_t corrections = 0;
+
+	Track* FindTrack(std::uint32_t body) {
+		for (Track& track : tracks) {
+			if (track.body == body) {
+				return &track;
+			}
+		}
+		return nullptr;
+	}
+
+	// The bodies of a snapshot are in id order
+	static const BodyRecord* FindBody(const SnapshotState& state, std::uint32_t body) {
+		auto it = std::lower_bound(state.bodies.begin(), state.bodies.end(), body,
+			[](const BodyRecord& record, std::uint32_t id) { return record.id < id; });
+		return it != state.bodies.end() && it->id == body ? &*it : nullptr;
+	}
+
+public:
+	DragPrediction(const PredictionSettings& settings = PredictionSettings()) : settings(settings) {}
+
+	const PredictionSettings& GetSettings() const { return settings; }
+
+	// The client put body at position, sent with the input sequence send_command gave it (0: drawn there but
+	// never reconciled). now in local seconds
+	void Predict(std::uint32_t body, sf::Vector2f position, std::uint32_t sequence, double now) {
+		Track* track = FindTrack(body);
+		if (!track) {
+			tracks.push_back(Track());
+			track = &tracks.back();
+			track->body = body;
+		}
+		track->input = position;
+		track->held = true;
+		track->lastInput = now;
+		if (sequence == 0) {
+			return;
+		}
+		track->lastSequence = sequence;
+		if (pending.size() >= settings.maxPending) {
+			pending.erase(pending.begin());
+		}
+		pending.push_back(Input{ sequence, body, position });
+	}
+
+	// The mouse let go, the body goes back to the server once its last input is drawn
+	void Release(std::uint32_t body) {
+		if (Track* track = FindTrack(body)) {
+			track->held = false;
+		}
+	}
+
+	// NetMessageType::InputAck: every input up to sequence is in the snapshot of tick
+	void OnAck(std::uint32_t sequence, std::uint32_t tick) {
+		std::size_t done = 0;
+		for (; done < pending.size() && pending[done].sequence <= sequence; done++) {
+			const Input& input = pending[done];
+			auto check = std::find_if(checks.begin(), checks.end(),
+				[&input, tick](const Check& check) { return check.body == input.body && check.tick == tick; });
+			if (check != checks.end()) {
+				check->position = input.position;
+			}
+			else {
+				checks.push_back(Check{ tick, input.body, input.position });
+			}
+		}
+		pending.erase(pending.begin(), pending.begin() + done);
+		for (Track& track : tracks) {
+			if (track.lastSequence != 0 && track.lastSequence <= sequence) {
+				track.ackedSequence = track.lastSequence;
+				track.ackedTick = tick;
+			}
+		}
+	}
+
+	// After a snapshot or an ack came in. newestTick is the newest snapshot received: a checked tick older than
+	// it that is not in the history will not come any more (lost, or replaced by a newer one)
+	void Reconcile(const SnapshotHistory& history, std::uint32_t newestTick) {
+		for (std::size_t i = 0; i < checks.size();) {
+			const Check& check = checks[i];
+			const SnapshotState* state = history.Find(check.tick);
+			if (!state) {
+				if (newestTick > check.tick) {
+					checks.erase(checks.begin() + i);
+				}
+				else {
+					i++;
+				}
+				continue;
+			}
+			Track* track = FindTrack(check.body);
+			const BodyRecord* record = FindBody(*state, check.body);
+			if (track && !record) {
+				// Deleted, or out of the view the server sends: there is nothing to predict against
+				tracks.erase(tracks.begin() + (track - tracks.data()));
+			}
+			else if (track) {
+				sf::Vector2f difference = record->position - check.position;
+				bool off = std::hypot(difference.x, difference.y) > settings.tolerance;
+				track->target = off ? difference : sf::Vector2f();
+				reconciled++;
+				corrections += off ? 1 : 0;
+			}
+			checks.erase(checks.begin() + i);
+		}
+	}
+
+	// After the interpolation moved the bodies. objects in id order, renderTick is the tick the interpolation
+	// draws now (SnapshotInterpolator::RenderTick)
+	void Apply(const std::vector<BaseShape*>& objects, double renderTick, double now) {
+		float seconds = lastApply < 0 ? 0 : static_cast<float>(std::min(0.1, now - lastApply));
+		lastApply = now;
+		float blend = std::min(1.0f, settings.correctionRate * seconds);
+		for (std::size_t i = 0; i < tracks.size();) {
+			Track& track = tracks[i];
+			bool drawn = track.lastSequence != 0 && track.ackedSequence == track.lastSequence && renderTick >= track.ackedTick;
+			if (!track.held && (drawn || now - track.lastInput > settings.giveUpSeconds)) {
+				tracks.erase(tracks.begin() + i);
+				continue;
+			}
+			track.correction += (track.target - track.correction) * blend;
+			auto it = std::lower_bound(objects.begin(), objects.end(), track.body,
+				[](BaseShape* shape, std::uint32_t id) { return static_cast<std::uint32_t>(shape->GetID()) < id; });
+			if (it != objects.end() && static_cast<std::uint32_t>((*it)->GetID()) == track.body) {
+				(*it)->SetPosition(track.input + track.correction);
+			}
+			i++;
+		}
+	}
+
+	// A new connection or world, nothing of the old one is acknowledged any more
+	void Clear() {
+		pending.clear();
+		checks.clear();
+		tracks.clear();
+		lastApply = -1;
+	}
+
+	bool IsPredicted(std::uint32_t body) const {
+		return std::any_of(tracks.begin(), tracks.end(), [body](const Track& track) { return track.body == body; });
+	}
+
+	std::size_t Pending() const { return pending.size(); }
+	// Acknowledged inputs compared with the server, and how many of them it did not agree with
+	std::uint64_t Reconciled() const { return reconciled; }
+	std::uint64_t Corrections() const { return corrections; }
+};
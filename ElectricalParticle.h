@@ -1,5 +1,4 @@
 #pragma once
-#include <SFML/Graphics.hpp>
 #include <iostream> 
 #include "Circle.h"
 #define K_ 8.987551792300000e+09
@@ -20,18 +19,17 @@ private:
 	bool isFixed; 
 
 public:
-	ElectricalParticle(float radius, sf::Color color, sf::Vector2f pos, float gravity, double mass, double charge, bool fixed, sf::Vector2f initialVel, int objCount) : Circle(radius, color, pos, gravity, mass, initialVel, objCount), charge(charge), isFixed(fixed) {
+	ElectricalParticle(float radius, SimColor color, sf::Vector2f pos, float gravity, double mass, double charge, bool fixed, sf::Vector2f initialVel, int objCount) : Circle(radius, color, pos, gravity, mass, initialVel, objCount), charge(charge), isFixed(fixed) {
 
 	}
 
 	// Copy constructor
 	ElectricalParticle(ElectricalParticle& other)
 		: Circle(other) {
-		// Copy SFML shape properties
-		setRadius(other.getRadius());
-		setFillColor(other.getFillColor());
-		setOrigin(other.getOrigin());
-		setPosition(other.getPosition());
+		// Copy shape properties
+		radius = other.radius;
+		color = other.color;
+		position = other.position;
 
 		// Copy Circle class properties
 		oldPosition = other.oldPosition;
@@ -41,6 +39,10 @@ public:
 		type = "ElectPart";
 	}
 
+	ShapeKind GetKind() const override {
+		return ShapeKind::ElectricalParticle;
+	}
+
 	double GetCharge() {
 		return charge;
 	}
@@ -0,0 +1 @@
+#include "FrameExporter.h"
\ No newline at end of file
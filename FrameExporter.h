@@ -0,0 +1,232 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
+
+enum class FrameFormat {
+	PPM,      // frame_000000.ppm, frame_000001.ppm ...
+	PNG,      // frame_000000.png, frame_000001.png ...
+	RawStream // One file of raw RGBA frames back to back, for ffmpeg -f rawvideo -pix_fmt rgba
+};
+
+// Writes rendered frames to disk on a pool of encoder threads.
+// The render thread takes a pixel buffer with AcquireBuffer(), reads the frame into it and gives it back with
+// SubmitFrame(). The encoders write it and return the buffer to the free list, so no buffer is allocated after
+// the start and the number of frames in flight is bounded (when all the buffers are busy AcquireBuffer waits).
+// Frames are expected bottom row first like glReadPixels gives them, the encoders flip them while writing.
+class FrameExporter
+{
+private:
+	struct Frame {
+		int index = 0;
+		std::vector<sf::Uint8> pixels; // RGBA
+	};
+
+	std::string outputPath; // Folder for the image sequences, file path for the raw stream
+	FrameFormat format;
+	unsigned int width;
+	unsigned int height;
+
+	std::vector<Frame> frames; // All the buffers, allocated once
+	std::vector<Frame*> freeFrames;
+	std::deque<Frame*> pendingFrames;
+	std::mutex queueMutex;
+	std::condition_variable freeFrameReady;
+	std::condition_variable pendingFrameReady;
+	bool finishing = false;
+
+	std::vector<std::thread> encoders;
+
+	// The raw stream is one file so the frames have to be written in order
+	std::ofstream rawStream;
+	std::mutex rawStreamMutex;
+	std::condition_variable rawTurnChanged;
+	int nextRawFrame = 0;
+
+	int framesWritten = 0;
+
+	std::string FramePath(int index, const char* extension) const {
+		char name[32];
+		std::snprintf(name, sizeof(name), "frame_%06d.%s", index, extension);
+		return outputPath + "/" + name;
+	}
+
+	void WritePPM(const Frame& frame, std::vector<char>& row) {
+		std::ofstream file(FramePath(frame.index, "ppm"), std::ios::binary);
+		if (!file) {
+			std::cerr << "Could not open " << FramePath(frame.index, "ppm") << std::endl;
+			return;
+		}
+		file << "P6\n" << width << " " << height << "\n255\n";
+		row.resize(static_cast<size_t>(width) * 3);
+		for (unsigned int y = height; y-- > 0;) {
+			const sf::Uint8* source = &frame.pixels[static_cast<size_t>(y) * width * 4];
+			for (unsigned int x = 0; x < width; x++) {
+				row[x * 3] = static_cast<char>(source[x * 4]);
+				row[x * 3 + 1] = static_cast<char>(source[x * 4 + 1]);
+				row[x * 3 + 2] = static_cast<char>(source[x * 4 + 2]);
+			}
+			file.write(row.data(), row.size());
+		}
+	}
+
+	void WritePNG(const Frame& frame, sf::Image& image) {
+		image.create(width, height, frame.pixels.data()); // Same size every frame so the image keeps its memory
+		image.flipVertically();
+		if (!image.saveToFile(FramePath(frame.index, "png"))) {
+			std::cerr << "Could not write " << FramePath(frame.index, "png") << std::endl;
+		}
+	}
+
+	void WriteRaw(const Frame& frame) {
+		std::unique_lock<std::mutex> lock(rawStreamMutex);
+		rawTurnChanged.wait(lock, [&]() { return nextRawFrame == frame.index; });
+		size_t rowSize = static_cast<size_t>(width) * 4;
+		for (unsigned int y = height; y-- > 0;) {
+			rawStream.write(reinterpret_cast<const char*>(&frame.pixels[y * rowSize]), rowSize);
+		}
+		nextRawFrame++;
+		rawTurnChanged.notify_all();
+	}
+
+	void EncoderLoop() {
+		// Per encoder scratch, reused for every frame it writes
+		std::vector<char> row;
+		sf::Image image;
+
+		while (true) {
+			Frame* frame = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				pendingFrameReady.wait(lock, [&]() { return finishing || !pendingFrames.empty(); });
+				if (pendingFrames.empty()) {
+					return; // finishing and nothing left
+				}
+				frame = pendingFrames.front();
+				pendingFrames.pop_front();
+			}
+
+			switch (format) {
+			case FrameFormat::PPM:
+				WritePPM(*frame, row);
+				break;
+			case FrameFormat::PNG:
+				WritePNG(*frame, image);
+				break;
+			case FrameFormat::RawStream:
+				WriteRaw(*frame);
+				break;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				freeFrames.push_back(frame);
+				framesWritten++;
+			}
+			freeFrameReady.notify_one();
+		}
+	}
+
+public:
+	// bufferCount is how many frames can be in flight (rendered but not written yet)
+	FrameExporter(const std::string& outputPath, FrameFormat format, unsigned int width, unsigned int height,
+		int encoderCount = 0, int bufferCount = 0)
+		: outputPath(outputPath), format(format), width(width), height(height) {
+		if (encoderCount <= 0) {
+			// Leave one core for the simulation and one for the rendering
+			encoderCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 2);
+		}
+		if (bufferCount <= 0) {
+			bufferCount = encoderCount * 2;
+		}
+
+		if (format == FrameFormat::RawStream) {
+			rawStream.open(outputPath, std::ios::binary);
+			if (!rawStream) {
+				std::cerr << "Could not open " << outputPath << std::endl;
+			}
+		}
+		else {
+			std::error_code error;
+			std::filesystem::create_directories(outputPath, error);
+		}
+
+		frames.resize(bufferCount);
+		for (Frame& frame : frames) {
+			frame.pixels.resize(static_cast<size_t>(width) * height * 4);
+			freeFrames.push_back(&frame);
+		}
+
+		for (int i = 0; i < encoderCount; i++) {
+			encoders.emplace_back([this]() { EncoderLoop(); });
+		}
+	}
+
+	~FrameExporter() {
+		Finish();
+	}
+
+	FrameExporter(const FrameExporter&) = delete;
+	FrameExporter& operator=(const FrameExporter&) = delete;
+
+	unsigned int GetWidth() const { return width; }
+
+	unsigned int GetHeight() const { return height; }
+
+	// Waits while every buffer is still being written, that is the back pressure on the render loop
+	sf::Uint8* AcquireBuffer(int frameIndex) {
+		std::unique_lock<std::mutex> lock(queueMutex);
+		freeFrameReady.wait(lock, [&]() { return !freeFrames.empty(); });
+		Frame* frame = freeFrames.back();
+		freeFrames.pop_back();
+		frame->index = frameIndex;
+		return frame->pixels.data();
+	}
+
+	// Gives back a buffer from AcquireBuffer with the frame in it. frames must be submitted in index order starting from 0
+	void SubmitFrame(sf::Uint8* pixels) {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			for (Frame& frame : frames) {
+				if (frame.pixels.data() == pixels) {
+					pendingFrames.push_back(&frame);
+					break;
+				}
+			}
+		}
+		pendingFrameReady.notify_one();
+	}
+
+	// Writes what is left in the queue and stops the encoders
+	void Finish() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (finishing) {
+				return;
+			}
+			finishing = true;
+		}
+		pendingFrameReady.notify_all();
+		for (auto& encoder : encoders) {
+			encoder.join();
+		}
+		encoders.clear();
+		if (rawStream.is_open()) {
+			rawStream.close();
+		}
+	}
+
+	int GetFramesWritten() {
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return framesWritten;
+	}
+};
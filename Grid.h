@@ -42,10 +42,6 @@ public:
 		return nullptr; // Return nullptr if no ball contains the point
 	}
 
-
-	virtual sf::RectangleShape createGridVisually(const sf::Vector2f& size, const sf::Vector2f& position, float outlineThickness, sf::Color outlineColor) { return sf::RectangleShape(); }
-
-	virtual void DrawGrids(sf::RenderWindow& window) {}
 };
 
 class GridUnorderd : public Grid //Using Hash Mapping
@@ -77,6 +73,12 @@ public:
 	// Clears the gridMap 
 	void clear() override {
 		gridMap.clear();
+		hashKeyVec.clear();
+	}
+
+	// All the occupied cells, for the front ends that want to draw them
+	const std::unordered_map<int, std::vector<BaseShape*>>& GetCells() const {
+		return gridMap;
 	}
 
 	// Returns the hash map size
@@ -121,7 +123,7 @@ public:
 		int gridColumn;
 		sf::Vector2f pos = obj->GetPosition();
 		if (Circle* circle = dynamic_cast<Circle*>(obj)) {
-			gridColumn = static_cast<int>(pos.x / (circle->getRadius() * multiplier));
+			gridColumn = static_cast<int>(pos.x / (circle->GetRadius() * multiplier));
 		}
 		else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(obj))
 		{
@@ -134,7 +136,7 @@ public:
 		int gridRow;
 		sf::Vector2f pos = obj->GetPosition();
 		if (Circle* circle = dynamic_cast<Circle*>(obj)) {
-			gridRow = static_cast<int>(pos.y / (circle->getRadius() * multiplier));
+			gridRow = static_cast<int>(pos.y / (circle->GetRadius() * multiplier));
 		}
 		else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(obj))
 		{
@@ -156,7 +158,7 @@ public:
 			sf::Vector2f objPos = obj->GetPosition();
 			double distance = std::sqrt(std::pow(objPos.x - pointPosf.x, 2) + std::pow(objPos.y - pointPosf.y, 2));
 			if (Circle* circle = dynamic_cast<Circle*>(obj)) {
-				if (distance <= circle->getRadius()) {
+				if (distance <= circle->GetRadius()) {
 					return obj; // Return a pointer to the circle as a baseShape if the point is within the radius
 				}
 			}
@@ -183,34 +185,6 @@ public:
 		}
 		return nullptr; // Return nullptr if no ball contains the point
 	}
-
-	sf::RectangleShape createGridVisually(const sf::Vector2f& size, const sf::Vector2f& position, float outlineThickness, sf::Color outlineColor) override {
-		sf::RectangleShape rectangle(size); // Set size
-		rectangle.setPosition(position);    // Set position
-		rectangle.setOutlineThickness(outlineThickness); // Set outline thickness
-		rectangle.setOutlineColor(outlineColor);         // Set outline color
-		rectangle.setFillColor(sf::Color::Transparent);  // Make it transparent
-
-		return rectangle;
-	}
-
-	//Draws the grids visually
-	void DrawGrids(sf::RenderWindow& window) override {
-		for (auto& keyAndObject : gridMap) {
-			int hashKey = keyAndObject.first;
-			std::vector<BaseShape*> objVec = keyAndObject.second;
-			BaseShape* obj = objVec.front();
-			sf::RectangleShape gridRect;
-			if (Circle* circle = dynamic_cast<Circle*>(obj)) {
-				gridRect = createGridVisually(sf::Vector2f(circle->GetRadius() * 2, circle->GetRadius() * 2), obj->GetPosition(), 3.0, sf::Color(255, 0, 0));
-				gridRect.setOrigin(circle->GetRadius(), circle->GetRadius());
-			}
-			else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(obj)) {
-				gridRect = createGridVisually(sf::Vector2f(rectangle->getSize().x, rectangle->getSize().y), obj->GetPosition(), 3.0, sf::Color(255, 0, 0));
-			}
-			window.draw(gridRect);
-		}
-	}
 };
 
 class GridFixed :public Grid {
@@ -233,7 +207,7 @@ public:
 		int gridColumn;
 		sf::Vector2f pos = obj->GetPosition();
 		if (Circle* circle = dynamic_cast<Circle*>(obj)) {
-			gridColumn = static_cast<int>(pos.x / (circle->getRadius()));
+			gridColumn = static_cast<int>(pos.x / (circle->GetRadius()));
 		}
 		else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(obj))
 		{
@@ -246,7 +220,7 @@ public:
 		int gridRow;
 		sf::Vector2f pos = obj->GetPosition();
 		if (Circle* circle = dynamic_cast<Circle*>(obj)) {
-			gridRow = static_cast<int>(pos.y / (circle->getRadius()));
+			gridRow = static_cast<int>(pos.y / (circle->GetRadius()));
 		}
 		else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(obj))
 		{
@@ -284,7 +258,7 @@ public:
 			sf::Vector2f objPos = obj->GetPosition();
 			double distance = std::sqrt(std::pow(objPos.x - pointPosf.x, 2) + std::pow(objPos.y - pointPosf.y, 2));
 			if (Circle* circle = dynamic_cast<Circle*>(obj)) {
-				if (distance <= circle->getRadius()) {
+				if (distance <= circle->GetRadius()) {
 					return obj; // Return a pointer to the circle as a baseShape if the point is within the radius
 				}
 			}
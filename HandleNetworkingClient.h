@@ -4,73 +4,219 @@
 #include <thread>
 #include <string>
 #include <deque>
+#include <array>
 #include <mutex>
-#include <SFML/Graphics.hpp>;
-#include <SFML/Window.hpp>
-#include "BaseShape.h"
-#include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/binary_oarchive.hpp>
-#include "Options.h"
-#include "Serialization.h"
-#include "UI.h"
+#include <atomic>
+#include <cstring>
+#include "NetFrame.h"
+#include "SnapshotDatagram.h"
+#include "SnapshotCompression.h"
+#include "CommandProtocol.h"
 
 using boost::asio::ip::tcp;
 using boost::asio::ip::udp;
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
 
 
+// The connection to the server. The sockets and timers live on one strand, so the coroutines that own them (the
+// connect and TCP read session, the UDP receive session) and the writes run one at a time even when the
+// io_context runs on several threads. The other threads only ever post to the strand
 class HandleNetworkingClient {
 public:
 	HandleNetworkingClient(boost::asio::io_context& io_context,
 		const std::string& host,
 		unsigned short tcp_port,
-		unsigned short udp_port)
+		unsigned short udp_port,
+		std::uint32_t room_id = 0)
 		: io_context_(io_context),
-		tcp_socket_(io_context),
-		udp_socket_(io_context, udp::endpoint(udp::v4(), 0)),
+		strand_(boost::asio::make_strand(io_context)),
+		room_id_(room_id),
+		tcp_socket_(strand_),
+		udp_socket_(strand_, udp::endpoint(udp::v4(), 0)),
 		resolver_(io_context),
-		should_try_connect_(true),
-		retry_timer_(io_context) {
+		retry_timer_(strand_),
+		input_timer_(strand_) {
 
 		auto tcp_results = resolver_.resolve(host, std::to_string(tcp_port));
 		tcp_endpoint_ = *tcp_results.begin();
 		udp_endpoint_ = udp::endpoint(tcp_endpoint_.address(), udp_port);
 	}
 
+	// Everything that came from the server, frame headers and datagrams included. any thread
+	std::uint64_t get_received_bytes() const { return received_bytes_.load(std::memory_order_relaxed); }
+
+	// Snapshots that came compressed and the time spent unpacking them. any thread
+	std::uint64_t get_compressed_frames() const { return compressed_frames_.load(std::memory_order_relaxed); }
+	std::uint64_t get_decompress_nanoseconds() const { return decompress_nanoseconds_.load(std::memory_order_relaxed); }
+
+	// Whether to ask the server for compressed snapshots at the handshake (see SnapshotCompression.h), before connect
+	void set_snapshot_compression(bool enabled) { snapshot_compression_ = enabled; }
+
+	// How often the unreliable commands go out, coalesced (see CommandCoalescer). The server's tick rate by
+	// default, more would only be thrown away there. 0 sends every command right away. before connect
+	void set_input_rate(float hz) { input_rate_ = hz; }
+
+	// Datagrams of commands sent, and commands folded into newer ones instead of being sent. any thread
+	std::uint64_t get_input_datagrams() const { return input_datagrams_.load(std::memory_order_relaxed); }
+	std::uint64_t get_coalesced_commands() const {
+		std::lock_guard<std::mutex> lock(input_mutex_);
+		return input_coalescer_.Coalesced();
+	}
+
 	void stop_connecting() {
 		should_try_connect_ = false;
-		retry_timer_.cancel();
+		boost::asio::post(strand_, [this]() { retry_timer_.cancel(); });
 	}
 
 	void connect() {
-		attempt_connect();
+		boost::asio::co_spawn(strand_, connect_session(), boost::asio::detached);
 	}
 
+	// Can be called from any thread, the queue is only touched on the strand
 	void send_tcp_message(const std::string& message) {
-		bool write_in_progress = !tcp_message_queue_.empty();
-		tcp_message_queue_.push_back(message + "\n");
+		boost::asio::post(strand_, [this, message]() {
+			bool write_in_progress = !tcp_message_queue_.empty();
+			tcp_message_queue_.push_back(message + "\n");
 
-		if (!write_in_progress) {
-			do_tcp_write();
-		}
+			if (!write_in_progress) {
+				do_tcp_write();
+			}
+			});
 	}
 
 	void send_udp_message(const std::string& message) {
-		udp_socket_.async_send_to(
-			boost::asio::buffer(message),
-			udp_endpoint_,
-			[this, message](const boost::system::error_code& ec, std::size_t /*bytes_sent*/) {
-				if (!ec) {
-					//std::cout << "UDP message sent: " << message << std::endl;
-				}
-				else {
-					std::cout << "UDP send failed: " << ec.message() << std::endl;
-				}
+		auto datagram = std::make_shared<std::string>(message);
+		boost::asio::post(strand_, [this, datagram]() {
+			udp_socket_.async_send_to(
+				boost::asio::buffer(*datagram),
+				udp_endpoint_,
+				[datagram](const boost::system::error_code& ec, std::size_t /*bytes_sent*/) {
+					if (!ec) {
+						//std::cout << "UDP message sent: " << *datagram << std::endl;
+					}
+					else {
+						std::cout << "UDP send failed: " << ec.message() << std::endl;
+					}
+				});
 			});
 	}
 
+	// One binary command (see CommandProtocol.h). The reliable ones go in the TCP stream right away, the rest
+	// (drags, spawns) wait for the next input send and go in a datagram with the others. Returns the input sequence
+	// an unreliable one goes with, the server acknowledges it (TranslateInputAck); 0 for a reliable one
+	std::uint32_t send_command(Command command, bool reliable = false) {
+		command.sequence = reliable ? 0 : ++input_sequence_;
+		if (!reliable && input_rate_ > 0) {
+			bool arm = false;
+			{
+				std::lock_guard<std::mutex> lock(input_mutex_);
+				input_coalescer_.Add(command);
+				arm = !input_timer_armed_;
+				input_timer_armed_ = true;
+			}
+			if (arm) {
+				boost::asio::post(strand_, [this]() { arm_input_timer(); });
+			}
+			return command.sequence;
+		}
+		command_writer_.Clear();
+		if ((!reliable && !command_writer_.AddSequence(command.sequence)) || !command_writer_.Add(command)) {
+			return 0;
+		}
+		const std::vector<std::uint8_t>& bytes = command_writer_.Message();
+		if (reliable) {
+			std::string message(bytes.begin(), bytes.end());
+			boost::asio::post(strand_, [this, message]() {
+				bool write_in_progress = !tcp_message_queue_.empty();
+				tcp_message_queue_.push_back(message); // No newline, the message has its size
+
+				if (!write_in_progress) {
+					do_tcp_write();
+				}
+				});
+			return 0;
+		}
+		send_command_datagram(bytes);
+		return command.sequence;
+	}
+
+	// Any thread, the sockets are closed on the strand
 	void disconnect_from_server() {
 		// Stop any ongoing retries for connection
 		should_try_connect_ = false;
+		boost::asio::dispatch(strand_, [this]() { close_sockets(); });
+	}
+
+
+protected:
+	virtual void TranslateMessage(const std::string& message) {}
+
+	// payload is only valid during the call, see Snapshot.h for the layout
+	virtual void TranslateSnapshot(const std::uint8_t* payload, std::size_t size) {}
+
+	// Same, for DeltaSnapshot.h frames
+	virtual void TranslateDeltaSnapshot(const std::uint8_t* payload, std::size_t size) {}
+
+	// Every command sent up to input sequence is applied, the snapshot of tick is the first that shows it
+	virtual void TranslateInputAck(std::uint32_t sequence, std::uint32_t tick) {}
+
+	void SaveMessage(const std::string& message) {
+		std::lock_guard<std::mutex> lock(storedMessagesMutex);
+		storedMessages.push_back(message);
+	}
+
+	const std::vector<std::string>& GetStoredMessages() {
+		std::lock_guard<std::mutex> lock(storedMessagesMutex);
+		return storedMessages;
+	}
+
+	// Method to clear stored messages
+	void ClearStoredMessages() {
+		std::lock_guard<std::mutex> lock(storedMessagesMutex);
+		storedMessages.clear();
+	}
+
+
+private:
+	// Connects, retrying every 5 seconds, then reads the TCP stream until it ends. A dropped connection is not
+	// retried, connect() again for that
+	awaitable<void> connect_session() {
+		while (should_try_connect_) {
+			// Close socket if it's open before attempting new connection
+			boost::system::error_code ec;
+			if (tcp_socket_.is_open()) {
+				tcp_socket_.close(ec);
+			}
+
+			std::cout << "\033[31m" << "Attempting to connect to server..." << std::endl; // red because it is cool ngl
+			co_await tcp_socket_.async_connect(tcp_endpoint_, boost::asio::redirect_error(use_awaitable, ec));
+			if (ec) {
+				std::cout << "TCP connection failed: " << ec.message() << std::endl;
+				if (!should_try_connect_) {
+					break;
+				}
+				std::cout << "Retrying in 5 seconds..." << std::endl;
+				retry_timer_.expires_after(std::chrono::seconds(5));
+				co_await retry_timer_.async_wait(boost::asio::redirect_error(use_awaitable, ec));
+				continue;
+			}
+
+			std::cout << "\033[0m" << "Connected to TCP server!" << std::endl;
+			udp_reassembler_.Reset();
+			tcp_decompressor_.Reset(); // The stream context starts over with the connection
+			send_handshake();
+			if (!udp_receiving_) {
+				udp_receiving_ = true;
+				boost::asio::co_spawn(strand_, udp_receive_session(), boost::asio::detached);
+			}
+			co_await tcp_receive_session();
+			co_return;
+		}
+		std::cout << "Stopped trying to connect." << std::endl;
+	}
+
+	void close_sockets() {
 		retry_timer_.cancel();
 
 		// Close the TCP socket if its open
@@ -102,70 +248,34 @@ public:
 		}
 	}
 
-
-protected:
-	virtual void TranslateMessage(const std::string& message) {}
-
-	void SaveMessage(const std::string& message) {
-		std::lock_guard<std::mutex> lock(storedMessagesMutex);
-		storedMessages.push_back(message);
-	}
-
-	const std::vector<std::string>& GetStoredMessages() {
-		std::lock_guard<std::mutex> lock(storedMessagesMutex);
-		return storedMessages;
-	}
-
-	// Method to clear stored messages
-	void ClearStoredMessages() {
-		std::lock_guard<std::mutex> lock(storedMessagesMutex);
-		storedMessages.clear();
-	}
-
-
-private:
-	void attempt_connect() {
-		if (!should_try_connect_) {
-			std::cout << "Stopped trying to connect." << std::endl;
-			return;
-		}
-
-		// Close socket if it's open before attempting new connection
-		if (tcp_socket_.is_open()) {
-			tcp_socket_.close();
-		}
-
-		std::cout << "\033[31m" << "Attempting to connect to server..." << std::endl; // red because it is cool ngl
-		tcp_socket_.async_connect(
-			tcp_endpoint_,
-			[this](const boost::system::error_code& ec) {
-				if (!ec) {
-					std::cout << "\033[0m" << "Connected to TCP server!" << std::endl;
-					start_tcp_receive();
-					start_udp_receive();
-				}
-				else {
-					std::cout << "TCP connection failed: " << ec.message() << std::endl;
-					schedule_reconnect();
-				}
+	// Any thread, sent from the strand
+	void send_command_datagram(const std::vector<std::uint8_t>& bytes) {
+		auto message = std::make_shared<std::string>(bytes.begin(), bytes.end());
+		input_datagrams_.fetch_add(1, std::memory_order_relaxed);
+		boost::asio::dispatch(strand_, [this, message]() {
+			udp_socket_.async_send_to(
+				boost::asio::buffer(*message),
+				udp_endpoint_,
+				[message](const boost::system::error_code& ec, std::size_t /*bytes_sent*/) {
+					if (ec) {
+						std::cout << "UDP send failed: " << ec.message() << std::endl;
+					}
+				});
 			});
 	}
 
-	void schedule_reconnect() {
-		if (!should_try_connect_) return;
-
-		std::cout << "Retrying in 5 seconds..." << std::endl;
-		retry_timer_.expires_after(std::chrono::seconds(5));
-		retry_timer_.async_wait([this](const boost::system::error_code& ec) {
-			if (!ec && should_try_connect_) {
-				attempt_connect();
+	// On the strand. Once per input interval while there are commands, the timer is not armed when idle
+	void arm_input_timer() {
+		input_timer_.expires_after(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / input_rate_)));
+		input_timer_.async_wait([this](const boost::system::error_code& ec) {
+			std::lock_guard<std::mutex> lock(input_mutex_);
+			if (!ec) {
+				input_coalescer_.Flush(input_writer_, [this](const std::vector<std::uint8_t>& bytes) { send_command_datagram(bytes); });
 			}
+			input_timer_armed_ = false; // Under the lock, the next command arms it again
 			});
 	}
 
-	bool should_try_connect_;
-	boost::asio::steady_timer retry_timer_;
-
 	void do_tcp_write() {
 		boost::asio::async_write(
 			tcp_socket_,
@@ -183,62 +293,146 @@ private:
 			});
 	}
 
-	void start_tcp_receive() {
-		boost::asio::async_read_until(
-			tcp_socket_,
-			tcp_buffer_,
-			'\n',
-			[this](const boost::system::error_code& ec, std::size_t length) {
-				if (!ec) {
-					std::string message(boost::asio::buffers_begin(tcp_buffer_.data()),
-						boost::asio::buffers_begin(tcp_buffer_.data()) + length);
-					tcp_buffer_.consume(length);
-
-					// Handle the received message
-					TranslateMessage(message);
-
-					// Continue listening for TCP messages
-					start_tcp_receive();
-				}
-				else {
-					std::cout << "TCP receive failed: " << ec.message() << std::endl;
-				}
-			});
+	void send_handshake() {
+		// The handshake, the first message picks the room on the server
+		send_tcp_message("room:" + std::to_string(room_id_));
 
 		// Send the UDP port to the server
 		send_tcp_message("udp:" + std::to_string(udp_socket_.local_endpoint().port()));
-	}
 
+		if (snapshot_compression_) {
+			send_tcp_message("compress:lz");
+		}
+	}
 
-	void start_udp_receive() {
-		udp_socket_.async_receive_from(
-			boost::asio::buffer(udp_data_, max_length),
-			udp_sender_endpoint_,
-			[this](const boost::system::error_code& errorCode, std::size_t bytesRecived) {
-				if (!errorCode) {
-					std::string message(udp_data_, bytesRecived);
-					TranslateMessage(message); // Process the message
-					start_udp_receive();       // Continue receiving
-				}
-				else {
-					std::cout << "UDP receive failed: " << errorCode.message() << std::endl;
-				}
-			});
+	// decompressor is the one of the socket the frame came in on, the TCP one has the stream dictionary
+	void dispatch_frame(NetMessageType type, const std::uint8_t* payload, std::size_t size, FrameDecompressor& decompressor) {
+		switch (type) {
+		case NetMessageType::Text:
+			// The server's round trip time probe, answered here so every front end does
+			if (size > 5 && std::memcmp(payload, "ping:", 5) == 0) {
+				send_tcp_message("pong:" + std::string(payload + 5, payload + size));
+				break;
+			}
+			TranslateMessage(std::string(payload, payload + size));
+			break;
+		case NetMessageType::Snapshot:
+			TranslateSnapshot(payload, size);
+			break;
+		case NetMessageType::DeltaSnapshot:
+			TranslateDeltaSnapshot(payload, size);
+			break;
+		case NetMessageType::InputAck:
+			if (size >= NetFrame::InputAckSize) {
+				TranslateInputAck(Wire::GetU32(payload), Wire::GetU32(payload + 4));
+			}
+			break;
+		case NetMessageType::Compressed: {
+			auto start = std::chrono::steady_clock::now();
+			NetMessageType inner;
+			const std::uint8_t* raw = nullptr;
+			std::size_t raw_size = 0;
+			if (!decompressor.Decompress(payload, size, inner, raw, raw_size)) {
+				std::cout << "Compressed frame that does not decode, dropped" << std::endl;
+				break;
+			}
+			compressed_frames_.fetch_add(1, std::memory_order_relaxed);
+			decompress_nanoseconds_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+			dispatch_frame(inner, raw, raw_size, decompressor);
+			break;
+		}
+		default:
+			std::cout << "Unknown frame type " << static_cast<int>(type) << std::endl;
+			break;
+		}
 	}
 
+	// The server sends NetFrames: first the fixed size header, then exactly payload size bytes. The payload buffer
+	// keeps its capacity, no allocation once it is big enough
+	awaitable<void> tcp_receive_session() {
+		while (true) {
+			boost::system::error_code ec;
+			co_await boost::asio::async_read(tcp_socket_, boost::asio::buffer(tcp_frame_header_), boost::asio::redirect_error(use_awaitable, ec));
+			if (ec) {
+				std::cout << "TCP receive failed: " << ec.message() << std::endl;
+				co_return;
+			}
+			std::uint32_t payload_size = NetFrame::ReadPayloadSize(tcp_frame_header_.data());
+			if (payload_size > NetFrame::MaxPayloadSize) {
+				std::cout << "TCP frame of " << payload_size << " bytes, the stream is broken" << std::endl;
+				tcp_socket_.close(ec);
+				co_return;
+			}
+			tcp_frame_payload_.resize(payload_size);
+			co_await boost::asio::async_read(tcp_socket_, boost::asio::buffer(tcp_frame_payload_), boost::asio::redirect_error(use_awaitable, ec));
+			if (ec) {
+				std::cout << "TCP receive failed: " << ec.message() << std::endl;
+				co_return;
+			}
+			received_bytes_.fetch_add(NetFrame::HeaderSize + tcp_frame_payload_.size(), std::memory_order_relaxed);
+			dispatch_frame(NetFrame::ReadType(tcp_frame_header_.data()), tcp_frame_payload_.data(), tcp_frame_payload_.size(), tcp_decompressor_);
+		}
+	}
 
+	// Runs from the first connect until the socket is closed, reconnects keep it
+	awaitable<void> udp_receive_session() {
+		while (true) {
+			boost::system::error_code errorCode;
+			std::size_t bytesRecived = co_await udp_socket_.async_receive_from(boost::asio::buffer(udp_data_, max_length), udp_sender_endpoint_,
+				boost::asio::redirect_error(use_awaitable, errorCode));
+			if (errorCode) {
+				std::cout << "UDP receive failed: " << errorCode.message() << std::endl;
+				udp_receiving_ = false;
+				co_return;
+			}
+			received_bytes_.fetch_add(bytesRecived, std::memory_order_relaxed);
+			const std::uint8_t* data = reinterpret_cast<const std::uint8_t*>(udp_data_);
+			if (SnapshotDatagram::IsDatagram(data, bytesRecived)) {
+				// Only a whole tick newer than the last one drawn comes out, stale fragments are dropped
+				if (udp_reassembler_.Add(data, bytesRecived)) {
+					dispatch_frame(udp_reassembler_.GetType(), udp_reassembler_.GetPayload(), udp_reassembler_.GetPayloadSize(), udp_decompressor_);
+				}
+			}
+			else {
+				std::string message(udp_data_, bytesRecived);
+				TranslateMessage(message); // Process the message
+			}
+		}
+	}
 
 	boost::asio::io_context& io_context_;
+	boost::asio::strand<boost::asio::io_context::executor_type> strand_; // Of everything below that does io
+	std::uint32_t room_id_; // Sent at the handshake
 	tcp::socket tcp_socket_;
 	udp::socket udp_socket_;
 	tcp::resolver resolver_;
+	std::atomic<bool> should_try_connect_{ true };
+	boost::asio::steady_timer retry_timer_;
+	bool udp_receiving_ = false; // Only the strand
 	tcp::endpoint tcp_endpoint_;
 	udp::endpoint udp_endpoint_;
 	udp::endpoint udp_sender_endpoint_;
-	boost::asio::streambuf tcp_buffer_;
-	enum { max_length = 1024 };
+	std::array<std::uint8_t, NetFrame::HeaderSize> tcp_frame_header_;
+	std::vector<std::uint8_t> tcp_frame_payload_;
+	enum { max_length = 2048 }; // Bigger than SnapshotDatagram::MaxDatagramSize
 	char udp_data_[max_length];
+	SnapshotReassembler udp_reassembler_;
 	std::deque<std::string> tcp_message_queue_;
+	CommandWriter command_writer_; // Only the thread that calls send_command
+	std::uint32_t input_sequence_ = 0; // Same
+	float input_rate_ = 60;
+	boost::asio::steady_timer input_timer_;
+	mutable std::mutex input_mutex_; // input_coalescer_ and input_timer_armed_, the caller of send_command and the io thread
+	CommandCoalescer input_coalescer_;
+	bool input_timer_armed_ = false;
+	CommandWriter input_writer_; // Only the strand
+	std::atomic<std::uint64_t> input_datagrams_{ 0 };
+	std::atomic<std::uint64_t> received_bytes_{ 0 };
+	bool snapshot_compression_ = true;
+	FrameDecompressor tcp_decompressor_;
+	FrameDecompressor udp_decompressor_; // Datagrams are compressed on their own, no dictionary
+	std::atomic<std::uint64_t> compressed_frames_{ 0 };
+	std::atomic<std::uint64_t> decompress_nanoseconds_{ 0 };
 	std::vector<std::string> storedMessages;
 	mutable std::mutex storedMessagesMutex;
 };
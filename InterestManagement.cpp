@@ -0,0 +1 @@
+#include "InterestManagement.h"
\ No newline at end of file
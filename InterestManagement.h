@@ -0,0 +1,159 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "SimTypes.h"
+#include "DeltaSnapshot.h"
+
+// Area of interest: a client that reported its view only gets the bodies around it.
+// The area is the view plus a margin on every side, a body comes in when any of it is inside that area and only leaves
+// when it is also outside the hysteresis band around it, so bodies on the edge do not flicker in and out (every
+// flicker would be a full entry in the delta).
+
+struct InterestSettings
+{
+	float cellSize = 256;      // Interest grid cell, in world units
+	float margin = 0.25f;      // Of the view size, added on every side. bodies come in before they are on screen
+	float hysteresis = 0.25f;  // Of the view size, on top of the margin, before a body leaves again
+};
+
+// Uniform grid over the captured bodies, built once a tick and queried for every client.
+// The collision grid sizes its cells by the body size, so it can not answer "what is inside this rectangle"
+class InterestGrid
+{
+private:
+	float cellSize = 256;
+	std::unordered_map<std::int64_t, std::vector<std::uint32_t>> cells; // Cell -> indices into the state bodies
+	std::vector<std::int64_t> usedCells;
+	sf::Vector2f maxHalfSize; // Of the bodies in the grid, they are in the cell of their center only
+
+	static std::int64_t CellKey(std::int64_t column, std::int64_t row) {
+		return (column << 32) ^ (row & 0xFFFFFFFF);
+	}
+
+	// Clamped, a client can report any view
+	int CellOf(float value) const {
+		return static_cast<int>(std::clamp(std::floor(value / cellSize), -1.0e9f, 1.0e9f));
+	}
+
+public:
+	InterestGrid(float cellSize = 256) : cellSize(cellSize) {}
+
+	// Half width and height of a body, it is drawn around its position
+	static sf::Vector2f HalfSize(const BodyRecord& body) {
+		return body.kind == ShapeKind::Rectangle ? body.size / 2.0f : body.size;
+	}
+
+	// The cell vectors are cleared, not freed, so a steady world does not allocate
+	void Build(const SnapshotState& state) {
+		for (std::int64_t key : usedCells) {
+			cells[key].clear();
+		}
+		usedCells.clear();
+		maxHalfSize = sf::Vector2f(0, 0);
+		for (std::uint32_t i = 0; i < state.bodies.size(); i++) {
+			const sf::Vector2f& position = state.bodies[i].position;
+			sf::Vector2f halfSize = HalfSize(state.bodies[i]);
+			maxHalfSize.x = std::max(maxHalfSize.x, halfSize.x);
+			maxHalfSize.y = std::max(maxHalfSize.y, halfSize.y);
+			std::int64_t key = CellKey(CellOf(position.x), CellOf(position.y));
+			std::vector<std::uint32_t>& cell = cells[key];
+			if (cell.empty()) {
+				usedCells.push_back(key);
+			}
+			cell.push_back(i);
+		}
+	}
+
+	// Every body index in the cells the area touches, grown by the largest body (so also some outside it)
+	template<typename F>
+	void Query(const SimRect& area, F&& visit) const {
+		int firstColumn = CellOf(area.left - maxHalfSize.x);
+		int lastColumn = CellOf(area.left + area.width + maxHalfSize.x);
+		int firstRow = CellOf(area.top - maxHalfSize.y);
+		int lastRow = CellOf(area.top + area.height + maxHalfSize.y);
+		std::int64_t cellCount = static_cast<std::int64_t>(lastColumn - firstColumn + 1) * (lastRow - firstRow + 1);
+		if (cellCount > static_cast<std::int64_t>(usedCells.size())) {
+			// Zoomed far out, walking the occupied cells is cheaper than walking the area
+			for (std::int64_t key : usedCells) {
+				for (std::uint32_t index : cells.at(key)) {
+					visit(index);
+				}
+			}
+			return;
+		}
+		for (int row = firstRow; row <= lastRow; row++) {
+			for (int column = firstColumn; column <= lastColumn; column++) {
+				auto found = cells.find(CellKey(column, row));
+				if (found != cells.end()) {
+					for (std::uint32_t index : found->second) {
+						visit(index);
+					}
+				}
+			}
+		}
+	}
+};
+
+// One client's view and the bodies it had last tick
+class ClientInterest
+{
+private:
+	SimRect view;
+	bool hasView = false;
+	std::vector<std::uint32_t> visibleIDs; // Sorted
+	std::vector<std::uint32_t> nextVisibleIDs;
+	std::vector<std::uint32_t> picked;
+
+	static SimRect Grow(const SimRect& rect, float fraction) {
+		float grow = std::max(rect.width, rect.height) * fraction;
+		return SimRect(rect.left - grow, rect.top - grow, rect.width + grow * 2, rect.height + grow * 2);
+	}
+
+	// Whether any of a body is inside the area, a big one is seen long before its center is
+	static bool Overlaps(const SimRect& area, const BodyRecord& body) {
+		sf::Vector2f halfSize = InterestGrid::HalfSize(body);
+		return body.position.x + halfSize.x >= area.left && body.position.x - halfSize.x <= area.left + area.width &&
+			body.position.y + halfSize.y >= area.top && body.position.y - halfSize.y <= area.top + area.height;
+	}
+
+public:
+	void SetView(const SimRect& newView) {
+		view = newView;
+		hasView = newView.width > 0 && newView.height > 0;
+	}
+
+	bool HasView() const { return hasView; }
+
+	const SimRect& GetView() const { return view; }
+
+	// The bodies of world this client should get, in id order like every SnapshotState
+	void Filter(const SnapshotState& world, const InterestGrid& grid, const InterestSettings& settings, SnapshotState& out) {
+		SimRect enter = Grow(view, settings.margin);
+		SimRect leave = Grow(view, settings.margin + settings.hysteresis);
+
+		picked.clear();
+		grid.Query(leave, [&](std::uint32_t index) {
+			const BodyRecord& body = world.bodies[index];
+			if (!Overlaps(leave, body)) {
+				return;
+			}
+			if (Overlaps(enter, body) || std::binary_search(visibleIDs.begin(), visibleIDs.end(), body.id)) {
+				picked.push_back(index);
+			}
+			});
+		std::sort(picked.begin(), picked.end()); // world.bodies is sorted by id, so the indices give id order
+
+		out.tick = world.tick;
+		out.tableSizes = world.tableSizes;
+		out.bodies.clear();
+		nextVisibleIDs.clear();
+		for (std::uint32_t index : picked) {
+			out.bodies.push_back(world.bodies[index]);
+			nextVisibleIDs.push_back(world.bodies[index].id);
+		}
+		std::swap(visibleIDs, nextVisibleIDs);
+	}
+};
@@ -0,0 +1 @@
+#include "Journal.h"
\ No newline at end of file
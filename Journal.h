@@ -0,0 +1,279 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "NetFrame.h"
+#include "CommandProtocol.h"
+#include "BaseShape.h"
+
+// A room's session on disk: the settings and random seeds it started with, then every command it applied with
+// the tick it was applied on. The physics steps a fixed time per tick, so running the same commands on the same
+// ticks from the same start gives the same world, bit for bit (same build and machine). The server replays a
+// journal headless and as fast as it can for profiling (server --replay <file>).
+//
+// The file, little endian like the wire formats:
+//   "ATJL" | u32 version | scene (JournalScene::Size bytes)
+//   records: u8 JournalRecord | u32 tick | payload
+// and only ever appended to, so a server that dies leaves a journal that replays up to its last checkpoint.
+
+// How the room was set up, everything the physics reads that is not a command
+struct JournalScene
+{
+	std::uint32_t room = 0;
+	float tickRate = 60;
+	std::uint32_t substeps = 1;   // At the start, a Substeps record when the overload policy changes it
+	std::uint32_t objectSeed = 0; // ObjectsList::Seed
+	std::uint32_t linkSeed = 0;   // LineLink::Seed
+	std::int32_t width = 1920;
+	std::int32_t height = 1080;
+	float gravity = 0;
+	float elastic = 0;
+	float lineLength = 150;
+	bool collision = false;
+	bool borderless = true;
+
+	static constexpr std::size_t Size = 41;
+
+	void Write(std::uint8_t* out) const {
+		Wire::PutU32(out, room);
+		Wire::PutF32(out + 4, tickRate);
+		Wire::PutU32(out + 8, substeps);
+		Wire::PutU32(out + 12, objectSeed);
+		Wire::PutU32(out + 16, linkSeed);
+		Wire::PutU32(out + 20, static_cast<std::uint32_t>(width));
+		Wire::PutU32(out + 24, static_cast<std::uint32_t>(height));
+		Wire::PutF32(out + 28, gravity);
+		Wire::PutF32(out + 32, elastic);
+		Wire::PutF32(out + 36, lineLength);
+		Wire::PutU8(out + 40, static_cast<std::uint8_t>((collision ? 1 : 0) | (borderless ? 2 : 0)));
+	}
+
+	void Read(const std::uint8_t* in) {
+		room = Wire::GetU32(in);
+		tickRate = Wire::GetF32(in + 4);
+		substeps = Wire::GetU32(in + 8);
+		objectSeed = Wire::GetU32(in + 12);
+		linkSeed = Wire::GetU32(in + 16);
+		width = static_cast<std::int32_t>(Wire::GetU32(in + 20));
+		height = static_cast<std::int32_t>(Wire::GetU32(in + 24));
+		gravity = Wire::GetF32(in + 28);
+		elastic = Wire::GetF32(in + 32);
+		lineLength = Wire::GetF32(in + 36);
+		std::uint8_t flags = Wire::GetU8(in + 40);
+		collision = (flags & 1) != 0;
+		borderless = (flags & 2) != 0;
+	}
+};
+
+enum class JournalRecord : std::uint8_t {
+	Command = 1,   // u8 op | i8 direction | i32 client | u32 body | u32 other body | i32 value | f32 x | f32 y
+	Substeps = 2,  // u32 physics steps per tick from this tick on
+	Checkpoint = 3 // u32 body count | u64 state hash (JournalHash) after the tick, for checking a replay
+};
+
+struct JournalFormat
+{
+	static constexpr std::uint32_t Magic = 0x4C4A5441; // "ATJL"
+	static constexpr std::uint32_t Version = 1;
+	static constexpr std::size_t FileHeaderSize = 8 + JournalScene::Size;
+	static constexpr std::size_t RecordHeaderSize = 5;
+	static constexpr std::size_t CommandSize = 26;
+	static constexpr std::size_t SubstepsSize = 4;
+	static constexpr std::size_t CheckpointSize = 12;
+
+	static std::size_t PayloadSize(JournalRecord kind) {
+		switch (kind) {
+		case JournalRecord::Command: return CommandSize;
+		case JournalRecord::Substeps: return SubstepsSize;
+		case JournalRecord::Checkpoint: return CheckpointSize;
+		default: return 0;
+		}
+	}
+};
+
+// FNV-1a over the id and the exact position bits of every body, in list order. Two worlds with the same hash
+// moved the same way
+inline std::uint64_t JournalHash(const std::vector<BaseShape*>& shapes) {
+	std::uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](std::uint32_t value) {
+		for (int i = 0; i < 4; i++) {
+			hash ^= (value >> (i * 8)) & 0xFF;
+			hash *= 1099511628211ull;
+		}
+		};
+	for (BaseShape* shape : shapes) {
+		sf::Vector2f position = shape->GetPosition();
+		sf::Vector2f oldPosition = shape->GetOldPosition();
+		mix(static_cast<std::uint32_t>(shape->GetID()));
+		mix(std::bit_cast<std::uint32_t>(position.x));
+		mix(std::bit_cast<std::uint32_t>(position.y));
+		mix(std::bit_cast<std::uint32_t>(oldPosition.x));
+		mix(std::bit_cast<std::uint32_t>(oldPosition.y));
+	}
+	return hash;
+}
+
+// Appends to a journal file. Only the room's tick writes, the records collect in a buffer that goes to the file
+// on every checkpoint (about once a second) and when the writer is closed
+class JournalWriter
+{
+private:
+	std::ofstream file;
+	std::vector<std::uint8_t> buffer;
+	std::uint64_t records = 0;
+
+	std::uint8_t* Append(JournalRecord kind, std::uint32_t tick) {
+		std::size_t start = buffer.size();
+		buffer.resize(start + JournalFormat::RecordHeaderSize + JournalFormat::PayloadSize(kind));
+		std::uint8_t* out = buffer.data() + start;
+		Wire::PutU8(out, static_cast<std::uint8_t>(kind));
+		Wire::PutU32(out + 1, tick);
+		records++;
+		return out + JournalFormat::RecordHeaderSize;
+	}
+
+public:
+	JournalWriter() = default;
+	JournalWriter(const JournalWriter&) = delete;
+	JournalWriter& operator=(const JournalWriter&) = delete;
+
+	~JournalWriter() { Close(); }
+
+	bool Open(const std::string& path, const JournalScene& scene) {
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+		std::uint8_t header[JournalFormat::FileHeaderSize];
+		Wire::PutU32(header, JournalFormat::Magic);
+		Wire::PutU32(header + 4, JournalFormat::Version);
+		scene.Write(header + 8);
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.flush();
+		return static_cast<bool>(file);
+	}
+
+	bool IsOpen() const { return file.is_open(); }
+	std::uint64_t Records() const { return records; }
+
+	void WriteCommand(std::uint32_t tick, const Command& command) {
+		std::uint8_t* out = Append(JournalRecord::Command, tick);
+		Wire::PutU8(out, static_cast<std::uint8_t>(command.op));
+		Wire::PutU8(out + 1, static_cast<std::uint8_t>(command.direction));
+		Wire::PutU32(out + 2, static_cast<std::uint32_t>(command.clientID));
+		Wire::PutU32(out + 6, command.body);
+		Wire::PutU32(out + 10, command.otherBody);
+		Wire::PutU32(out + 14, static_cast<std::uint32_t>(command.value));
+		Wire::PutF32(out + 18, command.position.x);
+		Wire::PutF32(out + 22, command.position.y);
+	}
+
+	void WriteSubsteps(std::uint32_t tick, int substeps) {
+		Wire::PutU32(Append(JournalRecord::Substeps, tick), static_cast<std::uint32_t>(substeps));
+	}
+
+	void WriteCheckpoint(std::uint32_t tick, std::size_t bodies, std::uint64_t hash) {
+		std::uint8_t* out = Append(JournalRecord::Checkpoint, tick);
+		Wire::PutU32(out, static_cast<std::uint32_t>(bodies));
+		Wire::PutU32(out + 4, static_cast<std::uint32_t>(hash));
+		Wire::PutU32(out + 8, static_cast<std::uint32_t>(hash >> 32));
+		Flush();
+	}
+
+	void Flush() {
+		if (!file.is_open() || buffer.empty()) {
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+		file.flush();
+		buffer.clear();
+	}
+
+	void Close() {
+		Flush();
+		if (file.is_open()) {
+			file.close();
+		}
+	}
+};
+
+// One record of a journal
+struct JournalEntry
+{
+	JournalRecord kind = JournalRecord::Command;
+	std::uint32_t tick = 0;
+	Command command;             // Command
+	int substeps = 1;            // Substeps
+	std::uint32_t bodies = 0;    // Checkpoint
+	std::uint64_t hash = 0;      // Checkpoint
+};
+
+// Reads a whole journal into memory first, so a replay measures the simulation and not the disk
+class JournalReader
+{
+private:
+	std::vector<std::uint8_t> data;
+	std::size_t offset = 0;
+	JournalScene scene;
+
+public:
+	// false when the file is missing or not a journal of this version
+	bool Open(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+		data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		if (data.size() < JournalFormat::FileHeaderSize || Wire::GetU32(data.data()) != JournalFormat::Magic ||
+			Wire::GetU32(data.data() + 4) != JournalFormat::Version) {
+			return false;
+		}
+		scene.Read(data.data() + 8);
+		offset = JournalFormat::FileHeaderSize;
+		return true;
+	}
+
+	const JournalScene& Scene() const { return scene; }
+
+	// false at the end, or at a record that was cut off or is unknown
+	bool Next(JournalEntry& entry) {
+		if (data.size() - offset < JournalFormat::RecordHeaderSize) {
+			return false;
+		}
+		const std::uint8_t* in = data.data() + offset;
+		JournalRecord kind = static_cast<JournalRecord>(Wire::GetU8(in));
+		std::size_t payloadSize = JournalFormat::PayloadSize(kind);
+		if (payloadSize == 0 || data.size() - offset - JournalFormat::RecordHeaderSize < payloadSize) {
+			return false;
+		}
+		entry.kind = kind;
+		entry.tick = Wire::GetU32(in + 1);
+		in += JournalFormat::RecordHeaderSize;
+		switch (kind) {
+		case JournalRecord::Command:
+			entry.command.op = static_cast<CommandOp>(Wire::GetU8(in));
+			entry.command.direction = static_cast<std::int8_t>(Wire::GetU8(in + 1));
+			entry.command.clientID = static_cast<int>(Wire::GetU32(in + 2));
+			entry.command.body = Wire::GetU32(in + 6);
+			entry.command.otherBody = Wire::GetU32(in + 10);
+			entry.command.value = static_cast<std::int32_t>(Wire::GetU32(in + 14));
+			entry.command.position = sf::Vector2f(Wire::GetF32(in + 18), Wire::GetF32(in + 22));
+			break;
+		case JournalRecord::Substeps:
+			entry.substeps = static_cast<int>(Wire::GetU32(in));
+			break;
+		case JournalRecord::Checkpoint:
+			entry.bodies = Wire::GetU32(in);
+			entry.hash = Wire::GetU32(in + 4) | (static_cast<std::uint64_t>(Wire::GetU32(in + 8)) << 32);
+			break;
+		default:
+			break;
+		}
+		offset += JournalFormat::RecordHeaderSize + payloadSize;
+		return true;
+	}
+};
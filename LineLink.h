@@ -3,12 +3,13 @@
 #include "Rectangle.h"
 #include "BaseShape.h"
 #include <vector>
-#include <SFML/Graphics.hpp>
 #include <unordered_map>
 #include <random>
 #include <ctime>
 #include <iostream>
 #include <functional>
+#include <algorithm>
+#include <tuple>
 #define PI       3.14159265358979323846   // pi
 
 
@@ -19,14 +20,32 @@ private:
 	std::unordered_map<BaseShape*, std::vector<std::tuple<BaseShape*, float,float>>> fixedConnections;
 	std::unordered_map<BaseShape*, std::vector<BaseShape*>> nonFixedConnections;
 	std::vector<BaseShape*> allObjects;
+	// Every object with a link, in the order it got its first one. The links are applied in this order, the
+	// order of the maps depends on the pointers and is different every run (a journal replay needs the same one)
+	std::vector<BaseShape*> linkOrder;
 	std::mt19937 rng; // Random number generator
+	unsigned int seed;
+
+	void TrackLinked(BaseShape* obj) {
+		if (std::find(linkOrder.begin(), linkOrder.end(), obj) == linkOrder.end()) {
+			linkOrder.push_back(obj);
+		}
+	}
 
 public:
 
 	LineLink(float lineLength) : lineLength(lineLength) {
-		rng.seed(std::time(nullptr));
+		Seed(static_cast<unsigned int>(std::time(nullptr)));
+	}
+
+	// For a session that has to run the same again (see Journal.h)
+	void Seed(unsigned int newSeed) {
+		seed = newSeed;
+		rng.seed(seed);
 	}
 
+	unsigned int GetSeed() const { return seed; }
+
 	~LineLink() {
 		allObjects.clear();
 	}
@@ -35,6 +54,7 @@ public:
 		allObjects.clear();
 		fixedConnections.clear();
 		nonFixedConnections.clear();
+		linkOrder.clear();
 	}
 
 	void AddObject(BaseShape* obj) {
@@ -43,9 +63,27 @@ public:
 		}
 	}
 
+	// Forgets the object and every link it is in
+	void RemoveObject(BaseShape* obj) {
+		allObjects.erase(std::remove(allObjects.begin(), allObjects.end(), obj), allObjects.end());
+		linkOrder.erase(std::remove(linkOrder.begin(), linkOrder.end(), obj), linkOrder.end());
+		fixedConnections.erase(obj);
+		for (auto& pair : fixedConnections) {
+			auto& links = pair.second;
+			links.erase(std::remove_if(links.begin(), links.end(),
+				[obj](const std::tuple<BaseShape*, float, float>& link) { return std::get<0>(link) == obj; }), links.end());
+		}
+		nonFixedConnections.erase(obj);
+		for (auto& pair : nonFixedConnections) {
+			pair.second.erase(std::remove(pair.second.begin(), pair.second.end(), obj), pair.second.end());
+		}
+	}
+
 	void MakeNewLink(BaseShape* obj1, BaseShape* obj2, int type) {
 		AddObject(obj1);
 		AddObject(obj2);
+		TrackLinked(obj1);
+		TrackLinked(obj2);
 		
 		if (type == 1) { // Fixed connection
 			sf::Vector2f delta = obj2->GetPosition() - obj1->GetPosition();
@@ -208,44 +246,70 @@ public:
 
 	void ApplyAllLinks() {
 		// Apply non-fixed connections
-		for (const auto& pair : nonFixedConnections) {
-			BaseShape* obj1 = pair.first;
-			for (BaseShape* obj2 : pair.second) {
+		for (BaseShape* obj1 : linkOrder) {
+			auto found = nonFixedConnections.find(obj1);
+			if (found == nonFixedConnections.end()) {
+				continue;
+			}
+			for (BaseShape* obj2 : found->second) {
 				ApplyLink(obj1, obj2);
 			}
 		}
 
 		// Apply fixed connections
-		for (const auto& pair : fixedConnections) {
-			BaseShape* obj1 = pair.first;
-			for (const auto& [obj2, angle, thisLineLength] : pair.second) {
+		for (BaseShape* obj1 : linkOrder) {
+			auto found = fixedConnections.find(obj1);
+			if (found == fixedConnections.end()) {
+				continue;
+			}
+			for (const auto& [obj2, angle, thisLineLength] : found->second) {
 				ApplyLinkWithFixedAngle(obj1, obj2, angle, thisLineLength);
 			}
 		}
 	}
 
-	void Draw(sf::RenderWindow& window) {
-		sf::VertexArray lines(sf::Lines);
-		for (const auto& pair : fixedConnections) {
-			BaseShape* obj1 = pair.first;
-			for (const auto& [obj2, angle, thisLineLength] : pair.second) {
-				lines.append(sf::Vertex(obj1->GetPosition(), sf::Color::White));
-				lines.append(sf::Vertex(obj2->GetPosition(), sf::Color::White));
+	// Calls the function with the two ends of every link, for drawing or sending them
+	void ForEachLink(const std::function<void(BaseShape*, BaseShape*)>& function) const {
+		for (BaseShape* obj1 : linkOrder) {
+			auto found = fixedConnections.find(obj1);
+			if (found == fixedConnections.end()) {
+				continue;
+			}
+			for (const auto& [obj2, angle, thisLineLength] : found->second) {
+				function(obj1, obj2);
+			}
+		}
+		for (BaseShape* obj1 : linkOrder) {
+			auto found = nonFixedConnections.find(obj1);
+			if (found == nonFixedConnections.end()) {
+				continue;
+			}
+			for (BaseShape* obj2 : found->second) {
+				function(obj1, obj2);
+			}
+		}
+	}
+
+	// Calls the function with every object obj is linked to and the type of that link (1 fixed, 2 not)
+	void ForEachLinkOf(BaseShape* obj, const std::function<void(BaseShape*, int)>& function) const {
+		auto fixed = fixedConnections.find(obj);
+		if (fixed != fixedConnections.end()) {
+			for (const auto& [other, angle, thisLineLength] : fixed->second) {
+				function(other, 1);
 			}
 		}
-		for (const auto& pair : nonFixedConnections) {
-			BaseShape* obj1 = pair.first;
-			for (BaseShape* obj2 : pair.second) {
-				lines.append(sf::Vertex(obj1->GetPosition(), sf::Color::White));
-				lines.append(sf::Vertex(obj2->GetPosition(), sf::Color::White));
+		auto nonFixed = nonFixedConnections.find(obj);
+		if (nonFixed != nonFixedConnections.end()) {
+			for (BaseShape* other : nonFixed->second) {
+				function(other, 2);
 			}
 		}
-		window.draw(lines);
 	}
 
 	void Clear() {
 		fixedConnections.clear();
 		nonFixedConnections.clear();
 		allObjects.clear();
+		linkOrder.clear();
 	}
 };
@@ -0,0 +1 @@
+#include "LodRenderer.h"
\ No newline at end of file
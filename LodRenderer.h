@@ -0,0 +1,167 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <algorithm>
+#include "BaseShape.h"
+
+// Level of detail rendering for big scenes.
+// When zoomed out most bodies are smaller than a pixel, so drawing them as circles is wasted work.
+// Bodies under the screen radius threshold get splatted (one point per body) into a colour/density
+// accumulation buffer that is uploaded as one texture, and only the bodies that are big enough on screen
+// are drawn as real shapes. this way the draw cost scales with the screen pixels and not the body count.
+class LodRenderer
+{
+private:
+	// Per pixel accumulation, colors are summed so overlapping bodies blend to their average color
+	struct SplatCell {
+		sf::Uint32 r = 0;
+		sf::Uint32 g = 0;
+		sf::Uint32 b = 0;
+		sf::Uint32 count = 0;
+	};
+
+	bool enabled = true;
+	float screenRadiusThreshold = 1.5f; // In pixels. under it the body is splatted instead of drawn
+	float densityGain = 96.f; // How much alpha every body adds to its pixel, more bodies on a pixel -> more solid
+
+	sf::Vector2u bufferSize = sf::Vector2u(0, 0);
+	std::vector<SplatCell> accumulation;
+	std::vector<sf::Uint8> pixels; // RGBA, uploaded to the texture every frame
+	std::vector<unsigned int> touchedPixels; // So clearing costs only what was written and not the whole screen
+	sf::Texture splatTexture;
+	sf::Sprite splatSprite;
+
+	int lastSplatted = 0;
+	int lastDrawn = 0;
+
+	// The buffers follow the target size, they are only reallocated when the target is resized
+	void ResizeBuffers(sf::Vector2u newSize) {
+		if (newSize == bufferSize) {
+			return;
+		}
+		bufferSize = newSize;
+		accumulation.assign(static_cast<size_t>(bufferSize.x) * bufferSize.y, SplatCell());
+		pixels.assign(static_cast<size_t>(bufferSize.x) * bufferSize.y * 4, 0);
+		touchedPixels.clear();
+		touchedPixels.reserve(1024);
+		if (bufferSize.x > 0 && bufferSize.y > 0) {
+			splatTexture.create(bufferSize.x, bufferSize.y);
+		}
+		splatSprite.setTexture(splatTexture, true);
+	}
+
+	void Splat(unsigned int pixelIndex, SimColor color) {
+		SplatCell& cell = accumulation[pixelIndex];
+		if (cell.count == 0) {
+			touchedPixels.push_back(pixelIndex);
+		}
+		cell.r += color.r;
+		cell.g += color.g;
+		cell.b += color.b;
+		cell.count += 1;
+	}
+
+	// Turns the sums into the final RGBA pixels. only the touched pixels are visited
+	void ResolveSplats() {
+		for (unsigned int pixelIndex : touchedPixels) {
+			SplatCell& cell = accumulation[pixelIndex];
+			sf::Uint8* pixel = &pixels[static_cast<size_t>(pixelIndex) * 4];
+			pixel[0] = static_cast<sf::Uint8>(cell.r / cell.count);
+			pixel[1] = static_cast<sf::Uint8>(cell.g / cell.count);
+			pixel[2] = static_cast<sf::Uint8>(cell.b / cell.count);
+			pixel[3] = static_cast<sf::Uint8>(std::min(255.f, cell.count * densityGain));
+		}
+	}
+
+	// After the upload the touched pixels go back to zero for the next frame
+	void ClearSplats() {
+		for (unsigned int pixelIndex : touchedPixels) {
+			accumulation[pixelIndex] = SplatCell();
+			std::fill_n(&pixels[static_cast<size_t>(pixelIndex) * 4], 4, 0);
+		}
+		touchedPixels.clear();
+	}
+
+public:
+	LodRenderer() {}
+
+	void SetEnabled(bool isEnabled) { enabled = isEnabled; }
+
+	bool IsEnabled() const { return enabled; }
+
+	void ToggleEnabled() { enabled = !enabled; }
+
+	void SetScreenRadiusThreshold(float pixelsRadius) { screenRadiusThreshold = pixelsRadius; }
+
+	float GetScreenRadiusThreshold() const { return screenRadiusThreshold; }
+
+	void SetDensityGain(float gain) { densityGain = gain; }
+
+	int GetLastSplattedCount() const { return lastSplatted; }
+
+	int GetLastDrawnCount() const { return lastDrawn; }
+
+	// Draws all the objects with the target current view. big ones with drawShape(obj), small ones as splats
+	template <typename DrawShapeFunction>
+	void Draw(sf::RenderTarget& target, const std::vector<BaseShape*>& objList, DrawShapeFunction&& drawShape) {
+		lastSplatted = 0;
+		lastDrawn = 0;
+
+		if (!enabled) {
+			for (auto& obj : objList) {
+				drawShape(obj);
+			}
+			lastDrawn = static_cast<int>(objList.size());
+			return;
+		}
+
+		ResizeBuffers(target.getSize());
+		if (bufferSize.x == 0 || bufferSize.y == 0) {
+			return;
+		}
+
+		// World -> pixel mapping of the current view, calculated once instead of mapCoordsToPixel per object
+		const sf::View view = target.getView();
+		sf::Vector2f viewSize = view.getSize();
+		sf::Vector2f viewTopLeft = view.getCenter() - viewSize / 2.f;
+		sf::Vector2f pixelsPerUnit(bufferSize.x / viewSize.x, bufferSize.y / viewSize.y);
+		float pixelsPerUnitRadius = std::min(std::abs(pixelsPerUnit.x), std::abs(pixelsPerUnit.y));
+
+		for (auto& obj : objList) {
+			sf::Vector2f pos = obj->GetPosition();
+			float pixelX = (pos.x - viewTopLeft.x) * pixelsPerUnit.x;
+			float pixelY = (pos.y - viewTopLeft.y) * pixelsPerUnit.y;
+			float screenRadius = obj->GetEstimatedSize() * pixelsPerUnitRadius;
+
+			// Out of the screen, nothing to draw
+			if (pixelX + screenRadius < 0 || pixelY + screenRadius < 0 ||
+				pixelX - screenRadius >= bufferSize.x || pixelY - screenRadius >= bufferSize.y) {
+				continue;
+			}
+
+			if (screenRadius >= screenRadiusThreshold) {
+				drawShape(obj);
+				lastDrawn++;
+			}
+			else if (pixelX >= 0 && pixelY >= 0 && pixelX < bufferSize.x && pixelY < bufferSize.y) {
+				unsigned int pixelIndex = static_cast<unsigned int>(pixelY) * bufferSize.x + static_cast<unsigned int>(pixelX);
+				Splat(pixelIndex, obj->GetColor());
+				lastSplatted++;
+			}
+		}
+
+		if (touchedPixels.empty()) {
+			return;
+		}
+
+		ResolveSplats();
+		splatTexture.update(pixels.data());
+
+		// The splat texture is in pixels, so it is drawn with the default view on top of the world
+		target.setView(target.getDefaultView());
+		target.draw(splatSprite);
+		target.setView(view);
+
+		ClearSplats();
+	}
+};
@@ -0,0 +1 @@
+#include "NetFrame.h"
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <memory>
+#include <vector>
+#include <string>
+
+// Little endian byte helpers for the binary wire formats.
+// Written byte by byte so the wire layout does not depend on the machine or the struct padding.
+struct Wire
+{
+	static void PutU8(std::uint8_t* out, std::uint8_t value) { out[0] = value; }
+
+	static void PutU16(std::uint8_t* out, std::uint16_t value) {
+		out[0] = static_cast<std::uint8_t>(value);
+		out[1] = static_cast<std::uint8_t>(value >> 8);
+	}
+
+	static void PutU32(std::uint8_t* out, std::uint32_t value) {
+		out[0] = static_cast<std::uint8_t>(value);
+		out[1] = static_cast<std::uint8_t>(value >> 8);
+		out[2] = static_cast<std::uint8_t>(value >> 16);
+		out[3] = static_cast<std::uint8_t>(value >> 24);
+	}
+
+	static void PutF32(std::uint8_t* out, float value) { PutU32(out, std::bit_cast<std::uint32_t>(value)); }
+
+	static void PutF64(std::uint8_t* out, double value) {
+		std::uint64_t bits = std::bit_cast<std::uint64_t>(value);
+		PutU32(out, static_cast<std::uint32_t>(bits));
+		PutU32(out + 4, static_cast<std::uint32_t>(bits >> 32));
+	}
+
+	static std::uint8_t GetU8(const std::uint8_t* in) { return in[0]; }
+
+	static std::uint16_t GetU16(const std::uint8_t* in) {
+		return static_cast<std::uint16_t>(in[0] | (in[1] << 8));
+	}
+
+	static std::uint32_t GetU32(const std::uint8_t* in) {
+		return static_cast<std::uint32_t>(in[0]) | (static_cast<std::uint32_t>(in[1]) << 8) |
+			(static_cast<std::uint32_t>(in[2]) << 16) | (static_cast<std::uint32_t>(in[3]) << 24);
+	}
+
+	static float GetF32(const std::uint8_t* in) { return std::bit_cast<float>(GetU32(in)); }
+
+	static double GetF64(const std::uint8_t* in) {
+		return std::bit_cast<double>(static_cast<std::uint64_t>(GetU32(in)) | (static_cast<std::uint64_t>(GetU32(in + 4)) << 32));
+	}
+};
+
+// What a frame on the server -> client TCP stream carries
+enum class NetMessageType : std::uint8_t {
+	Text = 1,     // Old style text message ("broadcast:...", "client:...")
+	Snapshot = 2,     // Binary world snapshot, see Snapshot.h
+	DeltaSnapshot = 3, // Only what changed since a snapshot the client acknowledged, see DeltaSnapshot.h
+	Compressed = 4,    // Another frame, compressed (see SnapshotCompression.h)
+	InputAck = 5,      // u32 input sequence | u32 tick: the newest command of this client applied, the snapshot of that
+	                   // tick is the first to show it (see DragPrediction.h)
+	// Only between the server processes of a sharded world, see Sharding.h
+	ShardHello = 16,    // First frame of a link: who is calling
+	ShardExchange = 17, // Halo and migrating bodies of one tick, shard -> neighbour shard
+	ShardCommands = 18  // A binary command message (CommandProtocol.h), coordinator -> owning shard
+};
+
+// A whole frame (header included) that is never changed after it is written, so one copy can sit in the send
+// queue of every connection at the same time
+using SharedFrame = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+// Buffers for frames that are shared between send queues. A buffer is free again when the pool holds the only
+// reference to it (every connection that queued it is done sending), so a steady run does not allocate
+class FramePool
+{
+private:
+	std::vector<std::shared_ptr<std::vector<std::uint8_t>>> buffers;
+
+public:
+	std::shared_ptr<std::vector<std::uint8_t>> Take() {
+		for (auto& buffer : buffers) {
+			if (buffer.use_count() == 1) {
+				return buffer;
+			}
+		}
+		buffers.push_back(std::make_shared<std::vector<std::uint8_t>>());
+		return buffers.back();
+	}
+};
+
+// Every server -> client TCP message is a frame: u32 payload size | u8 NetMessageType | payload.
+// The size comes first so the reader knows how much to read, binary payloads can contain any byte (even '\n').
+struct NetFrame
+{
+	static constexpr std::size_t HeaderSize = 5;
+	static constexpr std::uint32_t MaxPayloadSize = 64 * 1024 * 1024; // Anything bigger is a broken stream
+
+	static void WriteHeader(std::uint8_t* out, NetMessageType type, std::uint32_t payloadSize) {
+		Wire::PutU32(out, payloadSize);
+		Wire::PutU8(out + 4, static_cast<std::uint8_t>(type));
+	}
+
+	static std::uint32_t ReadPayloadSize(const std::uint8_t* header) { return Wire::GetU32(header); }
+
+	static NetMessageType ReadType(const std::uint8_t* header) { return static_cast<NetMessageType>(Wire::GetU8(header + 4)); }
+
+	static SharedFrame MakeText(const std::string& message) {
+		auto frame = std::make_shared<std::vector<std::uint8_t>>(HeaderSize + message.size());
+		WriteHeader(frame->data(), NetMessageType::Text, static_cast<std::uint32_t>(message.size()));
+		std::memcpy(frame->data() + HeaderSize, message.data(), message.size());
+		return frame;
+	}
+
+	static constexpr std::size_t InputAckSize = 8;
+
+	static SharedFrame MakeInputAck(std::uint32_t sequence, std::uint32_t tick) {
+		auto frame = std::make_shared<std::vector<std::uint8_t>>(HeaderSize + InputAckSize);
+		WriteHeader(frame->data(), NetMessageType::InputAck, static_cast<std::uint32_t>(InputAckSize));
+		Wire::PutU32(frame->data() + HeaderSize, sequence);
+		Wire::PutU32(frame->data() + HeaderSize + 4, tick);
+		return frame;
+	}
+};
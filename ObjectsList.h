@@ -1,8 +1,10 @@
 #pragma once
 #include <vector>
+#include <deque>
 #include <random>
+#include <ctime>
+#include <algorithm>
 #include "Grid.h"
-#include "CircleBase.h"
 #include "LineLink.h"
 #include "Rectangle.h"
 #include "Planet.h"
@@ -13,27 +15,101 @@
 #include <atomic>
 #include "ThreadPool.h" // Include the ThreadPool header
 
+// One piece of a planet tracking line, from the old position to the new one
+struct TrailSegment {
+	sf::Vector2f start;
+	sf::Vector2f end;
+};
+
 class ObjectsList
 {
 private:
 	int objCount = 0;
 	std::mt19937 rnd;
+	unsigned int seed;
 	Grid* grid;
-	std::vector<std::pair<Planet*, sf::VertexArray>> planetList;
+	std::vector<std::pair<Planet*, std::deque<TrailSegment>>> planetList;
+	const size_t maxTrailSegments = 63; // How long the tracking line of a planet is
 	std::vector<ElectricalParticle*> electricalParticlesList;
 	float lineLength;
 	std::vector<BaseShape*> fixedObjects;
+	std::size_t contactCount = 0; // Overlaps resolved since the last ResetContactCount
 
 public:
 	LineLink connectedObjects = LineLink(lineLength);
 	std::vector<BaseShape*> objList;
 
 	ObjectsList(float lineLength) :lineLength(lineLength) { // Adjust cell size as needed
-		rnd.seed(static_cast<unsigned>(std::time(nullptr)));
+		Seed(static_cast<unsigned>(std::time(nullptr)));
+		grid = new GridUnorderd(); // One grid for the whole run, cleared every frame instead of allocating a new one
 	}
 
+	ObjectsList(const ObjectsList&) = delete;
+	ObjectsList& operator=(const ObjectsList&) = delete;
+
 	~ObjectsList() { // Deleter or else memory leak ):
 		DeleteAll();
+		delete grid;
+	}
+
+	// For the front ends that draw the objects
+	const std::vector<std::pair<Planet*, std::deque<TrailSegment>>>& GetPlanetList() const {
+		return planetList;
+	}
+
+	Grid* GetGrid() {
+		return grid;
+	}
+
+	// For the server telemetry, a pair can count once from each side
+	std::size_t ContactCount() const { return contactCount; }
+	void ResetContactCount() { contactCount = 0; }
+
+	// Seeds the spawns (the links have a generator of their own, connectedObjects.Seed), for a session that has to run
+	// the same again
+	void Seed(unsigned int newSeed) {
+		seed = newSeed;
+		rnd.seed(seed);
+	}
+
+	unsigned int GetSeed() const { return seed; }
+
+	// The ids of new bodies count up from here, so the shards of one world never hand out the same id
+	void SetIDBase(int base) {
+		objCount = base;
+	}
+
+	// Puts a body made somewhere else into the world (a body another shard handed over), in the same lists the
+	// Create functions put it in. fixed is a body CreateNewFixedCircle would make, particles know it themselves.
+	// The grid is filled from objList every step, nothing to do there
+	void InsertObj(BaseShape* obj, bool fixed) {
+		objList.push_back(obj);
+		if (obj->GetKind() == ShapeKind::ElectricalParticle) {
+			electricalParticlesList.push_back(static_cast<ElectricalParticle*>(obj));
+		}
+		else if (obj->GetKind() == ShapeKind::Planet) {
+			planetList.push_back(std::make_pair(static_cast<Planet*>(obj), std::deque<TrailSegment>()));
+		}
+		else if (fixed) {
+			fixedObjects.push_back(obj);
+		}
+	}
+
+	bool IsFixedObj(BaseShape* obj) const {
+		return std::find(fixedObjects.begin(), fixedObjects.end(), obj) != fixedObjects.end();
+	}
+
+	// Takes a body out of the world without deleting it (its links go with it)
+	void DetachObj(BaseShape* obj) {
+		auto found = std::find(objList.begin(), objList.end(), obj);
+		if (found != objList.end()) {
+			objList.erase(found);
+		}
+		electricalParticlesList.erase(std::remove(electricalParticlesList.begin(), electricalParticlesList.end(), obj), electricalParticlesList.end());
+		fixedObjects.erase(std::remove(fixedObjects.begin(), fixedObjects.end(), obj), fixedObjects.end());
+		planetList.erase(std::remove_if(planetList.begin(), planetList.end(),
+			[obj](const std::pair<Planet*, std::deque<TrailSegment>>& planet) { return planet.first == obj; }), planetList.end());
+		connectedObjects.RemoveObject(obj);
 	}
 
 	void DeleteAll() {
@@ -42,11 +118,13 @@ public:
 		}
 		objList.clear();
 		planetList.clear();
+		electricalParticlesList.clear();
+		fixedObjects.clear();
 		connectedObjects.Clear();
 		objCount = 0;
 	}
 
-	BaseShape* CreateNewCircle(float gravity, sf::Color color, sf::Vector2f pos, sf::Vector2f initialVel) {
+	BaseShape* CreateNewCircle(float gravity, SimColor color, sf::Vector2f pos, sf::Vector2f initialVel) {
 		std::uniform_int_distribution<int> radiusRange(20, 20);
 
 		sf::Vector2f position(pos);
@@ -59,7 +137,7 @@ public:
 		// std::cout << "Creating ball at position: (" << position.x << ", " << position.y << ")\n";
 	}
 
-	BaseShape* CreateNewFixedCircle(sf::Color color, sf::Vector2f pos) {
+	BaseShape* CreateNewFixedCircle(SimColor color, sf::Vector2f pos) {
 		std::uniform_int_distribution<int> radiusRange(20, 20);
 
 		sf::Vector2f position(pos);
@@ -73,55 +151,16 @@ public:
 		// std::cout << "Creating ball at position: (" << position.x << ", " << position.y << ")\n";
 	}
 
-	void addThickLine(sf::VertexArray& vertices, const sf::Vector2f& start, const sf::Vector2f& end, float thickness, const sf::Color& color) {
-		sf::Vector2f direction = end - start;
-		float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
-		if (length != 0) {
-			direction.x /= length;
-			direction.y /= length;
-		}
-		sf::Vector2f perpendicular(-direction.y * thickness / 2, direction.x * thickness / 2);
-
-		// Define the 4 corners of the rectangle
-		sf::Vector2f topLeft = start + perpendicular;
-		sf::Vector2f bottomLeft = start - perpendicular;
-		sf::Vector2f topRight = end + perpendicular;
-		sf::Vector2f bottomRight = end - perpendicular;
-
-		// Append the 4 vertices to the VertexArray
-		vertices.append(sf::Vertex(topLeft, color));
-		vertices.append(sf::Vertex(bottomLeft, color));
-		vertices.append(sf::Vertex(bottomRight, color));
-		vertices.append(sf::Vertex(topRight, color));
-	}
-
-	void rebuildVertexArray(sf::VertexArray& vertices, size_t maxVertices) {
-		// Only keep the last `maxVertices` vertices, corresponding to `maxVertices / 4` segments
-		size_t vertexCount = vertices.getVertexCount();
-		if (vertexCount > maxVertices) {
-			// Rebuild the array to only include the last `maxVertices` vertices
-			sf::VertexArray newVertices(sf::Quads);
-
-			// Copy the last `maxVertices` vertices
-			for (size_t i = vertexCount - maxVertices; i < vertexCount; ++i) {
-				newVertices.append(vertices[i]);
-			}
-
-			// Replace old vertices with the new one
-			vertices = newVertices;
-		}
-	}
-
-	void CreateNewPlanet(float innerGravity, sf::Color color, sf::Vector2f pos, float radius, float mass) {
+	void CreateNewPlanet(float innerGravity, SimColor color, sf::Vector2f pos, float radius, float mass) {
 		float gravity = 0;
 		Planet* planet = new Planet(radius, color, pos, gravity, mass, innerGravity, objCount);
 		objList.push_back(planet); // Pushing back the BaseShape* into the vector of all objects
-		sf::VertexArray trackingLine(sf::Quads);
+		std::deque<TrailSegment> trackingLine;
 		planetList.push_back(std::make_pair(planet, trackingLine)); // Pushing back the Planet* and tracking line into the vector of planets
 		objCount += 1;
 	}
 
-	void CreateNewElectricalParticle(double charge, bool isFixed, sf::Vector2f initialVel, sf::Color color, sf::Vector2f pos, float radius, float mass) {
+	void CreateNewElectricalParticle(double charge, bool isFixed, sf::Vector2f initialVel, SimColor color, sf::Vector2f pos, float radius, float mass) {
 		float gravity = 0;
 		ElectricalParticle* particle = new ElectricalParticle(radius, color, pos, gravity, mass, charge, isFixed, initialVel, objCount);
 		objList.push_back(particle); // Pushing back the BaseShape* into the vector of all objects
@@ -129,7 +168,7 @@ public:
 		objCount += 1;
 	}
 
-	void CreateNewRectangle(float gravity, sf::Color color, sf::Vector2f pos) {
+	void CreateNewRectangle(float gravity, SimColor color, sf::Vector2f pos) {
 		std::uniform_int_distribution<int> heightRange(50, 50);
 		std::uniform_int_distribution<int> widthRange(50, 50);
 		std::uniform_int_distribution<int> rndXRange(300, 500);  // Replace 920 with actual window width
@@ -150,7 +189,7 @@ public:
 		connectedObjects.MakeNewLink(shape, target, type);
 	} //TODO : Use this because it is more OOP way
 
-	BaseShape* createNewLinkedCircle(BaseShape* target, int type, float gravity, sf::Color color, sf::Vector2f pos, sf::Vector2f initialVel) {
+	BaseShape* createNewLinkedCircle(BaseShape* target, int type, float gravity, SimColor color, sf::Vector2f pos, sf::Vector2f initialVel) {
 		CreateNewCircle(gravity, color, pos, initialVel);
 		connectedObjects.MakeNewLink(objList[objCount - 1], target, type);
 		return objList[objCount - 1];
@@ -271,7 +310,7 @@ public:
 					if (Circle* circle = dynamic_cast<Circle*>(obj)) {
 						if (Circle* otherCircle = dynamic_cast<Circle*>(otherObj)) {
 							if (circle != otherCircle) {
-								circle->HandleCollision(otherCircle);
+								contactCount += circle->HandleCollision(otherCircle);
 							}
 						}
 					}
@@ -280,20 +319,20 @@ public:
 						if (RectangleClass* otherRectangle = dynamic_cast<RectangleClass*>(otherObj))
 						{
 							if (rectangle != otherRectangle) {
-								rectangle->HandleCollision(otherRectangle); // Handle collision with any other shape
+								contactCount += rectangle->HandleCollision(otherRectangle); // Handle collision with any other shape
 							}
 						}
 					}
 					if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(obj)) {
 						if (Circle* otherCircle = dynamic_cast<Circle*>(otherObj))
 						{
-							rectangle->HandleCollision(otherCircle); // Handle collision with any other shape
+							contactCount += rectangle->HandleCollision(otherCircle); // Handle collision with any other shape
 						}
 					}
 					else if (Circle* otherCircle = dynamic_cast<Circle*>(otherObj)) {
 						if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(obj))
 						{
-							rectangle->HandleCollision(otherCircle); // Handle collision with any other shape
+							contactCount += rectangle->HandleCollision(otherCircle); // Handle collision with any other shape
 						}
 					}
 				}
@@ -321,7 +360,7 @@ public:
 					if (Circle* circle = dynamic_cast<Circle*>(obj)) {
 						if (Circle* otherCircle = dynamic_cast<Circle*>(otherObj)) {
 							if (circle != otherCircle) {
-								circle->HandleCollisionElastic(otherCircle, elastic);
+								contactCount += circle->HandleCollisionElastic(otherCircle, elastic);
 							}
 						}
 					}
@@ -345,12 +384,7 @@ public:
 	}
 
 	void DeleteThisObj(BaseShape* obj) {
-		auto potentialErased = std::find(objList.begin(), objList.end(), obj);
-
-		// If found, erase it from the vector
-		if (potentialErased != objList.end()) {
-			objList.erase(potentialErased);
-		}
+		DetachObj(obj); // Out of every list and link first, they would keep the pointer
 		delete obj;
 	}
 
@@ -402,7 +436,7 @@ public:
 				}
 			}
 			else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(obj)) {
-				sf::FloatRect bounds = rectangle->GetGlobalBounds();
+				SimRect bounds = rectangle->GetGlobalBounds();
 
 				if (bounds.contains(pos)) {
 					return obj->GetID();
@@ -417,7 +451,7 @@ public:
 		std::vector<BaseShape*> combinedObjects;
 		combinedObjects.insert(combinedObjects.end(), objList.begin(), objList.end());
 		combinedObjects.insert(combinedObjects.end(), fixedObjects.begin(), fixedObjects.end());
-		for (auto planet : planetList) {
+		for (auto& planet : planetList) {
 			BaseShape* planetPointer = planet.first;
 			combinedObjects.push_back(planetPointer);
 		}
@@ -428,16 +462,6 @@ public:
 		return combinedObjects;
 	}
 
-	void DrawObjects(sf::RenderWindow& window, float fps, bool planetMode) {
-		float deltaTime = 1 / fps;
-		connectedObjects.Draw(window);
-		//grid->DrawGrids(window);
-		for (auto& ball : objList) {
-			ball->draw(window);
-		}
-
-	}
-
 	void MoveWhenFreeze(int window_width, int window_height, float fps, bool borderless) {
 		/*if (borderless)
 		{
@@ -447,7 +471,6 @@ public:
 		{
 			grid = new GridFixed();
 		}*/
-		grid = new GridUnorderd();
 		grid->clear(); // Clear the grid
 
 		for (auto& ball : objList) {
@@ -472,8 +495,6 @@ public:
 		//{
 		//	grid = new GridFixed();
 		//}
-		grid = new GridUnorderd();
-
 		grid->clear(); // Clear the grid
 
 		for (auto& ball : objList) {
@@ -503,20 +524,10 @@ public:
 				}
 			}
 			planetList[i].first->applyOneForce(allForces);
-			addThickLine(planetList[i].second, planetList[i].first->GetOldPosition(), planetList[i].first->GetPosition(), planetList[i].first->GetRadius() / 1.5, planetList[i].first->GetColor());
-			rebuildVertexArray(planetList[i].second, 252);
-			for (int alphaChange = planetList[i].second.getVertexCount() - 4; alphaChange >= 0; alphaChange -= 4)  // Start from last rectangle and move backwards
-			{
-				sf::Color newColor = planetList[i].first->GetColor();
-
-				// Gradually decrease alpha value from the last rectangle to the first (more transparent at the start, less transparent later)
-				newColor.a = std::max<sf::Uint8>(0u, newColor.a - (planetList[i].second.getVertexCount() - alphaChange - 4));  // Ensure the types match
-
-				// Apply the modified color to all 4 vertices of the current rectangle
-				planetList[i].second[alphaChange].color = newColor;
-				planetList[i].second[alphaChange + 1].color = newColor;
-				planetList[i].second[alphaChange + 2].color = newColor;
-				planetList[i].second[alphaChange + 3].color = newColor;
+			// The tracking line keeps only the last segments, the front ends draw it fading out
+			planetList[i].second.push_back({ planetList[i].first->GetOldPosition(), planetList[i].first->GetPosition() });
+			if (planetList[i].second.size() > maxTrailSegments) {
+				planetList[i].second.pop_front();
 			}
 			//planetList[i].first->SetOldPosition(planetList[i].first->GetPosition());
 		}
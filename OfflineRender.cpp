@@ -0,0 +1 @@
+#include "OfflineRender.h"
\ No newline at end of file
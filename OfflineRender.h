@@ -0,0 +1,95 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include <functional>
+#include <iostream>
+#include <string>
+#include "ObjectsList.h"
+#include "WorldRenderer.h"
+#include "FrameExporter.h"
+
+struct OfflineRenderSettings {
+	unsigned int width = 1920;
+	unsigned int height = 1080;
+	int frameCount = 600;
+	float dt = 1.0f / 60.0f; // Fixed step, one simulation step per frame
+	FrameFormat format = FrameFormat::PNG;
+	std::string outputPath = "render"; // Folder for PNG/PPM, file for the raw stream
+	int encoderCount = 0; // 0 = pick from the core count
+	float elastic = 0.0;
+	bool enableCollison = true;
+	bool borderless = false;
+	sf::Color background_color = sf::Color(30, 30, 30);
+};
+
+// Renders a simulation run to files instead of a window.
+// The simulation steps at a fixed dt (not the wall clock), every frame is drawn into a RenderTexture and handed
+// to the FrameExporter, so while the encoders write frame N the render thread is already on frame N+1.
+class OfflineRender
+{
+private:
+	OfflineRenderSettings settings;
+	ObjectsList objectList;
+	WorldRenderer worldRenderer;
+	sf::RenderTexture renderTexture;
+	bool planetMode = false;
+
+	// Reads the frame straight into the exporter buffer, sf::Texture::copyToImage would allocate a new image every frame
+	void ReadPixels(sf::Uint8* pixels) {
+		if (!renderTexture.setActive(true)) {
+			std::cerr << "Could not activate the render texture" << std::endl;
+			return;
+		}
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, settings.width, settings.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		renderTexture.setActive(false);
+	}
+
+public:
+	OfflineRender(const OfflineRenderSettings& settings, float lineLength = 150)
+		: settings(settings), objectList(lineLength) {}
+
+	// For building the scene before Run()
+	ObjectsList& GetObjectList() { return objectList; }
+
+	WorldRenderer& GetWorldRenderer() { return worldRenderer; }
+
+	void SetPlanetMode(bool isPlanetMode) { planetMode = isPlanetMode; }
+
+	bool Run() {
+		if (!renderTexture.create(settings.width, settings.height)) {
+			std::cerr << "Could not create a " << settings.width << "x" << settings.height << " render texture" << std::endl;
+			return false;
+		}
+
+		FrameExporter exporter(settings.outputPath, settings.format, settings.width, settings.height, settings.encoderCount);
+		float fps = 1.0f / settings.dt;
+
+		sf::Clock clock;
+		for (int frame = 0; frame < settings.frameCount; frame++) {
+			objectList.MoveObjects(settings.width, settings.height, fps, settings.elastic, planetMode, settings.enableCollison, settings.borderless);
+
+			renderTexture.clear(settings.background_color);
+			worldRenderer.Draw(renderTexture, objectList);
+			renderTexture.display();
+
+			sf::Uint8* pixels = exporter.AcquireBuffer(frame);
+			ReadPixels(pixels);
+			exporter.SubmitFrame(pixels);
+
+			if (frame % 60 == 0) {
+				std::cout << "Rendered frame " << frame << "/" << settings.frameCount << std::endl;
+			}
+		}
+		exporter.Finish();
+
+		float seconds = clock.getElapsedTime().asSeconds();
+		std::cout << "Wrote " << exporter.GetFramesWritten() << " frames in " << seconds << "s ("
+			<< exporter.GetFramesWritten() / seconds << " fps)" << std::endl;
+		if (settings.format == FrameFormat::RawStream) {
+			std::cout << "ffmpeg -f rawvideo -pix_fmt rgba -s " << settings.width << "x" << settings.height
+				<< " -r " << fps << " -i " << settings.outputPath << " out.mp4" << std::endl;
+		}
+		return true;
+	}
+};
@@ -7,6 +7,7 @@
 #include <ctime>
 #include "LineLink.h"
 #include "ObjectsList.h"
+#include "WorldRenderer.h"
 #include "Grid.h" 
 #include "Button.h"
 #include "Rectangle.h"
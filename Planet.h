@@ -1,5 +1,4 @@
 #pragma once
-#include <SFML/Graphics.hpp>
 #include <iostream> 
 #include "Circle.h"
 
@@ -9,18 +8,17 @@ private:
 	float innerGravity;
 
 public:
-	Planet(float radius, sf::Color color, sf::Vector2f pos, float gravity, double mass, float innerGravity, int objCount) : Circle(radius, color, pos, gravity, mass, sf::Vector2f(0, 0), objCount), innerGravity(innerGravity) {
+	Planet(float radius, SimColor color, sf::Vector2f pos, float gravity, double mass, float innerGravity, int objCount) : Circle(radius, color, pos, gravity, mass, sf::Vector2f(0, 0), objCount), innerGravity(innerGravity) {
 
 	}
 
 	// Copy constructor
 	Planet(Planet& other)
 		: Circle(other) {
-		// Copy SFML shape properties
-		setRadius(other.getRadius());
-		setFillColor(other.getFillColor());
-		setOrigin(other.getOrigin());
-		setPosition(other.getPosition());
+		// Copy shape properties
+		radius = other.radius;
+		color = other.color;
+		position = other.position;
 
 		// Copy Circle class properties
 		oldPosition = other.oldPosition;
@@ -31,6 +29,10 @@ public:
 	}
 
 
+	ShapeKind GetKind() const override {
+		return ShapeKind::Planet;
+	}
+
 	sf::Vector2f GravitateAccurate(BaseShape* object) {
 		// Calculate the vector from this object to the other object
 		sf::Vector2f distanceVec = object->GetPosition() - GetPosition(); // Reversed direction
@@ -0,0 +1 @@
+#include "Quantization.h"
\ No newline at end of file
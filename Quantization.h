@@ -0,0 +1,501 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <bit>
+#include "SimTypes.h"
+#include "NetFrame.h"
+#include "Snapshot.h"
+
+// Quantized body state for the snapshots. A client only draws the bodies, so it does not need full floats:
+// positions are fixed point inside the world bounds, sizes/masses/colors are indices into small tables of the
+// values in use, and velocity is only sent when the client extrapolates. Every field has its own bit budget.
+// A position or velocity outside its range goes as two full floats behind a flag bit instead of being clamped.
+
+struct QuantizationConfig
+{
+	SimRect worldBounds = SimRect(-4096, -4096, 16384, 16384); // Positions outside go as full floats
+	std::uint8_t positionBits = 18;   // Per axis, 1..24. 18 bits over 16384 units is 1/16 of a unit
+	std::uint8_t velocityBits = 12;   // Per axis, 0..24. 0 = velocity is not sent, the client extrapolates with it
+	float maxSpeed = 2048;            // Velocity range is -maxSpeed..maxSpeed, 12 bits is 1 unit/s. Faster goes as floats
+	std::uint8_t sizeIndexBits = 8;   // 1..16, how many different sizes (radius or width/height) can be told apart
+	std::uint8_t massIndexBits = 0;   // 0..16, 0 = mass is not sent
+	std::uint8_t colorIndexBits = 8;  // 1..16, palette size
+
+	static constexpr std::size_t WireSize = 28;
+
+	void Write(std::uint8_t* out) const {
+		Wire::PutF32(out, worldBounds.left);
+		Wire::PutF32(out + 4, worldBounds.top);
+		Wire::PutF32(out + 8, worldBounds.width);
+		Wire::PutF32(out + 12, worldBounds.height);
+		Wire::PutF32(out + 16, maxSpeed);
+		out[20] = positionBits;
+		out[21] = velocityBits;
+		out[22] = sizeIndexBits;
+		out[23] = massIndexBits;
+		out[24] = colorIndexBits;
+		out[25] = 0;
+		out[26] = 0;
+		out[27] = 0;
+	}
+
+	bool Read(const std::uint8_t* in) {
+		worldBounds = SimRect(Wire::GetF32(in), Wire::GetF32(in + 4), Wire::GetF32(in + 8), Wire::GetF32(in + 12));
+		maxSpeed = Wire::GetF32(in + 16);
+		positionBits = in[20];
+		velocityBits = in[21];
+		sizeIndexBits = in[22];
+		massIndexBits = in[23];
+		colorIndexBits = in[24];
+		return IsValid();
+	}
+
+	bool IsValid() const {
+		return positionBits >= 1 && positionBits <= 24 && velocityBits <= 24 &&
+			sizeIndexBits >= 1 && sizeIndexBits <= 16 && massIndexBits <= 16 &&
+			colorIndexBits >= 1 && colorIndexBits <= 16 &&
+			worldBounds.width > 0 && worldBounds.height > 0 && maxSpeed > 0;
+	}
+};
+
+// Packs values of any bit width (up to 24) one after the other, least significant bit first
+class BitWriter
+{
+private:
+	std::uint8_t* out;
+	std::uint64_t pending = 0;
+	int pendingBits = 0;
+
+public:
+	BitWriter(std::uint8_t* out) : out(out) {}
+
+	void Write(std::uint32_t value, int bitCount) {
+		pending |= static_cast<std::uint64_t>(value & ((1u << bitCount) - 1)) << pendingBits;
+		pendingBits += bitCount;
+		while (pendingBits >= 8) {
+			*out++ = static_cast<std::uint8_t>(pending);
+			pending >>= 8;
+			pendingBits -= 8;
+		}
+	}
+
+	void WriteF32(float value) {
+		std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+		Write(bits & 0xFFFF, 16);
+		Write(bits >> 16, 16);
+	}
+
+	// Small numbers in few bytes, 7 bits per group
+	void WriteVarint(std::uint32_t value) {
+		while (value >= 0x80) {
+			Write((value & 0x7F) | 0x80, 8);
+			value >>= 7;
+		}
+		Write(value, 8);
+	}
+
+	// Writes the last partial byte, returns the end of the written data
+	std::uint8_t* Finish() {
+		if (pendingBits > 0) {
+			*out++ = static_cast<std::uint8_t>(pending);
+			pending = 0;
+			pendingBits = 0;
+		}
+		return out;
+	}
+};
+
+class BitReader
+{
+private:
+	const std::uint8_t* in;
+	const std::uint8_t* end;
+	std::uint64_t pending = 0;
+	int pendingBits = 0;
+	bool failed = false;
+
+public:
+	BitReader(const std::uint8_t* in, const std::uint8_t* end) : in(in), end(end) {}
+
+	std::uint32_t Read(int bitCount) {
+		while (pendingBits < bitCount) {
+			if (in == end) {
+				failed = true;
+				return 0;
+			}
+			pending |= static_cast<std::uint64_t>(*in++) << pendingBits;
+			pendingBits += 8;
+		}
+		std::uint32_t value = static_cast<std::uint32_t>(pending & ((1u << bitCount) - 1));
+		pending >>= bitCount;
+		pendingBits -= bitCount;
+		return value;
+	}
+
+	float ReadF32() {
+		std::uint32_t low = Read(16);
+		return std::bit_cast<float>(low | (Read(16) << 16));
+	}
+
+	std::uint32_t ReadVarint() {
+		std::uint32_t value = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			std::uint32_t group = Read(8);
+			value |= (group & 0x7F) << shift;
+			if ((group & 0x80) == 0) {
+				return value;
+			}
+		}
+		failed = true;
+		return 0;
+	}
+
+	bool Failed() const { return failed; }
+};
+
+// Keys and distances for the values the tables hold
+struct QuantValue
+{
+	static std::uint64_t Key(float value) { return std::bit_cast<std::uint32_t>(value); }
+	static std::uint64_t Key(sf::Vector2f value) {
+		return (static_cast<std::uint64_t>(std::bit_cast<std::uint32_t>(value.x)) << 32) | std::bit_cast<std::uint32_t>(value.y);
+	}
+	static std::uint64_t Key(SimColor value) { return (value.r << 16) | (value.g << 8) | value.b; }
+
+	// Relative difference, masses go from particles (1e-27) to planets (1e16)
+	static float Distance(float a, float b) {
+		float largest = std::max(std::abs(a), std::abs(b));
+		return largest == 0 ? 0 : std::abs(a - b) / largest;
+	}
+	static float Distance(sf::Vector2f a, sf::Vector2f b) { return Distance(a.x, b.x) + Distance(a.y, b.y); }
+	static float Distance(SimColor a, SimColor b) {
+		float dr = static_cast<float>(a.r) - b.r;
+		float dg = static_cast<float>(a.g) - b.g;
+		float db = static_cast<float>(a.b) - b.b;
+		return dr * dr + dg * dg + db * db;
+	}
+};
+
+// Append only table of the values in use, the index is what goes on the wire.
+// Indices never change, so a client that got entries 0..n once keeps them. When the table is full a new value
+// gets the nearest entry (and that answer is remembered, the search is done once per distinct value)
+template <typename Value>
+class QuantTable
+{
+private:
+	std::vector<Value> values;
+	std::unordered_map<std::uint64_t, std::uint32_t> indexByKey;
+	std::uint32_t capacity = 256;
+
+public:
+	void Reset(std::uint32_t newCapacity) {
+		capacity = newCapacity;
+		values.clear();
+		indexByKey.clear();
+	}
+
+	std::uint32_t IndexOf(const Value& value) {
+		std::uint64_t key = QuantValue::Key(value);
+		auto found = indexByKey.find(key);
+		if (found != indexByKey.end()) {
+			return found->second;
+		}
+		std::uint32_t index = 0;
+		if (values.size() < capacity) {
+			index = static_cast<std::uint32_t>(values.size());
+			values.push_back(value);
+		}
+		else {
+			float best = QuantValue::Distance(values[0], value);
+			for (std::uint32_t i = 1; i < values.size(); i++) {
+				float distance = QuantValue::Distance(values[i], value);
+				if (distance < best) {
+					best = distance;
+					index = i;
+				}
+			}
+		}
+		indexByKey.emplace(key, index);
+		return index;
+	}
+
+	// Client side, the entries come from the snapshots
+	void Set(std::uint32_t index, const Value& value) {
+		if (index >= values.size()) {
+			values.resize(index + 1);
+		}
+		values[index] = value;
+	}
+
+	bool Has(std::uint32_t index) const { return index < values.size(); }
+
+	const Value& Get(std::uint32_t index) const { return values[index]; }
+
+	std::uint32_t Size() const { return static_cast<std::uint32_t>(values.size()); }
+};
+
+// How full every table was at some tick, a snapshot carries the entries added since its baseline
+struct QuantTableSizes
+{
+	std::uint32_t sizes = 0;
+	std::uint32_t masses = 0;
+	std::uint32_t colors = 0;
+};
+
+// Both sides of the quantized encoding. the server snaps and writes, the client reads.
+// Snap() rounds a record to exactly what the client will decode, so the delta compare skips bodies that
+// moved less than one step
+class Quantizer
+{
+private:
+	QuantizationConfig config;
+	QuantTable<sf::Vector2f> sizes;
+	QuantTable<float> masses;
+	QuantTable<SimColor> colors;
+
+	static std::uint32_t MaxCode(int bits) { return (1u << bits) - 1; }
+
+	static std::uint32_t Encode(float value, float origin, float extent, int bits) {
+		float scaled = std::round((value - origin) / extent * MaxCode(bits));
+		if (!(scaled > 0)) return 0; // Also NaN
+		return static_cast<std::uint32_t>(std::min(scaled, static_cast<float>(MaxCode(bits))));
+	}
+
+	static float Decode(std::uint32_t code, float origin, float extent, int bits) {
+		return origin + code * (extent / MaxCode(bits));
+	}
+
+	// Also false for NaN and infinity, those go as floats too
+	static bool InRange(float value, float origin, float extent) {
+		return value >= origin && value <= origin + extent;
+	}
+
+	bool PositionInRange(sf::Vector2f position) const {
+		const SimRect& bounds = config.worldBounds;
+		return InRange(position.x, bounds.left, bounds.width) && InRange(position.y, bounds.top, bounds.height);
+	}
+
+	bool VelocityInRange(sf::Vector2f velocity) const {
+		return InRange(velocity.x, -config.maxSpeed, config.maxSpeed * 2) && InRange(velocity.y, -config.maxSpeed, config.maxSpeed * 2);
+	}
+
+	sf::Vector2f DecodePosition(std::uint32_t x, std::uint32_t y) const {
+		return sf::Vector2f(Decode(x, config.worldBounds.left, config.worldBounds.width, config.positionBits),
+			Decode(y, config.worldBounds.top, config.worldBounds.height, config.positionBits));
+	}
+
+	sf::Vector2f DecodeVelocity(std::uint32_t x, std::uint32_t y) const {
+		return sf::Vector2f(Decode(x, -config.maxSpeed, config.maxSpeed * 2, config.velocityBits),
+			Decode(y, -config.maxSpeed, config.maxSpeed * 2, config.velocityBits));
+	}
+
+	// Flag bit, then the codes or (flag set) the floats as they are
+	void WritePosition(BitWriter& writer, sf::Vector2f position) const {
+		const SimRect& bounds = config.worldBounds;
+		bool inRange = PositionInRange(position);
+		writer.Write(inRange ? 0 : 1, 1);
+		if (inRange) {
+			writer.Write(Encode(position.x, bounds.left, bounds.width, config.positionBits), config.positionBits);
+			writer.Write(Encode(position.y, bounds.top, bounds.height, config.positionBits), config.positionBits);
+		}
+		else {
+			writer.WriteF32(position.x);
+			writer.WriteF32(position.y);
+		}
+	}
+
+	void WriteVelocity(BitWriter& writer, sf::Vector2f velocity) const {
+		bool inRange = VelocityInRange(velocity);
+		writer.Write(inRange ? 0 : 1, 1);
+		if (inRange) {
+			writer.Write(Encode(velocity.x, -config.maxSpeed, config.maxSpeed * 2, config.velocityBits), config.velocityBits);
+			writer.Write(Encode(velocity.y, -config.maxSpeed, config.maxSpeed * 2, config.velocityBits), config.velocityBits);
+		}
+		else {
+			writer.WriteF32(velocity.x);
+			writer.WriteF32(velocity.y);
+		}
+	}
+
+	sf::Vector2f ReadPosition(BitReader& reader) const {
+		if (reader.Read(1)) {
+			float x = reader.ReadF32();
+			return sf::Vector2f(x, reader.ReadF32());
+		}
+		std::uint32_t x = reader.Read(config.positionBits);
+		return DecodePosition(x, reader.Read(config.positionBits));
+	}
+
+	sf::Vector2f ReadVelocity(BitReader& reader) const {
+		if (reader.Read(1)) {
+			float x = reader.ReadF32();
+			return sf::Vector2f(x, reader.ReadF32());
+		}
+		std::uint32_t x = reader.Read(config.velocityBits);
+		return DecodeVelocity(x, reader.Read(config.velocityBits));
+	}
+
+public:
+	static constexpr int KindBits = 3;
+	static constexpr int LinkedBits = 2; // linked + 1, so -1..2
+
+	Quantizer(const QuantizationConfig& config = QuantizationConfig()) {
+		SetConfig(config);
+	}
+
+	// Server side. the tables start over, so the clients have to get a full snapshot after it
+	void SetConfig(const QuantizationConfig& newConfig) {
+		config = newConfig;
+		sizes.Reset(1u << config.sizeIndexBits);
+		masses.Reset(config.massIndexBits > 0 ? 1u << config.massIndexBits : 1);
+		colors.Reset(1u << config.colorIndexBits);
+	}
+
+	const QuantizationConfig& GetConfig() const { return config; }
+
+	QuantTableSizes GetTableSizes() const { return QuantTableSizes{ sizes.Size(), masses.Size(), colors.Size() }; }
+
+	void Snap(BodyRecord& record) {
+		const SimRect& bounds = config.worldBounds;
+		if (PositionInRange(record.position)) { // Out of range stays as it is, it goes as floats
+			record.position = DecodePosition(Encode(record.position.x, bounds.left, bounds.width, config.positionBits),
+				Encode(record.position.y, bounds.top, bounds.height, config.positionBits));
+		}
+		if (config.velocityBits == 0) {
+			record.velocity = sf::Vector2f(0, 0);
+		}
+		else if (VelocityInRange(record.velocity)) {
+			record.velocity = DecodeVelocity(Encode(record.velocity.x, -config.maxSpeed, config.maxSpeed * 2, config.velocityBits),
+				Encode(record.velocity.y, -config.maxSpeed, config.maxSpeed * 2, config.velocityBits));
+		}
+		record.size = sizes.Get(sizes.IndexOf(record.size));
+		record.mass = config.massIndexBits > 0 ? masses.Get(masses.IndexOf(record.mass)) : 0;
+		record.color = colors.Get(colors.IndexOf(SimColor(record.color.r, record.color.g, record.color.b)));
+		record.linked = static_cast<std::int8_t>(std::clamp<int>(record.linked, -1, 2));
+	}
+
+	// The DeltaField bits of a record, the record must be snapped already
+	void WriteFields(BitWriter& writer, const BodyRecord& record, std::uint8_t mask) {
+		if (mask & DeltaPosition) {
+			WritePosition(writer, record.position);
+		}
+		if ((mask & DeltaVelocity) && config.velocityBits > 0) {
+			WriteVelocity(writer, record.velocity);
+		}
+		if (mask & DeltaColor) {
+			writer.Write(colors.IndexOf(record.color), config.colorIndexBits);
+		}
+		if (mask & DeltaSize) {
+			writer.Write(sizes.IndexOf(record.size), config.sizeIndexBits);
+		}
+		if ((mask & DeltaMass) && config.massIndexBits > 0) {
+			writer.Write(masses.IndexOf(record.mass), config.massIndexBits);
+		}
+		if (mask & DeltaKindAndLinked) {
+			writer.Write(static_cast<std::uint32_t>(record.kind), KindBits);
+			writer.Write(static_cast<std::uint32_t>(record.linked + 1), LinkedBits);
+		}
+	}
+
+	bool ReadFields(BitReader& reader, std::uint8_t mask, BodyRecord& record) const {
+		if (mask & DeltaPosition) {
+			record.position = ReadPosition(reader);
+		}
+		if ((mask & DeltaVelocity) && config.velocityBits > 0) {
+			record.velocity = ReadVelocity(reader);
+		}
+		if (mask & DeltaColor) {
+			std::uint32_t index = reader.Read(config.colorIndexBits);
+			if (!colors.Has(index)) return false;
+			record.color = colors.Get(index);
+		}
+		if (mask & DeltaSize) {
+			std::uint32_t index = reader.Read(config.sizeIndexBits);
+			if (!sizes.Has(index)) return false;
+			record.size = sizes.Get(index);
+		}
+		if ((mask & DeltaMass) && config.massIndexBits > 0) {
+			std::uint32_t index = reader.Read(config.massIndexBits);
+			if (!masses.Has(index)) return false;
+			record.mass = masses.Get(index);
+		}
+		if (mask & DeltaKindAndLinked) {
+			record.kind = static_cast<ShapeKind>(reader.Read(KindBits));
+			record.linked = static_cast<std::int8_t>(static_cast<int>(reader.Read(LinkedBits)) - 1);
+		}
+		return !reader.Failed();
+	}
+
+	// Config and the table entries added between two table sizes:
+	//   QuantizationConfig | u32 first size index | u32 count | count * (f32, f32) |
+	//   u32 first mass index | u32 count | count * f32 | u32 first color index | u32 count | count * (u8 r, g, b)
+	std::size_t TablesWireSize(const QuantTableSizes& from, const QuantTableSizes& to) const {
+		return QuantizationConfig::WireSize + 24 + (to.sizes - from.sizes) * 8 + (to.masses - from.masses) * 4 + (to.colors - from.colors) * 3;
+	}
+
+	std::uint8_t* WriteTables(std::uint8_t* out, const QuantTableSizes& from, const QuantTableSizes& to) const {
+		config.Write(out);
+		out += QuantizationConfig::WireSize;
+		Wire::PutU32(out, from.sizes);
+		Wire::PutU32(out + 4, to.sizes - from.sizes);
+		out += 8;
+		for (std::uint32_t i = from.sizes; i < to.sizes; i++) {
+			Wire::PutF32(out, sizes.Get(i).x);
+			Wire::PutF32(out + 4, sizes.Get(i).y);
+			out += 8;
+		}
+		Wire::PutU32(out, from.masses);
+		Wire::PutU32(out + 4, to.masses - from.masses);
+		out += 8;
+		for (std::uint32_t i = from.masses; i < to.masses; i++) {
+			Wire::PutF32(out, masses.Get(i));
+			out += 4;
+		}
+		Wire::PutU32(out, from.colors);
+		Wire::PutU32(out + 4, to.colors - from.colors);
+		out += 8;
+		for (std::uint32_t i = from.colors; i < to.colors; i++) {
+			out[0] = colors.Get(i).r;
+			out[1] = colors.Get(i).g;
+			out[2] = colors.Get(i).b;
+			out += 3;
+		}
+		return out;
+	}
+
+	// Client side, takes the config and the new entries. returns nullptr when the data is broken
+	const std::uint8_t* ReadTables(const std::uint8_t* in, const std::uint8_t* end) {
+		if (end - in < static_cast<std::ptrdiff_t>(QuantizationConfig::WireSize) || !config.Read(in)) {
+			return nullptr;
+		}
+		in += QuantizationConfig::WireSize;
+
+		auto readRange = [&](std::uint32_t& first, std::uint32_t& count, std::size_t entrySize, std::uint32_t capacityBits) {
+			if (end - in < 8) return false;
+			first = Wire::GetU32(in);
+			count = Wire::GetU32(in + 4);
+			in += 8;
+			std::uint64_t last = static_cast<std::uint64_t>(first) + count;
+			return last <= (1ull << capacityBits) && static_cast<std::uint64_t>(end - in) >= count * entrySize;
+		};
+
+		std::uint32_t first = 0;
+		std::uint32_t count = 0;
+		if (!readRange(first, count, 8, config.sizeIndexBits)) return nullptr;
+		for (std::uint32_t i = 0; i < count; i++, in += 8) {
+			sizes.Set(first + i, sf::Vector2f(Wire::GetF32(in), Wire::GetF32(in + 4)));
+		}
+		if (!readRange(first, count, 4, std::max<std::uint32_t>(config.massIndexBits, 1))) return nullptr;
+		for (std::uint32_t i = 0; i < count; i++, in += 4) {
+			masses.Set(first + i, Wire::GetF32(in));
+		}
+		if (!readRange(first, count, 3, config.colorIndexBits)) return nullptr;
+		for (std::uint32_t i = 0; i < count; i++, in += 3) {
+			colors.Set(first + i, SimColor(in[0], in[1], in[2]));
+		}
+		return in;
+	}
+};
@@ -1,10 +1,10 @@
 #pragma once
-#include <SFML/Graphics.hpp>
 #include <iostream> 
 #include "BaseShape.h"
 #include "Circle.h"
 
-class RectangleClass : public BaseShape, public sf::RectangleShape
+// Plain simulation rectangle, the position is its center. drawn by the front ends
+class RectangleClass : public BaseShape
 {
 private:
 	float width;
@@ -13,26 +13,20 @@ private:
 public:
 	RectangleClass() :BaseShape(), width(0.0), height(0.0) {}; // must have deffult constructor for networking
 	// Constructor with radius, color, gravity, mass
-	RectangleClass(float width, float height, sf::Color color, float gravity, double mass, int objCount)
+	RectangleClass(float width, float height, SimColor color, float gravity, double mass, int objCount)
 		: BaseShape(color, gravity, mass, objCount), width(width), height(height)
 	{
-		setSize(sf::Vector2f(width, height));
-		setFillColor(color);
-		setOrigin(width / 2, height / 2);
-		setPosition(width / 2, height / 2);
+		position = sf::Vector2f(width / 2, height / 2);
 		oldPosition = sf::Vector2f(width, height);
 		acceleration = sf::Vector2f(0, gravity * 100); //(x axis, y axis)
 		type = "Rectangle";
 	}
 
 	// Constructor with radius, color, gravity, mass, position
-	RectangleClass(float width, float height, sf::Color color, sf::Vector2f pos, float gravity, double mass, int objCount)
+	RectangleClass(float width, float height, SimColor color, sf::Vector2f pos, float gravity, double mass, int objCount)
 		: BaseShape(color, gravity, mass, objCount), width(width), height(height)
 	{
-		setSize(sf::Vector2f(width, height));
-		setFillColor(color);
-		setOrigin(width / 2, height / 2);
-		setPosition(pos);
+		position = pos;
 		oldPosition = pos;
 		acceleration = sf::Vector2f(0, gravity * 100);//(x axis, y axis)
 		type = "Rectangle";
@@ -44,7 +38,7 @@ public:
 		sf::Vector2f currentPos = GetPosition();
 		sf::Vector2f newPos = currentPos + velocity * dt + (acceleration * (dt * dt * 0.5f));
 		oldPosition = currentPos;
-		setPosition(newPos);
+		position = newPos;
 
 		// Update velocity for the next frame
 		velocity = (newPos - currentPos) / dt;
@@ -56,24 +50,12 @@ public:
 		sf::Vector2f currentPos = GetPosition();
 		sf::Vector2f newPos = currentPos + velocity * dt + (acceleration * (dt * dt * 0.5f));
 		oldPosition = currentPos;
-		setPosition(newPos);
+		position = newPos;
 
 		// Update velocity for the next frame
 		velocity = (newPos - currentPos) / dt;
 	}
 
-	// Set shape color
-	void setColor(sf::Color newColor) override
-	{
-		color = newColor;  // Update the member variable
-		setFillColor(newColor);
-	}
-
-	// Function to draw the rectangle
-	void draw(sf::RenderWindow& window)
-	{
-		window.draw(*this);
-	}
 
 	void handleWallCollision(int window_width, int window_height) {
 		sf::Vector2f pos = GetPosition();
@@ -105,7 +87,7 @@ public:
 			oldPosition.y = pos.y + (pos.y - oldPosition.y) * energyLossFactor;
 		}
 
-		setPosition(pos);
+		position = pos;
 	}
 
 
@@ -138,8 +120,8 @@ public:
 		return 0.0;
 	}
 
-	double FindOverlap(sf::CircleShape* circle) {
-		sf::Vector2f circlePos = circle->getPosition();  // Circle's center
+	double FindOverlap(Circle* circle) {
+		sf::Vector2f circlePos = circle->GetPosition();  // Circle's center
 		sf::Vector2f rectPos = GetPosition();      // Rectangle's center
 
 		float halfRectWidth = width / 2;
@@ -154,7 +136,7 @@ public:
 		float distanceY = circlePos.y - closestY;
 		float distanceSquared = distanceX * distanceX + distanceY * distanceY;
 
-		float radius = circle->getRadius();
+		float radius = circle->GetRadius();
 
 		// If the distance is less than the radius, they overlap
 		if (distanceSquared <= radius * radius) {
@@ -187,7 +169,7 @@ public:
 
 	//Check if a point intersects with a rectangle
 	bool IsCollision(sf::Vector2f otherPos) {
-		sf::Vector2f pos = getPosition();
+		sf::Vector2f pos = position;
 		float x = pos.x;
 		float y = pos.y;
 		float xMouse = otherPos.x;
@@ -199,7 +181,7 @@ public:
 		return false;
 	}
 
-	void HandleCollision(RectangleClass* otherRec) {
+	bool HandleCollision(RectangleClass* otherRec) {
 		if (IsCollision(otherRec))
 		{
 			// Get positions of both circles
@@ -223,13 +205,15 @@ public:
 				posOther -= displacement * massRatio; // Move the other circle
 
 				// Update positions
-				setPosition(pos);
-				otherRec->setPosition(posOther);
+				position = pos;
+				otherRec->position = posOther;
+				return true;
 			}
 		}
+		return false;
 	}
 
-	void HandleCollision(Circle* circle) {
+	bool HandleCollision(Circle* circle) {
 		if (isCollison(circle))
 		{
 			// Get positions of both circles
@@ -253,10 +237,12 @@ public:
 				posOther -= displacement * massRatio; // Move the other circle
 
 				// Update positions
-				setPosition(pos);
-				circle->setPosition(posOther);
+				position = pos;
+				circle->SetPosition(posOther);
+				return true;
 			}
 		}
+		return false;
 	}
 
 	bool isCollison(Circle* circle) {
@@ -275,7 +261,7 @@ public:
 		float distX = xCir - testX;
 		float distY = yCir - testY;
 		float distance = sqrt((distX * distX) + (distY * distY));
-		if (distance <= circle->getRadius()) {
+		if (distance <= circle->GetRadius()) {
 			return true;
 		}
 		return false;
@@ -283,42 +269,25 @@ public:
 
 	void HandleCollisionElastic(RectangleClass* otherRec, float elastic) {}///!!!!!!!!!!//// fill
 
-	float GetHeight() {
+	float GetHeight() const {
 		return height;
 	}
 
-	float GetWidth() {
+	float GetWidth() const {
 		return width;
 	}
 
-	void SetPosition(sf::Vector2f newPos) override
-	{
-		setPosition(newPos);
-	}
-
 	void SetSizeAndOrigin(float newWidth, float newHeight) {
 		width = newWidth;
 		height = newHeight;
-		setOrigin(width, height);
-	}
-
-	void SetOutline(sf::Color color, float thickness) override {
-		setOutlineThickness(thickness);
-		setOutlineColor(color);
 	}
 
-	sf::Vector2f GetPosition() const override {
-		return getPosition();
-	}
-
-	std::string GetPositionStr() const override {
-		std::stringstream ss;
-		ss << "X=" << GetPosition().x << "Y=" << GetPosition().y;
-		return ss.str();
+	ShapeKind GetKind() const override {
+		return ShapeKind::Rectangle;
 	}
 
-	sf::FloatRect GetGlobalBounds()  override {
-		return getGlobalBounds();
+	SimRect GetGlobalBounds()  override {
+		return SimRect(position.x - width / 2, position.y - height / 2, width, height);
 	}
 
 	float GetEstimatedSize() override {
@@ -4,7 +4,7 @@
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <SFML/Graphics.hpp> // For sf::Color and sf::Vector2f
+#include "SimTypes.h" // For SimColor and sf::Vector2f
 
 #include "Circle.h"
 #include "Rectangle.h"
@@ -25,13 +25,13 @@ private:
     }
 
     // Extracts RGB color from a string in the format "rgb(r,g,b)"
-    static sf::Color ExtractColor(const std::string& colorStr) {
+    static SimColor ExtractColor(const std::string& colorStr) {
         size_t start = colorStr.find("(");
         size_t end = colorStr.find(")");
 
         if (start == std::string::npos || end == std::string::npos || start > end) {
             std::cerr << "Invalid color format: " << colorStr << std::endl;
-            return sf::Color(0, 0, 0); // Default to black
+            return SimColor(0, 0, 0); // Default to black
         }
 
         std::string values = colorStr.substr(start + 1, end - start - 1);
@@ -39,7 +39,7 @@ private:
 
         if (colorComponents.size() != 3) {
             std::cerr << "Invalid number of color components: " << colorStr << std::endl;
-            return sf::Color(0, 0, 0); // Default to black
+            return SimColor(0, 0, 0); // Default to black
         }
 
         try {
@@ -51,11 +51,11 @@ private:
             g = std::clamp(g, 0, 255);
             b = std::clamp(b, 0, 255);
 
-            return sf::Color(r, g, b);
+            return SimColor(r, g, b);
         }
         catch (...) {
             std::cerr << "Error parsing RGB components in: " << colorStr << std::endl;
-            return sf::Color(0, 0, 0); // Default to black
+            return SimColor(0, 0, 0); // Default to black
         }
     }
 
@@ -119,7 +119,7 @@ public:
 
                 int currentIndex = 1;
                 int id = std::stoi(shapeData[currentIndex++]);
-                sf::Color color = ExtractColor(shapeData[currentIndex++]);
+                SimColor color = ExtractColor(shapeData[currentIndex++]);
                 double mass = std::stod(shapeData[currentIndex++]);
                 sf::Vector2f pos(std::stof(shapeData[currentIndex++]), std::stof(shapeData[currentIndex++]));
                 sf::Vector2f accel(std::stof(shapeData[currentIndex++]), std::stof(shapeData[currentIndex++]));
@@ -142,7 +142,7 @@ public:
                     float height = std::stof(shapeData[currentIndex++]);
                     float width = std::stof(shapeData[currentIndex++]);
                     sf::Vector2f velocity(std::stof(shapeData[currentIndex++]), std::stof(shapeData[currentIndex++]));
-                    rect->setSize(sf::Vector2f(width, height));
+                    rect->SetSizeAndOrigin(width, height);
                     rect->SetVelocity(velocity);
                 }
 
@@ -166,7 +166,7 @@ public:
 //    circle->SetOldPosition(sf::Vector2f(10, 20));
 //    circle->SetAcceleration(sf::Vector2f(0, 9.8));
 //    circle->SetLinked(1);
-//    circle->setColor(sf::Color(255, 33, 0)); // Red
+//    circle->setColor(SimColor(255, 33, 0)); // Red
 //    circle->SetRadius(15.0);
 //    circle->SetVelocity(sf::Vector2f(2.0, 3.0));
 //    shapes.push_back(circle);
@@ -176,7 +176,7 @@ public:
 //    rect->SetOldPosition(sf::Vector2f(30, 40));
 //    rect->SetAcceleration(sf::Vector2f(1, 0));
 //    rect->SetLinked(2);
-//    rect->setColor(sf::Color(0, 255, 1)); // Green
+//    rect->setColor(SimColor(0, 255, 1)); // Green
 //    rect->setSize(sf::Vector2f(50, 100));
 //    rect->SetVelocity(sf::Vector2f(4.0, 5.0));
 //    shapes.push_back(rect);
@@ -0,0 +1 @@
+#include "Sharding.h"
\ No newline at end of file
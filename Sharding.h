@@ -0,0 +1,274 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "SimTypes.h"
+#include "NetFrame.h"
+#include "Snapshot.h"
+
+// A world that is too big for one simulation thread is cut into regions, each simulated by a server process of
+// its own (a shard). A shard owns the bodies in its region: only it moves them, and a body that leaves the region
+// is handed to the shard it went into (migration). Bodies close to a border are also sent to the neighbour every
+// tick as read-only copies (the halo), so collisions across the border see both sides. A coordinator process
+// merges the worlds of the shards into one snapshot for the clients and sends their commands to the owner.
+
+// The cut of the world: columns x rows regions of the same size over area, the outer regions go on forever
+// (the world is borderless). rows = 1 is vertical strips
+struct ShardLayout
+{
+	int columns = 2;
+	int rows = 1;
+	SimRect area = SimRect(0, 0, 1920, 1080);
+	float halo = 100; // How far from a border a body is still sent to the neighbour
+
+	int Count() const { return std::max(1, columns) * std::max(1, rows); }
+
+	// The shard that owns a position
+	int ShardAt(sf::Vector2f position) const {
+		int column = Cell(position.x, area.left, area.width, columns);
+		int row = Cell(position.y, area.top, area.height, rows);
+		return row * std::max(1, columns) + column;
+	}
+
+	// The region of a shard, the outer sides reach (almost) infinity
+	SimRect Region(int shard) const {
+		int column = shard % std::max(1, columns);
+		int row = shard / std::max(1, columns);
+		float far = std::numeric_limits<float>::max() / 4;
+		float cellWidth = area.width / std::max(1, columns);
+		float cellHeight = area.height / std::max(1, rows);
+		float left = column == 0 ? -far : area.left + column * cellWidth;
+		float right = column == columns - 1 ? far : area.left + (column + 1) * cellWidth;
+		float top = row == 0 ? -far : area.top + row * cellHeight;
+		float bottom = row == rows - 1 ? far : area.top + (row + 1) * cellHeight;
+		return SimRect(left, top, right - left, bottom - top);
+	}
+
+	// Whether a body at position (outside the shard) is close enough to its region to be in its halo
+	bool InHalo(int shard, sf::Vector2f position) const {
+		SimRect region = Region(shard);
+		float dx = std::max({ region.left - position.x, 0.0f, position.x - (region.left + region.width) });
+		float dy = std::max({ region.top - position.y, 0.0f, position.y - (region.top + region.height) });
+		return (dx > 0 || dy > 0) && dx <= halo && dy <= halo;
+	}
+
+	// Regions that share a side or a corner, the only ones a halo can reach (halo < region size)
+	bool Neighbours(int a, int b) const {
+		int width = std::max(1, columns);
+		return a != b && std::abs(a % width - b % width) <= 1 && std::abs(a / width - b / width) <= 1;
+	}
+
+private:
+	static int Cell(float value, float start, float size, int count) {
+		count = std::max(1, count);
+		if (!std::isfinite(value) || size <= 0) {
+			return 0;
+		}
+		float cell = std::floor((value - start) / (size / count));
+		return static_cast<int>(std::clamp(cell, 0.0f, static_cast<float>(count - 1)));
+	}
+};
+
+// Frames between the server processes (NetFrame header, types ShardHello / ShardExchange / ShardCommands).
+// A shard sends its world to the coordinator as a plain Snapshot frame (Snapshot.h), only its own bodies
+struct ShardFormat
+{
+	// ShardHello: u8 role | u32 shard index (of the caller, 0 for the coordinator)
+	static constexpr std::size_t HelloSize = 5;
+	// ShardExchange: u32 tick | u32 halo count | u32 migrant count | u32 link count | halo records
+	// (SnapshotFormat::RecordSize each) | migrants (MigrantSize each) | links (LinkSize each)
+	static constexpr std::size_t ExchangeHeaderSize = 16;
+	// A migrant is its record and what a snapshot does not need:
+	// f32 gravity | f32 acceleration x | f32 acceleration y | f64 charge | u8 flags (MigrantFixed)
+	static constexpr std::size_t MigrantSize = SnapshotFormat::RecordSize + 21;
+	// A link between two migrants of the exchange: u32 body | u32 other body | u8 type (LineLink, 1 fixed 2 not)
+	static constexpr std::size_t LinkSize = 9;
+	static constexpr std::uint8_t MigrantFixed = 1;
+};
+
+// A body handed to another shard, everything it needs to go on there as it was
+struct MigrantRecord
+{
+	BodyRecord body;
+	float gravity = 0;
+	sf::Vector2f acceleration;
+	double charge = 0; // Electrical particles
+	bool fixed = false;
+
+	// fixed: the world keeps it in place (ObjectsList::IsFixedObj), particles know it themselves
+	static MigrantRecord FromShape(BaseShape* obj, bool fixed) {
+		MigrantRecord record;
+		record.body = BodyRecord::FromShape(obj);
+		record.gravity = obj->GetGravity();
+		record.acceleration = obj->GetAcceleration();
+		record.fixed = fixed;
+		if (record.body.kind == ShapeKind::ElectricalParticle) {
+			ElectricalParticle* particle = static_cast<ElectricalParticle*>(obj);
+			record.charge = particle->GetCharge();
+			record.fixed = particle->GetIsFixed();
+		}
+		return record;
+	}
+
+	// The body again, for ObjectsList::InsertObj
+	BaseShape* CreateShape() const {
+		BaseShape* shape;
+		if (body.kind == ShapeKind::ElectricalParticle) {
+			shape = new ElectricalParticle(0, SimColor(), sf::Vector2f(0, 0), gravity, 0, charge, fixed, sf::Vector2f(0, 0), BaseShape::objectCount);
+		}
+		else {
+			shape = SnapshotReader::NewShape(body.kind);
+		}
+		SnapshotReader::ApplyRecord(shape, body);
+		shape->SetGravity(gravity);
+		shape->SetAcceleration(acceleration);
+		return shape;
+	}
+};
+
+struct MigrantLink
+{
+	std::uint32_t body = 0;
+	std::uint32_t other = 0;
+	std::uint8_t type = 0;
+};
+
+enum class ShardRole : std::uint8_t {
+	Shard = 1,
+	Coordinator = 2
+};
+
+inline SharedFrame MakeShardHello(ShardRole role, std::uint32_t index) {
+	auto frame = std::make_shared<std::vector<std::uint8_t>>(NetFrame::HeaderSize + ShardFormat::HelloSize);
+	std::uint8_t* out = frame->data();
+	NetFrame::WriteHeader(out, NetMessageType::ShardHello, static_cast<std::uint32_t>(ShardFormat::HelloSize));
+	Wire::PutU8(out + NetFrame::HeaderSize, static_cast<std::uint8_t>(role));
+	Wire::PutU32(out + NetFrame::HeaderSize + 1, index);
+	return frame;
+}
+
+// The halo and the migrants of one tick for one neighbour. The records are kept between ticks, so after the
+// first ticks writing an exchange does not allocate except for the frame pool
+class ShardExchangeWriter
+{
+private:
+	FramePool pool;
+	std::vector<BodyRecord> halo;
+	std::vector<MigrantRecord> migrants;
+	std::vector<MigrantLink> links;
+
+public:
+	void Clear() {
+		halo.clear();
+		migrants.clear();
+		links.clear();
+	}
+
+	void AddHalo(const BodyRecord& record) { halo.push_back(record); }
+	void AddMigrant(const MigrantRecord& record) { migrants.push_back(record); }
+	// Both ends are migrants of this exchange
+	void AddLink(std::uint32_t body, std::uint32_t other, int type) { links.push_back(MigrantLink{ body, other, static_cast<std::uint8_t>(type) }); }
+
+	std::size_t MigrantCount() const { return migrants.size(); }
+
+	SharedFrame Write(std::uint32_t tick) {
+		std::shared_ptr<std::vector<std::uint8_t>> buffer = pool.Take();
+		std::size_t payloadSize = ShardFormat::ExchangeHeaderSize + halo.size() * SnapshotFormat::RecordSize
+			+ migrants.size() * ShardFormat::MigrantSize + links.size() * ShardFormat::LinkSize;
+		buffer->resize(NetFrame::HeaderSize + payloadSize);
+		std::uint8_t* out = buffer->data();
+		NetFrame::WriteHeader(out, NetMessageType::ShardExchange, static_cast<std::uint32_t>(payloadSize));
+		out += NetFrame::HeaderSize;
+		Wire::PutU32(out, tick);
+		Wire::PutU32(out + 4, static_cast<std::uint32_t>(halo.size()));
+		Wire::PutU32(out + 8, static_cast<std::uint32_t>(migrants.size()));
+		Wire::PutU32(out + 12, static_cast<std::uint32_t>(links.size()));
+		out += ShardFormat::ExchangeHeaderSize;
+		for (const BodyRecord& record : halo) {
+			SnapshotWriter::WriteRecord(out, record);
+			out += SnapshotFormat::RecordSize;
+		}
+		for (const MigrantRecord& record : migrants) {
+			SnapshotWriter::WriteRecord(out, record.body);
+			std::uint8_t* state = out + SnapshotFormat::RecordSize;
+			Wire::PutF32(state, record.gravity);
+			Wire::PutF32(state + 4, record.acceleration.x);
+			Wire::PutF32(state + 8, record.acceleration.y);
+			Wire::PutF64(state + 12, record.charge);
+			Wire::PutU8(state + 20, record.fixed ? ShardFormat::MigrantFixed : 0);
+			out += ShardFormat::MigrantSize;
+		}
+		for (const MigrantLink& link : links) {
+			Wire::PutU32(out, link.body);
+			Wire::PutU32(out + 4, link.other);
+			Wire::PutU8(out + 8, link.type);
+			out += ShardFormat::LinkSize;
+		}
+		return buffer;
+	}
+};
+
+// Reads an exchange payload in place, like SnapshotReader
+class ShardExchangeReader
+{
+private:
+	const std::uint8_t* records = nullptr;
+	const std::uint8_t* migrantRecords = nullptr;
+	const std::uint8_t* linkRecords = nullptr;
+	std::uint32_t tick = 0;
+	std::uint32_t haloCount = 0;
+	std::uint32_t migrantCount = 0;
+	std::uint32_t linkCount = 0;
+
+public:
+	// payload is what follows the NetFrame header
+	bool Parse(const std::uint8_t* payload, std::size_t size) {
+		if (size < ShardFormat::ExchangeHeaderSize) {
+			return false;
+		}
+		std::uint32_t halo = Wire::GetU32(payload + 4);
+		std::uint32_t migrants = Wire::GetU32(payload + 8);
+		std::uint32_t links = Wire::GetU32(payload + 12);
+		std::uint64_t needed = static_cast<std::uint64_t>(halo) * SnapshotFormat::RecordSize
+			+ static_cast<std::uint64_t>(migrants) * ShardFormat::MigrantSize + static_cast<std::uint64_t>(links) * ShardFormat::LinkSize;
+		if (size - ShardFormat::ExchangeHeaderSize < needed) {
+			return false;
+		}
+		tick = Wire::GetU32(payload);
+		haloCount = halo;
+		migrantCount = migrants;
+		linkCount = links;
+		records = payload + ShardFormat::ExchangeHeaderSize;
+		migrantRecords = records + static_cast<std::size_t>(halo) * SnapshotFormat::RecordSize;
+		linkRecords = migrantRecords + static_cast<std::size_t>(migrants) * ShardFormat::MigrantSize;
+		return true;
+	}
+
+	std::uint32_t GetTick() const { return tick; }
+	std::uint32_t GetHaloCount() const { return haloCount; }
+	std::uint32_t GetMigrantCount() const { return migrantCount; }
+	std::uint32_t GetLinkCount() const { return linkCount; }
+
+	BodyRecord GetHalo(std::uint32_t index) const {
+		return SnapshotReader::ReadRecord(records + static_cast<std::size_t>(index) * SnapshotFormat::RecordSize);
+	}
+
+	MigrantRecord GetMigrant(std::uint32_t index) const {
+		const std::uint8_t* in = migrantRecords + static_cast<std::size_t>(index) * ShardFormat::MigrantSize;
+		MigrantRecord record;
+		record.body = SnapshotReader::ReadRecord(in);
+		const std::uint8_t* state = in + SnapshotFormat::RecordSize;
+		record.gravity = Wire::GetF32(state);
+		record.acceleration = sf::Vector2f(Wire::GetF32(state + 4), Wire::GetF32(state + 8));
+		record.charge = Wire::GetF64(state + 12);
+		record.fixed = (Wire::GetU8(state + 20) & ShardFormat::MigrantFixed) != 0;
+		return record;
+	}
+
+	MigrantLink GetLink(std::uint32_t index) const {
+		const std::uint8_t* in = linkRecords + static_cast<std::size_t>(index) * ShardFormat::LinkSize;
+		return MigrantLink{ Wire::GetU32(in), Wire::GetU32(in + 4), Wire::GetU8(in + 8) };
+	}
+};
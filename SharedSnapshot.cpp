@@ -0,0 +1 @@
+#include "SharedSnapshot.h"
\ No newline at end of file
@@ -0,0 +1,254 @@
+#pragma once
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <new>
+#include <string>
+#include "Snapshot.h"
+#include "DeltaSnapshot.h"
+
+// Snapshots for programs on the same machine (a visualiser, a recorder) through shared memory instead of the
+// loopback socket. The server writes every snapshot once into a ring of slots in a named segment, any number of
+// readers map the segment and read the newest slot in place. Nothing goes from a reader to the server, so a
+// reader costs the server nothing, and a slow or dead reader can not hold it up.
+//
+// Every slot is guarded by a sequence number (a seqlock): odd while the server writes the slot, one more after.
+// A reader notes the number, reads, and checks the number is still the same; if not, the server wrote over the
+// slot meanwhile and what was read is thrown away. The server writes the slots in turn, so it takes a reader
+// (slot count - 1) snapshots of time to have its slot written over.
+//
+// The segment: header (64 bytes) | slot headers (64 bytes each) | slots (slot bytes each). A slot holds a
+// snapshot payload as on the wire (SnapshotFormat header and records, Snapshot.h) so SnapshotReader reads it.
+
+struct SharedSnapshotFormat
+{
+	static constexpr std::uint32_t Magic = 0x4D535441; // "ATSM"
+	static constexpr std::uint32_t Version = 1;
+	static constexpr std::size_t HeaderSize = 64;
+	static constexpr std::size_t SlotHeaderSize = 64; // A cache line each, the slot being written does not slow reads of the others
+};
+
+struct alignas(64) SharedSnapshotHeader
+{
+	std::uint32_t magic = 0;
+	std::uint32_t version = 0;
+	std::uint32_t slotCount = 0;
+	std::uint32_t slotBytes = 0;
+	std::atomic<std::uint64_t> published{ 0 }; // Snapshots written so far, the newest is in slot (published - 1) % slotCount
+};
+
+struct alignas(64) SharedSnapshotSlot
+{
+	std::atomic<std::uint32_t> sequence{ 0 };
+	std::uint32_t size = 0; // Of the payload
+	std::uint32_t tick = 0;
+};
+
+static_assert(sizeof(SharedSnapshotHeader) == SharedSnapshotFormat::HeaderSize);
+static_assert(sizeof(SharedSnapshotSlot) == SharedSnapshotFormat::SlotHeaderSize);
+// Atomics in memory another process maps must not hide a lock
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free);
+
+// The server side, one per room. Only the room's tick publishes
+class SharedSnapshotWriter
+{
+private:
+	std::string name;
+	boost::interprocess::shared_memory_object memory;
+	boost::interprocess::mapped_region region;
+	SharedSnapshotHeader* header = nullptr;
+	SharedSnapshotSlot* slots = nullptr;
+	std::uint8_t* data = nullptr;
+	std::uint64_t published = 0; // Only the publishing thread, the others read the header's
+	std::uint64_t oversized = 0; // Snapshots with more bodies than a slot holds, not published
+
+public:
+	SharedSnapshotWriter() = default;
+	SharedSnapshotWriter(const SharedSnapshotWriter&) = delete;
+	SharedSnapshotWriter& operator=(const SharedSnapshotWriter&) = delete;
+
+	// The segment goes away with the writer, readers that have it mapped keep their mapping
+	~SharedSnapshotWriter() {
+		if (header) {
+			boost::interprocess::shared_memory_object::remove(name.c_str());
+		}
+	}
+
+	// A segment of that name left by a server that died is replaced. Slots are sized for maxBodies bodies
+	bool Open(const std::string& segmentName, std::size_t maxBodies, std::uint32_t slotCount = 4) {
+		using namespace boost::interprocess;
+		slotCount = std::max<std::uint32_t>(2, slotCount);
+		std::size_t slotBytes = (SnapshotFormat::HeaderSize + maxBodies * SnapshotFormat::RecordSize + 63) / 64 * 64;
+		std::size_t totalSize = SharedSnapshotFormat::HeaderSize + slotCount * (SharedSnapshotFormat::SlotHeaderSize + slotBytes);
+		try {
+			shared_memory_object::remove(segmentName.c_str());
+			memory = shared_memory_object(create_only, segmentName.c_str(), read_write);
+			memory.truncate(static_cast<offset_t>(totalSize));
+			region = mapped_region(memory, read_write);
+		}
+		catch (const interprocess_exception& error) {
+			std::cerr << "Could not create the shared memory " << segmentName << ": " << error.what() << std::endl;
+			return false;
+		}
+		name = segmentName;
+		std::uint8_t* base = static_cast<std::uint8_t*>(region.get_address());
+		slots = reinterpret_cast<SharedSnapshotSlot*>(base + SharedSnapshotFormat::HeaderSize);
+		for (std::uint32_t i = 0; i < slotCount; i++) {
+			new (slots + i) SharedSnapshotSlot();
+		}
+		data = base + SharedSnapshotFormat::HeaderSize + slotCount * SharedSnapshotFormat::SlotHeaderSize;
+		header = new (base) SharedSnapshotHeader();
+		header->version = SharedSnapshotFormat::Version;
+		header->slotCount = slotCount;
+		header->slotBytes = static_cast<std::uint32_t>(slotBytes);
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = SharedSnapshotFormat::Magic; // Last, a reader that maps the segment now sees it set up or not at all
+		return true;
+	}
+
+	bool IsOpen() const { return header != nullptr; }
+	const std::string& Name() const { return name; }
+	// Any thread, the telemetry reads it while the room publishes
+	std::uint64_t Published() const { return header ? header->published.load(std::memory_order_relaxed) : 0; }
+	std::uint64_t Oversized() const { return oversized; }
+
+	bool Publish(const SnapshotState& state) {
+		std::size_t size = SnapshotFormat::HeaderSize + state.bodies.size() * SnapshotFormat::RecordSize;
+		if (!header || size > header->slotBytes) {
+			oversized += header ? 1 : 0;
+			return false;
+		}
+		std::size_t index = published % header->slotCount;
+		SharedSnapshotSlot& slot = slots[index];
+		std::uint8_t* out = data + index * header->slotBytes;
+
+		std::uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+		slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release); // The odd number is seen before any of the new bytes
+		SnapshotWriter::WriteHeader(out, state.tick, static_cast<std::uint32_t>(state.bodies.size()));
+		out += SnapshotFormat::HeaderSize;
+		for (const BodyRecord& record : state.bodies) {
+			SnapshotWriter::WriteRecord(out, record);
+			out += SnapshotFormat::RecordSize;
+		}
+		slot.size = static_cast<std::uint32_t>(size);
+		slot.tick = state.tick;
+		slot.sequence.store(sequence + 2, std::memory_order_release);
+
+		published++;
+		header->published.store(published, std::memory_order_release);
+		return true;
+	}
+};
+
+// A local consumer. Reads the newest snapshot where the server wrote it, nothing is copied
+class SharedSnapshotReader
+{
+private:
+	boost::interprocess::shared_memory_object memory;
+	boost::interprocess::mapped_region region;
+	const SharedSnapshotHeader* header = nullptr;
+	const SharedSnapshotSlot* slots = nullptr;
+	const std::uint8_t* data = nullptr;
+
+public:
+	// One snapshot in the segment. Only good while Valid() says so
+	struct View
+	{
+		const std::uint8_t* payload = nullptr;
+		std::size_t size = 0;
+		std::uint32_t tick = 0;
+		std::uint64_t publication = 0; // Published() when it was taken, goes up by one per snapshot
+		const SharedSnapshotSlot* slot = nullptr;
+		std::uint32_t sequence = 0;
+	};
+
+	// false while the server has not made the segment (yet)
+	bool Open(const std::string& segmentName) {
+		using namespace boost::interprocess;
+		header = nullptr;
+		try {
+			memory = shared_memory_object(open_only, segmentName.c_str(), read_only);
+			region = mapped_region(memory, read_only);
+		}
+		catch (const interprocess_exception&) {
+			return false;
+		}
+		const std::uint8_t* base = static_cast<const std::uint8_t*>(region.get_address());
+		if (region.get_size() < SharedSnapshotFormat::HeaderSize) {
+			return false;
+		}
+		const SharedSnapshotHeader* mapped = reinterpret_cast<const SharedSnapshotHeader*>(base);
+		if (mapped->magic != SharedSnapshotFormat::Magic || mapped->version != SharedSnapshotFormat::Version) {
+			return false;
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (region.get_size() < SharedSnapshotFormat::HeaderSize + static_cast<std::size_t>(mapped->slotCount) * (SharedSnapshotFormat::SlotHeaderSize + mapped->slotBytes)) {
+			return false;
+		}
+		header = mapped;
+		slots = reinterpret_cast<const SharedSnapshotSlot*>(base + SharedSnapshotFormat::HeaderSize);
+		data = base + SharedSnapshotFormat::HeaderSize + static_cast<std::size_t>(header->slotCount) * SharedSnapshotFormat::SlotHeaderSize;
+		return true;
+	}
+
+	bool IsOpen() const { return header != nullptr; }
+
+	std::uint64_t Published() const { return header ? header->published.load(std::memory_order_acquire) : 0; }
+
+	// The newest snapshot, false when there is none yet or the server is in the middle of writing it
+	bool Latest(View& view) const {
+		std::uint64_t published = Published();
+		if (published == 0) {
+			return false;
+		}
+		std::size_t index = (published - 1) % header->slotCount;
+		const SharedSnapshotSlot& slot = slots[index];
+		std::uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence % 2 != 0 || slot.size > header->slotBytes) {
+			return false;
+		}
+		view.payload = data + index * header->slotBytes;
+		view.size = slot.size;
+		view.tick = slot.tick;
+		view.publication = published;
+		view.slot = &slot;
+		view.sequence = sequence;
+		return true;
+	}
+
+	// After reading a view: false when the server wrote over it meanwhile, what was read is garbage then
+	bool Valid(const View& view) const {
+		std::atomic_thread_fence(std::memory_order_acquire); // The reads of the bytes happen before this load
+		return view.slot && view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+	}
+
+	// Calls consume(const SnapshotReader&, const View&) with the newest snapshot when it is newer than
+	// lastPublication. The result of consume only counts when the slot was not written meanwhile, it can be
+	// called more than once (a few tries). false when there was nothing new
+	template<typename Consume>
+	bool ReadLatest(std::uint64_t& lastPublication, Consume&& consume, std::uint64_t* tornReads = nullptr) const {
+		for (int attempt = 0; attempt < 4; attempt++) {
+			View view;
+			if (!Latest(view) || view.publication == lastPublication) {
+				return false;
+			}
+			SnapshotReader reader;
+			bool parsed = reader.Parse(view.payload, view.size);
+			if (parsed) {
+				consume(reader, view);
+			}
+			if (Valid(view)) {
+				lastPublication = view.publication;
+				return parsed;
+			}
+			if (tornReads) {
+				(*tornReads)++;
+			}
+		}
+		return false;
+	}
+};
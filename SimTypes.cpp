@@ -0,0 +1 @@
+#include "SimTypes.h"
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include <SFML/System/Vector2.hpp> // Header only template, does not pull the window or graphics modules
+#include <cstdint>
+
+// Plain types for the headless simulation core.
+// The core (bodies, grid, links, solvers, serialization) must not depend on sfml-graphics or sfml-window,
+// so the server can run on a machine with no display. The SFML front ends convert these at draw time.
+
+// RGBA color of a body
+struct SimColor
+{
+	std::uint8_t r = 255;
+	std::uint8_t g = 255;
+	std::uint8_t b = 255;
+	std::uint8_t a = 255;
+
+	SimColor() {}
+
+	SimColor(std::uint8_t red, std::uint8_t green, std::uint8_t blue, std::uint8_t alpha = 255)
+		: r(red), g(green), b(blue), a(alpha) {}
+
+	bool operator==(const SimColor& other) const {
+		return r == other.r && g == other.g && b == other.b && a == other.a;
+	}
+
+	bool operator!=(const SimColor& other) const {
+		return !(*this == other);
+	}
+};
+
+// Which class a body is, used by the binary formats instead of the type string
+enum class ShapeKind : std::uint8_t
+{
+	Unknown = 0,
+	Circle = 1,
+	Rectangle = 2,
+	Planet = 3,
+	ElectricalParticle = 4
+};
+
+// Axis aligned rectangle in world units, left/top is the minimum corner
+struct SimRect
+{
+	float left = 0;
+	float top = 0;
+	float width = 0;
+	float height = 0;
+
+	SimRect() {}
+
+	SimRect(float left, float top, float width, float height)
+		: left(left), top(top), width(width), height(height) {}
+
+	bool contains(sf::Vector2f point) const {
+		return point.x >= left && point.x < left + width && point.y >= top && point.y < top + height;
+	}
+
+	bool intersects(const SimRect& other) const {
+		return left < other.left + other.width && other.left < left + width &&
+			top < other.top + other.height && other.top < top + height;
+	}
+};
@@ -52,6 +52,7 @@ protected:
 	// Physics and simulation parameters
 	float lineLength = 45;
 	ObjectsList objectList;
+	WorldRenderer worldRenderer; // Draws objectList, the simulation itself does not know SFML graphics
 	float deltaTime = 1.0f / 60.0f;
 	float elastic = 0.0;
 	int objCount = 0;
@@ -80,16 +81,16 @@ protected:
 	BaseShape* previousConnecttableBallPointer = nullptr;
 
 	// Visual settings
-	sf::Color ball_color = sf::Color(238, 238, 238);
-	sf::Color proton_color = sf::Color(255, 222, 33);
-	sf::Color electron_color = sf::Color(106, 102, 157);
+	SimColor ball_color = SimColor(238, 238, 238);
+	SimColor proton_color = SimColor(255, 222, 33);
+	SimColor electron_color = SimColor(106, 102, 157);
 	sf::Color ball_color2 = sf::Color(50, 5, 11);
 	sf::Color background_color = sf::Color(30, 30, 30);
 	sf::Color buttonColor = sf::Color(55, 58, 64);
 	sf::Color bb = sf::Color(44, 55, 100);
-	sf::Color explosion = sf::Color(205, 92, 8);
-	sf::Color outlineColor = sf::Color(255, 255, 255);
-	sf::Color previousColor = sf::Color(0, 0, 0);
+	SimColor explosion = SimColor(205, 92, 8);
+	SimColor outlineColor = SimColor(255, 255, 255);
+	SimColor previousColor = SimColor(0, 0, 0);
 	sf::Color sideMenuColor = sf::Color(23, 23, 23, 204); //not solid color more transperent
 
 	//Textures:
@@ -199,7 +200,7 @@ private:
 
 		keyActions.push_back({ sf::Keyboard::Space, [&]() { ToggleFreeze(); } });
 		keyActions.push_back({ sf::Keyboard::Q, [&]() {
-			objectList.CreateNewFixedCircle(sf::Color(255, 255, 255), currentMousePos);
+			objectList.CreateNewFixedCircle(SimColor(255, 255, 255), currentMousePos);
 			objCount += 1;
 		} });
 
@@ -211,6 +212,7 @@ private:
 		keyActions.push_back({ sf::Keyboard::Num6, [&]() { enableCollison = !enableCollison; } });
 		keyActions.push_back({ sf::Keyboard::Num7, [&]() { borderless = !borderless; } });
 		keyActions.push_back({ sf::Keyboard::Num0, [&]() { The3BodyProblem(); } });
+		keyActions.push_back({ sf::Keyboard::O, [&]() { worldRenderer.lodRenderer.ToggleEnabled(); } }); // Level of detail rendering
 
 		keyActions.push_back({ sf::Keyboard::Left, [&]() { view.move(-moveSpeedScreen, 0.f); } });
 		keyActions.push_back({ sf::Keyboard::Right, [&]() { view.move(moveSpeedScreen, 0.f); } });
@@ -306,7 +308,7 @@ private:
 			{
 				thisBallPointer->SetOutline(outlineColor, 5);
 				// Get the current color
-				sf::Color currentColor = thisBallPointer->GetColor();
+				SimColor currentColor = thisBallPointer->GetColor();
 				previousColor = currentColor;
 				// Darken the color by reducing the RGB values (without going below 0)
 				currentColor.r = std::max(0, currentColor.r - 15);
@@ -361,7 +363,7 @@ private:
 	void AddCirclesInOrder() {
 		for (size_t i = 0; i < 10; i++)
 		{
-			BaseShape* newObject = objectList.CreateNewCircle(options.gravity, gradient[gradientStep], spawnStartingPoint, initialVel);
+			BaseShape* newObject = objectList.CreateNewCircle(options.gravity, ToSimColor(gradient[gradientStep]), spawnStartingPoint, initialVel);
 			//newObject->SetOutline(outlineColor, 2);
 			objCount += 1;
 			gradientStep += 1;
@@ -381,7 +383,7 @@ private:
 	void AddRectanglesInOrder() {
 		for (size_t i = 0; i < 10; i++)
 		{
-			objectList.CreateNewRectangle(options.gravity, gradient[gradientStep], spawnStartingPoint);
+			objectList.CreateNewRectangle(options.gravity, ToSimColor(gradient[gradientStep]), spawnStartingPoint);
 			objCount += 1;
 			gradientStep += 1;
 			spawnStartingPoint.x += startingPointAdder;
@@ -433,7 +435,7 @@ private:
 		objCount = 0;
 		planetMode = false;
 		connectingMode = false;
-		previousColor = sf::Color(0, 0, 0);
+		previousColor = SimColor(0, 0, 0);
 		initialVel = sf::Vector2f(0, 0);
 
 		// Mouse and interaction state
@@ -450,7 +452,7 @@ private:
 	}
 
 	void createConnectedObjects() override {
-		BaseShape* newObject = objectList.CreateNewCircle(options.gravity, gradient[gradientStep], currentMousePos, initialVel);
+		BaseShape* newObject = objectList.CreateNewCircle(options.gravity, ToSimColor(gradient[gradientStep]), currentMousePos, initialVel);
 		objCount++;
 		objectList.connectedObjects.AddObject(newObject);
 		objectList.connectedObjects.ConnectRandom(10, typeOfLink);
@@ -466,9 +468,9 @@ private:
 
 	void The3BodyProblem() {
 		planetMode = true;
-		objectList.CreateNewPlanet(7000, sf::Color(205, 28, 24), sf::Vector2f(990, 466.02540), 20, 5.9722 * pow(10, 16));
-		objectList.CreateNewPlanet(7000, sf::Color(0, 71, 171), sf::Vector2f(1000 - 110, 600), 20, 5.9722 * pow(10, 16));
-		objectList.CreateNewPlanet(7000, sf::Color(137, 243, 54), sf::Vector2f(1200 - 110, 600), 20, 5.9722 * pow(10, 16));
+		objectList.CreateNewPlanet(7000, SimColor(205, 28, 24), sf::Vector2f(990, 466.02540), 20, 5.9722 * pow(10, 16));
+		objectList.CreateNewPlanet(7000, SimColor(0, 71, 171), sf::Vector2f(1000 - 110, 600), 20, 5.9722 * pow(10, 16));
+		objectList.CreateNewPlanet(7000, SimColor(137, 243, 54), sf::Vector2f(1200 - 110, 600), 20, 5.9722 * pow(10, 16));
 		objCount++;
 	}
 
@@ -490,7 +492,7 @@ private:
 	}
 
 	void CreateRandomConnectedCircles() {
-		BaseShape* newObject = objectList.CreateNewCircle(options.gravity, gradient[gradientStep], currentMousePos, initialVel);
+		BaseShape* newObject = objectList.CreateNewCircle(options.gravity, ToSimColor(gradient[gradientStep]), currentMousePos, initialVel);
 		objCount += 1;
 		objectList.connectedObjects.AddObject(newObject);
 		objectList.connectedObjects.ConnectRandom(10, typeOfLink);
@@ -524,14 +526,14 @@ private:
 	}
 
 	void scaleCircle(Circle* circle) override {
-		if (mouseFlagScrollDown && circle->getRadius() > 0.0001) {
-			circle->SetRadiusAndCenter(circle->getRadius() - mouseScrollPower);
+		if (mouseFlagScrollDown && circle->GetRadius() > 0.0001) {
+			circle->SetRadiusAndCenter(circle->GetRadius() - mouseScrollPower);
 			circle->SetMass(circle->GetMass() - mouseScrollPower * 10);
-			std::cout << circle->getRadius();
+			std::cout << circle->GetRadius();
 			mouseFlagScrollDown = false;
 		}
 		else {
-			circle->SetRadiusAndCenter(circle->getRadius() + mouseScrollPower);
+			circle->SetRadiusAndCenter(circle->GetRadius() + mouseScrollPower);
 			circle->SetMass(circle->GetMass() + mouseScrollPower * 10);
 			mouseFlagScrollUp = false;
 		}
@@ -601,7 +603,7 @@ private:
 			objectList.MoveWhenFreeze(window_width, window_height, currentFPS, borderless);
 		}
 
-		objectList.DrawObjects(window, currentFPS, planetMode);
+		worldRenderer.Draw(window, objectList);
 	}
 
 	void initializeUI() override {
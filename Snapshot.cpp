@@ -0,0 +1 @@
+#include "Snapshot.h"
\ No newline at end of file
@@ -0,0 +1,238 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include "NetFrame.h"
+#include "SimTypes.h"
+#include "BaseShape.h"
+#include "Circle.h"
+#include "Rectangle.h"
+#include "Planet.h"
+#include "ElectricalParticle.h"
+
+// Binary world snapshot, replaces the ToString/SplitString text format on the wire.
+//
+// Layout (little endian), after the NetFrame header:
+//   header, 16 bytes:
+//     u16 magic 'S''N' | u8 version | u8 record size | u32 tick | u32 body count | u32 flags (0 for now)
+//   body count records of record size bytes, version 1 records are 40 bytes:
+//     u32 id | u8 kind | u8 r | u8 g | u8 b | f32 x | f32 y | f32 velocity x | f32 velocity y |
+//     f32 size x | f32 size y | f32 mass | i8 linked | 3 bytes padding
+//   size is (radius, radius) for circles and (width, height) for rectangles.
+// Readers step by the record size from the header, so a newer version can append fields to the record
+// and old readers still read the part they know.
+
+// One body as it is on the wire
+struct BodyRecord
+{
+	std::uint32_t id = 0;
+	ShapeKind kind = ShapeKind::Unknown;
+	SimColor color;
+	sf::Vector2f position;
+	sf::Vector2f velocity;
+	sf::Vector2f size;
+	float mass = 0;
+	std::int8_t linked = -1;
+
+	static BodyRecord FromShape(BaseShape* obj) {
+		BodyRecord record;
+		record.id = static_cast<std::uint32_t>(obj->GetID());
+		record.kind = obj->GetKind();
+		record.color = obj->GetColor();
+		record.position = obj->GetPosition();
+		record.velocity = obj->GetVelocity();
+		if (record.kind == ShapeKind::Rectangle) {
+			RectangleClass* rectangle = static_cast<RectangleClass*>(obj);
+			record.size = sf::Vector2f(rectangle->GetWidth(), rectangle->GetHeight());
+		}
+		else if (record.kind != ShapeKind::Unknown) {
+			float radius = static_cast<Circle*>(obj)->GetRadius();
+			record.size = sf::Vector2f(radius, radius);
+		}
+		record.mass = static_cast<float>(obj->GetMass());
+		record.linked = static_cast<std::int8_t>(obj->GetLinked());
+		return record;
+	}
+};
+
+// The fields of a record, the deltas send a mask of the ones that changed
+enum DeltaField : std::uint8_t
+{
+	DeltaPosition = 1 << 0,
+	DeltaVelocity = 1 << 1,
+	DeltaColor = 1 << 2,
+	DeltaSize = 1 << 3,
+	DeltaMass = 1 << 4,
+	DeltaKindAndLinked = 1 << 5,
+	DeltaAllFields = DeltaPosition | DeltaVelocity | DeltaColor | DeltaSize | DeltaMass | DeltaKindAndLinked,
+	DeltaRemoved = 1 << 7
+};
+
+struct SnapshotFormat
+{
+	static constexpr std::uint16_t Magic = 0x4E53; // "SN"
+	static constexpr std::uint8_t Version = 1;
+	static constexpr std::size_t HeaderSize = 16;
+	static constexpr std::size_t RecordSize = 40;
+};
+
+// Writes snapshots into pooled buffers, after the first ticks writing a snapshot does not allocate
+class SnapshotWriter
+{
+private:
+	FramePool pool;
+
+public:
+	// One record in the layout of SnapshotFormat::RecordSize, also used by the shard exchange (Sharding.h)
+	static void WriteRecord(std::uint8_t* out, const BodyRecord& record) {
+		Wire::PutU32(out, record.id);
+		Wire::PutU8(out + 4, static_cast<std::uint8_t>(record.kind));
+		Wire::PutU8(out + 5, record.color.r);
+		Wire::PutU8(out + 6, record.color.g);
+		Wire::PutU8(out + 7, record.color.b);
+		Wire::PutF32(out + 8, record.position.x);
+		Wire::PutF32(out + 12, record.position.y);
+		Wire::PutF32(out + 16, record.velocity.x);
+		Wire::PutF32(out + 20, record.velocity.y);
+		Wire::PutF32(out + 24, record.size.x);
+		Wire::PutF32(out + 28, record.size.y);
+		Wire::PutF32(out + 32, record.mass);
+		Wire::PutU8(out + 36, static_cast<std::uint8_t>(record.linked));
+		out[37] = 0;
+		out[38] = 0;
+		out[39] = 0;
+	}
+
+	// The SnapshotFormat::HeaderSize bytes before the records, also used by the shared memory ring (SharedSnapshot.h)
+	static void WriteHeader(std::uint8_t* out, std::uint32_t tick, std::uint32_t bodyCount) {
+		Wire::PutU16(out, SnapshotFormat::Magic);
+		Wire::PutU8(out + 2, SnapshotFormat::Version);
+		Wire::PutU8(out + 3, static_cast<std::uint8_t>(SnapshotFormat::RecordSize));
+		Wire::PutU32(out + 4, tick);
+		Wire::PutU32(out + 8, bodyCount);
+		Wire::PutU32(out + 12, 0);
+	}
+
+	// Returns the whole NetFrame (header included), ready to be written to a socket as is
+	SharedFrame Write(std::uint32_t tick, const std::vector<BaseShape*>& bodies) {
+		std::shared_ptr<std::vector<std::uint8_t>> buffer = pool.Take();
+		std::size_t payloadSize = SnapshotFormat::HeaderSize + bodies.size() * SnapshotFormat::RecordSize;
+		buffer->resize(NetFrame::HeaderSize + payloadSize);
+
+		std::uint8_t* out = buffer->data();
+		NetFrame::WriteHeader(out, NetMessageType::Snapshot, static_cast<std::uint32_t>(payloadSize));
+		out += NetFrame::HeaderSize;
+
+		WriteHeader(out, tick, static_cast<std::uint32_t>(bodies.size()));
+		out += SnapshotFormat::HeaderSize;
+
+		for (BaseShape* obj : bodies) {
+			WriteRecord(out, BodyRecord::FromShape(obj));
+			out += SnapshotFormat::RecordSize;
+		}
+		return buffer;
+	}
+};
+
+// Reads a snapshot payload in place, nothing is copied or allocated. the data must outlive the reader
+class SnapshotReader
+{
+private:
+	const std::uint8_t* records = nullptr;
+	std::size_t recordSize = 0;
+	std::uint32_t tick = 0;
+	std::uint32_t bodyCount = 0;
+
+public:
+	// Checks the header and that all the records are inside the data. payload is what follows the NetFrame header
+	bool Parse(const std::uint8_t* payload, std::size_t size) {
+		records = nullptr;
+		bodyCount = 0;
+		if (size < SnapshotFormat::HeaderSize || Wire::GetU16(payload) != SnapshotFormat::Magic) {
+			std::cerr << "Not a snapshot" << std::endl;
+			return false;
+		}
+		std::uint8_t version = Wire::GetU8(payload + 2);
+		recordSize = Wire::GetU8(payload + 3);
+		if (version < 1 || recordSize < SnapshotFormat::RecordSize) {
+			std::cerr << "Unsupported snapshot version " << static_cast<int>(version) << std::endl;
+			return false;
+		}
+		tick = Wire::GetU32(payload + 4);
+		std::uint32_t count = Wire::GetU32(payload + 8);
+		if ((size - SnapshotFormat::HeaderSize) / recordSize < count) {
+			std::cerr << "Snapshot is cut, " << count << " bodies do not fit in " << size << " bytes" << std::endl;
+			return false;
+		}
+		bodyCount = count;
+		records = payload + SnapshotFormat::HeaderSize;
+		return true;
+	}
+
+	std::uint32_t GetTick() const { return tick; }
+
+	std::uint32_t GetBodyCount() const { return bodyCount; }
+
+	BodyRecord GetBody(std::uint32_t index) const {
+		return ReadRecord(records + static_cast<std::size_t>(index) * recordSize);
+	}
+
+	// One record written by SnapshotWriter::WriteRecord
+	static BodyRecord ReadRecord(const std::uint8_t* in) {
+		BodyRecord record;
+		record.id = Wire::GetU32(in);
+		record.kind = static_cast<ShapeKind>(Wire::GetU8(in + 4));
+		record.color = SimColor(Wire::GetU8(in + 5), Wire::GetU8(in + 6), Wire::GetU8(in + 7));
+		record.position = sf::Vector2f(Wire::GetF32(in + 8), Wire::GetF32(in + 12));
+		record.velocity = sf::Vector2f(Wire::GetF32(in + 16), Wire::GetF32(in + 20));
+		record.size = sf::Vector2f(Wire::GetF32(in + 24), Wire::GetF32(in + 28));
+		record.mass = Wire::GetF32(in + 32);
+		record.linked = static_cast<std::int8_t>(Wire::GetU8(in + 36));
+		return record;
+	}
+
+	// The kind of body a record is drawn with, unknown kinds are drawn as circles
+	static ShapeKind ProxyKind(ShapeKind kind) {
+		return kind == ShapeKind::Unknown ? ShapeKind::Circle : kind;
+	}
+
+	// An empty body of the right class, so planets and particles stay planets and particles on the client.
+	// The counter is passed back as it is, the constructors with objCount overwrite BaseShape::objectCount
+	static BaseShape* NewShape(ShapeKind kind) {
+		switch (ProxyKind(kind)) {
+		case ShapeKind::Rectangle:
+			return new RectangleClass();
+		case ShapeKind::Planet:
+			return new Planet(0, SimColor(), sf::Vector2f(0, 0), 0, 0, 0, BaseShape::objectCount);
+		case ShapeKind::ElectricalParticle:
+			return new ElectricalParticle(0, SimColor(), sf::Vector2f(0, 0), 0, 0, 0, false, sf::Vector2f(0, 0), BaseShape::objectCount);
+		default:
+			return new Circle();
+		}
+	}
+
+	// Sets everything the record has on a body of the same kind
+	static void ApplyRecord(BaseShape* shape, const BodyRecord& record) {
+		if (record.kind == ShapeKind::Rectangle) {
+			static_cast<RectangleClass*>(shape)->SetSizeAndOrigin(record.size.x, record.size.y);
+		}
+		else {
+			static_cast<Circle*>(shape)->SetRadius(record.size.x);
+		}
+		shape->SetID(static_cast<int>(record.id));
+		shape->setColor(record.color);
+		shape->SetMass(record.mass);
+		shape->SetPosition(record.position);
+		shape->SetOldPosition(record.position); // SetVelocity moves the old position from here
+		shape->SetVelocity(record.velocity);
+		shape->SetLinked(record.linked);
+	}
+
+	// Builds a body the front ends can draw from a record
+	static BaseShape* CreateShape(const BodyRecord& record) {
+		BaseShape* shape = NewShape(record.kind);
+		ApplyRecord(shape, record);
+		return shape;
+	}
+};
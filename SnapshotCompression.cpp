@@ -0,0 +1 @@
+#include "SnapshotCompression.h"
\ No newline at end of file
@@ -0,0 +1,368 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "NetFrame.h"
+
+// Compression of the snapshot frames. Snapshots compress well: the ids count up, the colours repeat, the sizes and
+// masses barely change and the positions move a little, and the snapshot before has most of the same bytes.
+//
+// The codec is an LZ77 in the style of LZ4 (byte aligned, no entropy stage, fast to decode):
+//   sequences of: token (literal count << 4 | match length - 4) | [more literal count] | literals |
+//                 u24 offset back | [more match length]
+//   a count of 15 in the token goes on in the bytes after it, each adds up to 255 (255 = another byte follows).
+//   The last sequence is only literals, it ends where the raw size is reached.
+// A match can reach back into a dictionary in front of the data. Over TCP the dictionary is the last snapshot
+// payload compressed on the same connection (the stream context): the frames arrive in order and none is lost,
+// so both sides have it. A datagram can be lost, so over UDP every frame is compressed on its own.
+//
+// A compressed frame is a NetFrame of type Compressed:
+//   u8 NetMessageType of the frame inside | u8 flags (1 = against the stream dictionary) | u32 raw payload size |
+//   the codec's output
+// Compression is asked for at the handshake: the client says "compress:lz" and the server answers
+// "compress:lz:<level>" or "compress:none". A client that does not ask gets the frames as they were.
+
+enum class CompressionLevel : std::uint8_t {
+	Off = 0,
+	Fast = 1, // One match candidate per position, skips ahead over data that does not match
+	High = 2  // Follows the hash chain for the longest match, smaller output for more time
+};
+
+inline const char* CompressionLevelName(CompressionLevel level) {
+	switch (level) {
+	case CompressionLevel::Fast: return "fast";
+	case CompressionLevel::High: return "high";
+	default: return "off";
+	}
+}
+
+inline bool ParseCompressionLevel(std::string_view text, CompressionLevel& level) {
+	if (text == "off" || text == "none") {
+		level = CompressionLevel::Off;
+	}
+	else if (text == "fast") {
+		level = CompressionLevel::Fast;
+	}
+	else if (text == "high") {
+		level = CompressionLevel::High;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+struct CompressionFormat
+{
+	static constexpr std::size_t HeaderSize = 6;
+	static constexpr std::uint8_t StreamFlag = 1;
+	static constexpr std::size_t MinMatch = 4;
+	static constexpr std::size_t MaxOffset = (1u << 24) - 1;
+	static constexpr std::size_t MaxDictionary = 4 * 1024 * 1024; // The tail of the last payload, on both sides
+	static constexpr std::size_t MinPayloadSize = 64;             // Smaller frames go as they are
+};
+
+// LZ compressor with its tables kept between calls, so after the first frames it does not allocate
+class LzCompressor
+{
+private:
+	std::vector<std::uint8_t> window; // Dictionary then data, matches are found in both
+	std::vector<std::int32_t> head;   // Last position of each hash
+	std::vector<std::int32_t> chain;  // Position before with the same hash (High only)
+
+	static std::uint32_t Read32(const std::uint8_t* at) {
+		std::uint32_t value;
+		std::memcpy(&value, at, 4);
+		return value;
+	}
+
+	static void PutCount(std::vector<std::uint8_t>& out, std::size_t count) {
+		while (count >= 255) {
+			out.push_back(255);
+			count -= 255;
+		}
+		out.push_back(static_cast<std::uint8_t>(count));
+	}
+
+	static void PutSequence(std::vector<std::uint8_t>& out, const std::uint8_t* literals, std::size_t literalCount, std::size_t offset, std::size_t matchLength) {
+		std::size_t matchCode = matchLength == 0 ? 0 : matchLength - CompressionFormat::MinMatch;
+		out.push_back(static_cast<std::uint8_t>((std::min<std::size_t>(literalCount, 15) << 4) | std::min<std::size_t>(matchCode, 15)));
+		if (literalCount >= 15) {
+			PutCount(out, literalCount - 15);
+		}
+		out.insert(out.end(), literals, literals + literalCount);
+		if (matchLength == 0) {
+			return;
+		}
+		out.push_back(static_cast<std::uint8_t>(offset));
+		out.push_back(static_cast<std::uint8_t>(offset >> 8));
+		out.push_back(static_cast<std::uint8_t>(offset >> 16));
+		if (matchCode >= 15) {
+			PutCount(out, matchCode - 15);
+		}
+	}
+
+public:
+	// Appends the compressed data to out. The decoder needs the same dictionary (may be empty)
+	void Compress(const std::uint8_t* dictionary, std::size_t dictionarySize, const std::uint8_t* data, std::size_t size,
+		CompressionLevel level, std::vector<std::uint8_t>& out) {
+		window.resize(dictionarySize + size);
+		if (dictionarySize > 0) {
+			std::memcpy(window.data(), dictionary, dictionarySize);
+		}
+		std::memcpy(window.data() + dictionarySize, data, size);
+		const std::uint8_t* base = window.data();
+		std::size_t end = window.size();
+
+		// Big enough for the window, not more: a small delta does not clear a big table
+		int hashBits = 10;
+		while (hashBits < 16 && (std::size_t(1) << hashBits) < end) {
+			hashBits++;
+		}
+		head.assign(std::size_t(1) << hashBits, -1);
+		bool high = level == CompressionLevel::High;
+		if (high) {
+			chain.resize(end);
+		}
+		auto hash = [hashBits](std::uint32_t value) { return (value * 2654435761u) >> (32 - hashBits); };
+		auto insert = [&](std::size_t position) {
+			std::uint32_t h = hash(Read32(base + position));
+			if (high) {
+				chain[position] = head[h];
+			}
+			head[h] = static_cast<std::int32_t>(position);
+		};
+
+		std::size_t last = end >= CompressionFormat::MinMatch ? end - CompressionFormat::MinMatch : 0;
+		for (std::size_t position = 0; position + CompressionFormat::MinMatch <= dictionarySize && position <= last; position++) {
+			insert(position);
+		}
+
+		std::size_t position = dictionarySize;
+		std::size_t anchor = dictionarySize;
+		int depth = high ? 16 : 1;
+		while (end >= CompressionFormat::MinMatch && position <= last) {
+			std::uint32_t value = Read32(base + position);
+			std::int32_t candidate = head[hash(value)];
+			std::size_t bestLength = 0;
+			std::size_t bestOffset = 0;
+			for (int tries = 0; candidate >= 0 && tries < depth; tries++) {
+				std::size_t offset = position - static_cast<std::size_t>(candidate);
+				if (offset > CompressionFormat::MaxOffset) {
+					break;
+				}
+				if (Read32(base + candidate) == value) {
+					std::size_t length = CompressionFormat::MinMatch;
+					while (position + length < end && base[candidate + length] == base[position + length]) {
+						length++;
+					}
+					if (length > bestLength) {
+						bestLength = length;
+						bestOffset = offset;
+					}
+				}
+				candidate = high ? chain[candidate] : -1;
+			}
+			insert(position);
+
+			if (bestLength < CompressionFormat::MinMatch) {
+				// The longer nothing matched, the bigger the steps (Fast), like LZ4's acceleration
+				position += high ? 1 : 1 + ((position - anchor) >> 6);
+				continue;
+			}
+			PutSequence(out, base + anchor, position - anchor, bestOffset, bestLength);
+			std::size_t matchEnd = position + bestLength;
+			if (high) {
+				for (std::size_t inside = position + 1; inside < matchEnd && inside <= last; inside++) {
+					insert(inside);
+				}
+			}
+			else if (matchEnd - 2 <= last) {
+				insert(matchEnd - 2);
+			}
+			position = matchEnd;
+			anchor = position;
+		}
+		PutSequence(out, base + anchor, end - anchor, 0, 0);
+	}
+};
+
+// Decodes into out, which already holds dictionarySize bytes of dictionary and is rawSize bytes after it.
+// false when the data is broken (never reads or writes outside the buffers)
+inline bool LzDecompress(const std::uint8_t* in, std::size_t size, std::uint8_t* out, std::size_t dictionarySize, std::size_t rawSize) {
+	const std::uint8_t* inEnd = in + size;
+	std::size_t position = dictionarySize;
+	std::size_t end = dictionarySize + rawSize;
+	auto readCount = [&](std::size_t& count) {
+		std::uint8_t more;
+		do {
+			if (in >= inEnd) {
+				return false;
+			}
+			more = *in++;
+			count += more;
+		} while (more == 255);
+		return true;
+	};
+	while (true) {
+		if (in >= inEnd) {
+			return false;
+		}
+		std::uint8_t token = *in++;
+		std::size_t literals = token >> 4;
+		if (literals == 15 && !readCount(literals)) {
+			return false;
+		}
+		if (literals > static_cast<std::size_t>(inEnd - in) || literals > end - position) {
+			return false;
+		}
+		std::memcpy(out + position, in, literals);
+		in += literals;
+		position += literals;
+		if (position == end) {
+			return true;
+		}
+
+		if (inEnd - in < 3) {
+			return false;
+		}
+		std::size_t offset = in[0] | (in[1] << 8) | (static_cast<std::size_t>(in[2]) << 16);
+		in += 3;
+		std::size_t length = (token & 15);
+		if (length == 15 && !readCount(length)) {
+			return false;
+		}
+		length += CompressionFormat::MinMatch;
+		if (offset == 0 || offset > position || length > end - position) {
+			return false;
+		}
+		// Byte by byte, a match can overlap what it writes (a run)
+		const std::uint8_t* from = out + position - offset;
+		std::uint8_t* to = out + position;
+		if (offset >= length) {
+			std::memcpy(to, from, length);
+		}
+		else {
+			for (std::size_t i = 0; i < length; i++) {
+				to[i] = from[i];
+			}
+		}
+		position += length;
+	}
+}
+
+// What the compression did, read by the telemetry
+struct CompressionStats
+{
+	std::atomic<std::uint64_t> frames{ 0 };       // Sent compressed
+	std::atomic<std::uint64_t> skipped{ 0 };      // Did not get smaller, sent as they were
+	std::atomic<std::uint64_t> rawBytes{ 0 };     // Of all the frames it was given
+	std::atomic<std::uint64_t> packedBytes{ 0 };  // What went out for them
+	std::atomic<std::uint64_t> nanoseconds{ 0 };  // Spent compressing
+
+	double Ratio() const {
+		std::uint64_t packed = packedBytes.load(std::memory_order_relaxed);
+		return packed == 0 ? 1 : static_cast<double>(rawBytes.load(std::memory_order_relaxed)) / packed;
+	}
+
+	double MicrosPerFrame() const {
+		std::uint64_t count = frames.load(std::memory_order_relaxed) + skipped.load(std::memory_order_relaxed);
+		return count == 0 ? 0 : nanoseconds.load(std::memory_order_relaxed) / 1000.0 / count;
+	}
+};
+
+// Turns frames into Compressed frames. One per TCP connection (the stream context) and one per room for the
+// datagrams, only ever used by one thread at a time
+class FrameCompressor
+{
+private:
+	LzCompressor lz;
+	FramePool pool;
+	SharedFrame dictionary; // The last frame compressed as a stream, kept alive instead of copied
+	CompressionStats stats;
+
+public:
+	// A Compressed frame, or nullptr when it would not be smaller (send the frame itself then). streaming: against
+	// the last streaming frame, only for an ordered and reliable stream
+	SharedFrame Compress(const SharedFrame& frame, CompressionLevel level, bool streaming) {
+		std::size_t rawSize = frame->size() - NetFrame::HeaderSize;
+		if (level == CompressionLevel::Off || rawSize < CompressionFormat::MinPayloadSize) {
+			return nullptr;
+		}
+		auto start = std::chrono::steady_clock::now();
+		const std::uint8_t* dictionaryData = nullptr;
+		std::size_t dictionarySize = 0;
+		if (streaming && dictionary) {
+			std::size_t payloadSize = dictionary->size() - NetFrame::HeaderSize;
+			dictionarySize = std::min(payloadSize, CompressionFormat::MaxDictionary);
+			dictionaryData = dictionary->data() + NetFrame::HeaderSize + (payloadSize - dictionarySize);
+		}
+
+		std::shared_ptr<std::vector<std::uint8_t>> buffer = pool.Take();
+		buffer->resize(NetFrame::HeaderSize + CompressionFormat::HeaderSize);
+		lz.Compress(dictionaryData, dictionarySize, frame->data() + NetFrame::HeaderSize, rawSize, level, *buffer);
+		bool smaller = buffer->size() < frame->size();
+
+		stats.rawBytes.fetch_add(frame->size(), std::memory_order_relaxed);
+		stats.packedBytes.fetch_add(smaller ? buffer->size() : frame->size(), std::memory_order_relaxed);
+		(smaller ? stats.frames : stats.skipped).fetch_add(1, std::memory_order_relaxed);
+		stats.nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+		if (!smaller) {
+			return nullptr;
+		}
+
+		std::uint8_t* out = buffer->data();
+		NetFrame::WriteHeader(out, NetMessageType::Compressed, static_cast<std::uint32_t>(buffer->size() - NetFrame::HeaderSize));
+		Wire::PutU8(out + NetFrame::HeaderSize, static_cast<std::uint8_t>(NetFrame::ReadType(frame->data())));
+		Wire::PutU8(out + NetFrame::HeaderSize + 1, streaming ? CompressionFormat::StreamFlag : 0);
+		Wire::PutU32(out + NetFrame::HeaderSize + 2, static_cast<std::uint32_t>(rawSize));
+		if (streaming) {
+			dictionary = frame;
+		}
+		return buffer;
+	}
+
+	const CompressionStats& Stats() const { return stats; }
+};
+
+// Client side, on the network thread. Keeps the stream dictionary, Reset() it for a new connection
+class FrameDecompressor
+{
+private:
+	std::vector<std::uint8_t> dictionary;
+	std::vector<std::uint8_t> window; // Dictionary then the decoded payload
+
+public:
+	void Reset() { dictionary.clear(); }
+
+	// payload is the Compressed frame's payload. raw stays valid until the next call
+	bool Decompress(const std::uint8_t* payload, std::size_t size, NetMessageType& type, const std::uint8_t*& raw, std::size_t& rawSize) {
+		if (size < CompressionFormat::HeaderSize) {
+			return false;
+		}
+		type = static_cast<NetMessageType>(Wire::GetU8(payload));
+		bool streaming = (Wire::GetU8(payload + 1) & CompressionFormat::StreamFlag) != 0;
+		rawSize = Wire::GetU32(payload + 2);
+		if (rawSize > NetFrame::MaxPayloadSize || type == NetMessageType::Compressed) {
+			return false;
+		}
+		std::size_t dictionarySize = streaming ? std::min(dictionary.size(), CompressionFormat::MaxDictionary) : 0;
+		window.resize(dictionarySize + rawSize);
+		if (dictionarySize > 0) {
+			std::memcpy(window.data(), dictionary.data() + (dictionary.size() - dictionarySize), dictionarySize);
+		}
+		if (!LzDecompress(payload + CompressionFormat::HeaderSize, size - CompressionFormat::HeaderSize, window.data(), dictionarySize, rawSize)) {
+			return false;
+		}
+		raw = window.data() + dictionarySize;
+		if (streaming) {
+			dictionary.assign(raw, raw + rawSize);
+		}
+		return true;
+	}
+};
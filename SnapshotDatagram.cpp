@@ -0,0 +1 @@
+#include "SnapshotDatagram.h"
\ No newline at end of file
@@ -0,0 +1,207 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "NetFrame.h"
+
+// Snapshots over UDP. A lost TCP segment holds back every snapshot after it, over UDP a lost datagram only loses
+// its own tick and the next one is drawn as soon as it is complete.
+//
+// A frame is cut into datagrams of at most MaxDatagramSize bytes (under the usual internet MTU, so IP does not
+// fragment them):
+//   u16 magic 'U''D' | u8 version | u8 NetMessageType | u32 tick | u16 fragment index | u16 fragment count |
+//   u32 payload size | up to FragmentSize bytes of the payload
+// The receiver puts the fragments of a tick back together and drops the ones of ticks older than the last whole one.
+
+struct SnapshotDatagram
+{
+	static constexpr std::uint16_t Magic = 0x4455; // "UD"
+	static constexpr std::uint8_t Version = 1;
+	static constexpr std::size_t HeaderSize = 16;
+	static constexpr std::size_t MaxDatagramSize = 1200;
+	static constexpr std::size_t FragmentSize = MaxDatagramSize - HeaderSize;
+
+	static bool IsDatagram(const std::uint8_t* data, std::size_t size) {
+		return size >= HeaderSize && Wire::GetU16(data) == Magic;
+	}
+
+	// Newer with wrap around, a tick counter at 60 ticks a second wraps after two years
+	static bool IsNewer(std::uint32_t tick, std::uint32_t than) {
+		return static_cast<std::int32_t>(tick - than) > 0;
+	}
+
+	// The datagrams are back to back in one buffer, all of them MaxDatagramSize bytes but the last
+	static std::size_t DatagramCount(const std::vector<std::uint8_t>& datagrams) {
+		return (datagrams.size() + MaxDatagramSize - 1) / MaxDatagramSize;
+	}
+
+	static const std::uint8_t* Datagram(const std::vector<std::uint8_t>& datagrams, std::size_t index, std::size_t& size) {
+		std::size_t offset = index * MaxDatagramSize;
+		size = std::min(MaxDatagramSize, datagrams.size() - offset);
+		return datagrams.data() + offset;
+	}
+};
+
+// Cuts NetFrames into datagrams, into pooled buffers so a frame cached for many clients is only cut once
+class SnapshotFragmenter
+{
+private:
+	FramePool pool;
+
+public:
+	// frame is a whole NetFrame (header included) as the snapshot writers return it
+	SharedFrame Fragment(const SharedFrame& frame, std::uint32_t tick) {
+		const std::uint8_t* payload = frame->data() + NetFrame::HeaderSize;
+		std::size_t payloadSize = frame->size() - NetFrame::HeaderSize;
+		std::size_t count = std::max<std::size_t>(1, (payloadSize + SnapshotDatagram::FragmentSize - 1) / SnapshotDatagram::FragmentSize);
+
+		std::shared_ptr<std::vector<std::uint8_t>> buffer = pool.Take();
+		buffer->resize(count * SnapshotDatagram::HeaderSize + payloadSize);
+		std::uint8_t* out = buffer->data();
+		for (std::size_t i = 0; i < count; i++) {
+			std::size_t offset = i * SnapshotDatagram::FragmentSize;
+			std::size_t length = std::min(SnapshotDatagram::FragmentSize, payloadSize - offset);
+			Wire::PutU16(out, SnapshotDatagram::Magic);
+			Wire::PutU8(out + 2, SnapshotDatagram::Version);
+			Wire::PutU8(out + 3, frame->at(4)); // NetMessageType from the frame header
+			Wire::PutU32(out + 4, tick);
+			Wire::PutU16(out + 8, static_cast<std::uint16_t>(i));
+			Wire::PutU16(out + 10, static_cast<std::uint16_t>(count));
+			Wire::PutU32(out + 12, static_cast<std::uint32_t>(payloadSize));
+			std::memcpy(out + SnapshotDatagram::HeaderSize, payload + offset, length);
+			out += SnapshotDatagram::HeaderSize + length;
+		}
+		return buffer;
+	}
+};
+
+// Client side. A few ticks can be in flight at once (datagrams of two ticks can arrive mixed),
+// an incomplete tick is dropped when a newer one completes or when its slot is needed
+class SnapshotReassembler
+{
+private:
+	struct Slot
+	{
+		bool used = false;
+		std::uint32_t tick = 0;
+		NetMessageType type = NetMessageType::Snapshot;
+		std::uint16_t fragmentCount = 0;
+		std::uint16_t received = 0;
+		std::vector<std::uint8_t> payload; // Keeps its capacity when the slot is reused
+		std::vector<bool> have;
+	};
+
+	std::vector<Slot> slots;
+	bool delivered = false;
+	std::uint32_t lastDeliveredTick = 0;
+	Slot* completed = nullptr;
+	std::uint64_t staleDropped = 0;
+	std::uint64_t incompleteDropped = 0;
+
+	Slot& FreeSlot() {
+		Slot* oldest = &slots[0];
+		for (Slot& slot : slots) {
+			if (!slot.used) {
+				return slot;
+			}
+			if (SnapshotDatagram::IsNewer(oldest->tick, slot.tick)) {
+				oldest = &slot;
+			}
+		}
+		incompleteDropped++;
+		return *oldest;
+	}
+
+public:
+	SnapshotReassembler(std::size_t inFlight = 4) : slots(inFlight) {}
+
+	// For a new connection, the server starts counting ticks again
+	void Reset() {
+		for (Slot& slot : slots) {
+			slot.used = false;
+		}
+		delivered = false;
+		completed = nullptr;
+	}
+
+	// True when this datagram completed a frame, GetType()/GetPayload() are valid until the next Add()
+	bool Add(const std::uint8_t* data, std::size_t size) {
+		completed = nullptr;
+		if (!SnapshotDatagram::IsDatagram(data, size) || Wire::GetU8(data + 2) != SnapshotDatagram::Version) {
+			return false;
+		}
+		NetMessageType type = static_cast<NetMessageType>(Wire::GetU8(data + 3));
+		std::uint32_t tick = Wire::GetU32(data + 4);
+		std::uint16_t index = Wire::GetU16(data + 8);
+		std::uint16_t count = Wire::GetU16(data + 10);
+		std::uint32_t payloadSize = Wire::GetU32(data + 12);
+
+		if (delivered && !SnapshotDatagram::IsNewer(tick, lastDeliveredTick)) {
+			staleDropped++; // Something newer is drawn already
+			return false;
+		}
+		std::size_t offset = static_cast<std::size_t>(index) * SnapshotDatagram::FragmentSize;
+		std::size_t expectedCount = std::max<std::size_t>(1, (payloadSize + SnapshotDatagram::FragmentSize - 1) / SnapshotDatagram::FragmentSize);
+		if (payloadSize > NetFrame::MaxPayloadSize || count != expectedCount || index >= count ||
+			size - SnapshotDatagram::HeaderSize != std::min<std::size_t>(SnapshotDatagram::FragmentSize, payloadSize - offset)) {
+			return false; // Broken or not ours
+		}
+
+		Slot* slot = nullptr;
+		for (Slot& candidate : slots) {
+			if (candidate.used && candidate.tick == tick) {
+				slot = &candidate;
+				break;
+			}
+		}
+		if (slot && (slot->fragmentCount != count || slot->payload.size() != payloadSize || slot->type != type)) {
+			slot->used = false; // Same tick, different frame. start over with the new one
+			slot = nullptr;
+		}
+		if (!slot) {
+			slot = &FreeSlot();
+			slot->used = true;
+			slot->tick = tick;
+			slot->type = type;
+			slot->fragmentCount = count;
+			slot->received = 0;
+			slot->payload.resize(payloadSize);
+			slot->have.assign(count, false);
+		}
+		if (slot->have[index]) {
+			return false; // Duplicate
+		}
+		slot->have[index] = true;
+		slot->received++;
+		std::memcpy(slot->payload.data() + offset, data + SnapshotDatagram::HeaderSize, size - SnapshotDatagram::HeaderSize);
+		if (slot->received < slot->fragmentCount) {
+			return false;
+		}
+
+		// Whole. everything older than it will never be drawn
+		delivered = true;
+		lastDeliveredTick = tick;
+		for (Slot& other : slots) {
+			if (other.used && &other != slot && !SnapshotDatagram::IsNewer(other.tick, tick)) {
+				other.used = false;
+				incompleteDropped++;
+			}
+		}
+		slot->used = false;
+		completed = slot;
+		return true;
+	}
+
+	NetMessageType GetType() const { return completed->type; }
+
+	const std::uint8_t* GetPayload() const { return completed->payload.data(); }
+
+	std::size_t GetPayloadSize() const { return completed->payload.size(); }
+
+	std::uint32_t GetTick() const { return completed->tick; }
+
+	std::uint64_t GetStaleDropped() const { return staleDropped; }
+
+	std::uint64_t GetIncompleteDropped() const { return incompleteDropped; }
+};
@@ -0,0 +1 @@
+#include "SnapshotInterpolator.h"
\ No newline at end of file
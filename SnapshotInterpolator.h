@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "DeltaSnapshot.h"
+
+// Client side jitter buffer. Snapshots arrive every few ticks and not exactly on time, so the client draws the
+// world a little in the past (delay) and interpolates between the two received snapshots around that time.
+// When the next snapshot is late it extrapolates from the last one with the velocity, for a short while only.
+// This lets the server broadcast at 10-20 Hz and the client still draw smooth motion at its own frame rate.
+
+struct InterpolationSettings
+{
+	float ticksPerSecond = 60;      // Server simulation rate, the ticks in the snapshots are in these
+	float delay = 0.1f;             // Seconds behind the newest snapshot, about two snapshots at 20 Hz
+	float maxExtrapolation = 0.25f; // Seconds past the newest snapshot before the bodies stop moving
+};
+
+class SnapshotInterpolator
+{
+private:
+	InterpolationSettings settings;
+	bool synced = false;
+	double clockOffset = 0; // Server time - local time, in seconds
+
+	static sf::Vector2f Lerp(sf::Vector2f a, sf::Vector2f b, float t) {
+		return a + (b - a) * t;
+	}
+
+public:
+	SnapshotInterpolator(const InterpolationSettings& settings = InterpolationSettings()) : settings(settings) {}
+
+	const InterpolationSettings& GetSettings() const { return settings; }
+
+	void SetSettings(const InterpolationSettings& newSettings) { settings = newSettings; }
+
+	// A new connection starts its ticks again
+	void Reset() { synced = false; }
+
+	// Every received snapshot moves the clock estimate. the offset follows the fastest arrival right away and
+	// drifts slowly when the snapshots come later, so one late packet does not push the whole playback back
+	void OnSnapshot(std::uint32_t tick, double now) {
+		double sample = tick / settings.ticksPerSecond - now;
+		if (!synced || sample > clockOffset) {
+			clockOffset = sample;
+			synced = true;
+		}
+		else {
+			clockOffset += (sample - clockOffset) * 0.01;
+		}
+	}
+
+	// The tick that is drawn at local time now (with a fraction)
+	double RenderTick(double now) const {
+		return (now + clockOffset - settings.delay) * settings.ticksPerSecond;
+	}
+
+	// The bodies as they should be drawn now, in id order. false when there is nothing received yet
+	bool Sample(const SnapshotHistory& history, double now, SnapshotState& out) const {
+		const SnapshotState* before = nullptr;
+		const SnapshotState* after = nullptr;
+		double renderTick = RenderTick(now);
+		history.FindAround(renderTick, before, after);
+		if (!before && !after) {
+			return false;
+		}
+
+		out.bodies.clear();
+		if (!before || !after) {
+			// Only newer ones (just connected, draw the oldest as is), or only older ones (late, extrapolate)
+			const SnapshotState* state = before ? before : after;
+			out.tick = state->tick;
+			out.bodies = state->bodies;
+			if (before) {
+				float seconds = static_cast<float>(std::min<double>((renderTick - before->tick) / settings.ticksPerSecond, settings.maxExtrapolation));
+				for (BodyRecord& body : out.bodies) {
+					body.position += body.velocity * seconds;
+				}
+			}
+			return true;
+		}
+
+		// Both sorted by id, bodies only in one of them are drawn where that one has them
+		float t = static_cast<float>((renderTick - before->tick) / (static_cast<double>(after->tick) - before->tick));
+		out.tick = before->tick;
+		std::size_t i = 0;
+		std::size_t j = 0;
+		while (i < before->bodies.size() || j < after->bodies.size()) {
+			if (j == after->bodies.size() || (i < before->bodies.size() && before->bodies[i].id < after->bodies[j].id)) {
+				out.bodies.push_back(before->bodies[i++]);
+			}
+			else if (i == before->bodies.size() || after->bodies[j].id < before->bodies[i].id) {
+				out.bodies.push_back(after->bodies[j++]);
+			}
+			else {
+				BodyRecord body = after->bodies[j];
+				body.position = Lerp(before->bodies[i].position, after->bodies[j].position, t);
+				out.bodies.push_back(body);
+				i++;
+				j++;
+			}
+		}
+		return true;
+	}
+};
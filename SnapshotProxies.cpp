@@ -0,0 +1 @@
+#include "SnapshotProxies.h"
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include "Snapshot.h"
+#include "DeltaSnapshot.h"
+
+// The client's bodies are proxies of the server's. A new snapshot updates the proxies that are still there in
+// place (found by id), and only the created/removed bodies take a proxy from the pool or give it back, so a
+// steady world costs one pass per snapshot with no allocation and the memory stays flat.
+//
+// The proxies live in the objList that is passed in (kept in id order), the pool owns the free ones. A proxy the
+// front end deletes itself (ObjectsList::DeleteThisObj) is simply not there on the next snapshot.
+class SnapshotProxyPool
+{
+private:
+	static constexpr std::size_t KindCount = 5;
+	std::array<std::vector<BaseShape*>, KindCount> freeProxies; // By ShapeKind
+	std::vector<BaseShape*> next; // The new objList, swapped in so both vectors keep their memory
+
+	static std::size_t KindIndex(ShapeKind kind) {
+		std::size_t index = static_cast<std::size_t>(SnapshotReader::ProxyKind(kind));
+		return index < KindCount ? index : static_cast<std::size_t>(ShapeKind::Circle);
+	}
+
+	BaseShape* Take(ShapeKind kind) {
+		std::vector<BaseShape*>& pool = freeProxies[KindIndex(kind)];
+		if (pool.empty()) {
+			return SnapshotReader::NewShape(kind);
+		}
+		BaseShape* proxy = pool.back();
+		pool.pop_back();
+		return proxy;
+	}
+
+	void Release(BaseShape* proxy) {
+		freeProxies[KindIndex(proxy->GetKind())].push_back(proxy);
+	}
+
+public:
+	SnapshotProxyPool() {}
+	SnapshotProxyPool(const SnapshotProxyPool&) = delete;
+	SnapshotProxyPool& operator=(const SnapshotProxyPool&) = delete;
+
+	~SnapshotProxyPool() {
+		for (std::vector<BaseShape*>& pool : freeProxies) {
+			for (BaseShape* proxy : pool) {
+				delete proxy;
+			}
+		}
+	}
+
+	// Makes objList match the state. both are walked in id order
+	void Apply(const SnapshotState& state, std::vector<BaseShape*>& objList) {
+		auto byID = [](BaseShape* a, BaseShape* b) { return a->GetID() < b->GetID(); };
+		if (!std::is_sorted(objList.begin(), objList.end(), byID)) {
+			std::sort(objList.begin(), objList.end(), byID);
+		}
+
+		next.clear();
+		std::size_t j = 0;
+		for (const BodyRecord& record : state.bodies) {
+			// Proxies before this id are gone on the server
+			while (j < objList.size() && static_cast<std::uint32_t>(objList[j]->GetID()) < record.id) {
+				Release(objList[j++]);
+			}
+			BaseShape* proxy = nullptr;
+			if (j < objList.size() && static_cast<std::uint32_t>(objList[j]->GetID()) == record.id) {
+				proxy = objList[j++];
+				if (proxy->GetKind() != SnapshotReader::ProxyKind(record.kind)) {
+					Release(proxy); // Same id, other class
+					proxy = Take(record.kind);
+				}
+			}
+			else {
+				proxy = Take(record.kind);
+			}
+			SnapshotReader::ApplyRecord(proxy, record);
+			next.push_back(proxy);
+		}
+		while (j < objList.size()) {
+			Release(objList[j++]);
+		}
+		std::swap(objList, next);
+	}
+
+	// Gives every proxy back, for leaving the server
+	void ReleaseAll(std::vector<BaseShape*>& objList) {
+		for (BaseShape* proxy : objList) {
+			Release(proxy);
+		}
+		objList.clear();
+	}
+
+	std::size_t GetFreeCount() const {
+		std::size_t count = 0;
+		for (const std::vector<BaseShape*>& pool : freeProxies) {
+			count += pool.size();
+		}
+		return count;
+	}
+};
@@ -0,0 +1 @@
+#include "Telemetry.h"
\ No newline at end of file
@@ -0,0 +1,397 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "TickScheduler.h"
+
+// What the server tells about itself: log lines that do not block the thread that writes them, and metrics that
+// are sampled every second and dumped for other programs (JSON lines or a Prometheus text file) and the console.
+
+// Log lines go to a queue and a thread of its own writes them, so a tick or an io handler never waits for the
+// console. When the writer can not keep up the newest lines are dropped (and counted) instead of growing forever
+class AsyncLogger
+{
+private:
+	std::ostream& out;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<std::string> pending;
+	std::vector<std::string> writing; // Only the writer thread, swapped with pending
+	std::size_t maxPending = 8192;
+	std::atomic<std::uint64_t> dropped{ 0 };
+	bool stopping = false;
+	std::thread writer;
+
+	void Run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			wake.wait(lock, [this]() { return stopping || !pending.empty(); });
+			if (pending.empty() && stopping) {
+				return;
+			}
+			std::swap(pending, writing);
+			lock.unlock();
+			for (const std::string& line : writing) {
+				out << line << '\n';
+			}
+			out.flush();
+			writing.clear();
+			lock.lock();
+		}
+	}
+
+public:
+	AsyncLogger(std::ostream& out) : out(out) {
+		writer = std::thread([this]() { Run(); });
+	}
+
+	// Writes what is still queued
+	~AsyncLogger() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		writer.join();
+	}
+
+	AsyncLogger(const AsyncLogger&) = delete;
+	AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+	// The process wide logger, to std::cout
+	static AsyncLogger& Get() {
+		static AsyncLogger logger(std::cout);
+		return logger;
+	}
+
+	// Any thread. One line, without the newline
+	void Write(std::string line) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (pending.size() >= maxPending) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			pending.push_back(std::move(line));
+		}
+		wake.notify_one();
+	}
+
+	std::uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+// Log() << "Client " << id << " connected"; the line is queued when the statement ends
+class LogLine
+{
+private:
+	std::ostringstream text;
+
+public:
+	LogLine() = default;
+	LogLine(const LogLine&) = delete;
+	LogLine& operator=(const LogLine&) = delete;
+
+	~LogLine() { AsyncLogger::Get().Write(std::move(text).str()); }
+
+	template<typename T>
+	LogLine& operator<<(const T& value) {
+		text << value;
+		return *this;
+	}
+};
+
+inline LogLine Log() { return LogLine(); }
+
+// Round trip time of one connection from ping / pong pairs, smoothed like TCP does (1/8 of every new sample).
+// Samples come from an io thread, the telemetry reads from its own
+class RttEstimator
+{
+private:
+	std::atomic<float> smoothedMicros{ 0 };
+	std::atomic<float> lastMicros{ 0 };
+	std::atomic<float> minMicros{ 0 };
+	std::atomic<std::uint64_t> samples{ 0 };
+
+public:
+	void Sample(double micros) {
+		float sample = static_cast<float>(std::max(0.0, micros));
+		float smoothed = samples.load(std::memory_order_relaxed) == 0 ? sample : smoothedMicros.load(std::memory_order_relaxed) * 0.875f + sample * 0.125f;
+		float lowest = minMicros.load(std::memory_order_relaxed);
+		if (samples.load(std::memory_order_relaxed) == 0 || sample < lowest) {
+			minMicros.store(sample, std::memory_order_relaxed);
+		}
+		smoothedMicros.store(smoothed, std::memory_order_relaxed);
+		lastMicros.store(sample, std::memory_order_relaxed);
+		samples.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool HasSamples() const { return samples.load(std::memory_order_relaxed) > 0; }
+	double SmoothedMillis() const { return smoothedMicros.load(std::memory_order_relaxed) / 1000.0; }
+	double LastMillis() const { return lastMicros.load(std::memory_order_relaxed) / 1000.0; }
+	double MinMillis() const { return minMicros.load(std::memory_order_relaxed) / 1000.0; }
+};
+
+// "ping:<micros>" from the server, the client sends the same number back as "pong:<micros>" right away
+struct PingText
+{
+	static std::int64_t NowMicros() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static std::string Ping() { return "ping:" + std::to_string(NowMicros()); }
+};
+
+// The parts of a tick, timed one after the other
+enum class TickPhase : std::uint8_t {
+	Commands,  // Draining the command ring
+	Exchange,  // Halo and migrants of a sharded world (both sides of the physics)
+	Physics,
+	Broadcast, // Snapshots for the clients
+	Count
+};
+
+inline const char* TickPhaseName(TickPhase phase) {
+	switch (phase) {
+	case TickPhase::Commands: return "commands";
+	case TickPhase::Exchange: return "exchange";
+	case TickPhase::Physics: return "physics";
+	case TickPhase::Broadcast: return "broadcast";
+	default: return "unknown";
+	}
+}
+
+// Start() at the top of a tick, Mark(phase) at the end of every piece of work: the time since the last mark goes to
+// that phase (a phase can come more than once a tick), End() records every phase once. Written by the tick, read by
+// the telemetry
+class TickPhaseTimes
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+private:
+	static constexpr std::size_t PhaseCount = static_cast<std::size_t>(TickPhase::Count);
+	std::array<DurationHistogram, PhaseCount> phases;
+	std::array<Clock::duration, PhaseCount> thisTick{};
+	Clock::time_point last;
+
+public:
+	void Start() {
+		thisTick.fill(Clock::duration::zero());
+		last = Clock::now();
+	}
+
+	void Mark(TickPhase phase) {
+		Clock::time_point now = Clock::now();
+		thisTick[static_cast<std::size_t>(phase)] += now - last;
+		last = now;
+	}
+
+	void End() {
+		for (std::size_t i = 0; i < PhaseCount; i++) {
+			phases[i].Record(std::chrono::duration<double, std::micro>(thisTick[i]).count());
+		}
+	}
+
+	const DurationHistogram& Get(TickPhase phase) const { return phases[static_cast<std::size_t>(phase)]; }
+};
+
+// One sample of every metric, each a name, a few labels and a number. Built by the telemetry thread, so nothing
+// here is shared
+class MetricsSnapshot
+{
+public:
+	using Labels = std::vector<std::pair<std::string, std::string>>;
+
+	struct Sample
+	{
+		std::string name;
+		Labels labels;
+		double value = 0;
+	};
+
+private:
+	std::vector<Sample> samples;
+	double time = 0; // Seconds since the epoch
+
+	static void WriteJsonString(std::ostream& out, std::string_view text) {
+		out << '"';
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				out << '\\' << c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out << escaped;
+			}
+			else {
+				out << c;
+			}
+		}
+		out << '"';
+	}
+
+	static void WriteNumber(std::ostream& out, double value) {
+		if (!std::isfinite(value)) {
+			out << 0;
+			return;
+		}
+		out << std::setprecision(10) << value;
+		out.unsetf(std::ios::floatfield);
+	}
+
+public:
+	static constexpr const char* Prefix = "atomical_";
+
+	void Clear(double timeSeconds) {
+		samples.clear();
+		time = timeSeconds;
+	}
+
+	void Add(std::string name, double value, Labels labels = {}) {
+		samples.push_back(Sample{ std::move(name), std::move(labels), value });
+	}
+
+	const std::vector<Sample>& Samples() const { return samples; }
+	double Time() const { return time; }
+
+	// One line: {"time":..,"metrics":[{"name":..,"labels":{..},"value":..},..]}
+	void WriteJsonLine(std::ostream& out) const {
+		out << "{\"time\":" << std::fixed << std::setprecision(3) << time;
+		out.unsetf(std::ios::floatfield);
+		out << ",\"metrics\":[";
+		for (std::size_t i = 0; i < samples.size(); i++) {
+			const Sample& sample = samples[i];
+			out << (i == 0 ? "" : ",") << "{\"name\":";
+			WriteJsonString(out, sample.name);
+			if (!sample.labels.empty()) {
+				out << ",\"labels\":{";
+				for (std::size_t j = 0; j < sample.labels.size(); j++) {
+					out << (j == 0 ? "" : ",");
+					WriteJsonString(out, sample.labels[j].first);
+					out << ':';
+					WriteJsonString(out, sample.labels[j].second);
+				}
+				out << '}';
+			}
+			out << ",\"value\":";
+			WriteNumber(out, sample.value);
+			out << '}';
+		}
+		out << "]}\n";
+	}
+
+	// The text exposition format, name{label="value"} number
+	void WritePrometheus(std::ostream& out) const {
+		for (const Sample& sample : samples) {
+			out << Prefix << sample.name;
+			if (!sample.labels.empty()) {
+				out << '{';
+				for (std::size_t j = 0; j < sample.labels.size(); j++) {
+					out << (j == 0 ? "" : ",") << sample.labels[j].first << "=";
+					WriteJsonString(out, sample.labels[j].second); // Same escaping for the label values
+				}
+				out << '}';
+			}
+			out << ' ';
+			WriteNumber(out, sample.value);
+			out << '\n';
+		}
+	}
+
+	// For the console: one line per label set, in the order they were added
+	void WriteTable(std::ostream& out) const {
+		const Labels* current = nullptr;
+		for (const Sample& sample : samples) {
+			if (!current || *current != sample.labels) {
+				if (current) {
+					out << '\n';
+				}
+				current = &sample.labels;
+				if (sample.labels.empty()) {
+					out << "server";
+				}
+				for (std::size_t j = 0; j < sample.labels.size(); j++) {
+					out << (j == 0 ? "" : " ") << sample.labels[j].first << " " << sample.labels[j].second;
+				}
+				out << ":";
+			}
+			out << " " << sample.name << " " << std::fixed << std::setprecision(2) << sample.value;
+			out.unsetf(std::ios::floatfield);
+		}
+		if (current) {
+			out << '\n';
+		}
+	}
+};
+
+enum class MetricsFormat : std::uint8_t {
+	JsonLines,  // One line appended per dump
+	Prometheus  // The whole file written again per dump (to a temporary file first, so a reader never sees half)
+};
+
+struct TelemetrySettings
+{
+	float sampleSeconds = 1;  // Also how often the clients are pinged
+	float dumpSeconds = 10;
+	std::string path;         // No dump when empty, the console still has the samples
+	MetricsFormat format = MetricsFormat::JsonLines;
+};
+
+// Where the periodic dump goes, nothing when the path is empty
+class MetricsFile
+{
+private:
+	std::string path;
+	MetricsFormat format = MetricsFormat::JsonLines;
+	std::string buffer; // Reused
+
+public:
+	MetricsFile(std::string path = "", MetricsFormat format = MetricsFormat::JsonLines) : path(std::move(path)), format(format) {}
+
+	bool Enabled() const { return !path.empty(); }
+
+	bool Write(const MetricsSnapshot& snapshot) {
+		if (path.empty()) {
+			return false;
+		}
+		std::ostringstream text(std::move(buffer));
+		text.str("");
+		if (format == MetricsFormat::JsonLines) {
+			snapshot.WriteJsonLine(text);
+			std::ofstream file(path, std::ios::app | std::ios::binary);
+			file << text.view();
+			buffer = std::move(text).str();
+			return static_cast<bool>(file);
+		}
+		snapshot.WritePrometheus(text);
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::trunc | std::ios::binary);
+			file << text.view();
+			if (!file) {
+				return false;
+			}
+		}
+		buffer = std::move(text).str();
+		if (std::rename(temporary.c_str(), path.c_str()) == 0) {
+			return true;
+		}
+		std::remove(path.c_str()); // Windows does not rename over a file that is there
+		return std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+};
@@ -0,0 +1 @@
+#include "TickPool.h"
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+#include <exception>
+#include "TickScheduler.h"
+
+// A fixed rate loop that runs on a TickPool instead of a thread of its own
+class TickTask
+{
+public:
+	virtual ~TickTask() = default;
+
+	virtual TickScheduler& Scheduler() = 0;
+
+	// The work of one tick. never called for the same task on two threads at the same time
+	virtual void Tick() = 0;
+
+	// Checked after every tick, a finished task is dropped from the pool
+	virtual bool Finished() { return false; }
+};
+
+// Many fixed rate loops on a few threads.
+// The tasks sit in a heap by their next deadline, a free worker takes the earliest one when it is due, runs one tick
+// and puts it back with its new deadline. A task is only in the heap while nobody runs it, so its ticks never
+// overlap, and a sleeping task costs nothing but its heap entry.
+class TickPool
+{
+private:
+	struct Entry
+	{
+		TickScheduler::Clock::time_point deadline;
+		std::shared_ptr<TickTask> task;
+
+		bool operator>(const Entry& other) const { return deadline > other.deadline; }
+	};
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<Entry> heap; // Earliest deadline first (std::greater)
+	bool stopping = false;
+	std::atomic<std::size_t> taskCount{ 0 };
+
+	void Push(Entry entry) {
+		heap.push_back(std::move(entry));
+		std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+		wake.notify_one();
+	}
+
+public:
+	TickPool() {}
+	TickPool(const TickPool&) = delete;
+	TickPool& operator=(const TickPool&) = delete;
+
+	// Any thread, the first tick is right away
+	void Add(std::shared_ptr<TickTask> task) {
+		std::lock_guard<std::mutex> lock(mutex);
+		TickScheduler::Clock::time_point deadline = task->Scheduler().NextDeadline();
+		Push(Entry{ deadline, std::move(task) });
+		taskCount++;
+	}
+
+	std::size_t TaskCount() const { return taskCount.load(); }
+
+	// Runs ticks on the calling thread until Stop
+	void Work() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!stopping) {
+			if (heap.empty()) {
+				wake.wait(lock);
+				continue;
+			}
+			TickScheduler::Clock::time_point deadline = heap.front().deadline;
+			if (TickScheduler::Clock::now() < deadline) {
+				wake.wait_until(lock, deadline); // An earlier task that is added wakes it again
+				continue;
+			}
+			std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+			std::shared_ptr<TickTask> task = std::move(heap.back().task);
+			heap.pop_back();
+			lock.unlock();
+
+			TickScheduler& scheduler = task->Scheduler();
+			scheduler.BeginTick();
+			try {
+				task->Tick();
+			}
+			catch (const std::exception& e) {
+				std::cerr << "Exception in tick: " << e.what() << std::endl;
+			}
+			scheduler.EndTick();
+			bool finished = task->Finished();
+
+			lock.lock();
+			if (finished) {
+				taskCount--;
+			}
+			else {
+				Push(Entry{ scheduler.NextDeadline(), std::move(task) });
+			}
+		}
+	}
+
+	// threadCount workers, the calling thread is one of them. returns after Stop
+	void Run(std::size_t threadCount) {
+		std::vector<std::thread> workers;
+		for (std::size_t i = 1; i < threadCount; i++) {
+			workers.emplace_back([this]() { Work(); });
+		}
+		Work();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	void Stop() {
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		wake.notify_all();
+	}
+};
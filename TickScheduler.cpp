@@ -0,0 +1 @@
+#include "TickScheduler.h"
\ No newline at end of file
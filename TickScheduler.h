@@ -0,0 +1,331 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+
+// Fixed rate loop for the server simulation.
+// Deadlines are absolute (start + tick * period), so the time a tick spends working does not push every later tick
+// back, and a late wake up is made up on the next one instead of adding up. When the ticks take longer than the
+// period for a while the scheduler sheds work in steps (see OverloadPolicy), and it gives the work back once the
+// ticks fit again.
+
+// What the server gives up when the ticks do not fit, in the order of TickSettings::policies
+enum class OverloadPolicy : std::uint8_t {
+	SkipBroadcast,  // Snapshot every other broadcast tick, the clients interpolate over the gap
+	ReduceSubsteps, // Fewer physics steps per tick (same simulated time, bigger steps)
+	ShedInterest    // Smaller area of interest margin, fewer bodies per client snapshot
+};
+
+struct TickSettings
+{
+	float tickRate = 60;            // Simulation ticks per second
+	float broadcastRate = 20;       // Snapshots per second, rounded to a whole number of ticks
+	int substeps = 2;               // Physics steps per tick
+	int minSubsteps = 1;            // What ReduceSubsteps goes down to, the same as substeps turns it off
+	float interestShed = 0.25f;     // Interest margin scale while ShedInterest is on
+	float overloadLoad = 0.9f;      // Average work time / period above which a tick counts as overloaded
+	float recoverLoad = 0.6f;       // ...and below which it counts as calm
+	int escalateTicks = 30;         // Overloaded ticks in a row before the next policy turns on
+	int recoverTicks = 120;         // Calm ticks in a row before the last policy turns off again
+	int maxCatchUpTicks = 5;        // Ticks behind after which the schedule restarts instead of running them all
+	std::array<OverloadPolicy, 3> policies = { OverloadPolicy::SkipBroadcast, OverloadPolicy::ReduceSubsteps, OverloadPolicy::ShedInterest };
+};
+
+// Durations in power of two buckets from 50 us, so it is a few atomics and no allocation per tick.
+// Written by the simulation thread, read by the console
+class DurationHistogram
+{
+public:
+	static constexpr int BucketCount = 18;      // The last bucket is everything from 50 us * 2^16 (3.3 s) up
+	static constexpr double FirstBucketMicros = 50;
+
+private:
+	std::array<std::atomic<std::uint64_t>, BucketCount> buckets{};
+	std::atomic<std::uint64_t> count{ 0 };
+	std::atomic<std::uint64_t> totalMicros{ 0 };
+	std::atomic<std::uint64_t> maxMicros{ 0 };
+
+public:
+	// Upper bound of a bucket in microseconds
+	static double BucketLimit(int bucket) { return FirstBucketMicros * std::ldexp(1.0, bucket); }
+
+	void Record(double micros) {
+		int bucket = 0;
+		while (bucket < BucketCount - 1 && micros >= BucketLimit(bucket)) {
+			bucket++;
+		}
+		buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		std::uint64_t whole = static_cast<std::uint64_t>(std::max(0.0, micros));
+		totalMicros.fetch_add(whole, std::memory_order_relaxed);
+		if (whole > maxMicros.load(std::memory_order_relaxed)) {
+			maxMicros.store(whole, std::memory_order_relaxed);
+		}
+	}
+
+	void Reset() {
+		for (auto& bucket : buckets) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		count = 0;
+		totalMicros = 0;
+		maxMicros = 0;
+	}
+
+	// Adds the durations of another histogram, for totals over many of them
+	void Merge(const DurationHistogram& other) {
+		for (int i = 0; i < BucketCount; i++) {
+			buckets[i].fetch_add(other.buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		count.fetch_add(other.Count(), std::memory_order_relaxed);
+		totalMicros.fetch_add(other.totalMicros.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		std::uint64_t otherMax = other.maxMicros.load(std::memory_order_relaxed);
+		if (otherMax > maxMicros.load(std::memory_order_relaxed)) {
+			maxMicros.store(otherMax, std::memory_order_relaxed);
+		}
+	}
+
+	std::uint64_t Count() const { return count.load(std::memory_order_relaxed); }
+
+	double MeanMicros() const {
+		std::uint64_t n = Count();
+		return n == 0 ? 0 : static_cast<double>(totalMicros.load(std::memory_order_relaxed)) / n;
+	}
+
+	double MaxMicros() const { return static_cast<double>(maxMicros.load(std::memory_order_relaxed)); }
+
+	// Sum of the whole microseconds, with Count the mean of any stretch between two reads
+	std::uint64_t TotalMicros() const { return totalMicros.load(std::memory_order_relaxed); }
+
+	// Upper bound of the bucket the percentile falls in (0-1)
+	double PercentileMicros(double percentile) const {
+		std::uint64_t n = Count();
+		if (n == 0) {
+			return 0;
+		}
+		std::uint64_t target = static_cast<std::uint64_t>(std::ceil(percentile * n));
+		std::uint64_t seen = 0;
+		for (int i = 0; i < BucketCount; i++) {
+			seen += buckets[i].load(std::memory_order_relaxed);
+			if (seen >= target) {
+				return i == BucketCount - 1 ? MaxMicros() : BucketLimit(i);
+			}
+		}
+		return MaxMicros();
+	}
+
+	// One line per bucket that has something, for the console
+	void Print(std::ostream& out, const char* name) const {
+		out << name << ": " << Count() << " ticks, mean " << std::fixed << std::setprecision(2) << MeanMicros() / 1000
+			<< " ms, p50 <" << PercentileMicros(0.5) / 1000 << " ms, p99 <" << PercentileMicros(0.99) / 1000
+			<< " ms, max " << MaxMicros() / 1000 << " ms" << std::endl;
+		for (int i = 0; i < BucketCount; i++) {
+			std::uint64_t inBucket = buckets[i].load(std::memory_order_relaxed);
+			if (inBucket > 0) {
+				out << "  < " << std::setw(8) << BucketLimit(i) / 1000 << " ms: " << inBucket << std::endl;
+			}
+		}
+		out.unsetf(std::ios::floatfield);
+	}
+};
+
+class TickScheduler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+private:
+	TickSettings settings;
+	Clock::duration period;
+	Clock::time_point start;      // Deadline of tick 0 of this schedule
+	std::uint64_t scheduleTick = 0; // Ticks since start
+	Clock::time_point workStart;
+	Clock::time_point retryAt;      // Set by Retry, the same tick runs again then
+	bool started = false;
+	bool idle = false;              // Set by Retry and Idle, EndTick records nothing for this tick
+
+	double averageLoad = 0; // Work time / period, smoothed over a few ticks
+	int overloadedInARow = 0;
+	int calmInARow = 0;
+	std::atomic<int> level{ 0 }; // How many of settings.policies are on
+	std::atomic<std::uint64_t> skippedBroadcasts{ 0 };
+	std::atomic<std::uint64_t> droppedTicks{ 0 };  // Given up on after a long stall
+	std::atomic<std::uint64_t> lateTicks{ 0 };     // Started after their deadline (caught up)
+	std::atomic<float> load{ 0 };
+
+	DurationHistogram workTimes;  // Commands + physics + broadcast of one tick
+	DurationHistogram wakeDelays; // How late the tick started after its deadline
+
+	bool PolicyOn(OverloadPolicy policy) const {
+		int on = level.load(std::memory_order_relaxed);
+		for (int i = 0; i < on && i < static_cast<int>(settings.policies.size()); i++) {
+			if (settings.policies[i] == policy) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Clock::time_point Deadline(std::uint64_t tick) const {
+		return start + period * static_cast<Clock::rep>(tick);
+	}
+
+	static double Micros(Clock::duration duration) {
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+
+public:
+	TickScheduler(const TickSettings& settings = TickSettings()) {
+		SetSettings(settings);
+	}
+
+	// Only before the loop runs, or from the simulation thread
+	void SetSettings(const TickSettings& newSettings) {
+		settings = newSettings;
+		settings.tickRate = std::clamp(settings.tickRate, 1.0f, 1000.0f);
+		settings.substeps = std::max(1, settings.substeps);
+		settings.minSubsteps = std::clamp(settings.minSubsteps, 1, settings.substeps);
+		period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / settings.tickRate));
+		started = false;
+	}
+
+	const TickSettings& GetSettings() const { return settings; }
+
+	// Deadline of the next tick, now when the schedule has not started yet
+	Clock::time_point NextDeadline() const {
+		return started ? std::max(Deadline(scheduleTick), retryAt) : Clock::now();
+	}
+
+	// At the start of the work of a tick, on time or late
+	void BeginTick() {
+		Clock::time_point now = Clock::now();
+		if (!started) {
+			start = now;
+			scheduleTick = 0;
+			started = true;
+		}
+		Clock::time_point deadline = Deadline(scheduleTick);
+		bool retry = retryAt != Clock::time_point(); // Late on purpose, not a slow wake
+		if (now - deadline > period * settings.maxCatchUpTicks) {
+			// Stalled (debugger, a huge spawn), running every missed tick back to back would only stall the clients
+			std::uint64_t behind = static_cast<std::uint64_t>((now - deadline) / period);
+			droppedTicks += behind;
+			start = now - period * static_cast<Clock::rep>(scheduleTick);
+			deadline = now;
+		}
+		else if (now - deadline > period / 2 && !retry) {
+			lateTicks++;
+		}
+		if (!retry) {
+			wakeDelays.Record(now > deadline ? Micros(now - deadline) : 0);
+		}
+		workStart = now;
+		retryAt = Clock::time_point();
+		scheduleTick++;
+	}
+
+	// Inside the work of a tick that can not go on yet (it waits for another process): the same tick is tried
+	// again after delay instead of at the next deadline. The thread is free for other work meanwhile
+	void Retry(Clock::duration delay) {
+		scheduleTick--;
+		retryAt = Clock::now() + delay;
+		idle = true;
+	}
+
+	// Inside the work of a tick that had nothing to do (it waits for another process to show up): the tick is
+	// used up as usual but does not count as work, a waiting room would only pull the load down
+	void Idle() {
+		idle = true;
+	}
+
+	// For a loop of its own: sleeps until the deadline of the next tick, returns right away when the loop is behind
+	void WaitForNextTick() {
+		std::this_thread::sleep_until(NextDeadline());
+		BeginTick();
+	}
+
+	// After the work of a tick, updates the load and the overload level
+	void EndTick() {
+		if (idle) {
+			idle = false;
+			return;
+		}
+		Clock::duration work = Clock::now() - workStart;
+		workTimes.Record(Micros(work));
+		double tickLoad = static_cast<double>(work.count()) / static_cast<double>(period.count());
+		averageLoad += (tickLoad - averageLoad) * 0.1;
+		load.store(static_cast<float>(averageLoad), std::memory_order_relaxed);
+
+		int current = level.load(std::memory_order_relaxed);
+		if (averageLoad > settings.overloadLoad) {
+			calmInARow = 0;
+			if (++overloadedInARow >= settings.escalateTicks && current < static_cast<int>(settings.policies.size())) {
+				level.store(current + 1, std::memory_order_relaxed);
+				overloadedInARow = 0;
+			}
+		}
+		else if (averageLoad < settings.recoverLoad) {
+			overloadedInARow = 0;
+			if (++calmInARow >= settings.recoverTicks && current > 0) {
+				level.store(current - 1, std::memory_order_relaxed);
+				calmInARow = 0;
+			}
+		}
+		else {
+			overloadedInARow = 0;
+			calmInARow = 0;
+		}
+	}
+
+	// Seconds of simulation per tick
+	float TickSeconds() const { return 1.0f / settings.tickRate; }
+
+	std::uint32_t BroadcastInterval() const {
+		return static_cast<std::uint32_t>(std::max(1.0f, std::round(settings.tickRate / std::max(0.001f, settings.broadcastRate))));
+	}
+
+	// Whether tick gets a snapshot
+	bool ShouldBroadcast(std::uint32_t tick) {
+		std::uint32_t interval = BroadcastInterval();
+		if (tick % interval != 0) {
+			return false;
+		}
+		if (PolicyOn(OverloadPolicy::SkipBroadcast) && (tick / interval) % 2 == 1) {
+			skippedBroadcasts++;
+			return false;
+		}
+		return true;
+	}
+
+	int Substeps() const {
+		return PolicyOn(OverloadPolicy::ReduceSubsteps) ? settings.minSubsteps : settings.substeps;
+	}
+
+	// Scale for the interest margin and hysteresis
+	float InterestScale() const {
+		return PolicyOn(OverloadPolicy::ShedInterest) ? settings.interestShed : 1.0f;
+	}
+
+	// Any thread
+	int GetOverloadLevel() const { return level.load(std::memory_order_relaxed); }
+	float GetLoad() const { return load.load(std::memory_order_relaxed); }
+	std::uint64_t GetSkippedBroadcasts() const { return skippedBroadcasts.load(std::memory_order_relaxed); }
+	std::uint64_t GetDroppedTicks() const { return droppedTicks.load(std::memory_order_relaxed); }
+	std::uint64_t GetLateTicks() const { return lateTicks.load(std::memory_order_relaxed); }
+	const DurationHistogram& GetWorkTimes() const { return workTimes; }
+	const DurationHistogram& GetWakeDelays() const { return wakeDelays; }
+
+	void ResetStats() {
+		workTimes.Reset();
+		wakeDelays.Reset();
+		skippedBroadcasts = 0;
+		droppedTicks = 0;
+		lateTicks = 0;
+	}
+};
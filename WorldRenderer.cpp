@@ -0,0 +1 @@
+#include "WorldRenderer.h"
\ No newline at end of file
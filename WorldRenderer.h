@@ -0,0 +1,96 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "ObjectsList.h"
+#include "LodRenderer.h"
+
+// SimColor <-> sf::Color, the core only knows SimColor so the front ends convert at the border
+inline sf::Color ToSfColor(SimColor color) {
+	return sf::Color(color.r, color.g, color.b, color.a);
+}
+
+inline SimColor ToSimColor(sf::Color color) {
+	return SimColor(color.r, color.g, color.b, color.a);
+}
+
+// Draws the headless simulation (ObjectsList) with SFML.
+// The bodies are plain data now, so one circle shape and one rectangle shape are reused for every body
+// instead of every body being its own sf::Shape.
+class WorldRenderer
+{
+private:
+	sf::CircleShape circleShape;
+	sf::RectangleShape rectangleShape;
+	sf::VertexArray linkLines = sf::VertexArray(sf::Lines);
+	bool drawGrid = false;
+
+	void DrawLinks(sf::RenderTarget& target, const LineLink& links) {
+		linkLines.clear();
+		links.ForEachLink([&](BaseShape* obj1, BaseShape* obj2) {
+			linkLines.append(sf::Vertex(obj1->GetPosition(), sf::Color::White));
+			linkLines.append(sf::Vertex(obj2->GetPosition(), sf::Color::White));
+			});
+		target.draw(linkLines);
+	}
+
+	// Debug view of the occupied grid cells, a red outline around the first object of every cell
+	void DrawGridCells(sf::RenderTarget& target, Grid* grid) {
+		GridUnorderd* hashGrid = dynamic_cast<GridUnorderd*>(grid);
+		if (hashGrid == nullptr) {
+			return;
+		}
+		sf::RectangleShape cellRect;
+		cellRect.setFillColor(sf::Color::Transparent);
+		cellRect.setOutlineColor(sf::Color(255, 0, 0));
+		cellRect.setOutlineThickness(3.0);
+		for (auto& keyAndObjects : hashGrid->GetCells()) {
+			if (keyAndObjects.second.empty()) {
+				continue;
+			}
+			BaseShape* obj = keyAndObjects.second.front();
+			float size = obj->GetEstimatedSize() * 2;
+			cellRect.setSize(sf::Vector2f(size, size));
+			cellRect.setOrigin(size / 2, size / 2);
+			cellRect.setPosition(obj->GetPosition());
+			target.draw(cellRect);
+		}
+	}
+
+public:
+	LodRenderer lodRenderer;
+
+	WorldRenderer() {}
+
+	void ToggleGrid() { drawGrid = !drawGrid; }
+
+	void DrawShape(sf::RenderTarget& target, BaseShape* obj) {
+		if (Circle* circle = dynamic_cast<Circle*>(obj)) {
+			float radius = circle->GetRadius();
+			circleShape.setRadius(radius);
+			circleShape.setOrigin(radius, radius);
+			circleShape.setPosition(circle->GetPosition());
+			circleShape.setFillColor(ToSfColor(circle->GetColor()));
+			circleShape.setOutlineColor(ToSfColor(circle->GetOutlineColor()));
+			circleShape.setOutlineThickness(circle->GetOutlineThickness());
+			target.draw(circleShape);
+		}
+		else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(obj)) {
+			float width = rectangle->GetWidth();
+			float height = rectangle->GetHeight();
+			rectangleShape.setSize(sf::Vector2f(width, height));
+			rectangleShape.setOrigin(width / 2, height / 2);
+			rectangleShape.setPosition(rectangle->GetPosition());
+			rectangleShape.setFillColor(ToSfColor(rectangle->GetColor()));
+			rectangleShape.setOutlineColor(ToSfColor(rectangle->GetOutlineColor()));
+			rectangleShape.setOutlineThickness(rectangle->GetOutlineThickness());
+			target.draw(rectangleShape);
+		}
+	}
+
+	void Draw(sf::RenderTarget& target, ObjectsList& objectList) {
+		DrawLinks(target, objectList.connectedObjects);
+		if (drawGrid) {
+			DrawGridCells(target, objectList.GetGrid());
+		}
+		lodRenderer.Draw(target, objectList.objList, [&](BaseShape* obj) { DrawShape(target, obj); });
+	}
+};
@@ -0,0 +1 @@
+#include "LoadGenerator.h"
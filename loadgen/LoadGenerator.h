@@ -0,0 +1,728 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include "../PhysicSSimulator/HandleNetworkingClient.h"
+#include "../PhysicSSimulator/Snapshot.h"
+#include "../PhysicSSimulator/DeltaSnapshot.h"
+#include "../PhysicSSimulator/CommandProtocol.h"
+#include "../PhysicSSimulator/TickScheduler.h"
+#include "../PhysicSSimulator/SharedSnapshot.h"
+#include "../PhysicSSimulator/DragPrediction.h"
+
+// Headless clients for sizing a server: many connections that act like players (spawn, explode, drag, link) and
+// decode every snapshot like the real client does, without a window. Each client measures what it gets, the
+// totals are printed every few seconds and per client at the end. Observers read the rooms' snapshots from
+// shared memory instead (server --shm), like a visualiser on the server's machine.
+
+struct LoadSettings
+{
+	std::string host = "127.0.0.1";
+	unsigned short tcpPort = 8080;
+	unsigned short udpPort = 8081;
+	int clients = 50;
+	int threads = 2;              // io threads, each client stays on one of them
+	std::uint32_t rooms = 1;      // Clients go round robin into rooms 0 .. rooms - 1
+	float seconds = 60;           // How long the run is
+	float reportSeconds = 5;
+	float connectSeconds = 2;     // The clients connect spread over this long, not all at once
+	float actionsPerSecond = 0.5; // Per client, besides the drags
+	float serverTickRate = 60;    // For the jitter, must match the server's TickSettings::tickRate
+	// How often each action is picked, relative to the others
+	float spawnWeight = 1;
+	float explosionWeight = 1;
+	float dragWeight = 4;
+	float linkWeight = 1;
+	int spawnCount = 10;          // Circles per spawn ("CIR,10")
+	std::size_t maxBodies = 2000; // No more spawns or explosions once a client sees this many bodies
+	float dragSeconds = 1;
+	float dragRate = 30;          // Drag positions per second, like a client's frames
+	bool perClient = true;        // The table at the end
+	unsigned int seed = 1;
+	std::string sharedPrefix = "atomical"; // The server's --shm
+	int observers = 0;            // Shared memory readers, observer i reads room i % rooms
+	float observeRate = 60;       // Reads per second per observer, a visualiser's frames
+	bool compress = true;         // Ask for compressed snapshots, what the server does with it is its --compress
+	float inputRate = 60;         // Coalesced command sends per second, 0 sends each command as it comes
+};
+
+// What one client measured. Written on its io thread, read by the report
+struct LoadStats
+{
+	DurationHistogram decodeTimes;    // Parsing a snapshot and applying it to the baseline
+	DurationHistogram arrivalJitter;  // |time between two snapshots - their tick difference|
+	DurationHistogram snapshotDelay;  // How much later than the fastest snapshot so far a snapshot came, the
+	                                  // one way latency on top of the best case (the clocks are not shared)
+	DurationHistogram inputAcks;      // From sending a drag position until the server acknowledges it, the wait
+	                                  // the prediction hides
+	std::atomic<std::uint64_t> snapshots{ 0 };
+	std::atomic<std::uint64_t> resyncs{ 0 };    // Deltas on a baseline this client did not have
+	std::atomic<std::uint64_t> commands{ 0 };
+	std::atomic<std::uint64_t> bodies{ 0 };     // In the last snapshot
+	std::atomic<std::uint32_t> lastTick{ 0 };
+	std::atomic<std::uint64_t> reconciled{ 0 };  // Predicted drags the server acknowledged and they were compared with
+	std::atomic<std::uint64_t> corrections{ 0 }; // ...and it had the body somewhere else
+};
+
+// Reads the newest snapshot of a room from shared memory every frame, on a thread of its own. Every record is
+// decoded, what a renderer would have to do too
+class SharedObserver
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Stats
+	{
+		DurationHistogram readTimes; // Finding the newest slot, decoding all of it and checking it was not written over
+		std::atomic<std::uint64_t> reads{ 0 };
+		std::atomic<std::uint64_t> snapshots{ 0 }; // New ones
+		std::atomic<std::uint64_t> skipped{ 0 };   // Published between two reads, never seen
+		std::atomic<std::uint64_t> torn{ 0 };      // Written over while being read
+		std::atomic<std::size_t> bodies{ 0 };
+		std::atomic<std::uint32_t> lastTick{ 0 };
+	};
+
+private:
+	std::string segment;
+	float rate;
+	std::atomic<bool> running{ false };
+	std::thread thread;
+	Stats stats;
+	float checksum = 0; // So the decode is not optimized away
+
+	void Run() {
+		SharedSnapshotReader reader;
+		std::uint64_t lastPublication = 0;
+		Clock::time_point next = Clock::now();
+		auto frame = std::chrono::microseconds(static_cast<long long>(1e6 / std::max(1.0f, rate)));
+		while (running) {
+			next += frame;
+			if (!reader.IsOpen() && !reader.Open(segment)) {
+				std::this_thread::sleep_until(next);
+				continue;
+			}
+			Clock::time_point start = Clock::now();
+			std::uint64_t before = lastPublication;
+			std::uint64_t torn = 0;
+			bool fresh = reader.ReadLatest(lastPublication, [this](const SnapshotReader& snapshot, const SharedSnapshotReader::View& view) {
+				float sum = 0;
+				for (std::uint32_t i = 0; i < snapshot.GetBodyCount(); i++) {
+					BodyRecord body = snapshot.GetBody(i);
+					sum += body.position.x + body.position.y;
+				}
+				checksum += sum;
+				stats.bodies = snapshot.GetBodyCount();
+				stats.lastTick = view.tick;
+				}, &torn);
+			stats.readTimes.Record(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+			stats.reads++;
+			stats.torn += torn;
+			if (fresh) {
+				stats.snapshots++;
+				if (before != 0 && lastPublication > before + 1) {
+					stats.skipped += lastPublication - before - 1;
+				}
+			}
+			std::this_thread::sleep_until(next);
+		}
+	}
+
+public:
+	SharedObserver(std::string segment, float rate) : segment(std::move(segment)), rate(rate) {}
+
+	~SharedObserver() { Stop(); }
+
+	void Start() {
+		running = true;
+		thread = std::thread([this]() { Run(); });
+	}
+
+	void Stop() {
+		running = false;
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+
+	const Stats& GetStats() const { return stats; }
+	const std::string& Segment() const { return segment; }
+};
+
+class LoadClient : public HandleNetworkingClient {
+private:
+	using Clock = std::chrono::steady_clock;
+
+	int index;
+	const LoadSettings& settings;
+	LoadStats stats;
+	boost::asio::steady_timer timer;
+	std::mt19937 rnd;
+
+	// The same decoding as the real client (Client.h), without the proxies
+	SnapshotHistory receivedSnapshots = SnapshotHistory(32);
+	SnapshotState decodedSnapshot;
+	SnapshotState fullSnapshot;
+	Quantizer snapshotQuantizer;
+	bool waitingForFullSnapshot = false;
+	const SnapshotState* latest = nullptr;
+
+	bool hasArrival = false;
+	std::uint32_t arrivalTick = 0;
+	Clock::time_point arrivalTime;
+	double fastestOffset = 0; // Smallest arrival time - tick time so far, in seconds
+
+	Clock::time_point nextAction;
+	Clock::time_point dragEnd;
+	std::uint32_t dragBody = 0;
+	sf::Vector2f dragCenter;
+	float dragAngle = 0;
+	bool dragging = false;
+
+	// Predicted like the real client does, without anything to draw
+	DragPrediction prediction;
+	std::deque<std::pair<std::uint32_t, Clock::time_point>> sentInputs; // Sequence and when, until acknowledged
+	std::vector<BaseShape*> noObjects;
+
+public:
+	LoadClient(boost::asio::io_context& io_context, const LoadSettings& settings, int index)
+		: HandleNetworkingClient(io_context, settings.host, settings.tcpPort, settings.udpPort, index % std::max<std::uint32_t>(1, settings.rooms)),
+		index(index),
+		settings(settings),
+		timer(io_context),
+		rnd(settings.seed * 7919u + static_cast<unsigned int>(index))
+	{
+		set_snapshot_compression(settings.compress);
+		set_input_rate(settings.inputRate);
+	}
+
+	int Index() const { return index; }
+	const LoadStats& Stats() const { return stats; }
+
+	// On its io thread. Connects after delay, then acts until stopped
+	void Start(std::chrono::milliseconds delay) {
+		timer.expires_after(delay);
+		timer.async_wait([this](const boost::system::error_code& ec) {
+			if (ec) {
+				return;
+			}
+			connect();
+			nextAction = Clock::now() + RandomDelay();
+			Act();
+			});
+	}
+
+	// On its io thread
+	void Stop() {
+		timer.cancel();
+		disconnect_from_server();
+	}
+
+protected:
+	void TranslateSnapshot(const std::uint8_t* payload, std::size_t size) override {
+		Clock::time_point start = Clock::now();
+		SnapshotReader reader;
+		if (!reader.Parse(payload, size)) {
+			return;
+		}
+		fullSnapshot.tick = reader.GetTick();
+		fullSnapshot.bodies.clear();
+		for (std::uint32_t i = 0; i < reader.GetBodyCount(); i++) {
+			fullSnapshot.bodies.push_back(reader.GetBody(i));
+		}
+		Decoded(fullSnapshot.tick, fullSnapshot.bodies.size(), start);
+	}
+
+	void TranslateDeltaSnapshot(const std::uint8_t* payload, std::size_t size) override {
+		Clock::time_point start = Clock::now();
+		DeltaSnapshotReader reader;
+		if (!reader.ParseHeader(payload, size)) {
+			return;
+		}
+		const SnapshotState* baseline = nullptr;
+		if (reader.HasBaseline()) {
+			if (waitingForFullSnapshot) {
+				return;
+			}
+			baseline = receivedSnapshots.Find(reader.GetBaselineTick());
+			if (baseline == nullptr) {
+				Resync();
+				return;
+			}
+		}
+		if (!reader.Apply(baseline, decodedSnapshot, &snapshotQuantizer)) {
+			Resync();
+			return;
+		}
+		waitingForFullSnapshot = false;
+		SnapshotState& received = receivedSnapshots.Push();
+		std::swap(received, decodedSnapshot);
+		latest = &received;
+		send_tcp_message("ack:" + std::to_string(received.tick));
+		Decoded(received.tick, received.bodies.size(), start);
+		Reconcile();
+	}
+
+	void TranslateInputAck(std::uint32_t sequence, std::uint32_t tick) override {
+		Clock::time_point now = Clock::now();
+		bool acked = false;
+		Clock::time_point sent;
+		while (!sentInputs.empty() && sentInputs.front().first <= sequence) {
+			acked = true;
+			sent = sentInputs.front().second;
+			sentInputs.pop_front();
+		}
+		if (acked) {
+			stats.inputAcks.Record(std::chrono::duration<double, std::micro>(now - sent).count());
+		}
+		prediction.OnAck(sequence, tick);
+		Reconcile();
+	}
+
+private:
+	void Resync() {
+		waitingForFullSnapshot = true;
+		stats.resyncs++;
+		send_tcp_message("resync");
+	}
+
+	void Decoded(std::uint32_t tick, std::size_t bodyCount, Clock::time_point start) {
+		Clock::time_point now = Clock::now();
+		stats.decodeTimes.Record(std::chrono::duration<double, std::micro>(now - start).count());
+		stats.snapshots++;
+		stats.bodies = bodyCount;
+		stats.lastTick = tick;
+
+		double tickSeconds = tick / settings.serverTickRate;
+		double offset = std::chrono::duration<double>(now.time_since_epoch()).count() - tickSeconds;
+		if (!hasArrival || tick < arrivalTick) {
+			fastestOffset = offset; // First snapshot, or the server started over
+		}
+		else if (tick > arrivalTick) {
+			double expected = (tick - arrivalTick) / settings.serverTickRate;
+			double actual = std::chrono::duration<double>(now - arrivalTime).count();
+			stats.arrivalJitter.Record(std::abs(actual - expected) * 1e6);
+		}
+		fastestOffset = std::min(fastestOffset, offset);
+		stats.snapshotDelay.Record((offset - fastestOffset) * 1e6);
+		hasArrival = true;
+		arrivalTick = tick;
+		arrivalTime = now;
+	}
+
+	std::chrono::milliseconds RandomDelay() {
+		std::exponential_distribution<double> wait(std::max(0.001f, settings.actionsPerSecond));
+		return std::chrono::milliseconds(static_cast<long long>(wait(rnd) * 1000));
+	}
+
+	// A random body of the last snapshot, false before there is one
+	bool PickBody(BodyRecord& body) {
+		if (!latest || latest->bodies.empty()) {
+			return false;
+		}
+		std::uniform_int_distribution<std::size_t> pick(0, latest->bodies.size() - 1);
+		body = latest->bodies[pick(rnd)];
+		return true;
+	}
+
+	std::uint32_t Send(const Command& command, bool reliable = false) {
+		stats.commands++;
+		return send_command(command, reliable);
+	}
+
+	void Reconcile() {
+		if (!latest) {
+			return;
+		}
+		prediction.Reconcile(receivedSnapshots, latest->tick);
+		prediction.Apply(noObjects, latest->tick, std::chrono::duration<double>(Clock::now().time_since_epoch()).count());
+		stats.reconciled = prediction.Reconciled();
+		stats.corrections = prediction.Corrections();
+	}
+
+	// Runs at the drag rate: the current drag, and a new action when it is time for one
+	void Act() {
+		Clock::time_point now = Clock::now();
+		if (now < dragEnd) {
+			dragAngle += 6.2831853f / (settings.dragSeconds * settings.dragRate);
+			Command command;
+			command.op = CommandOp::SetPosition;
+			command.body = dragBody;
+			command.position = dragCenter + sf::Vector2f(std::cos(dragAngle), std::sin(dragAngle)) * 60.0f;
+			std::uint32_t sequence = Send(command);
+			if (sequence != 0) {
+				sentInputs.emplace_back(sequence, now);
+				if (sentInputs.size() > prediction.GetSettings().maxPending) {
+					sentInputs.pop_front();
+				}
+			}
+			prediction.Predict(dragBody, command.position, sequence, std::chrono::duration<double>(now.time_since_epoch()).count());
+			dragging = true;
+		}
+		else if (dragging) {
+			prediction.Release(dragBody);
+			dragging = false;
+		}
+		else if (now >= nextAction) {
+			Pick();
+			nextAction = now + RandomDelay();
+		}
+
+		timer.expires_after(std::chrono::microseconds(static_cast<long long>(1e6 / std::max(1.0f, settings.dragRate))));
+		timer.async_wait([this](const boost::system::error_code& ec) {
+			if (!ec) {
+				Act();
+			}
+			});
+	}
+
+	void Pick() {
+		float total = settings.spawnWeight + settings.explosionWeight + settings.dragWeight + settings.linkWeight;
+		float roll = std::uniform_real_distribution<float>(0, std::max(0.001f, total))(rnd);
+		bool crowded = stats.bodies.load() >= settings.maxBodies;
+		Command command;
+		if ((roll -= settings.spawnWeight) < 0) {
+			if (!crowded) {
+				command.op = CommandOp::SpawnCircles; // "CIR,10"
+				command.value = settings.spawnCount;
+				Send(command);
+			}
+			return;
+		}
+		if ((roll -= settings.explosionWeight) < 0) {
+			if (!crowded) {
+				command.op = CommandOp::Explosion;
+				command.value = static_cast<std::int32_t>(rnd() % 2 == 0 ? ExplosionShape::Circle : ExplosionShape::Rectangle);
+				command.position = sf::Vector2f(std::uniform_real_distribution<float>(100, 1820)(rnd), std::uniform_real_distribution<float>(100, 980)(rnd));
+				Send(command);
+			}
+			return;
+		}
+		BodyRecord body;
+		if ((roll -= settings.dragWeight) < 0) {
+			if (PickBody(body)) { // "NEWP" every frame while the mouse holds it
+				dragBody = body.id;
+				dragCenter = body.position;
+				dragAngle = 0;
+				dragEnd = Clock::now() + std::chrono::milliseconds(static_cast<long long>(settings.dragSeconds * 1000));
+			}
+			return;
+		}
+		BodyRecord other;
+		if (PickBody(body) && PickBody(other) && body.id != other.id) {
+			command.op = CommandOp::Link;
+			command.body = body.id;
+			command.otherBody = other.id;
+			Send(command, true);
+		}
+	}
+};
+
+// The clients on a few io threads, and the reports
+class LoadGenerator {
+private:
+	using Clock = std::chrono::steady_clock;
+
+	LoadSettings settings;
+	std::vector<std::unique_ptr<boost::asio::io_context>> contexts;
+	std::vector<std::unique_ptr<LoadClient>> clients;
+	std::vector<std::unique_ptr<SharedObserver>> observers;
+
+	struct Totals
+	{
+		std::uint64_t snapshots = 0;
+		std::uint64_t bytes = 0;
+		std::uint64_t commands = 0;
+		std::uint64_t resyncs = 0;
+		int receiving = 0;
+		std::uint64_t observed = 0; // New snapshots the observers read
+		std::uint64_t compressed = 0;
+		std::uint64_t decompressNanoseconds = 0;
+		std::uint64_t datagrams = 0;  // Of commands
+		std::uint64_t coalesced = 0;
+		std::uint64_t reconciled = 0;
+		std::uint64_t corrections = 0;
+	};
+
+	Totals Sum() const {
+		Totals totals;
+		for (const std::unique_ptr<LoadClient>& client : clients) {
+			const LoadStats& stats = client->Stats();
+			totals.snapshots += stats.snapshots;
+			totals.bytes += client->get_received_bytes();
+			totals.commands += stats.commands;
+			totals.resyncs += stats.resyncs;
+			totals.receiving += stats.snapshots > 0 ? 1 : 0;
+			totals.compressed += client->get_compressed_frames();
+			totals.decompressNanoseconds += client->get_decompress_nanoseconds();
+			totals.datagrams += client->get_input_datagrams();
+			totals.coalesced += client->get_coalesced_commands();
+			totals.reconciled += stats.reconciled;
+			totals.corrections += stats.corrections;
+		}
+		for (const std::unique_ptr<SharedObserver>& observer : observers) {
+			totals.observed += observer->GetStats().snapshots;
+		}
+		return totals;
+	}
+
+	static void PrintHistogram(std::ostream& out, const char* name, const DurationHistogram& histogram) {
+		// The percentile is the bound of its bucket, it can be above the largest one there was
+		double p99 = std::min(histogram.PercentileMicros(0.99), histogram.MaxMicros());
+		out << " " << name << " " << histogram.MeanMicros() / 1000 << "/" << p99 / 1000
+			<< "/" << histogram.MaxMicros() / 1000;
+	}
+
+public:
+	LoadGenerator(const LoadSettings& loadSettings) : settings(loadSettings) {
+		settings.threads = std::max(1, settings.threads);
+		for (int i = 0; i < settings.threads; i++) {
+			contexts.push_back(std::make_unique<boost::asio::io_context>());
+		}
+		for (int i = 0; i < settings.clients; i++) {
+			clients.push_back(std::make_unique<LoadClient>(*contexts[i % settings.threads], settings, i));
+		}
+		for (int i = 0; i < settings.observers; i++) {
+			std::uint32_t room = static_cast<std::uint32_t>(i) % std::max<std::uint32_t>(1, settings.rooms);
+			observers.push_back(std::make_unique<SharedObserver>(settings.sharedPrefix + "-room" + std::to_string(room), settings.observeRate));
+		}
+	}
+
+	void Run() {
+		std::cout << "Load: " << settings.clients << " clients on " << settings.threads << " threads against " << settings.host << ":"
+			<< settings.tcpPort << " in " << settings.rooms << " rooms for " << settings.seconds << " s";
+		if (!observers.empty()) {
+			std::cout << ", " << observers.size() << " shared memory observers at " << settings.observeRate << " Hz";
+		}
+		std::cout << std::endl;
+		for (std::unique_ptr<SharedObserver>& observer : observers) {
+			observer->Start();
+		}
+		for (std::size_t i = 0; i < clients.size(); i++) {
+			auto delay = std::chrono::milliseconds(static_cast<long long>(settings.connectSeconds * 1000 * i / std::max<std::size_t>(1, clients.size())));
+			LoadClient* client = clients[i].get();
+			boost::asio::post(*contexts[i % contexts.size()], [client, delay]() { client->Start(delay); });
+		}
+
+		std::vector<std::thread> threads;
+		std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work;
+		for (std::unique_ptr<boost::asio::io_context>& context : contexts) {
+			work.push_back(boost::asio::make_work_guard(*context));
+			boost::asio::io_context* io = context.get();
+			threads.emplace_back([io]() {
+				try {
+					io->run();
+				}
+				catch (const std::exception& e) {
+					std::cerr << "Exception in load thread: " << e.what() << std::endl;
+				}
+				});
+		}
+
+		Clock::time_point start = Clock::now();
+		Clock::time_point end = start + std::chrono::milliseconds(static_cast<long long>(settings.seconds * 1000));
+		Totals last;
+		Clock::time_point lastReport = start;
+		while (Clock::now() < end) {
+			std::this_thread::sleep_until(std::min(end, lastReport + std::chrono::milliseconds(static_cast<long long>(settings.reportSeconds * 1000))));
+			Clock::time_point now = Clock::now();
+			Totals totals = Sum();
+			Report(std::cout, totals, last, std::chrono::duration<double>(now - lastReport).count(), std::chrono::duration<double>(now - start).count());
+			last = totals;
+			lastReport = now;
+		}
+
+		for (std::size_t i = 0; i < clients.size(); i++) {
+			LoadClient* client = clients[i].get();
+			boost::asio::post(*contexts[i % contexts.size()], [client]() { client->Stop(); });
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		for (std::unique_ptr<boost::asio::io_context>& context : contexts) {
+			context->stop();
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		for (std::unique_ptr<SharedObserver>& observer : observers) {
+			observer->Stop();
+		}
+		Summary(std::cout, std::chrono::duration<double>(Clock::now() - start).count());
+	}
+
+private:
+	// One line for the last interval
+	void Report(std::ostream& out, const Totals& totals, const Totals& last, double interval, double elapsed) {
+		interval = std::max(interval, 0.001);
+		DurationHistogram decode, jitter, delay;
+		for (const std::unique_ptr<LoadClient>& client : clients) {
+			decode.Merge(client->Stats().decodeTimes);
+			jitter.Merge(client->Stats().arrivalJitter);
+			delay.Merge(client->Stats().snapshotDelay);
+		}
+		out << std::fixed << std::setprecision(2) << "[" << elapsed << " s] " << totals.receiving << "/" << clients.size() << " receiving, "
+			<< (totals.snapshots - last.snapshots) / interval << " snapshots/s, " << (totals.bytes - last.bytes) / interval / 1024
+			<< " KiB/s, " << (totals.commands - last.commands) / interval << " commands/s, " << totals.resyncs << " resyncs; ms mean/p99/max:";
+		PrintHistogram(out, "decode", decode);
+		PrintHistogram(out, "jitter", jitter);
+		PrintHistogram(out, "delay", delay);
+		if (!observers.empty()) {
+			DurationHistogram read;
+			std::uint64_t torn = 0;
+			for (const std::unique_ptr<SharedObserver>& observer : observers) {
+				read.Merge(observer->GetStats().readTimes);
+				torn += observer->GetStats().torn;
+			}
+			out << " | shm " << (totals.observed - last.observed) / interval << " snapshots/s, " << torn << " torn;";
+			PrintHistogram(out, "read", read);
+		}
+		out << std::endl;
+		out.unsetf(std::ios::floatfield);
+	}
+
+	void Summary(std::ostream& out, double elapsed) {
+		elapsed = std::max(elapsed, 0.001);
+		out << std::fixed << std::setprecision(2);
+		if (settings.perClient) {
+			out << "client room snapshots KiB/s bodies tick resyncs commands | ms mean/p99/max:" << std::endl;
+			for (const std::unique_ptr<LoadClient>& client : clients) {
+				const LoadStats& stats = client->Stats();
+				out << std::setw(6) << client->Index() << std::setw(5) << client->Index() % std::max<std::uint32_t>(1, settings.rooms)
+					<< std::setw(10) << stats.snapshots << std::setw(9) << client->get_received_bytes() / elapsed / 1024
+					<< std::setw(7) << stats.bodies << std::setw(8) << stats.lastTick << std::setw(8) << stats.resyncs
+					<< std::setw(9) << stats.commands << " |";
+				PrintHistogram(out, "decode", stats.decodeTimes);
+				PrintHistogram(out, "jitter", stats.arrivalJitter);
+				PrintHistogram(out, "delay", stats.snapshotDelay);
+				out << std::endl;
+			}
+		}
+		Totals totals = Sum();
+		out << "Total: " << totals.snapshots << " snapshots (" << totals.snapshots / elapsed << "/s), " << totals.bytes / elapsed / 1024
+			<< " KiB/s received, " << totals.commands << " commands, " << totals.resyncs << " resyncs, " << totals.receiving << "/"
+			<< clients.size() << " clients got snapshots" << std::endl;
+		out << "Input: " << totals.datagrams << " command datagrams (" << totals.datagrams / elapsed << "/s), " << totals.coalesced
+			<< " commands coalesced, " << totals.reconciled << " predicted drags reconciled, " << totals.corrections << " corrected" << std::endl;
+		if (totals.compressed > 0) {
+			out << "Compressed: " << totals.compressed << " frames, " << totals.decompressNanoseconds / 1000.0 / totals.compressed
+				<< " us each to decompress" << std::endl;
+		}
+		DurationHistogram decode, jitter, delay, inputAcks;
+		for (const std::unique_ptr<LoadClient>& client : clients) {
+			decode.Merge(client->Stats().decodeTimes);
+			jitter.Merge(client->Stats().arrivalJitter);
+			delay.Merge(client->Stats().snapshotDelay);
+			inputAcks.Merge(client->Stats().inputAcks);
+		}
+		out.unsetf(std::ios::floatfield);
+		decode.Print(out, "Decode");
+		jitter.Print(out, "Tick jitter");
+		delay.Print(out, "Snapshot delay");
+		inputAcks.Print(out, "Input to ack");
+
+		if (observers.empty()) {
+			return;
+		}
+		out << std::fixed << std::setprecision(2);
+		out << "observer segment reads snapshots skipped torn bodies tick | ms mean/p99/max:" << std::endl;
+		DurationHistogram read;
+		for (std::size_t i = 0; i < observers.size(); i++) {
+			const SharedObserver::Stats& stats = observers[i]->GetStats();
+			out << std::setw(8) << i << " " << observers[i]->Segment() << std::setw(8) << stats.reads << std::setw(10) << stats.snapshots
+				<< std::setw(8) << stats.skipped << std::setw(5) << stats.torn << std::setw(7) << stats.bodies << std::setw(8) << stats.lastTick << " |";
+			PrintHistogram(out, "read", stats.readTimes);
+			out << std::endl;
+			read.Merge(stats.readTimes);
+		}
+		out.unsetf(std::ios::floatfield);
+		read.Print(out, "Shared memory read");
+	}
+};
+
+// loadgen [--host <ip>] [--tcp <port>] [--udp <port>] [--clients <n>] [--threads <n>] [--rooms <n>] [--seconds <s>]
+//         [--report <s>] [--actions <per second>] [--spawn <n>] [--max-bodies <n>] [--tick-rate <hz>] [--seed <n>]
+//         [--weights <spawn>,<explosion>,<drag>,<link>] [--totals-only]
+//         [--observers <n>] [--shm <prefix>] [--observe-rate <hz>]    (--clients 0 for observers only)
+//         [--compress on|off] [--input-rate <hz>] [--drag-rate <hz>]    (--input-rate 0 sends every command at once)
+inline bool ParseLoadSettings(int argc, char* argv[], LoadSettings& settings) {
+	for (int i = 1; i < argc; i++) {
+		std::string_view option = argv[i];
+		if (option == "--totals-only") {
+			settings.perClient = false;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << option << std::endl;
+			return false;
+		}
+		std::string_view value = argv[++i];
+		bool ok = false;
+		if (option == "--host") {
+			settings.host = std::string(value);
+			ok = true;
+		}
+		else if (option == "--tcp") ok = CommandText::Number(value, settings.tcpPort);
+		else if (option == "--udp") ok = CommandText::Number(value, settings.udpPort);
+		else if (option == "--clients") ok = CommandText::Number(value, settings.clients);
+		else if (option == "--threads") ok = CommandText::Number(value, settings.threads);
+		else if (option == "--rooms") ok = CommandText::Number(value, settings.rooms);
+		else if (option == "--seconds") ok = CommandText::Number(value, settings.seconds);
+		else if (option == "--report") ok = CommandText::Number(value, settings.reportSeconds);
+		else if (option == "--actions") ok = CommandText::Number(value, settings.actionsPerSecond);
+		else if (option == "--spawn") ok = CommandText::Number(value, settings.spawnCount);
+		else if (option == "--max-bodies") ok = CommandText::Number(value, settings.maxBodies);
+		else if (option == "--tick-rate") ok = CommandText::Number(value, settings.serverTickRate);
+		else if (option == "--seed") ok = CommandText::Number(value, settings.seed);
+		else if (option == "--observers") ok = CommandText::Number(value, settings.observers);
+		else if (option == "--observe-rate") ok = CommandText::Number(value, settings.observeRate);
+		else if (option == "--input-rate") ok = CommandText::Number(value, settings.inputRate);
+		else if (option == "--drag-rate") ok = CommandText::Number(value, settings.dragRate) && settings.dragRate > 0;
+		else if (option == "--compress") {
+			ok = value == "on" || value == "off";
+			settings.compress = value == "on";
+		}
+		else if (option == "--shm") {
+			settings.sharedPrefix = std::string(value);
+			ok = !settings.sharedPrefix.empty();
+		}
+		else if (option == "--weights") {
+			std::string_view rest = value;
+			ok = CommandText::Number(CommandText::Next(rest, ','), settings.spawnWeight) &&
+				CommandText::Number(CommandText::Next(rest, ','), settings.explosionWeight) &&
+				CommandText::Number(CommandText::Next(rest, ','), settings.dragWeight) &&
+				CommandText::Number(rest, settings.linkWeight);
+		}
+		if (!ok) {
+			std::cerr << "Bad option " << option << " " << value << std::endl;
+			return false;
+		}
+	}
+	settings.reportSeconds = std::max(0.1f, settings.reportSeconds);
+	settings.serverTickRate = std::max(1.0f, settings.serverTickRate);
+	return settings.clients >= 0 && settings.observers >= 0 && settings.clients + settings.observers > 0;
+}
+
+int main(int argc, char* argv[]) {
+	try {
+		LoadSettings settings;
+		if (!ParseLoadSettings(argc, argv, settings)) {
+			return 1;
+		}
+		LoadGenerator generator(settings);
+		generator.Run();
+	}
+	catch (const std::exception& error) {
+		std::cerr << "Exception in main: " << error.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,321 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../PhysicSSimulator/BaseShape.h"
+#include "../PhysicSSimulator/Circle.h"
+#include "../PhysicSSimulator/ObjectsList.h"
+#include "../PhysicSSimulator/CommandProtocol.h"
+#include "../PhysicSSimulator/Journal.h"
+
+// The server has no window, the world size is fixed instead of being the desktop size
+struct eptions {
+	int window_height = 1080;
+	int window_width = 1920;
+	bool fullscreen = false;
+	float gravity = 0;
+	double massLock = 0;
+};
+
+eptions poptions;
+
+// The world of one room and what the commands do to it, without any networking. A server room is one (Room in
+// Server.h), a journal replay runs another
+class RoomSimulation {
+protected:
+#pragma region EssantialVariables
+	int window_height = poptions.window_height;
+	int window_width = poptions.window_width;
+	float gravity = 0;
+	double massLock = 0;
+
+	std::string screen = "START";
+
+	bool hovering = false;
+	bool connectingMode = false;
+	bool planetMode = false;
+	bool enableCollison = false;
+	bool borderless = true;
+
+	// Physics and simulation parameters
+	float lineLength = 150;
+	ObjectsList objectList;
+	float deltaTime = 1.0f / 60.0f;
+	float elastic = 0.0;
+	int objCount = 0;
+	float radius = 50;
+
+	// Visual settings
+	SimColor ball_color = SimColor(238, 238, 238);
+	SimColor ball_color2 = SimColor(50, 5, 11);
+	SimColor explosion = SimColor(205, 92, 8);
+	SimColor outlineColor = SimColor(255, 255, 255);
+	SimColor previousColor = SimColor(0, 0, 0);
+
+	// Gradient settings
+	short int gradientStep = 0;
+	short int gradientStepMax = 400;
+	std::vector<SimColor> gradient;
+
+	// Object templates
+	Circle* copyObjCir;
+	RectangleClass* copyObjRec;
+
+	// Spawn settings
+	float posYStartingPoint = 200;
+	int posXStartingPoint = radius;
+	short int startingPointAdder = 31;
+	sf::Vector2f spawnStartingPoint;
+	sf::Vector2f initialVel = sf::Vector2f(4, 0);
+
+	std::mutex objectListMutex;
+#pragma endregion
+
+public:
+	RoomSimulation()
+		: objectList(lineLength),
+		spawnStartingPoint(posXStartingPoint, posYStartingPoint)
+	{
+		setupGradient();
+	}
+
+	const std::vector<BaseShape*>& Shapes() const { return objectList.objList; }
+
+	// One tick of physics: the same simulated time (1 / tickRate) however many steps it is cut into
+	void Step(int substeps, float tickRate) {
+		float stepRate = tickRate * substeps;
+		objectList.ResetContactCount();
+		for (int step = 0; step < substeps; step++) {
+			objectList.MoveObjects(window_width, window_height, stepRate,
+				elastic, planetMode, enableCollison, borderless);
+		}
+	}
+
+	// What a journal of this simulation starts with
+	JournalScene Scene(std::uint32_t room, float tickRate, int substeps) {
+		JournalScene scene;
+		scene.room = room;
+		scene.tickRate = tickRate;
+		scene.substeps = static_cast<std::uint32_t>(substeps);
+		scene.objectSeed = objectList.GetSeed();
+		scene.linkSeed = objectList.connectedObjects.GetSeed();
+		scene.width = window_width;
+		scene.height = window_height;
+		scene.gravity = poptions.gravity;
+		scene.elastic = elastic;
+		scene.lineLength = lineLength;
+		scene.collision = enableCollison;
+		scene.borderless = borderless;
+		return scene;
+	}
+
+	// Starts an empty world the way the journal's did. Sets poptions too, which all the rooms share: only for a
+	// process that replays
+	void ApplyScene(const JournalScene& scene) {
+		poptions.window_width = scene.width;
+		poptions.window_height = scene.height;
+		poptions.gravity = scene.gravity;
+		window_width = scene.width;
+		window_height = scene.height;
+		elastic = scene.elastic;
+		enableCollison = scene.collision;
+		borderless = scene.borderless;
+		objectList.Seed(scene.objectSeed);
+		objectList.connectedObjects.Seed(scene.linkSeed);
+	}
+
+	// Splits a string by a delimiter
+	static std::vector<std::string> SplitString(const std::string& str, char delimiter) {
+		std::vector<std::string> tokens;
+		std::string token;
+		std::istringstream tokenStream(str);
+		while (std::getline(tokenStream, token, delimiter)) {
+			tokens.push_back(token);
+		}
+		return tokens;
+	}
+
+	sf::Vector2f StringToVector2f(std::string str) {
+		str = str.substr(1, str.length() - 2);
+		auto splitedStr = SplitString(str, ',');
+		return sf::Vector2f(std::stof(splitedStr[0]), std::stof(splitedStr[1]));
+	}
+
+	sf::Vector2i StringToVector2i(std::string str) {
+		str = str.substr(1, str.length() - 2);
+		auto splitedStr = SplitString(str, ',');
+		return sf::Vector2i(std::stoi(splitedStr[0]), std::stoi(splitedStr[1]));
+	}
+
+	std::vector<SimColor> GenerateGradient(SimColor startColor, SimColor endColor, int steps) {
+		std::vector<SimColor> newGradient;
+		float stepR = (endColor.r - startColor.r) / static_cast<float>(steps - 1);
+		float stepG = (endColor.g - startColor.g) / static_cast<float>(steps - 1);
+		float stepB = (endColor.b - startColor.b) / static_cast<float>(steps - 1);
+
+		for (int i = 0; i < steps; ++i) {
+			newGradient.push_back(SimColor(
+				startColor.r + stepR * i,
+				startColor.g + stepG * i,
+				startColor.b + stepB * i
+			));
+		}
+		return newGradient;
+	}
+
+	void setupGradient() {
+		SimColor startColor(128, 0, 128);  // purple
+		SimColor endColor(0, 0, 255);      // blue
+		gradient = GenerateGradient(startColor, endColor, gradientStepMax);
+	}
+
+	// One command, binary or text, already decoded on the io thread (see CommandProtocol.h for both formats)
+	void TranslateEvent(const Command& command) {
+		switch (command.op) {
+		case CommandOp::SpawnCircles:
+			SpawnCircles(command.value);
+			break;
+		case CommandOp::SpawnRectangles:
+			SpawnRectangles(command.value);
+			break;
+		case CommandOp::SpawnPlanet:
+			createPlanet(command.position);
+			break;
+		case CommandOp::Explosion:
+			SpawnExplosion(static_cast<ExplosionShape>(command.value), command.position);
+			break;
+		case CommandOp::LinkRandom:
+			objCount += 1;
+			objectList.connectedObjects.ConnectRandom(10, 1);
+			break;
+		case CommandOp::Link: {
+			BaseShape* obj = objectList.FindByID(static_cast<int>(command.body));
+			BaseShape* obj2 = objectList.FindByID(static_cast<int>(command.otherBody));
+			if (obj && obj2 && obj != obj2) { // Ids off the network, gone already or never there
+				objectList.connectObjects(obj, obj2, 1);
+			}
+			break;
+		}
+		case CommandOp::Delete: {
+			BaseShape* obj = objectList.FindByID(static_cast<int>(command.body));
+			objectList.DeleteThisObj(obj);
+			break;
+		}
+		case CommandOp::SetPosition: {
+			BaseShape* objPointer = objectList.FindByID(static_cast<int>(command.body));
+			if (objPointer != nullptr)
+			{
+				objPointer->SetPosition(command.position);
+			}
+			break;
+		}
+		case CommandOp::Scale:
+			handleScaling(objectList.FindByID(static_cast<int>(command.body)), command.value, command.direction);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void SpawnCircles(int num) {
+		for (int i = 0; i < num; i++)
+		{
+			BaseShape* newObject = objectList.CreateNewCircle(poptions.gravity, gradient[gradientStep], spawnStartingPoint, initialVel);
+			objCount += 1;
+			gradientStep += 1;
+			spawnStartingPoint.x += startingPointAdder;
+			if (gradientStep == gradientStepMax) {
+				std::reverse(gradient.begin(), gradient.end());
+				gradientStep = 0;
+			}
+			if (spawnStartingPoint.x >= poptions.window_width - radius || spawnStartingPoint.x <= radius)
+			{
+				startingPointAdder *= -1;
+			}
+			objectList.connectedObjects.AddObject(newObject);
+		}
+	}
+
+	void SpawnRectangles(int num) {
+		for (int i = 0; i < num; i++)
+		{
+			objectList.CreateNewRectangle(poptions.gravity, gradient[gradientStep], spawnStartingPoint);
+			objCount += 1;
+			gradientStep += 1;
+			spawnStartingPoint.x += startingPointAdder;
+			if (gradientStep == gradientStepMax) {
+				std::reverse(gradient.begin(), gradient.end());
+				gradientStep = 0;
+			}
+			if (spawnStartingPoint.x >= poptions.window_width - radius || spawnStartingPoint.x <= radius)
+			{
+				startingPointAdder *= -1;
+			}
+		}
+	}
+
+	void SpawnExplosion(ExplosionShape shape, sf::Vector2f pos) {
+		if (shape == ExplosionShape::Circle)
+		{
+			objectList.CreateNewCircle(poptions.gravity, explosion, sf::Vector2f(pos.x + 3, pos.y + 3), initialVel);
+			for (size_t i = 0; i < 50; i++)
+			{
+				objectList.CreateNewCircle(poptions.gravity, explosion, pos, initialVel);
+				objCount += 1;
+			}
+		}
+		if (shape == ExplosionShape::Rectangle)
+		{
+			objectList.CreateNewRectangle(poptions.gravity, explosion, sf::Vector2f(pos.x + 3, pos.y + 3));
+			for (size_t i = 0; i < 50; i++)
+			{
+				objectList.CreateNewRectangle(poptions.gravity, explosion, pos);
+				objCount += 1;
+			}
+		}
+	}
+
+	void createPlanet(sf::Vector2f(currentMousePos)) {
+		planetMode = true;
+		objectList.CreateNewPlanet(7000, ball_color, currentMousePos, 20, 5.9722 * pow(10, 15));
+		objCount++;
+	}
+
+	void handleScaling(BaseShape* objPointer, int power, int mouseFlagScroll) {
+		if (mouseFlagScroll == 1 || mouseFlagScroll == -1) {
+			if (Circle* circle = dynamic_cast<Circle*>(objPointer)) {
+				scaleCircle(circle, power, mouseFlagScroll);
+			}
+			else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(objPointer))
+			{
+				scaleRectangle(rectangle, power , mouseFlagScroll);
+			}
+		}
+	}
+
+	void scaleCircle(Circle* circle, int mouseScrollPower, int mouseFlagScroll) {
+		if (mouseFlagScroll ==-1 && circle->GetRadius() > 0.0001) {
+			circle->SetRadiusAndCenter(circle->GetRadius() - mouseScrollPower);
+			circle->SetMass(circle->GetMass() - mouseScrollPower * 10);
+		}
+		else {
+			circle->SetRadiusAndCenter(circle->GetRadius() + mouseScrollPower);
+			circle->SetMass(circle->GetMass() + mouseScrollPower * 10);
+		}
+	}
+
+	void scaleRectangle(RectangleClass* rectangle, int mouseScrollPower, int mouseFlagScroll) {
+		if (mouseFlagScroll==-1 && rectangle->GetHeight() > 0.0001 && rectangle->GetWidth() > 0.0001) {
+			rectangle->SetSizeAndOrigin(rectangle->GetWidth() - mouseScrollPower, rectangle->GetHeight() - mouseScrollPower);
+			rectangle->SetMass(rectangle->GetMass() - mouseScrollPower * 10);
+		}
+		else {
+			rectangle->SetSizeAndOrigin(rectangle->GetWidth() + mouseScrollPower, rectangle->GetHeight() + mouseScrollPower);
+			rectangle->SetMass(rectangle->GetMass() + mouseScrollPower * 10);
+		}
+	}
+};
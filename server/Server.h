@@ -8,146 +8,462 @@
 #include <vector>
 #include <string>
 #include <cstring>
+#include <cstdio>
+#include <cmath>
 #include <sstream>
 #include <set>
+#include <map>
+#include <array>
 #include <functional>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 //#include "../PhysicSSimulator/Options.h"
 //#include "../PhysicSSimulator/Options.cpp"
 #include "../PhysicSSimulator/BaseShape.h"
 #include "../PhysicSSimulator/Circle.h"
 #include "../PhysicSSimulator/Serialization.h"
-#include "../PhysicSSimulator/PhysicsSimulation.h"
+#include "../PhysicSSimulator/Snapshot.h"
+#include "../PhysicSSimulator/DeltaSnapshot.h"
+#include "../PhysicSSimulator/SnapshotDatagram.h"
+#include "../PhysicSSimulator/InterestManagement.h"
+#include "../PhysicSSimulator/CommandQueue.h"
+#include "../PhysicSSimulator/TickScheduler.h"
+#include "../PhysicSSimulator/TickPool.h"
+#include "../PhysicSSimulator/ObjectsList.h"
+#include "../PhysicSSimulator/Telemetry.h"
+#include "../PhysicSSimulator/Journal.h"
+#include "../PhysicSSimulator/SharedSnapshot.h"
+#include "../PhysicSSimulator/SnapshotCompression.h"
+#include "ShardNetwork.h"
+#include "RoomSimulation.h"
 
 
 using boost::asio::ip::tcp;
 using boost::asio::ip::udp;
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
 
-struct eptions {
-	sf::VideoMode desktopSize = sf::VideoMode::getDesktopMode();
-	int window_height = desktopSize.height;
-	int window_width = desktopSize.width;
-	bool fullscreen = false;
-	float gravity = 0;
-	double massLock = 0;
-};
-
-eptions poptions;
-
-int BaseShape::objectCount = 0;
+class Room;
 
 class ServerNetworking {
 public:
 	ServerNetworking(boost::asio::io_context& io_context, unsigned short tcpPort, unsigned short udpPort)
 		: tcpAcceptor(io_context, tcp::endpoint(tcp::v4(), tcpPort)),
-		udpSocket(io_context, udp::endpoint(udp::v4(), udpPort)),
+		udpSocket(boost::asio::make_strand(io_context), udp::endpoint(udp::v4(), udpPort)), // The receive and the sends
 		tcpPort(tcpPort),
 		udpPort(udpPort) {
-		std::cout << "Server started on TCP port " << tcpPort << " and UDP port " << udpPort << std::endl;
+		Log() << "Server started on TCP port " << tcpPort << " and UDP port " << udpPort;
 	}
 
+	virtual ~ServerNetworking() = default;
+
+	// The most a client that asks for it gets (see SnapshotCompression.h), before Start
+	void SetSnapshotCompression(CompressionLevel level) { snapshotCompression = level; }
+	CompressionLevel SnapshotCompression() const { return snapshotCompression; }
+
 	void Start() {
-		AcceptTCPConnection();
+		boost::asio::co_spawn(tcpAcceptor.get_executor(), AcceptTCPConnections(), boost::asio::detached);
 		ReceiveUDP();
 		StartConsoleInput();
 	}
 
 protected:
+	// One client. Its socket was accepted on a strand of its own, so the socket, the write signal and everything
+	// only the two sessions touch run one handler at a time whichever io thread runs them; the io_context can run
+	// on as many threads as there are. Two coroutines on that strand own the socket: the reader parses the messages
+	// in place in its buffer, the writer sends what the other threads queue. Both hold the connection alive
 	class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 	public:
 		tcp::socket& Socket() { return socket_; }
 		const std::string& Address() const { return address_; }
 		unsigned short Port() const { return port_; }
 		int ID() const { return client_id_; }
+		// Last snapshot tick the client said it has, -1 when it has none (it then gets a full snapshot)
+		std::int64_t AckedTick() const { return acked_tick_; }
+		// Where the snapshots go over UDP, port 0 until the client sends "udp:<port>" (it then gets them over TCP)
+		udp::endpoint SnapshotEndpoint() const { return udp::endpoint(remote_address_, udp_port_); }
+		bool HasSnapshotEndpoint() const { return udp_port_ != 0; }
+		// The world rectangle the client draws, false until it sends "view:left,top,width,height,zoom"
+		bool GetView(SimRect& view) {
+			std::lock_guard<std::mutex> lock(view_mutex_);
+			view = view_;
+			return has_view_;
+		}
+		// The room the client joined at the handshake, nullptr before its first message
+		std::shared_ptr<Room> GetRoom() {
+			std::lock_guard<std::mutex> lock(room_mutex_);
+			return room_;
+		}
+		void SetRoom(std::shared_ptr<Room> room) {
+			std::lock_guard<std::mutex> lock(room_mutex_);
+			room_ = std::move(room);
+		}
 
+		// socket's executor is the connection's strand
 		TcpConnection(tcp::socket socket, ServerNetworking& server)
 			: socket_(std::move(socket)),
+			write_signal_(socket_.get_executor()),
 			server_(server),
 			client_id_(++nextID) {
-			address_ = socket_.remote_endpoint().address().to_string();
-			port_ = socket_.remote_endpoint().port();
+			boost::system::error_code ec; // A client that is already gone, the reader finds out
+			tcp::endpoint remote = socket_.remote_endpoint(ec);
+			remote_address_ = remote.address();
+			address_ = remote_address_.to_string();
+			port_ = remote.port();
+			read_buffer_.resize(initial_read_buffer);
 		}
 
 		void start() {
-			std::cout << "Client " << client_id_ << " connected from " << address_ << ":" << port_ << std::endl;
-			read_message();
+			Log() << "Client " << client_id_ << " connected from " << address_ << ":" << port_;
+			boost::asio::co_spawn(socket_.get_executor(), read_session(shared_from_this()), boost::asio::detached);
+			boost::asio::co_spawn(socket_.get_executor(), write_session(shared_from_this()), boost::asio::detached);
 		}
 
+		// Text goes in a NetFrame too so it can share the stream with the binary snapshots
 		void send_message(const std::string& message) {
-			bool write_in_progress = !message_queue_.empty();
-			message_queue_.push_back(message + "\n");
-			if (!write_in_progress) {
-				do_write();
+			send_frame(NetFrame::MakeText(message));
+		}
+
+		// Only the pointer is queued, the same frame can be queued on every connection.
+		// A snapshot that is still waiting in the queue is replaced by the newer one (the client only needs the
+		// newest, a delta does not depend on the deltas before it), text keeps its order. Can be called from any thread
+		void send_frame(SharedFrame frame) {
+			bool start_write = false;
+			bool hopeless = false;
+			std::size_t queued_bytes = 0;
+			{
+				std::lock_guard<std::mutex> lock(queue_mutex_);
+				if (closing_) {
+					return;
+				}
+				if (IsSnapshot(*frame)) {
+					for (std::size_t i = message_queue_.size(); i > in_flight_count_; i--) {
+						if (IsSnapshot(*message_queue_[i - 1])) {
+							queued_bytes_ -= message_queue_[i - 1]->size();
+							message_queue_.erase(message_queue_.begin() + (i - 1));
+							send_stats_.droppedSnapshots++;
+							break;
+						}
+					}
+				}
+				queued_bytes_ += frame->size();
+				message_queue_.push_back(std::move(frame));
+				send_stats_.peakQueuedBytes = std::max(send_stats_.peakQueuedBytes, queued_bytes_);
+
+				// Hopeless: more queued than the limit even after coalescing, or no write finished for too long
+				auto stalled_for = std::chrono::steady_clock::now() - last_write_progress_;
+				hopeless = queued_bytes_ > max_queued_bytes || (write_in_progress_ && stalled_for > max_write_stall);
+				if (hopeless) {
+					closing_ = true;
+					queued_bytes = queued_bytes_;
+				}
+				else if (!write_in_progress_) {
+					write_in_progress_ = true;
+					last_write_progress_ = std::chrono::steady_clock::now(); // The stall is counted from here
+					start_write = true;
+				}
+			}
+
+			auto self(shared_from_this());
+			if (hopeless) {
+				Log() << "Client " << client_id_ << " can not keep up (" << queued_bytes << " bytes queued), disconnecting";
+				boost::asio::post(socket_.get_executor(), [this, self]() { close(); });
+			}
+			else if (start_write) {
+				// The writer is waiting for the signal, it set write_in_progress_ back on the strand right before
+				boost::asio::post(socket_.get_executor(), [this, self]() { write_signal_.cancel(); });
 			}
 		}
 
-		void send_shapes(const std::vector<BaseShape*>& shapes) {
-			std::string serializedShapes = Serialization::SerializeShapes(shapes);
-			send_message(serializedShapes);
+		struct SendStats
+		{
+			std::size_t queuedFrames = 0;
+			std::size_t queuedBytes = 0;
+			std::size_t peakQueuedBytes = 0;
+			std::uint64_t droppedSnapshots = 0; // Replaced by a newer one before they were sent
+			std::uint64_t sentFrames = 0;
+			std::uint64_t sentBytes = 0;
+			std::uint64_t sentDatagramBytes = 0; // Snapshots over UDP
+		};
+
+		// The client answers with the same number, see HandleNetworkingClient::dispatch_frame. Any thread
+		void send_ping() {
+			send_message(PingText::Ping());
+		}
+
+		const RttEstimator& Rtt() const { return rtt_; }
+
+		SendStats GetSendStats() {
+			std::lock_guard<std::mutex> lock(queue_mutex_);
+			SendStats stats = send_stats_;
+			stats.queuedFrames = message_queue_.size();
+			stats.queuedBytes = queued_bytes_;
+			stats.sentDatagramBytes = datagram_bytes_.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		// The room's tick, for the snapshots it sends over UDP
+		void count_datagram_bytes(std::size_t bytes) {
+			datagram_bytes_.fetch_add(bytes, std::memory_order_relaxed);
 		}
 
+		// What the handshake settled on, Off until the client asks
+		CompressionLevel Compression() const { return compression_.load(std::memory_order_relaxed); }
+		// Of the TCP stream only, the room counts the datagrams
+		const CompressionStats& GetCompressionStats() const { return compressor_.Stats(); }
+
 	protected:
-		void read_message() {
-			auto self(shared_from_this());
-			boost::asio::async_read_until(
-				socket_,
-				buffer_,
-				'\n',
-				[this, self](boost::system::error_code ec, std::size_t length) {
-					if (!ec) {
-						std::string message(boost::asio::buffers_begin(buffer_.data()),
-							boost::asio::buffers_begin(buffer_.data()) + length);
-						buffer_.consume(length);
-
-						// Store the message (thread-safe)
-						{
-							std::lock_guard<std::mutex> lock(server_.storedMessagesMutex);
-							server_.storedMessages.push_back(message);
-						}
+		// Bytes of the first message when it is all there, 0 when more is needed. A message is a text line or a
+		// binary command message (see CommandProtocol.h), the first byte tells which
+		static std::size_t message_size(const std::uint8_t* data, std::size_t available) {
+			if (available == 0) {
+				return 0;
+			}
+			if (data[0] != CommandMagic) {
+				const void* newline = std::memchr(data, '\n', available);
+				return newline ? static_cast<const std::uint8_t*>(newline) - data + 1 : 0;
+			}
+			std::size_t size = BinaryCommandMessageSize(data, available);
+			return size != 0 && size <= available ? size : 0;
+		}
 
-						// Check if the message is a serialized vector of BaseShape objects
-						if (message.length() > 1 && message[0] == '$') {
-							std::vector<BaseShape*> shapes = Serialization::DeserializeShapes(message.substr(1));
-						}
-						else {
-							// Handle regular string message
-							//std::cout << "Received message from client " << client_id << ": " << message << std::endl;
-							server_.HandleClientMessage(message);
-						}
+		// Reads into one buffer that is only ever grown, every whole message is handled where it lies and what is
+		// left of the last one moves to the front
+		awaitable<void> read_session(std::shared_ptr<TcpConnection> self) {
+			std::size_t filled = 0;
+			while (true) {
+				if (filled == read_buffer_.size()) {
+					if (read_buffer_.size() >= max_message_size) {
+						Log() << "Client " << client_id_ << " sent a message of more than " << max_message_size << " bytes, disconnecting";
+						break;
+					}
+					read_buffer_.resize(read_buffer_.size() * 2);
+				}
+				boost::system::error_code ec;
+				std::size_t length = co_await socket_.async_read_some(boost::asio::buffer(read_buffer_.data() + filled, read_buffer_.size() - filled),
+					boost::asio::redirect_error(use_awaitable, ec));
+				if (ec) {
+					break;
+				}
+				filled += length;
+
+				std::size_t consumed = 0;
+				while (std::size_t size = message_size(read_buffer_.data() + consumed, filled - consumed)) {
+					handle_message(self, read_buffer_.data() + consumed, size);
+					consumed += size;
+				}
+				if (consumed > 0) {
+					std::memmove(read_buffer_.data(), read_buffer_.data() + consumed, filled - consumed);
+					filled -= consumed;
+				}
+			}
+			close();
+			server_.HandleClientDisconnect(client_id_);
+		}
+
+		// On the strand. The pending read and write fail, both sessions end
+		void close() {
+			boost::system::error_code ec;
+			socket_.close(ec);
+			write_signal_.cancel();
+		}
+
+		void handle_message(const std::shared_ptr<TcpConnection>& self, const std::uint8_t* data, std::size_t length) {
+			std::string_view message(reinterpret_cast<const char*>(data), length);
+
+			// The handshake: a first message "room:<id>" joins that room, anything else joins the default room
+			// (and is handled as usual). The room can not change later, the snapshot acks are per room
+			if (!joined_) {
+				joined_ = true;
+				std::uint32_t room_id = DefaultRoom;
+				bool asked = message.starts_with("room:") && CommandText::Number(message.substr(5), room_id);
+				server_.JoinRoom(self, asked ? room_id : DefaultRoom);
+				if (message.starts_with("room:")) {
+					return;
+				}
+			}
+
+			// Binary commands are decoded right from the read buffer
+			if (IsBinaryCommandMessage(data, length)) {
+				server_.HandleClientCommands(data, length, *this);
+				return;
+			}
+
+			// Snapshot acks are for the connection itself, they do not go to the simulation
+			if (message.starts_with("ack:")) {
+				std::int64_t tick = -1;
+				if (CommandText::Number(message.substr(4), tick)) {
+					acked_tick_ = tick;
+				}
+				return;
+			}
+			if (message.starts_with("pong:")) {
+				std::int64_t sent = 0;
+				if (CommandText::Number(message.substr(5), sent)) {
+					rtt_.Sample(static_cast<double>(PingText::NowMicros() - sent));
+				}
+				return;
+			}
+			if (message.starts_with("compress:")) {
+				negotiate_compression(CommandText::Trim(message.substr(9)));
+				return;
+			}
+			if (message.starts_with("resync")) {
+				acked_tick_ = -1;
+				return;
+			}
+			if (message.starts_with("view:")) {
+				read_view(std::string(message.substr(5)));
+				return;
+			}
+			if (message.starts_with("room:")) {
+				Log() << "Client " << client_id_ << " asked for a room after the handshake, ignored";
+				return;
+			}
+			if (message.starts_with("udp:")) {
+				unsigned short port = 0;
+				if (CommandText::Number(message.substr(4), port)) {
+					udp_port_ = port;
+					server_.RegisterUdpClient(SnapshotEndpoint(), client_id_);
+					Log() << "Client " << client_id_ << " gets snapshots over UDP port " << udp_port_;
+				}
+				return;
+			}
+
+			// Check if the message is a serialized vector of BaseShape objects
+			if (message.length() > 1 && message[0] == '$') {
+				std::vector<BaseShape*> shapes = Serialization::DeserializeShapes(std::string(message.substr(1)));
+			}
+			else {
+				// Handle regular string message
+				//std::cout << "Received message from client " << client_id << ": " << message << std::endl;
+				server_.HandleClientMessage(message, *this);
+			}
+		}
 
-						read_message();
+		// "compress:lz" from the client means it can decode the codec, how hard to compress is the server's setting
+		void negotiate_compression(std::string_view offered) {
+			CompressionLevel level = offered == "lz" ? server_.SnapshotCompression() : CompressionLevel::Off;
+			compression_ = level;
+			send_message(level == CompressionLevel::Off ? std::string("compress:none") : std::string("compress:lz:") + CompressionLevelName(level));
+			Log() << "Client " << client_id_ << " snapshot compression: " << CompressionLevelName(level);
+		}
+
+		// The zoom is only informative, the view size already has it
+		void read_view(const std::string& text) {
+			float left = 0, top = 0, width = 0, height = 0, zoom = 1;
+			if (std::sscanf(text.c_str(), "%f,%f,%f,%f,%f", &left, &top, &width, &height, &zoom) < 4 ||
+				!std::isfinite(left) || !std::isfinite(top) || !std::isfinite(width) || !std::isfinite(height) ||
+				width <= 0 || height <= 0) {
+				return;
+			}
+			std::lock_guard<std::mutex> lock(view_mutex_);
+			view_ = SimRect(left, top, width, height);
+			has_view_ = true;
+		}
+
+		// Writes everything that is queued in one gather write, the frames stay in the queue (alive) until it is done.
+		// The frames being written are the first in_flight_count_ of the queue, coalescing does not touch them.
+		// With nothing queued it waits for send_frame to signal
+		awaitable<void> write_session(std::shared_ptr<TcpConnection> self) {
+			while (socket_.is_open()) {
+				in_flight_frames_.clear();
+				{
+					std::lock_guard<std::mutex> lock(queue_mutex_);
+					in_flight_bytes_ = 0;
+					if (message_queue_.empty() || closing_) {
+						write_in_progress_ = false;
 					}
 					else {
-						server_.HandleClientDisconnect(client_id_);
+						for (const SharedFrame& frame : message_queue_) {
+							in_flight_frames_.push_back(frame);
+							in_flight_bytes_ += frame->size();
+						}
+						in_flight_count_ = message_queue_.size();
 					}
-				});
-		}
+				}
+				boost::system::error_code ec;
+				if (in_flight_frames_.empty()) {
+					write_signal_.expires_at(boost::asio::steady_timer::time_point::max());
+					co_await write_signal_.async_wait(boost::asio::redirect_error(use_awaitable, ec));
+					continue;
+				}
 
-		void do_write() {
-			auto self(shared_from_this());
-			boost::asio::async_write(
-				socket_,
-				boost::asio::buffer(message_queue_.front()),
-				[this, self](boost::system::error_code ec, std::size_t /*length*/) {
-					if (!ec) {
-						message_queue_.pop_front();
-						if (!message_queue_.empty()) {
-							do_write();
+				// Compressed here and not by the room: there is one write at a time, so the snapshots are compressed in
+				// the order they go out and each one is the dictionary for the next
+				CompressionLevel level = Compression();
+				write_buffers_.clear();
+				for (SharedFrame& frame : in_flight_frames_) {
+					if (level != CompressionLevel::Off && IsSnapshot(*frame)) {
+						if (SharedFrame compressed = compressor_.Compress(frame, level, true)) {
+							frame = std::move(compressed);
 						}
 					}
-					else {
-						server_.HandleClientDisconnect(client_id_);
+					write_buffers_.push_back(boost::asio::buffer(*frame));
+				}
+
+				std::size_t length = co_await boost::asio::async_write(socket_, write_buffers_, boost::asio::redirect_error(use_awaitable, ec));
+				{
+					std::lock_guard<std::mutex> lock(queue_mutex_);
+					if (!ec) {
+						send_stats_.sentFrames += in_flight_count_;
+						send_stats_.sentBytes += length;
+						queued_bytes_ -= in_flight_bytes_; // As they were queued, before the compression
+						message_queue_.erase(message_queue_.begin(), message_queue_.begin() + in_flight_count_);
+						last_write_progress_ = std::chrono::steady_clock::now();
 					}
-				});
+					in_flight_count_ = 0;
+				}
+				if (ec) {
+					close();
+					server_.HandleClientDisconnect(client_id_);
+				}
+			}
+		}
+
+		static bool IsSnapshot(const std::vector<std::uint8_t>& frame) {
+			NetMessageType type = NetFrame::ReadType(frame.data());
+			return type == NetMessageType::Snapshot || type == NetMessageType::DeltaSnapshot;
 		}
 
+		static constexpr std::size_t max_queued_bytes = 32 * 1024 * 1024;
+		static constexpr std::size_t initial_read_buffer = 4096;
+		static constexpr std::size_t max_message_size = 16 * 1024 * 1024; // A text line, the binary ones are smaller
+		static constexpr std::chrono::seconds max_write_stall = std::chrono::seconds(10);
+
 		tcp::socket socket_;
+		boost::asio::steady_timer write_signal_; // Cancelled to wake the writer, never expires
 		ServerNetworking& server_;
-		boost::asio::streambuf buffer_;
-		std::deque<std::string> message_queue_;
+		std::vector<std::uint8_t> read_buffer_; // Only the reader
+		std::mutex queue_mutex_; // The simulation thread queues, the io threads write
+		std::deque<SharedFrame> message_queue_;
+		std::size_t in_flight_count_ = 0;
+		std::size_t queued_bytes_ = 0;
+		std::vector<boost::asio::const_buffer> write_buffers_; // Reused for every gather write, only the writer
+		std::vector<SharedFrame> in_flight_frames_;            // What write_buffers_ points to, some compressed
+		std::size_t in_flight_bytes_ = 0;
+		std::atomic<CompressionLevel> compression_{ CompressionLevel::Off };
+		FrameCompressor compressor_; // The stream context of this connection, only the writer uses it
+		bool write_in_progress_ = false; // The writer has frames or is about to, send_frame does not signal it
+		bool closing_ = false;
+		std::chrono::steady_clock::time_point last_write_progress_ = std::chrono::steady_clock::now();
+		SendStats send_stats_;
+		RttEstimator rtt_;
+		std::atomic<std::uint64_t> datagram_bytes_{ 0 };
+		std::atomic<std::int64_t> acked_tick_{ -1 };
+		std::atomic<unsigned short> udp_port_{ 0 };
+		std::mutex view_mutex_;
+		SimRect view_;
+		bool has_view_ = false;
+		std::mutex room_mutex_;
+		std::shared_ptr<Room> room_;
+		bool joined_ = false; // Only the reader
+		boost::asio::ip::address remote_address_;
 		std::string address_;
 		unsigned short port_;
 		int client_id_;
-		static int nextID;
+		static std::atomic<int> nextID; // The accepts run on any io thread
 	};
 
 	tcp::acceptor tcpAcceptor;
@@ -157,76 +473,104 @@ protected:
 	char udpData[max_length];
 	unsigned short tcpPort;
 	unsigned short udpPort;
+	std::mutex connectionsMutex; // tcpConnections and udpClients, the io threads and the console use them
 	std::map<int, std::shared_ptr<TcpConnection>> tcpConnections;
-	std::vector<std::string> storedMessages; // Vector to store messages
-	std::mutex storedMessagesMutex; // Mutex for thread-safe access to storedMessages
-
-	void AcceptTCPConnection() {
-		tcpAcceptor.async_accept(
-			[this](boost::system::error_code ec, tcp::socket socket) {
-				if (!ec) {
-					auto connection = std::make_shared<TcpConnection>(std::move(socket), *this);
-					tcpConnections[connection->ID()] = connection;
-					connection->start();
-				}
-				AcceptTCPConnection();
-			});
-	}
-
-	void HandleClientDisconnect(int client_id) {
-		auto it = tcpConnections.find(client_id);
-		if (it != tcpConnections.end()) {
-			std::cout << "Client " << client_id << " disconnected from "
-				<< it->second->Address() << ":" << it->second->Port() << std::endl;
-			tcpConnections.erase(it);
+	std::map<udp::endpoint, int> udpClients; // Snapshot endpoint -> client, so its UDP commands go to its room
+	std::atomic<std::uint64_t> unknownDatagrams{ 0 }; // UDP commands from endpoints no client registered, dropped
+	SnapshotWriter snapshotWriter; // Full snapshots for the console
+	CompressionLevel snapshotCompression = CompressionLevel::Fast;
+
+	// Rooms by id, made when the first client asks for one. Every room is a task on the pool of the derived server
+	static constexpr std::uint32_t DefaultRoom = 0;
+	static constexpr std::size_t MaxRooms = 1024;
+	std::mutex roomsMutex;
+	std::map<std::uint32_t, std::shared_ptr<Room>> rooms;
+
+	friend class Room;
+
+	// Every accepted socket gets a strand of its own, the connection's handlers run on it
+	awaitable<void> AcceptTCPConnections() {
+		while (tcpAcceptor.is_open()) {
+			boost::system::error_code ec;
+			tcp::socket socket = co_await tcpAcceptor.async_accept(boost::asio::make_strand(tcpAcceptor.get_executor()),
+				boost::asio::redirect_error(use_awaitable, ec));
+			if (ec) {
+				continue;
+			}
+			auto connection = std::make_shared<TcpConnection>(std::move(socket), *this);
+			{
+				std::lock_guard<std::mutex> lock(connectionsMutex);
+				tcpConnections[connection->ID()] = connection;
+			}
+			connection->start();
 		}
 	}
 
-	void HandleClientMessage(const std::string& message) {
-		// Store the message (thread-safe)
-		{
-			std::lock_guard<std::mutex> lock(storedMessagesMutex);
-			storedMessages.push_back(message);
-			//std::cout << "Received message from client " << client_id << ": " << message << std::endl;
-		}
-	}
-	std::vector<std::string> GetAllStoredMessages() {
-		std::lock_guard<std::mutex> lock(storedMessagesMutex);
-		return storedMessages;
-	}
+	// Made by the derived server, which also schedules it
+	virtual std::shared_ptr<Room> CreateRoom(std::uint32_t id) = 0;
+
+	// Defined after Room
+	void JoinRoom(const std::shared_ptr<TcpConnection>& connection, std::uint32_t room_id);
+	bool CloseRoom(Room& room);
+	void HandleClientDisconnect(int client_id);
+	void HandleClientMessage(std::string_view message, TcpConnection& connection);
+	void HandleClientCommands(const std::uint8_t* data, std::size_t size, TcpConnection& connection);
+	std::shared_ptr<Room> UdpSenderRoom(const udp::endpoint& sender, int& client_id);
 
-	// Helper method to clear stored messages
-	void ClearStoredMessages() {
-		std::lock_guard<std::mutex> lock(storedMessagesMutex);
-		storedMessages.clear();
+	void RegisterUdpClient(const udp::endpoint& endpoint, int client_id) {
+		std::lock_guard<std::mutex> lock(connectionsMutex);
+		udpClients[endpoint] = client_id;
 	}
 
 	void BroadcastTcpMessage(const std::string& message) {
+		std::lock_guard<std::mutex> lock(connectionsMutex);
 		for (auto& conn : tcpConnections) {
 			conn.second->send_message(message);
 		}
-		std::cout << "Broadcasted to " << tcpConnections.size() << " clients: " << message << std::endl;
+		Log() << "Broadcasted " << message.size() << " bytes to " << tcpConnections.size() << " clients";
+	}
+
+	// Fire and forget, a lost datagram is never sent again (the next tick replaces it).
+	// Posted so the simulation thread does not start socket operations itself
+	void SendDatagrams(SharedFrame datagrams, udp::endpoint endpoint) {
+		boost::asio::post(udpSocket.get_executor(), [this, datagrams, endpoint]() {
+			std::size_t count = SnapshotDatagram::DatagramCount(*datagrams);
+			for (std::size_t i = 0; i < count; i++) {
+				std::size_t size = 0;
+				const std::uint8_t* data = SnapshotDatagram::Datagram(*datagrams, i, size);
+				udpSocket.async_send_to(boost::asio::buffer(data, size), endpoint,
+					[datagrams](boost::system::error_code /*ec*/, std::size_t /*bytes_sent*/) {});
+			}
+			});
 	}
 
-	void BroadcastShapes(const std::vector<BaseShape*>& shapes) {
-		std::string serializedShapes = Serialization::SerializeShapes(shapes);
+	// Whole world, no baseline, for the console
+	void BroadcastFullSnapshot(const std::vector<BaseShape*>& shapes) {
+		SharedFrame snapshot = snapshotWriter.Write(0, shapes);
+		std::lock_guard<std::mutex> lock(connectionsMutex);
 		for (auto& conn : tcpConnections) {
-			conn.second->send_shapes(shapes);
+			conn.second->send_frame(snapshot);
 		}
 		//std::cout << "Broadcasted " << shapes.size() << " shapes to " << tcpConnections.size() << " clients" << std::endl;
 	}
 
 	void SendToClient(int client_id, const std::string& message) {
+		std::lock_guard<std::mutex> lock(connectionsMutex);
 		auto it = tcpConnections.find(client_id);
 		if (it != tcpConnections.end()) {
 			it->second->send_message(message);
 			//std::cout << "Sent to client " << client_id << ": " << message << std::endl;
 		}
 		else {
-			std::cout << "Client " << client_id << " not found" << std::endl;
+			Log() << "Client " << client_id << " not found";
 		}
 	}
 
+	std::string RoomName(TcpConnection& connection);
+
+	// Console commands of the derived server, true when input was one
+	virtual bool HandleConsoleCommand(const std::string& /*input*/) { return false; }
+
 	void StartConsoleInput() {
 		std::thread input_thread([this]() {
 			std::string input;
@@ -237,11 +581,11 @@ protected:
 				}
 				else if (input.substr(0, 2) == "s:") {
 					// Broadcast shapes
-					BaseShape* cir = new Circle(3.0, sf::Color(1, 2, 3), sf::Vector2f(69, 96), 9.8, 300.0, sf::Vector2f(4, 0), 0);
-					BaseShape* cir2 = new Circle(3.30, sf::Color(13, 2, 33), sf::Vector2f(369, 96), 9.8, 300.0, sf::Vector2f(43, 0), 30);
-					BaseShape* cir3 = new Circle(3.03, sf::Color(1, 333, 3), sf::Vector2f(6933, 963), 93.8, 3003.0, sf::Vector2f(34, 0), 3330);
+					BaseShape* cir = new Circle(3.0, SimColor(1, 2, 3), sf::Vector2f(69, 96), 9.8, 300.0, sf::Vector2f(4, 0), 0);
+					BaseShape* cir2 = new Circle(3.30, SimColor(13, 2, 33), sf::Vector2f(369, 96), 9.8, 300.0, sf::Vector2f(43, 0), 30);
+					BaseShape* cir3 = new Circle(3.03, SimColor(1, 77, 3), sf::Vector2f(6933, 963), 93.8, 3003.0, sf::Vector2f(34, 0), 3330);
 					std::vector<BaseShape*> shapes = { cir,cir2,cir3 };
-					BroadcastShapes(shapes);
+					BroadcastFullSnapshot(shapes);
 				}
 				else if (input.substr(0, 2) == "c:") {
 					// Send to specific client
@@ -251,12 +595,26 @@ protected:
 						SendToClient(client_id, input.substr(space_pos + 1));
 					}
 				}
+				else if (input == "queues") {
+					// Send queue of every client, a growing queue or many dropped snapshots is a slow client
+					std::lock_guard<std::mutex> lock(connectionsMutex);
+					for (const auto& conn : tcpConnections) {
+						TcpConnection::SendStats stats = conn.second->GetSendStats();
+						std::cout << "Client " << conn.first << ": " << stats.queuedFrames << " frames / " << stats.queuedBytes
+							<< " bytes queued (peak " << stats.peakQueuedBytes << "), " << stats.droppedSnapshots
+							<< " snapshots dropped, " << stats.sentFrames << " frames / " << stats.sentBytes << " bytes sent, "
+							<< stats.sentDatagramBytes << " bytes of datagrams" << std::endl;
+					}
+				}
+				else if (HandleConsoleCommand(input)) {
+				}
 				else if (input == "list") {
 					// List all connected clients
 					std::cout << "Connected clients:" << std::endl;
+					std::lock_guard<std::mutex> lock(connectionsMutex);
 					for (const auto& conn : tcpConnections) {
 						std::cout << "Client " << conn.first << " - "
-							<< conn.second->Address() << ":" << conn.second->Port() << std::endl;
+							<< conn.second->Address() << ":" << conn.second->Port() << RoomName(*conn.second) << std::endl;
 					}
 				}
 			}
@@ -264,33 +622,22 @@ protected:
 		input_thread.detach();
 	}
 
-	// Thread-safe method to access stored messages
-	std::vector<std::string> GetStoredMessages() {
-		std::lock_guard<std::mutex> lock(storedMessagesMutex);
-		return storedMessages; // Return a copy
-	}
+	void HandleUdpCommands(const std::uint8_t* data, std::size_t size);
 
 	void ReceiveUDP() {
 		udpSocket.async_receive_from(
 			boost::asio::buffer(udpData, max_length), udpSenderEndpoint,
 			[this](boost::system::error_code ec, std::size_t bytes_recvd) {
 				if (!ec) {
-					// Convert received data to string
-					std::string message(udpData, bytes_recvd);
-
-					HandleClientMessage(message);
+					const std::uint8_t* data = reinterpret_cast<const std::uint8_t*>(udpData);
+					HandleUdpCommands(data, bytes_recvd);
 
 					// Log the message
 					/*std::cout << "UDP received from "
 						<< udpSenderEndpoint.address().to_string()
 						<< ": " << message
 						<< std::endl;*/
-
-						// Echo the message back to the sender
-					udpSocket.async_send_to(
-						boost::asio::buffer(udpData, bytes_recvd),
-						udpSenderEndpoint,
-						[](boost::system::error_code /*ec*/, std::size_t /*bytes_sent*/) {});
+					// No echo anymore, the client reads snapshot datagrams from this port
 				}
 				// Continue receiving messages
 				ReceiveUDP();
@@ -298,460 +645,1152 @@ protected:
 	}
 };
 
-int ServerNetworking::TcpConnection::nextID = 0;
+std::atomic<int> ServerNetworking::TcpConnection::nextID{ 0 };
 
-class Server : public ServerNetworking, public PhysicsSimulationActions {
+// One independent simulation: its own world, tick scheduler, command queue and clients.
+// Rooms are tasks on the server's TickPool, so hundreds of small ones share a few threads
+class Room : public TickTask, public RoomSimulation {
 private:
-#pragma region EssantialVariables
-	sf::VideoMode desktopSize = sf::VideoMode::getDesktopMode();
-	int window_height = desktopSize.height;
-	int window_width = desktopSize.width;
-	bool fullscreen = false;
-	float gravity = 0;
-	double massLock = 0;
-
-
-	// Window and view settings
-	sf::View view;
-	sf::ContextSettings settings;
-	const float ZOOM_FACTOR = 1.5f;
-
-	// Cursors
-	sf::Cursor handCursor;
-	sf::Cursor defaultCursor;
-
-	std::string screen = "START";
-
-	bool hovering = false;
-	bool connectingMode = false;
-	bool planetMode = false;
-	bool enableCollison = false;
-	bool borderless = true;
-
-	// Physics and simulation parameters
-	float lineLength = 150;
-	ObjectsList objectList;
-	float deltaTime = 1.0f / 60.0f;
-	float elastic = 0.0;
-	int objCount = 0;
-	float radius = 50;
-
-	// Visual settings
-	sf::Color ball_color = sf::Color(238, 238, 238);
-	sf::Color ball_color2 = sf::Color(50, 5, 11);
-	sf::Color background_color = sf::Color(30, 30, 30);
-	sf::Color buttonColor = sf::Color(55, 58, 64);
-	sf::Color bb = sf::Color(44, 55, 100);
-	sf::Color explosion = sf::Color(205, 92, 8);
-	sf::Color outlineColor = sf::Color(255, 255, 255);
-	sf::Color previousColor = sf::Color(0, 0, 0);
-
-	// Gradient settings
-	short int gradientStep = 0;
-	short int gradientStepMax = 400;
-	std::vector<sf::Color> gradient;
-
-	// UI Elements
-	sf::Font font;
-	sf::Text ballsCountText;
-	sf::Text fpsText;
-	sf::Text linkingText;
-
-	// Menu elements
-	sf::RectangleShape headerText;
-	std::vector<std::pair<Button, bool>> settingsButtonVec;
-
-	// Performance tracking
-	sf::Clock clock;
-	sf::Clock fpsClock;
-	int frameCount = 0;
-	float currentFPS = 0.0f;
-
-	// Object templates
-	Circle* copyObjCir;
-	RectangleClass* copyObjRec;
-
-	// Spawn settings
-	float posYStartingPoint = 200;
-	int posXStartingPoint = radius;
-	short int startingPointAdder = 31;
-	sf::Vector2f spawnStartingPoint;
-	sf::Vector2f initialVel = sf::Vector2f(4, 0);
-
-	std::mutex objectListMutex;
-#pragma endregion
+	ServerNetworking& network;
+	std::uint32_t id;
+	using TcpConnection = ServerNetworking::TcpConnection;
+
+	// A client of this room with the room's snapshot state for it, only used by the ticks
+	struct RoomClient
+	{
+		std::shared_ptr<TcpConnection> connection;
+		ClientInterest interest;                        // Bodies it had last snapshot (with a view)
+		SnapshotHistory snapshots = SnapshotHistory(32); // Its own filtered states, baselines for its deltas
+		std::uint32_t appliedInput = 0;  // Newest input sequence of its commands a tick applied
+		std::uint32_t reportedInput = 0; // ...and the newest it was told about (NetMessageType::InputAck)
+	};
+	std::vector<std::unique_ptr<RoomClient>> clients;
+	// Joins and leaves from the io threads, the next tick applies them
+	std::mutex membershipMutex;
+	std::vector<std::shared_ptr<TcpConnection>> joining;
+	std::vector<int> leaving;
+	std::atomic<std::size_t> clientCount{ 0 };
+	std::atomic<std::size_t> bodyCount{ 0 };
+	std::uint64_t emptyTicks = 0;
+	float closeAfterSeconds = 60; // Empty for this long and the room is gone (not the default room)
+	bool closed = false;
+
+	// Commands from the io threads, the room's tick drains them. no lock on either side
+	MpscRing<Command> commandQueue = MpscRing<Command>(4096);
+	std::atomic<std::uint64_t> droppedCommands{ 0 };
+	std::atomic<std::uint64_t> invalidCommands{ 0 }; // Also the text commands the server has no handler for
+	std::atomic<std::uint64_t> supersededCommands{ 0 }; // Positions a newer one of the same tick replaced
+	TickCommands tickCommands; // Reused every tick
+
+	// For the telemetry, written by the ticks
+	TickPhaseTimes phaseTimes;
+	std::atomic<std::uint64_t> tickCount{ 0 };
+	std::atomic<std::uint64_t> processedCommands{ 0 };
+	std::atomic<std::size_t> commandQueueDepth{ 0 }; // Commands waiting at the start of the last tick
+	std::atomic<std::size_t> contactCount{ 0 };      // Overlaps resolved in the last tick
+
+	DeltaSnapshotWriter deltaWriter;
+	SnapshotHistory snapshotHistory = SnapshotHistory(32); // Baselines for the deltas, about half a second
+	SnapshotFragmenter fragmenter;
+	FrameCompressor datagramCompressor; // Every datagram frame on its own, a lost one must not break the next
+	// One delta per baseline tick, cut into datagrams only if a UDP client needs it. reused every tick
+	struct CachedDelta
+	{
+		std::int64_t baselineTick;
+		SharedFrame frame;
+		SharedFrame datagrams;
+		SharedFrame compressedDatagrams; // For the UDP clients that asked for compression
+	};
+	std::vector<CachedDelta> deltaFramesThisTick;
+	InterestSettings interestSettings;
+	InterestGrid interestGrid = InterestGrid(interestSettings.cellSize);
+	Quantizer quantizer; // Bit sizes of the snapshot fields, see QuantizationConfig
+	bool quantizeSnapshots = true;
+
+	// Tick rate, broadcast rate and what to shed under load. the clients interpolate with the same tick rate
+	// (InterpolationSettings::ticksPerSecond)
+	TickScheduler scheduler;
+	std::uint32_t tick = 0; // Simulation step number, sent with every snapshot
+
+	// A sharded world (see Sharding.h): the room is either one region of it or the coordinator that shows all of
+	// it, at most one of the two. Set before the pool runs
+	ShardNode* shardNode = nullptr;
+	ShardCoordinator* coordinator = nullptr;
+	bool exchangeSent = false; // This tick's exchange is out, the tick waits for the others' (ShardNode::Receive)
+	std::vector<BodyRecord> mergedBodies; // The coordinator's last merge
+
+	// The session on disk when the server runs with --journal (see Journal.h), only the ticks write it
+	std::unique_ptr<JournalWriter> journal;
+	int journaledSubsteps = 0;
+	// Every snapshot also goes to a shared memory ring for readers on this machine (--shm, SharedSnapshot.h)
+	std::unique_ptr<SharedSnapshotWriter> sharedSnapshots;
+
 
 public:
-	Server(boost::asio::io_context& io_context, unsigned short tcpPort, unsigned short udpPort)
-		: ServerNetworking(io_context, tcpPort, udpPort), PhysicsSimulationActions(),
-		settings(8),
-		objectList(lineLength),
-		spawnStartingPoint(posXStartingPoint, posYStartingPoint)
+	Room(ServerNetworking& network, std::uint32_t id, const TickSettings& tickSettings)
+		: network(network),
+		id(id)
 	{
-		setupGradient();
+		scheduler.SetSettings(tickSettings);
 	}
 
-	void Run() {
-		while (true) {
-			// Get events by const reference to avoid copying
-			const auto& events = GetStoredMessages();
+	std::uint32_t ID() const { return id; }
 
-			// Process events
-			TranslateEvents(events);
+	TickScheduler& Scheduler() override { return scheduler; }
 
-			// Clear the stored messages after processing
-			{
-				std::lock_guard<std::mutex> lock(storedMessagesMutex);
-				storedMessages.clear();
-			}
+	// The room simulates one region, its new bodies get ids no other shard hands out
+	void SetShardNode(ShardNode* node) {
+		journal.reset(); // The other shards change this world too, it can not be replayed alone
+		shardNode = node;
+		objectList.SetIDBase(node->Index() << 24);
+	}
 
-			// Update physics
-			objectList.MoveObjects(window_width, window_height, currentFPS,
-				elastic, planetMode, enableCollison, borderless);
+	// Before the room's first tick
+	void SetTickSettings(const TickSettings& settings) {
+		scheduler.SetSettings(settings);
+	}
 
-			//for (auto obj :objectList.objList)
-			//{
-			//	/*std::cout << "\033[34m" << "amogus = " << obj->GetID();*/
-			//}
-			//std::cout << "\033[0m";
-			// Broadcast using const reference
-			const auto& shapes = objectList.objList;
-			BroadcastShapes(shapes);
+	// The room runs no physics, it shows the merged world of the shards
+	void SetCoordinator(ShardCoordinator* shards) {
+		journal.reset();
+		coordinator = shards;
+	}
 
-			std::this_thread::sleep_for(std::chrono::milliseconds(16));
+	// Before the room's first tick
+	bool StartSharedSnapshots(const std::string& segmentName, std::size_t maxBodies) {
+		auto writer = std::make_unique<SharedSnapshotWriter>();
+		if (!writer->Open(segmentName, maxBodies)) {
+			return false;
 		}
+		sharedSnapshots = std::move(writer);
+		return true;
 	}
 
-	// Splits a string by a delimiter
-	static std::vector<std::string> SplitString(const std::string& str, char delimiter) {
-		std::vector<std::string> tokens;
-		std::string token;
-		std::istringstream tokenStream(str);
-		while (std::getline(tokenStream, token, delimiter)) {
-			tokens.push_back(token);
+	// Before the room's first tick. Not for a room of a sharded world
+	bool StartJournal(const std::string& path) {
+		if (shardNode || coordinator) {
+			return false;
 		}
-		return tokens;
+		auto writer = std::make_unique<JournalWriter>();
+		journaledSubsteps = scheduler.Substeps();
+		if (!writer->Open(path, Scene(id, scheduler.GetSettings().tickRate, journaledSubsteps))) {
+			return false;
+		}
+		journal = std::move(writer);
+		return true;
 	}
 
-	sf::Vector2f StringToVector2f(std::string str) {
-		str = str.substr(1, str.length() - 2);
-		auto splitedStr = SplitString(str, ',');
-		return sf::Vector2f(std::stof(splitedStr[0]), std::stof(splitedStr[1]));
-	}
+	bool Finished() override { return closed; }
 
-	sf::Vector2i StringToVector2i(std::string str) {
-		str = str.substr(1, str.length() - 2);
-		auto splitedStr = SplitString(str, ',');
-		return sf::Vector2i(std::stoi(splitedStr[0]), std::stoi(splitedStr[1]));
+	// Any thread
+	void AddClient(std::shared_ptr<TcpConnection> connection) {
+		std::lock_guard<std::mutex> lock(membershipMutex);
+		joining.push_back(std::move(connection));
 	}
 
-	std::vector<sf::Color> GenerateGradient(sf::Color startColor, sf::Color endColor, int steps) {
-		std::vector<sf::Color> newGradient;
-		float stepR = (endColor.r - startColor.r) / static_cast<float>(steps - 1);
-		float stepG = (endColor.g - startColor.g) / static_cast<float>(steps - 1);
-		float stepB = (endColor.b - startColor.b) / static_cast<float>(steps - 1);
+	void RemoveClient(int client_id) {
+		std::lock_guard<std::mutex> lock(membershipMutex);
+		leaving.push_back(client_id);
+	}
 
-		for (int i = 0; i < steps; ++i) {
-			newGradient.push_back(sf::Color(
-				startColor.r + stepR * i,
-				startColor.g + stepG * i,
-				startColor.b + stepB * i
-			));
-		}
-		return newGradient;
+	bool HasJoining() {
+		std::lock_guard<std::mutex> lock(membershipMutex);
+		return !joining.empty();
 	}
 
-	void setupGradient() {
-		sf::Color startColor(128, 0, 128);  // purple
-		sf::Color endColor(0, 0, 255);      // blue
-		gradient = GenerateGradient(startColor, endColor, gradientStepMax);
+	std::size_t ClientCount() const { return clientCount; }
+	std::size_t BodyCount() const { return bodyCount; }
+	std::uint64_t DroppedCommands() const { return droppedCommands; }
+	std::uint64_t InvalidCommands() const { return invalidCommands; }
+	std::uint64_t SupersededCommands() const { return supersededCommands; }
+	std::uint64_t TickCount() const { return tickCount; }
+	std::uint64_t SharedPublished() const { return sharedSnapshots ? sharedSnapshots->Published() : 0; }
+	const CompressionStats& DatagramCompression() const { return datagramCompressor.Stats(); }
+	std::uint64_t ProcessedCommands() const { return processedCommands; }
+	std::size_t CommandQueueDepth() const { return commandQueueDepth; }
+	std::size_t ContactCount() const { return contactCount; }
+	const TickPhaseTimes& PhaseTimes() const { return phaseTimes; }
+
+	// Any io thread. Text commands are cut and parsed here, the tick gets one Command per command
+	void PushTextMessage(std::string_view message, int client_id) {
+		CountCommands(PushTextCommands(commandQueue, message, client_id), client_id);
 	}
 
-	// Modify GetStoredMessages to return const reference
-	const std::vector<std::string>& GetStoredMessages() {
-		std::lock_guard<std::mutex> lock(storedMessagesMutex);
-		return storedMessages; // Return reference to stored messages
+	// Any io thread. One binary command message
+	void PushBinaryMessage(const std::uint8_t* data, std::size_t size, int client_id) {
+		CountCommands(PushBinaryCommands(commandQueue, data, size, client_id), client_id);
 	}
 
-	//Signs Meaning:
-	// ; end of message part
-	// , type , number -> meaning create object of type num times
-	// : action : identifier -> meaning do something who has different varients like link random/in some structure
-	// * type * vector -> for spawning in position something or giving velocity.
-	// & action & vector/objects & vector/objects -> do some action for two vectors or objects. like linking
-	// ^ action ^ ID -> do an action specific object id
-	// # ID # vetor -> manipulate vector on specific object id
-	// @ event @ obj_type @ ID @ number
-	void TranslateEvents(std::vector<std::string> events) {
-		for (const auto& event : events) {
-			auto tokens = SplitString(event, ';');
-			if (!tokens.empty()) {
-				for (const auto& token : tokens) {
-					if (token.find(',') != std::string::npos) {
-						auto splitToken = SplitString(token, ','); // Only split what we need
-						SpawnObjectsNonSpecific(splitToken);
-					}
-					if (token.find(':') != std::string::npos) {
-						auto eventAndIdentifier = SplitString(token, ':');
-						if (token.find('*') != std::string::npos)
-						{
-							auto actionAndPos = SplitString(eventAndIdentifier[1], '*');
-							SpawnObjectsIdentifierAndSpecific(eventAndIdentifier[0], actionAndPos);
-						}
-						else
-						{
-							SpawnObjectsIdentifier(eventAndIdentifier);
-						}
-					}
-					if (token.find('@') != std::string::npos)
-					{
-						auto splitedToken = SplitString(token, '@');
-						EventWithIdentifierOnID(splitedToken);
-					}
-					if (token.find('*') != std::string::npos) {
-						auto splitToken = SplitString(token, '*');
-						SpawnObjectsSpecific(splitToken);
-					}
-					if (token.find('&') != std::string::npos) {
-						auto splitToken = SplitString(token, '&');
-						EventBetweenTwo(splitToken);
-					}
-					if (token.find('^') != std::string::npos) {
-						auto actionAndID = SplitString(token, '^');
-						if (token.find('#') != std::string::npos)
-						{
-							auto idAndVec = SplitString(actionAndID[1], '#');
-							VectorEventOnID(actionAndID[0], idAndVec);
-						}
-						else {
-							EventAndID(actionAndID);
-						}
-					}
-					else if (event == "EXIT") {
-						// TODO: make disconnect from client
-					}
+	void Tick() override {
+		phaseTimes.Start();
+		UpdateClients();
+		if (coordinator) {
+			TickCoordinator();
+			return;
+		}
+		if (shardNode && !shardNode->Connected()) {
+			scheduler.Idle();
+			return; // The shards start (and go on) together, tick 0 is when all of them are there
+		}
+
+		// Everything the clients sent since the last tick, at most one ring full so a flood can not stall the tick.
+		// The journal gets what is applied, a replay does not need to drop anything again
+		if (!exchangeSent) {
+			std::size_t drained = DrainCommands();
+			tickCommands.ForEach([this](const Command& command) {
+				if (journal) {
+					journal->WriteCommand(tick, command);
 				}
+				TranslateEvent(command);
+				});
+			CountDrained(drained);
+			phaseTimes.Mark(TickPhase::Commands);
+		}
+
+		if (shardNode) {
+			if (!exchangeSent) {
+				shardNode->Send(objectList, tick);
+				exchangeSent = true;
 			}
+			if (!shardNode->Receive(objectList, tick)) {
+				// Not all neighbours are there yet, the worker goes on with other rooms and this tick runs again soon
+				scheduler.Retry(std::chrono::milliseconds(1));
+				return;
+			}
+			exchangeSent = false;
+			phaseTimes.Mark(TickPhase::Exchange);
 		}
 
+		// Update physics, the same simulated time every tick however many steps it is cut into
+		int substeps = scheduler.Substeps();
+		if (journal && substeps != journaledSubsteps) {
+			journal->WriteSubsteps(tick, substeps);
+			journaledSubsteps = substeps;
+		}
+		Step(substeps, scheduler.GetSettings().tickRate);
+		contactCount = objectList.ContactCount();
+		if (journal && tick % JournalCheckpointInterval() == 0) {
+			journal->WriteCheckpoint(tick, objectList.objList.size(), JournalHash(objectList.objList));
+		}
+		phaseTimes.Mark(TickPhase::Physics);
+
+		if (shardNode) {
+			// Every shard sends on the same ticks, so the coordinator merges worlds of one tick
+			shardNode->Settle(objectList, tick, tick % scheduler.BroadcastInterval() == 0);
+			phaseTimes.Mark(TickPhase::Exchange);
+		}
+		bodyCount = objectList.objList.size();
+
+		const auto& shapes = objectList.objList;
+		if ((!clients.empty() || sharedSnapshots) && scheduler.ShouldBroadcast(tick)) {
+			BroadcastShapes(shapes, tick, scheduler.InterestScale());
+		}
+		phaseTimes.Mark(TickPhase::Broadcast);
+		phaseTimes.End();
+		tick++;
+		tickCount++;
+
+		// A room nobody is in for a while is closed, unless someone is joining it right now
+		if (clients.empty() && id != ServerNetworking::DefaultRoom) {
+			emptyTicks++;
+			if (emptyTicks > closeAfterSeconds * scheduler.GetSettings().tickRate && network.CloseRoom(*this)) {
+				closed = true;
+			}
+		}
+		else {
+			emptyTicks = 0;
+		}
 	}
 
-	// SIGN ,
-	void SpawnObjectsNonSpecific(std::vector<std::string> EventAndNum) {
-		std::string event = EventAndNum[0];
-		int num = std::stoi(EventAndNum[1]);
-		if (event == "CIR") {
-			for (size_t i = 0; i < num; i++)
-			{
-				BaseShape* newObject = objectList.CreateNewCircle(poptions.gravity, gradient[gradientStep], spawnStartingPoint, initialVel);
-				objCount += 1;
-				gradientStep += 1;
-				spawnStartingPoint.x += startingPointAdder;
-				if (gradientStep == gradientStepMax) {
-					std::reverse(gradient.begin(), gradient.end());
-					gradientStep = 0;
-				}
-				if (spawnStartingPoint.x >= poptions.window_width - radius || spawnStartingPoint.x <= radius)
-				{
-					startingPointAdder *= -1;
-				}
-				objectList.connectedObjects.AddObject(newObject);
+private:
+	// The commands go to the shards that own them, the merged world of the shards goes to the clients
+	void TickCoordinator() {
+		std::size_t drained = DrainCommands();
+		tickCommands.ForEach([this](const Command& command) { coordinator->Route(command); });
+		coordinator->FlushCommands();
+		CountDrained(drained);
+		phaseTimes.Mark(TickPhase::Commands);
+
+		std::uint32_t worldTick = 0;
+		if (coordinator->TakeWorld(mergedBodies, worldTick)) {
+			bodyCount = mergedBodies.size();
+			if (!clients.empty() || sharedSnapshots) {
+				SnapshotState& current = snapshotHistory.Push();
+				current.CaptureRecords(worldTick, mergedBodies, quantizeSnapshots ? &quantizer : nullptr);
+				PublishShared(current);
+				BroadcastState(current, scheduler.InterestScale());
 			}
 		}
-		else if (event == "REC") {
-			for (size_t i = 0; i < num; i++)
-			{
-				objectList.CreateNewRectangle(poptions.gravity, gradient[gradientStep], spawnStartingPoint);
-				objCount += 1;
-				gradientStep += 1;
-				spawnStartingPoint.x += startingPointAdder;
-				if (gradientStep == gradientStepMax) {
-					std::reverse(gradient.begin(), gradient.end());
-					gradientStep = 0;
-				}
-				if (spawnStartingPoint.x >= poptions.window_width - radius || spawnStartingPoint.x <= radius)
-				{
-					startingPointAdder *= -1;
+		phaseTimes.Mark(TickPhase::Broadcast);
+		phaseTimes.End();
+		tick++;
+		tickCount++;
+	}
+
+	void UpdateClients() {
+		std::lock_guard<std::mutex> lock(membershipMutex);
+		for (std::shared_ptr<TcpConnection>& connection : joining) {
+			auto client = std::make_unique<RoomClient>();
+			client->connection = std::move(connection);
+			clients.push_back(std::move(client));
+		}
+		joining.clear();
+		for (int client_id : leaving) {
+			clients.erase(std::remove_if(clients.begin(), clients.end(),
+				[client_id](const std::unique_ptr<RoomClient>& client) { return client->connection->ID() == client_id; }), clients.end());
+		}
+		leaving.clear();
+		clientCount = clients.size();
+	}
+
+	// About once a second
+	std::uint32_t JournalCheckpointInterval() const {
+		return static_cast<std::uint32_t>(std::max(1.0f, scheduler.GetSettings().tickRate));
+	}
+
+	// Into tickCommands, without the positions a newer one replaces. The number popped.
+	// A replaced position still counts as applied for its client's input sequence, the newer one is where it went.
+	// A coordinator does not acknowledge inputs, the shards apply them on ticks of their own
+	std::size_t DrainCommands() {
+		tickCommands.Clear();
+		Command command;
+		std::size_t drained = 0;
+		RoomClient* sender = nullptr;
+		for (; drained < commandQueue.Capacity() && commandQueue.TryPop(command); drained++) {
+			tickCommands.Push(command);
+			if (command.sequence != 0 && !coordinator) {
+				if (!sender || sender->connection->ID() != command.clientID) {
+					sender = FindClient(command.clientID);
+				}
+				if (sender) {
+					sender->appliedInput = std::max(sender->appliedInput, command.sequence);
 				}
 			}
 		}
+		supersededCommands += tickCommands.DropSuperseded();
+		return drained;
 	}
 
-	// SIGN ^
-	void EventAndID(std::vector<std::string> EventAndID) {
-		std::string event = EventAndID[0];
-		std::string id = EventAndID[1];
-		if (event == "DEL") {
-			BaseShape* obj = objectList.FindByIDStr(id);
-			objectList.DeleteThisObj(obj);
+	RoomClient* FindClient(int client_id) {
+		for (std::unique_ptr<RoomClient>& client : clients) {
+			if (client->connection->ID() == client_id) {
+				return client.get();
+			}
 		}
+		return nullptr;
 	}
 
-	// SIGN *
-	void SpawnObjectsSpecific(std::vector<std::string> EventAndPos) {
-		std::string event = EventAndPos[0];
-		sf::Vector2f pos = StringToVector2f(EventAndPos[1]);
-		if (event == "PLANET") {
-			createPlanet(pos);
+	// With the snapshot of tick, which shows every input applied so far. Only when there is a newer one
+	void SendInputAck(RoomClient& client, std::uint32_t tick) {
+		if (client.appliedInput != client.reportedInput) {
+			client.connection->send_frame(NetFrame::MakeInputAck(client.appliedInput, tick));
+			client.reportedInput = client.appliedInput;
 		}
 	}
 
-	// SIGN :
-	void SpawnObjectsIdentifier(std::vector<std::string> eventAndIdentifier) {
-		std::string event = eventAndIdentifier[0];
-		std::string identifier = eventAndIdentifier[1];
+	void CountDrained(std::size_t drained) {
+		processedCommands += drained;
+		commandQueueDepth = drained;
+	}
 
-		if (event == "LINK")
-		{
-			if (identifier == "RND")
-			{
-				objCount += 1;
-				objectList.connectedObjects.ConnectRandom(10);
-			}
+	void CountCommands(const PushResult& result, int client_id) {
+		invalidCommands += result.invalid;
+		if (result.dropped > 0) {
+			droppedCommands += result.dropped;
+			Log() << "Dropped " << result.dropped << " commands from client " << client_id << " in room " << id << " (queue full)";
 		}
 	}
 
-	// SIGN : AND *
-	void SpawnObjectsIdentifierAndSpecific(std::string event, std::vector<std::string> typeAndPos) {
-		std::string type = typeAndPos[0];
-		sf::Vector2f pos = StringToVector2f(typeAndPos[1]);
-		if (event == "EXPLOSION") {
-			if (type == "CIR")
-			{
-				objectList.CreateNewCircle(poptions.gravity, explosion, sf::Vector2f(pos.x + 3, pos.y + 3), initialVel);
-				for (size_t i = 0; i < 50; i++)
-				{
-					objectList.CreateNewCircle(poptions.gravity, explosion, pos, initialVel);
-					objCount += 1;
+	// Every client gets what changed since the last snapshot it acknowledged.
+	// Clients that reported a view only get the bodies around it, in a delta of their own.
+	// The others share one frame per baseline, so it is one encode per baseline and not per client
+	void BroadcastShapes(const std::vector<BaseShape*>& shapes, std::uint32_t tick, float interestScale) {
+		SnapshotState& current = snapshotHistory.Push();
+		current.Capture(tick, shapes, quantizeSnapshots ? &quantizer : nullptr);
+		PublishShared(current);
+		BroadcastState(current, interestScale);
+	}
+
+	// The whole world, the local readers do their own culling
+	void PublishShared(const SnapshotState& current) {
+		if (sharedSnapshots && !sharedSnapshots->Publish(current) && sharedSnapshots->Oversized() == 1) {
+			Log() << "Room " << id << ": " << current.bodies.size() << " bodies do not fit the shared memory slots (--shm-bodies), not published";
+		}
+	}
+
+	// current is the newest state of snapshotHistory
+	void BroadcastState(const SnapshotState& current, float interestScale) {
+		Quantizer* snapshotQuantizer = quantizeSnapshots ? &quantizer : nullptr;
+		std::uint32_t tick = current.tick;
+		bool gridBuilt = false;
+		InterestSettings interest = interestSettings;
+		interest.margin *= interestScale;
+		interest.hysteresis *= interestScale;
+
+		for (std::unique_ptr<RoomClient>& client : clients) {
+			TcpConnection& connection = *client->connection;
+			std::int64_t acked = connection.AckedTick();
+			SimRect view;
+			if (connection.GetView(view)) {
+				if (!gridBuilt) {
+					interestGrid.Build(current);
+					gridBuilt = true;
+				}
+				client->interest.SetView(view);
+				SnapshotState& visible = client->snapshots.Push();
+				client->interest.Filter(current, interestGrid, interest, visible);
+				const SnapshotState* baseline = acked < 0 ? nullptr : client->snapshots.Find(static_cast<std::uint32_t>(acked));
+				if (baseline == &visible) {
+					baseline = nullptr;
 				}
+				SharedFrame frame = deltaWriter.Write(visible, baseline, snapshotQuantizer);
+				SendSnapshot(connection, frame, nullptr, tick);
+				SendInputAck(*client, tick);
+				continue;
 			}
-			if (type == "REC")
-			{
-				objectList.CreateNewRectangle(poptions.gravity, explosion, sf::Vector2f(pos.x + 3, pos.y + 3));
-				for (size_t i = 0; i < 50; i++)
-				{
-					objectList.CreateNewRectangle(poptions.gravity, explosion, pos);
-					objCount += 1;
+
+			const SnapshotState* baseline = acked < 0 ? nullptr : snapshotHistory.Find(static_cast<std::uint32_t>(acked));
+			if (baseline == &current) {
+				baseline = nullptr;
+			}
+			std::int64_t baselineTick = baseline ? baseline->tick : -1;
+
+			CachedDelta* cached = nullptr;
+			for (CachedDelta& delta : deltaFramesThisTick) {
+				if (delta.baselineTick == baselineTick) {
+					cached = &delta;
+					break;
 				}
 			}
+			if (!cached) {
+				deltaFramesThisTick.push_back(CachedDelta{ baselineTick, deltaWriter.Write(current, baseline, snapshotQuantizer), nullptr, nullptr });
+				cached = &deltaFramesThisTick.back();
+			}
+			SendSnapshot(connection, cached->frame, cached, tick);
+			SendInputAck(*client, tick);
 		}
+		deltaFramesThisTick.clear(); // So the pool gets the frames back once they are sent
 	}
 
-	// SIGN &
-	void EventBetweenTwo(std::vector<std::string> splitedVec) {
-		std::string event = splitedVec[0];
-		std::string id1 = splitedVec[1];
-		std::string id2 = splitedVec[2];
+	// Over UDP when the client gave a port, else over TCP (where the connection compresses). cached keeps the
+	// cut frame, compressed or not, for the next client on the same baseline (nullptr when nobody else gets it)
+	void SendSnapshot(TcpConnection& connection, const SharedFrame& frame, CachedDelta* cached, std::uint32_t tick) {
+		if (!connection.HasSnapshotEndpoint()) {
+			connection.send_frame(frame);
+			return;
+		}
+		CompressionLevel level = connection.Compression();
+		SharedFrame uncached;
+		SharedFrame& datagrams = !cached ? uncached : level == CompressionLevel::Off ? cached->datagrams : cached->compressedDatagrams;
+		if (!datagrams) {
+			SharedFrame compressed = datagramCompressor.Compress(frame, level, false);
+			datagrams = fragmenter.Fragment(compressed ? compressed : frame, tick);
+		}
+		connection.count_datagram_bytes(datagrams->size());
+		network.SendDatagrams(datagrams, connection.SnapshotEndpoint());
+	}
+};
 
-		if (event == "LINK")
-		{
-			BaseShape* obj = objectList.FindByIDStr(id1);
-			BaseShape* obj2 = objectList.FindByIDStr(id2);
-			objectList.connectObjects(obj, obj2);
+// The networking and the rooms, the rooms tick on a pool sized to the cores
+class Server : public ServerNetworking {
+private:
+	TickPool pool;
+	TickSettings roomTickSettings; // For the rooms made from now on
+	std::unique_ptr<ShardNode> shardNode;          // This process is one region of a sharded world
+	std::unique_ptr<ShardCoordinator> coordinator; // ...or the process the clients of that world connect to
+
+	// The telemetry thread samples every room and client, the console shows the last sample
+	TelemetrySettings telemetrySettings;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	std::mutex metricsMutex;
+	MetricsSnapshot lastMetrics;
+	// Counters at the last sample, for the rates. only the telemetry thread
+	struct RoomCounters
+	{
+		std::uint64_t ticks = 0;
+		std::uint64_t commands = 0;
+		std::array<std::pair<std::uint64_t, std::uint64_t>, static_cast<std::size_t>(TickPhase::Count)> phases{}; // Count, total
+		std::pair<std::uint64_t, std::uint64_t> work{};
+	};
+	std::map<std::uint32_t, RoomCounters> lastRoomCounters;
+	std::map<int, std::uint64_t> lastSentBytes;
+	std::chrono::steady_clock::time_point lastSample = startTime;
+
+	std::string journalPrefix; // Every room journals its session when set, see StartJournals
+	std::string sharedPrefix;  // Every room publishes to shared memory when set, see StartSharedSnapshots
+	std::size_t sharedMaxBodies = 16384;
+
+	// <prefix>-room<id>-<unix time>.journal, a room that opens again gets a new file
+	void StartRoomJournal(Room& room) {
+		std::string path = journalPrefix + "-room" + std::to_string(room.ID()) + "-" +
+			std::to_string(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()) + ".journal";
+		if (room.StartJournal(path)) {
+			Log() << "Room " << room.ID() << " journal: " << path;
+		}
+		else {
+			Log() << "Room " << room.ID() << " is not journaled (could not open " << path << " or the room is sharded)";
+		}
+	}
+
+	// <prefix>-room<id>
+	void StartRoomSharedSnapshots(Room& room) {
+		std::string segment = sharedPrefix + "-room" + std::to_string(room.ID());
+		if (room.StartSharedSnapshots(segment, sharedMaxBodies)) {
+			Log() << "Room " << room.ID() << " snapshots in shared memory " << segment;
 		}
 	}
 
-	// SIGN ^ AND #
-	void VectorEventOnID(std::string event, std::vector<std::string> idAndVector) {
-		std::string id = idAndVector[0];
-		sf::Vector2f pos = StringToVector2f(idAndVector[1]);
-		if (event == "NEWP")
+	std::shared_ptr<Room> FindRoom(std::uint32_t id) {
+		std::lock_guard<std::mutex> lock(roomsMutex);
+		auto found = rooms.find(id);
+		return found == rooms.end() ? nullptr : found->second;
+	}
+
+	void PingClients() {
+		std::lock_guard<std::mutex> lock(connectionsMutex);
+		for (auto& conn : tcpConnections) {
+			conn.second->send_ping();
+		}
+	}
+
+	// Mean of what a histogram got since the last sample, in milliseconds
+	static double IntervalMeanMillis(const DurationHistogram& histogram, std::pair<std::uint64_t, std::uint64_t>& last) {
+		std::pair<std::uint64_t, std::uint64_t> now{ histogram.Count(), histogram.TotalMicros() };
+		double mean = now.first > last.first ? static_cast<double>(now.second - last.second) / (now.first - last.first) / 1000 : 0;
+		last = now;
+		return mean;
+	}
+
+	// Telemetry thread. The rooms and connections are copied out first so no lock is held while sampling them
+	void SampleMetrics(MetricsSnapshot& snapshot) {
+		auto now = std::chrono::steady_clock::now();
+		double interval = std::max(0.001, std::chrono::duration<double>(now - lastSample).count());
+		lastSample = now;
+		snapshot.Clear(std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+		std::vector<std::shared_ptr<Room>> roomList;
 		{
-			BaseShape* objPointer = objectList.FindByIDStr(id);
-			if (objPointer != nullptr)
-			{
-				objPointer->SetPosition(pos);
+			std::lock_guard<std::mutex> lock(roomsMutex);
+			for (const auto& room : rooms) {
+				roomList.push_back(room.second);
+			}
+		}
+		std::vector<std::shared_ptr<TcpConnection>> connections;
+		{
+			std::lock_guard<std::mutex> lock(connectionsMutex);
+			for (const auto& conn : tcpConnections) {
+				connections.push_back(conn.second);
+			}
+		}
 
+		snapshot.Add("uptime_seconds", std::chrono::duration<double>(now - startTime).count());
+		snapshot.Add("rooms", static_cast<double>(roomList.size()));
+		snapshot.Add("clients", static_cast<double>(connections.size()));
+		snapshot.Add("log_lines_dropped_total", static_cast<double>(AsyncLogger::Get().Dropped()));
+		snapshot.Add("udp_unknown_datagrams_total", static_cast<double>(unknownDatagrams.load(std::memory_order_relaxed)));
+
+		std::map<std::uint32_t, RoomCounters> roomCounters;
+		for (const std::shared_ptr<Room>& room : roomList) {
+			RoomCounters& counters = roomCounters[room->ID()];
+			counters = lastRoomCounters[room->ID()];
+			MetricsSnapshot::Labels labels{ { "room", std::to_string(room->ID()) } };
+			TickScheduler& scheduler = room->Scheduler();
+
+			std::uint64_t ticks = room->TickCount();
+			std::uint64_t commands = room->ProcessedCommands();
+			snapshot.Add("ticks_per_second", (ticks - std::min(ticks, counters.ticks)) / interval, labels);
+			snapshot.Add("tick_load", scheduler.GetLoad(), labels);
+			snapshot.Add("overload_level", scheduler.GetOverloadLevel(), labels);
+			snapshot.Add("tick_work_ms", IntervalMeanMillis(scheduler.GetWorkTimes(), counters.work), labels);
+			for (std::size_t i = 0; i < counters.phases.size(); i++) {
+				TickPhase phase = static_cast<TickPhase>(i);
+				snapshot.Add(std::string("tick_") + TickPhaseName(phase) + "_ms", IntervalMeanMillis(room->PhaseTimes().Get(phase), counters.phases[i]), labels);
 			}
+			snapshot.Add("bodies", static_cast<double>(room->BodyCount()), labels);
+			snapshot.Add("contacts", static_cast<double>(room->ContactCount()), labels);
+			snapshot.Add("room_clients", static_cast<double>(room->ClientCount()), labels);
+			snapshot.Add("commands_per_second", (commands - std::min(commands, counters.commands)) / interval, labels);
+			snapshot.Add("command_queue_depth", static_cast<double>(room->CommandQueueDepth()), labels);
+			snapshot.Add("commands_dropped_total", static_cast<double>(room->DroppedCommands()), labels);
+			snapshot.Add("commands_invalid_total", static_cast<double>(room->InvalidCommands()), labels);
+			snapshot.Add("commands_superseded_total", static_cast<double>(room->SupersededCommands()), labels);
+			snapshot.Add("shm_snapshots_total", static_cast<double>(room->SharedPublished()), labels);
+			const CompressionStats& datagramCompression = room->DatagramCompression();
+			if (datagramCompression.frames + datagramCompression.skipped > 0) {
+				snapshot.Add("udp_compression_ratio", datagramCompression.Ratio(), labels);
+				snapshot.Add("udp_compress_us", datagramCompression.MicrosPerFrame(), labels);
+			}
+			counters.ticks = ticks;
+			counters.commands = commands;
 		}
+		lastRoomCounters = std::move(roomCounters);
+
+		std::map<int, std::uint64_t> sentBytes;
+		for (const std::shared_ptr<TcpConnection>& connection : connections) {
+			TcpConnection::SendStats stats = connection->GetSendStats();
+			std::shared_ptr<Room> room = connection->GetRoom();
+			MetricsSnapshot::Labels labels{ { "client", std::to_string(connection->ID()) }, { "room", room ? std::to_string(room->ID()) : "none" } };
+			std::uint64_t sent = stats.sentBytes + stats.sentDatagramBytes;
+			std::uint64_t last = lastSentBytes.count(connection->ID()) ? lastSentBytes[connection->ID()] : 0;
+			snapshot.Add("bytes_sent_total", static_cast<double>(sent), labels);
+			snapshot.Add("udp_bytes_sent_total", static_cast<double>(stats.sentDatagramBytes), labels);
+			snapshot.Add("send_bytes_per_second", (sent - std::min(sent, last)) / interval, labels);
+			snapshot.Add("send_queue_frames", static_cast<double>(stats.queuedFrames), labels);
+			snapshot.Add("send_queue_bytes", static_cast<double>(stats.queuedBytes), labels);
+			snapshot.Add("snapshots_dropped_total", static_cast<double>(stats.droppedSnapshots), labels);
+			const CompressionStats& compression = connection->GetCompressionStats();
+			if (compression.frames + compression.skipped > 0) {
+				snapshot.Add("compression_ratio", compression.Ratio(), labels);
+				snapshot.Add("compress_us", compression.MicrosPerFrame(), labels);
+			}
+			if (connection->Rtt().HasSamples()) {
+				snapshot.Add("rtt_ms", connection->Rtt().SmoothedMillis(), labels);
+				snapshot.Add("rtt_min_ms", connection->Rtt().MinMillis(), labels);
+			}
+			sentBytes[connection->ID()] = sent;
+		}
+		lastSentBytes = std::move(sentBytes);
 	}
 
-	// SIGN @ AND @ AND @ AND @
-	void EventWithIdentifierOnID(std::vector<std::string> splitedToken) {
-		std::string event = splitedToken[0];
-		std::string type = splitedToken[1];
-		std::string id = splitedToken[2];
-		int power = std::stoi(splitedToken[3]);
-		int mouseFlagScroll = std::stoi(splitedToken[4]);
-		BaseShape* objPointer = objectList.FindByIDStr(id);
-		if (event == "SCALE")
-		{
-			handleScaling(objPointer, power, mouseFlagScroll);
+public:
+	Server(boost::asio::io_context& io_context, unsigned short tcpPort, unsigned short udpPort)
+		: ServerNetworking(io_context, tcpPort, udpPort)
+	{
+		std::lock_guard<std::mutex> lock(roomsMutex);
+		rooms[DefaultRoom] = CreateRoom(DefaultRoom);
+	}
+
+	// Workers that run the rooms, the calling thread is one of them
+	void Run(std::size_t workerCount) {
+		pool.Run(std::max<std::size_t>(1, workerCount));
+	}
+
+	// For the default room and every room made from now on. Before Run
+	void SetTickSettings(const TickSettings& settings) {
+		roomTickSettings = settings;
+		FindRoom(DefaultRoom)->SetTickSettings(settings);
+	}
+
+	// The default room becomes region index of a sharded world, the other rooms stay as they are. Before Run
+	void StartShard(boost::asio::io_context& io_context, const ShardLayout& layout, int index, const std::string& host, unsigned short basePort) {
+		shardNode = std::make_unique<ShardNode>(io_context, layout, index, host, basePort);
+		std::shared_ptr<Room> room = FindRoom(DefaultRoom);
+		room->SetShardNode(shardNode.get());
+		shardNode->Start([room](const std::uint8_t* data, std::size_t size) { room->PushBinaryMessage(data, size, 0); });
+	}
+
+	// The default room shows the whole sharded world and sends its commands to the shards. Before Run
+	void StartCoordinator(boost::asio::io_context& io_context, const ShardLayout& layout, const std::string& host, unsigned short basePort) {
+		coordinator = std::make_unique<ShardCoordinator>(io_context, layout, host, basePort);
+		FindRoom(DefaultRoom)->SetCoordinator(coordinator.get());
+		coordinator->Start();
+		Log() << "Coordinator of " << layout.Count() << " shards (" << layout.columns << " x " << layout.rows << ")";
+	}
+
+	// Records the session of every room to a journal of its own from now on (server --replay runs one again).
+	// After StartShard / StartCoordinator, before Run
+	void StartJournals(const std::string& prefix) {
+		journalPrefix = prefix;
+		StartRoomJournal(*FindRoom(DefaultRoom));
+	}
+
+	// Readers on this machine map <prefix>-room<id> instead of connecting (SharedSnapshot.h). Before Run
+	void StartSharedSnapshots(const std::string& prefix, std::size_t maxBodies) {
+		sharedPrefix = prefix;
+		sharedMaxBodies = maxBodies;
+		StartRoomSharedSnapshots(*FindRoom(DefaultRoom));
+	}
+
+	// Pings the clients and samples the metrics every sampleSeconds, dumps them every dumpSeconds if there is a path
+	void StartTelemetry(const TelemetrySettings& settings) {
+		telemetrySettings = settings;
+		telemetrySettings.sampleSeconds = std::max(0.1f, telemetrySettings.sampleSeconds);
+		std::thread telemetry_thread([this]() {
+			MetricsFile file(telemetrySettings.path, telemetrySettings.format);
+			MetricsSnapshot snapshot;
+			auto sampleEvery = std::chrono::milliseconds(static_cast<long long>(telemetrySettings.sampleSeconds * 1000));
+			auto dumpEvery = std::chrono::milliseconds(static_cast<long long>(telemetrySettings.dumpSeconds * 1000));
+			auto nextDump = std::chrono::steady_clock::now() + dumpEvery;
+			while (true) {
+				std::this_thread::sleep_for(sampleEvery);
+				PingClients();
+				SampleMetrics(snapshot);
+				if (file.Enabled() && std::chrono::steady_clock::now() >= nextDump) {
+					if (!file.Write(snapshot)) {
+						Log() << "Could not write the metrics to " << telemetrySettings.path;
+					}
+					nextDump += dumpEvery;
+				}
+				std::lock_guard<std::mutex> lock(metricsMutex);
+				std::swap(lastMetrics, snapshot);
+			}
+			});
+		telemetry_thread.detach();
+		if (!telemetrySettings.path.empty()) {
+			Log() << "Metrics every " << telemetrySettings.dumpSeconds << " s to " << telemetrySettings.path;
 		}
 	}
-	void createPlanet(sf::Vector2f(currentMousePos)) {
-		planetMode = true;
-		objectList.CreateNewPlanet(7000, ball_color, currentMousePos, 20, 5.9722 * pow(10, 15));
-		objCount++;
+
+	std::shared_ptr<Room> CreateRoom(std::uint32_t id) override {
+		auto room = std::make_shared<Room>(*this, id, roomTickSettings);
+		if (!journalPrefix.empty()) {
+			StartRoomJournal(*room);
+		}
+		if (!sharedPrefix.empty()) {
+			StartRoomSharedSnapshots(*room);
+		}
+		pool.Add(room);
+		return room;
 	}
 
-	void handleScaling(BaseShape* objPointer, int power, int mouseFlagScroll) {
-		if (mouseFlagScroll == 1 || mouseFlagScroll == -1) {
-			if (Circle* circle = dynamic_cast<Circle*>(objPointer)) {
-				scaleCircle(circle, power, mouseFlagScroll);
+	// Console thread
+	bool HandleConsoleCommand(const std::string& input) override {
+		if (input == "rooms") {
+			std::lock_guard<std::mutex> lock(roomsMutex);
+			std::cout << rooms.size() << " rooms on " << pool.TaskCount() << " tasks" << std::endl;
+			for (const auto& room : rooms) {
+				TickScheduler& scheduler = room.second->Scheduler();
+				std::cout << "Room " << room.first << ": " << room.second->ClientCount() << " clients, " << room.second->BodyCount()
+					<< " bodies, load " << scheduler.GetLoad() << ", overload level " << scheduler.GetOverloadLevel() << ", commands "
+					<< room.second->DroppedCommands() << " dropped / " << room.second->InvalidCommands() << " invalid" << std::endl;
 			}
-			else if (RectangleClass* rectangle = dynamic_cast<RectangleClass*>(objPointer))
-			{
-				scaleRectangle(rectangle, power , mouseFlagScroll);
+			return true;
+		}
+		if (input == "stats") {
+			std::lock_guard<std::mutex> lock(metricsMutex);
+			if (lastMetrics.Samples().empty()) {
+				std::cout << "No sample yet" << std::endl;
+				return true;
 			}
+			lastMetrics.WriteTable(std::cout);
+			return true;
 		}
+		if (input == "shards") {
+			if (shardNode) {
+				ShardNode::Stats stats = shardNode->GetStats();
+				std::cout << "Shard " << shardNode->Index() << " of " << shardNode->Layout().Count() << (shardNode->Connected() ? ", running" : ", waiting for the others")
+					<< ": halo " << stats.haloSent << " sent / " << stats.haloReceived << " received, migrated " << stats.migratedOut << " out / "
+					<< stats.migratedIn << " in (" << stats.linksCut << " links cut), " << stats.stalls << " stalls, " << stats.stale << " late exchanges (halo dropped)" << std::endl;
+			}
+			else if (coordinator) {
+				ShardCoordinator::Stats stats = coordinator->GetStats();
+				std::cout << "Coordinator: " << coordinator->ConnectedCount() << "/" << coordinator->Layout().Count() << " shards connected, "
+					<< stats.merges << " merges, " << stats.routed << " commands routed, " << stats.unrouted << " unrouted" << std::endl;
+			}
+			else {
+				std::cout << "Not sharded" << std::endl;
+			}
+			return true;
+		}
+		if (input.starts_with("ticks")) {
+			// "ticks [room]" and "ticks reset [room]", the default room when none is given
+			std::string_view rest = std::string_view(input).substr(5);
+			bool reset = CommandText::Trim(rest).starts_with("reset");
+			if (reset) {
+				rest = CommandText::Trim(rest).substr(5);
+			}
+			std::uint32_t id = DefaultRoom;
+			if (!CommandText::Trim(rest).empty() && !CommandText::Number(rest, id)) {
+				return false;
+			}
+			std::shared_ptr<Room> room = FindRoom(id);
+			if (!room) {
+				std::cout << "Room " << id << " not found" << std::endl;
+				return true;
+			}
+			TickScheduler& scheduler = room->Scheduler();
+			if (reset) {
+				scheduler.ResetStats();
+				return true;
+			}
+			const TickSettings& settings = scheduler.GetSettings();
+			std::cout << "Room " << id << ": " << settings.tickRate << " ticks/s, snapshot every " << scheduler.BroadcastInterval()
+				<< " ticks, load " << scheduler.GetLoad() << ", overload level " << scheduler.GetOverloadLevel() << "/" << settings.policies.size()
+				<< ", " << scheduler.GetSkippedBroadcasts() << " broadcasts skipped, " << scheduler.GetLateTicks()
+				<< " ticks late, " << scheduler.GetDroppedTicks() << " ticks dropped" << std::endl;
+			scheduler.GetWorkTimes().Print(std::cout, "Tick work");
+			scheduler.GetWakeDelays().Print(std::cout, "Wake delay");
+			return true;
+		}
+		return false;
 	}
+};
 
-	void scaleCircle(Circle* circle, int mouseScrollPower, int mouseFlagScroll) {
-		if (mouseFlagScroll ==-1 && circle->getRadius() > 0.0001) {
-			circle->SetRadiusAndCenter(circle->getRadius() - mouseScrollPower);
-			circle->SetMass(circle->GetMass() - mouseScrollPower * 10);
+inline void ServerNetworking::JoinRoom(const std::shared_ptr<TcpConnection>& connection, std::uint32_t room_id) {
+	std::shared_ptr<Room> room;
+	{
+		// Under the lock so a room that is closing can not take the client with it (see CloseRoom)
+		std::lock_guard<std::mutex> lock(roomsMutex);
+		auto found = rooms.find(room_id);
+		if (found != rooms.end()) {
+			room = found->second;
+		}
+		else if (rooms.size() < MaxRooms) {
+			room = CreateRoom(room_id);
+			rooms[room_id] = room;
+			Log() << "Room " << room_id << " opened";
 		}
 		else {
-			circle->SetRadiusAndCenter(circle->getRadius() + mouseScrollPower);
-			circle->SetMass(circle->GetMass() + mouseScrollPower * 10);
+			room = rooms[DefaultRoom];
+			Log() << "Room limit reached, client " << connection->ID() << " goes to the default room";
 		}
+		room->AddClient(connection);
+	}
+	connection->SetRoom(room);
+	connection->send_message("room:" + std::to_string(room->ID()));
+	Log() << "Client " << connection->ID() << " joined room " << room->ID();
+}
+
+// From the room's own tick. false when someone is joining it, it then stays open
+inline bool ServerNetworking::CloseRoom(Room& room) {
+	std::lock_guard<std::mutex> lock(roomsMutex);
+	if (room.HasJoining()) {
+		return false;
 	}
+	rooms.erase(room.ID());
+	Log() << "Room " << room.ID() << " closed";
+	return true;
+}
 
-	void scaleRectangle(RectangleClass* rectangle, int mouseScrollPower, int mouseFlagScroll) {
-		if (mouseFlagScroll==-1 && rectangle->GetHeight() > 0.0001 && rectangle->GetWidth() > 0.0001) {
-			rectangle->SetSizeAndOrigin(rectangle->GetWidth() - mouseScrollPower, rectangle->GetHeight() - mouseScrollPower);
-			rectangle->SetMass(rectangle->GetMass() - mouseScrollPower * 10);
+inline void ServerNetworking::HandleClientDisconnect(int client_id) {
+	std::shared_ptr<TcpConnection> connection;
+	{
+		std::lock_guard<std::mutex> lock(connectionsMutex);
+		auto it = tcpConnections.find(client_id);
+		if (it == tcpConnections.end()) {
+			return;
 		}
-		else {
-			rectangle->SetSizeAndOrigin(rectangle->GetWidth() + mouseScrollPower, rectangle->GetHeight() + mouseScrollPower);
-			rectangle->SetMass(rectangle->GetMass() + mouseScrollPower * 10);
+		connection = it->second;
+		tcpConnections.erase(it);
+		for (auto udpClient = udpClients.begin(); udpClient != udpClients.end(); ) {
+			udpClient = udpClient->second == client_id ? udpClients.erase(udpClient) : std::next(udpClient);
 		}
 	}
+	Log() << "Client " << client_id << " disconnected from "
+		<< connection->Address() << ":" << connection->Port();
+	if (std::shared_ptr<Room> room = connection->GetRoom()) {
+		room->RemoveClient(client_id);
+	}
+}
+
+inline void ServerNetworking::HandleClientMessage(std::string_view message, TcpConnection& connection) {
+	if (std::shared_ptr<Room> room = connection.GetRoom()) {
+		room->PushTextMessage(message, connection.ID());
+	}
+}
+
+inline void ServerNetworking::HandleClientCommands(const std::uint8_t* data, std::size_t size, TcpConnection& connection) {
+	if (std::shared_ptr<Room> room = connection.GetRoom()) {
+		room->PushBinaryMessage(data, size, connection.ID());
+	}
+}
+
+// The room of the client that sent from this endpoint and its id, nullptr for a sender no client registered
+// with "udp:" (or one that is not in a room yet)
+inline std::shared_ptr<Room> ServerNetworking::UdpSenderRoom(const udp::endpoint& sender, int& client_id) {
+	std::shared_ptr<TcpConnection> connection;
+	{
+		std::lock_guard<std::mutex> lock(connectionsMutex);
+		auto found = udpClients.find(sender);
+		if (found != udpClients.end()) {
+			auto client = tcpConnections.find(found->second);
+			if (client != tcpConnections.end()) {
+				connection = client->second;
+			}
+		}
+	}
+	client_id = connection ? connection->ID() : 0;
+	return connection ? connection->GetRoom() : nullptr;
+}
+
+inline void ServerNetworking::HandleUdpCommands(const std::uint8_t* data, std::size_t size) {
+	int client_id = 0;
+	std::shared_ptr<Room> room = UdpSenderRoom(udpSenderEndpoint, client_id);
+	if (!room) {
+		unknownDatagrams.fetch_add(1, std::memory_order_relaxed); // UDP has no handshake, anyone could send here
+		return;
+	}
+	if (IsBinaryCommandMessage(data, size)) {
+		room->PushBinaryMessage(data, size, client_id); // The id is where the input sequence is acknowledged
+	}
+	else {
+		room->PushTextMessage(std::string_view(reinterpret_cast<const char*>(data), size), client_id);
+	}
+}
+
+inline std::string ServerNetworking::RoomName(TcpConnection& connection) {
+	std::shared_ptr<Room> room = connection.GetRoom();
+	return room ? " in room " + std::to_string(room->ID()) : std::string(" (no room yet)");
+}
+
+// How this process runs, from the command line:
+//   server                                            the whole world in this process
+//   server --shard <i> --shards <n> [--rows <r>]      region i of a world cut into n regions (n / r columns, r rows)
+//   server --coordinator --shards <n> [--rows <r>]    the process the clients of that world connect to
+// with --tcp / --udp for the client ports, --shard-host / --shard-port for where the shards listen (port + i)
+// and --halo for the halo width. On one box: the shards, then the coordinator, then the clients as usual.
+// --metrics <file> dumps the metrics every --metrics-seconds, --metrics-format json (lines) or prometheus.
+// --journal <prefix> records every room's session, server --replay <file> runs one again headless and flat out.
+// --tick-rate / --broadcast-rate are ticks and snapshots per second of every room, --substeps the physics steps
+// per tick and --min-substeps what an overloaded room goes down to.
+// --shm <prefix> publishes every room's snapshots to shared memory <prefix>-room<id> for local readers, slots
+// for --shm-bodies bodies. --compress off|fast|high is the most snapshot compression a client that asks gets (fast).
+struct LaunchOptions
+{
+	unsigned short tcpPort = 8080;
+	unsigned short udpPort = 8081;
+	int shard = -1;
+	bool coordinator = false;
+	int shardCount = 1;
+	int rows = 1;
+	float halo = 100;
+	std::string shardHost = "127.0.0.1";
+	unsigned short shardPort = 9000;
+	bool portsGiven = false;
+	TelemetrySettings telemetry;
+	std::string journalPrefix;
+	std::string replayPath;
+	std::string sharedPrefix;
+	std::size_t sharedMaxBodies = 16384;
+	CompressionLevel compression = CompressionLevel::Fast;
+	TickSettings tickSettings;
+
+	bool Parse(int argc, char* argv[]) {
+		for (int i = 1; i < argc; i++) {
+			std::string_view option = argv[i];
+			if (option == "--coordinator") {
+				coordinator = true;
+				continue;
+			}
+			if (i + 1 >= argc) {
+				std::cerr << "Missing value for " << option << std::endl;
+				return false;
+			}
+			std::string_view value = argv[++i];
+			bool ok = false;
+			if (option == "--tcp") {
+				ok = CommandText::Number(value, tcpPort);
+				portsGiven = true;
+			}
+			else if (option == "--udp") {
+				ok = CommandText::Number(value, udpPort);
+				portsGiven = true;
+			}
+			else if (option == "--shard") {
+				ok = CommandText::Number(value, shard);
+			}
+			else if (option == "--shards") {
+				ok = CommandText::Number(value, shardCount);
+			}
+			else if (option == "--rows") {
+				ok = CommandText::Number(value, rows);
+			}
+			else if (option == "--halo") {
+				ok = CommandText::Number(value, halo);
+			}
+			else if (option == "--shard-host") {
+				shardHost = std::string(value);
+				ok = true;
+			}
+			else if (option == "--shard-port") {
+				ok = CommandText::Number(value, shardPort);
+			}
+			else if (option == "--metrics") {
+				telemetry.path = std::string(value);
+				ok = true;
+			}
+			else if (option == "--metrics-seconds") {
+				ok = CommandText::Number(value, telemetry.dumpSeconds);
+			}
+			else if (option == "--journal") {
+				journalPrefix = std::string(value);
+				ok = !journalPrefix.empty();
+			}
+			else if (option == "--shm") {
+				sharedPrefix = std::string(value);
+				ok = !sharedPrefix.empty();
+			}
+			else if (option == "--compress") {
+				ok = ParseCompressionLevel(value, compression);
+			}
+			else if (option == "--shm-bodies") {
+				ok = CommandText::Number(value, sharedMaxBodies);
+			}
+			else if (option == "--replay") {
+				replayPath = std::string(value);
+				ok = !replayPath.empty();
+			}
+			else if (option == "--tick-rate") {
+				ok = CommandText::Number(value, tickSettings.tickRate) && tickSettings.tickRate > 0;
+			}
+			else if (option == "--broadcast-rate") {
+				ok = CommandText::Number(value, tickSettings.broadcastRate) && tickSettings.broadcastRate > 0;
+			}
+			else if (option == "--substeps") {
+				ok = CommandText::Number(value, tickSettings.substeps) && tickSettings.substeps > 0;
+			}
+			else if (option == "--min-substeps") {
+				ok = CommandText::Number(value, tickSettings.minSubsteps) && tickSettings.minSubsteps > 0;
+			}
+			else if (option == "--metrics-format") {
+				ok = value == "json" || value == "prometheus";
+				telemetry.format = value == "prometheus" ? MetricsFormat::Prometheus : MetricsFormat::JsonLines;
+			}
+			if (!ok) {
+				std::cerr << "Bad option " << option << " " << value << std::endl;
+				return false;
+			}
+		}
+		if (shardCount < 1 || rows < 1 || shardCount % rows != 0 || (coordinator && shard >= 0) || shard >= shardCount) {
+			std::cerr << "--shards must be a multiple of --rows, --shard below --shards, and not both --shard and --coordinator" << std::endl;
+			return false;
+		}
+		if (tickSettings.minSubsteps > tickSettings.substeps) {
+			std::cerr << "--min-substeps must not be above --substeps (" << tickSettings.substeps << ")" << std::endl;
+			return false;
+		}
+		// Every shard also takes clients (they see its region only), on its own ports unless told otherwise
+		if (shard >= 0 && !portsGiven) {
+			tcpPort = static_cast<unsigned short>(8100 + shard * 2);
+			udpPort = static_cast<unsigned short>(8101 + shard * 2);
+		}
+		return true;
+	}
+
+	ShardLayout Layout() const {
+		ShardLayout layout;
+		layout.columns = shardCount / rows;
+		layout.rows = rows;
+		layout.area = SimRect(0, 0, static_cast<float>(poptions.window_width), static_cast<float>(poptions.window_height));
+		layout.halo = halo;
+		return layout;
+	}
 };
 
-int main() {
+// Runs a journal's session again without networking and without waiting for the tick time, checks the world
+// against every checkpoint the room wrote and prints how long the ticks took
+inline int ReplayJournal(const std::string& path) {
+	JournalReader reader;
+	if (!reader.Open(path)) {
+		std::cerr << "Not a journal (or another version): " << path << std::endl;
+		return 1;
+	}
+	const JournalScene& scene = reader.Scene();
+	RoomSimulation simulation;
+	simulation.ApplyScene(scene);
+	std::cout << "Replaying room " << scene.room << ": " << scene.tickRate << " ticks/s, " << scene.substeps << " substeps, seeds "
+		<< scene.objectSeed << " / " << scene.linkSeed << std::endl;
+
+	int substeps = static_cast<int>(scene.substeps);
+	std::uint32_t tick = 0;
+	std::uint64_t commands = 0;
+	std::uint64_t matched = 0;
+	std::uint64_t mismatched = 0;
+	std::int64_t firstMismatch = -1;
+	DurationHistogram tickTimes;
+	JournalEntry entry;
+	bool pending = reader.Next(entry);
+	auto start = std::chrono::steady_clock::now();
+	while (pending && entry.tick >= tick) {
+		// The commands of the tick, its physics, then its checkpoint: the order the room did them in
+		auto tickStart = std::chrono::steady_clock::now();
+		for (; pending && entry.tick == tick && entry.kind != JournalRecord::Checkpoint; pending = reader.Next(entry)) {
+			if (entry.kind == JournalRecord::Command) {
+				simulation.TranslateEvent(entry.command);
+				commands++;
+			}
+			else if (entry.kind == JournalRecord::Substeps) {
+				substeps = entry.substeps;
+			}
+		}
+		simulation.Step(substeps, scene.tickRate);
+		tickTimes.Record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - tickStart).count());
+		for (; pending && entry.tick == tick && entry.kind == JournalRecord::Checkpoint; pending = reader.Next(entry)) {
+			const std::vector<BaseShape*>& shapes = simulation.Shapes();
+			if (entry.bodies == shapes.size() && entry.hash == JournalHash(shapes)) {
+				matched++;
+			}
+			else {
+				mismatched++;
+				if (firstMismatch < 0) {
+					firstMismatch = tick;
+				}
+			}
+		}
+		tick++;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << tick << " ticks (" << tick / scene.tickRate << " s of play) in " << seconds << " s, "
+		<< (seconds > 0 ? tick / seconds : 0) << " ticks/s, " << commands << " commands, " << simulation.Shapes().size() << " bodies at the end" << std::endl;
+	std::cout << "Checkpoints: " << matched << " matched, " << mismatched << " differ";
+	if (firstMismatch >= 0) {
+		std::cout << " (first at tick " << firstMismatch << ")";
+	}
+	std::cout << std::endl;
+	tickTimes.Print(std::cout, "Tick");
+	return mismatched == 0 ? 0 : 2;
+}
+
+int main(int argc, char* argv[]) {
 	try {
+		LaunchOptions launch;
+		if (!launch.Parse(argc, argv)) {
+			return 1;
+		}
+		if (!launch.replayPath.empty()) {
+			return ReplayJournal(launch.replayPath);
+		}
 		boost::asio::io_context io_context;
-		unsigned short tcp_port = 8080;
-		unsigned short udp_port = 8081;
+		unsigned short tcp_port = launch.tcpPort;
+		unsigned short udp_port = launch.udpPort;
 
 		// Create server without window dependency
 		Server server(io_context, tcp_port, udp_port);
+		server.SetSnapshotCompression(launch.compression);
+		server.SetTickSettings(launch.tickSettings);
+		if (launch.shard >= 0) {
+			server.StartShard(io_context, launch.Layout(), launch.shard, launch.shardHost, launch.shardPort);
+		}
+		else if (launch.coordinator) {
+			server.StartCoordinator(io_context, launch.Layout(), launch.shardHost, launch.shardPort);
+		}
+		if (!launch.journalPrefix.empty()) {
+			server.StartJournals(launch.journalPrefix);
+		}
+		if (!launch.sharedPrefix.empty()) {
+			server.StartSharedSnapshots(launch.sharedPrefix, launch.sharedMaxBodies);
+		}
 		server.Start();
+		server.StartTelemetry(launch.telemetry);
 
 		std::cout << "\nServer commands:" << std::endl;
 		std::cout << "b:<message> - Broadcast message to all clients" << std::endl;
 		std::cout << "s: - broadcast shapes to all clients" << std::endl;
 		std::cout << "c:<client_id> <message> - send message to specific client" << std::endl;
-		std::cout << "list - list all connected clients" << std::endl;
+		std::cout << "list - list all connected clients and their rooms" << std::endl;
+		std::cout << "rooms - clients, bodies, load and dropped commands of every room" << std::endl;
+		std::cout << "ticks [room] - tick rate, load, overload level and tick time histograms (ticks reset [room] - clear them)" << std::endl;
+		std::cout << "queues - send queue size and dropped snapshots of every client" << std::endl;
+		std::cout << "shards - halo, migration and merge counts of a sharded world" << std::endl;
+		std::cout << "stats - ticks/s, tick phases, bodies, contacts, commands/s, bytes sent, send queues and round trip times" << std::endl;
 
 		// Create threads
 		std::vector<std::thread> threads;
 		const int thread_count = std::thread::hardware_concurrency();
 
-		// Physics thread
-		threads.emplace_back([&server]() {
+		// Room workers, every room is a task on this pool instead of a thread of its own
+		threads.emplace_back([&server, thread_count]() {
 			try {
-				server.Run();
+				server.Run(thread_count);
 			}
 			catch (const std::exception& e) {
-				std::cerr << "Exception in physics thread: " << e.what() << std::endl;
+				std::cerr << "Exception in room workers: " << e.what() << std::endl;
 			}
 			});
 
-		// Network threads
-		for (int i = 1; i < thread_count; ++i) {
+		// Network threads, at least one (a shard's tick waits for its neighbours' frames on them)
+		for (int i = 1; i < std::max(2, thread_count); ++i) {
 			threads.emplace_back([&io_context]() {
 				try {
 					io_context.run();
@@ -0,0 +1,798 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <iostream>
+#include <array>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "../PhysicSSimulator/Sharding.h"
+#include "../PhysicSSimulator/Snapshot.h"
+#include "../PhysicSSimulator/DeltaSnapshot.h"
+#include "../PhysicSSimulator/SnapshotProxies.h"
+#include "../PhysicSSimulator/CommandProtocol.h"
+#include "../PhysicSSimulator/ObjectsList.h"
+#include "../PhysicSSimulator/Telemetry.h"
+
+// The links between the server processes of a sharded world (see Sharding.h for the layout and the frames).
+// Every shard listens on its own port (basePort + index) and calls the shards before it, the coordinator calls
+// every shard. All on one box is 127.0.0.1 and a few ports
+
+// A framed TCP link to another server process. Any thread can send, the frames that come in go to the handler
+// on an io thread, one at a time
+class ShardLink : public std::enable_shared_from_this<ShardLink> {
+public:
+	using FrameHandler = std::function<void(ShardLink&, NetMessageType, const std::uint8_t*, std::size_t)>;
+	using CloseHandler = std::function<void(ShardLink&)>;
+
+	ShardLink(boost::asio::ip::tcp::socket socket) : socket_(std::move(socket)) {
+		boost::system::error_code ec;
+		socket_.set_option(boost::asio::ip::tcp::no_delay(true), ec); // A tick waits for these frames
+	}
+
+	void start(FrameHandler on_frame, CloseHandler on_close) {
+		on_frame_ = std::move(on_frame);
+		on_close_ = std::move(on_close);
+		read_header();
+	}
+
+	// Who is on the other side, from its ShardHello. -1 until then
+	int peer = -1;
+	ShardRole role = ShardRole::Shard;
+
+	void send_frame(SharedFrame frame) {
+		bool start_write = false;
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex_);
+			if (closed_) {
+				return;
+			}
+			message_queue_.push_back(std::move(frame));
+			if (!write_in_progress_) {
+				write_in_progress_ = true;
+				start_write = true;
+			}
+		}
+		if (start_write) {
+			auto self(shared_from_this());
+			boost::asio::post(socket_.get_executor(), [this, self]() { do_write(); });
+		}
+	}
+
+	void close() {
+		auto self(shared_from_this());
+		boost::asio::post(socket_.get_executor(), [this, self]() {
+			boost::system::error_code ec;
+			socket_.close(ec);
+			});
+	}
+
+private:
+	void read_header() {
+		auto self(shared_from_this());
+		boost::asio::async_read(socket_, boost::asio::buffer(header_),
+			[this, self](boost::system::error_code ec, std::size_t /*length*/) {
+				std::uint32_t size = NetFrame::ReadPayloadSize(header_.data());
+				if (ec || size > NetFrame::MaxPayloadSize) {
+					closed();
+					return;
+				}
+				payload_.resize(size);
+				boost::asio::async_read(socket_, boost::asio::buffer(payload_),
+					[this, self](boost::system::error_code ec, std::size_t /*length*/) {
+						if (ec) {
+							closed();
+							return;
+						}
+						on_frame_(*this, NetFrame::ReadType(header_.data()), payload_.data(), payload_.size());
+						read_header();
+					});
+			});
+	}
+
+	void do_write() {
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex_);
+			write_buffers_.clear();
+			for (const SharedFrame& frame : message_queue_) {
+				write_buffers_.push_back(boost::asio::buffer(*frame));
+			}
+			in_flight_count_ = message_queue_.size();
+		}
+		auto self(shared_from_this());
+		boost::asio::async_write(socket_, write_buffers_,
+			[this, self](boost::system::error_code ec, std::size_t /*length*/) {
+				bool more = false;
+				{
+					std::lock_guard<std::mutex> lock(queue_mutex_);
+					message_queue_.erase(message_queue_.begin(), message_queue_.begin() + in_flight_count_);
+					in_flight_count_ = 0;
+					more = !ec && !message_queue_.empty();
+					write_in_progress_ = more;
+				}
+				if (more) {
+					do_write();
+				}
+				else if (ec) {
+					boost::system::error_code ignored;
+					socket_.close(ignored); // The read fails and reports the close
+				}
+			});
+	}
+
+	void closed() {
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex_);
+			if (closed_) {
+				return;
+			}
+			closed_ = true;
+			message_queue_.clear();
+		}
+		boost::system::error_code ec;
+		socket_.close(ec);
+		on_close_(*this);
+	}
+
+	boost::asio::ip::tcp::socket socket_;
+	std::array<std::uint8_t, NetFrame::HeaderSize> header_{};
+	std::vector<std::uint8_t> payload_; // Reused for every frame, the handler reads it in place
+	FrameHandler on_frame_;
+	CloseHandler on_close_;
+	std::mutex queue_mutex_;
+	std::deque<SharedFrame> message_queue_;
+	std::size_t in_flight_count_ = 0;
+	std::vector<boost::asio::const_buffer> write_buffers_;
+	bool write_in_progress_ = false;
+	bool closed_ = false;
+};
+
+// Connects to another server process, again every half second until it is up. connected gets the socket
+inline void DialShard(boost::asio::io_context& io_context, boost::asio::ip::tcp::endpoint endpoint,
+	std::function<void(boost::asio::ip::tcp::socket)> connected) {
+	auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_context);
+	socket->async_connect(endpoint, [&io_context, endpoint, socket, connected](boost::system::error_code ec) {
+		if (!ec) {
+			connected(std::move(*socket));
+			return;
+		}
+		auto timer = std::make_shared<boost::asio::steady_timer>(io_context, std::chrono::milliseconds(500));
+		timer->async_wait([&io_context, endpoint, timer, connected](boost::system::error_code /*ec*/) {
+			DialShard(io_context, endpoint, connected);
+			});
+		});
+}
+
+// This process simulates one region of the world. The room that owns the world calls Send and Receive before its
+// physics and Settle after it, from its tick; everything else runs on the io threads.
+// The shards run in lock step: every tick each shard sends one exchange to every other shard and waits for one
+// from each of them, so no shard gets ahead of its neighbours' halo. The exchanges carry their tick, one that
+// comes in after its tick went on without it only gives its migrants (the sender deleted them already), its halo
+// is out of date. A shard that is not connected stops the ticks of
+// the others until it is back
+class ShardNode {
+public:
+	struct Stats
+	{
+		std::uint64_t haloSent = 0;
+		std::uint64_t haloReceived = 0;
+		std::uint64_t migratedOut = 0;
+		std::uint64_t migratedIn = 0;
+		std::uint64_t stalls = 0; // Exchanges that did not come in time, the tick went on without them
+		std::uint64_t stale = 0;  // Exchanges that came after that, only their migrants were taken
+		std::uint64_t linksCut = 0; // Links of a migrant to a body that did not go with it
+	};
+
+private:
+	boost::asio::io_context& io_context;
+	ShardLayout layout;
+	int index;
+	boost::asio::ip::address host;
+	unsigned short basePort;
+	boost::asio::ip::tcp::acceptor acceptor;
+	std::chrono::milliseconds exchangeTimeout = std::chrono::milliseconds(1000);
+
+	struct Peer
+	{
+		std::shared_ptr<ShardLink> link;
+		std::deque<std::vector<std::uint8_t>> inbox; // Exchange payloads that came in, oldest first (the tick is first)
+		ShardExchangeWriter writer;                  // Only the simulation thread
+	};
+	std::mutex mutex; // The links and the inboxes
+	std::vector<Peer> peers; // By shard index, the own slot stays empty
+	std::shared_ptr<ShardLink> coordinator;
+	std::vector<std::vector<std::uint8_t>> spare; // Payload buffers that were read, so the inboxes do not allocate
+	std::vector<std::vector<std::uint8_t>> late;  // Exchanges whose tick went by (or whose link closed), for their migrants
+	std::function<void(const std::uint8_t*, std::size_t)> onCommands;
+
+	// Only the simulation thread
+	std::vector<std::vector<std::uint8_t>> received;
+	std::vector<std::vector<std::uint8_t>> receivedLate;
+	std::chrono::steady_clock::time_point waitingSince; // First Receive of the tick
+	bool waiting = false;
+	SnapshotState haloState;
+	std::vector<BaseShape*> ghosts; // The halo of the neighbours, at the end of the world's objList during the physics
+	SnapshotProxyPool ghostPool;
+	std::vector<std::pair<BaseShape*, int>> leaving;   // And the shard it goes to
+	std::unordered_map<BaseShape*, int> leavingOwner;
+	std::unordered_map<std::uint32_t, BaseShape*> arrivedBodies; // The migrants of one exchange by id, for their links
+	SnapshotWriter worldWriter;
+
+	std::mutex statsMutex;
+	Stats stats;
+
+public:
+	ShardNode(boost::asio::io_context& io_context, const ShardLayout& layout, int index, const std::string& host, unsigned short basePort)
+		: io_context(io_context),
+		layout(layout),
+		index(index),
+		host(boost::asio::ip::make_address(host)),
+		basePort(basePort),
+		acceptor(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), static_cast<unsigned short>(basePort + index))),
+		peers(layout.Count())
+	{
+		Log() << "Shard " << index << " of " << layout.Count() << " listens for its neighbours on port " << basePort + index;
+	}
+
+	ShardNode(const ShardNode&) = delete;
+	ShardNode& operator=(const ShardNode&) = delete;
+
+	// commands gets the binary command messages the coordinator routes here, on an io thread
+	void Start(std::function<void(const std::uint8_t*, std::size_t)> commands) {
+		onCommands = std::move(commands);
+		Accept();
+		for (int shard = 0; shard < index; shard++) {
+			Dial(shard);
+		}
+	}
+
+	int Index() const { return index; }
+	const ShardLayout& Layout() const { return layout; }
+
+	// Every other shard is connected, the ticks only run then
+	bool Connected() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int shard = 0; shard < static_cast<int>(peers.size()); shard++) {
+			if (shard != index && !peers[shard].link) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	Stats GetStats() {
+		std::lock_guard<std::mutex> lock(statsMutex);
+		return stats;
+	}
+
+	// Before the physics of a tick: sends this shard's halo and the bodies that left it last tick to the others
+	void Send(ObjectsList& world, std::uint32_t tick) {
+		std::uint64_t haloSent = 0;
+		for (int shard = 0; shard < static_cast<int>(peers.size()); shard++) {
+			if (shard == index) {
+				continue;
+			}
+			Peer& peer = peers[shard];
+			std::shared_ptr<ShardLink> link;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				link = peer.link;
+			}
+			if (!link) {
+				continue; // Its migrants wait in the writer until it is back
+			}
+			if (layout.Neighbours(index, shard)) {
+				for (BaseShape* obj : world.objList) {
+					if (layout.InHalo(shard, obj->GetPosition())) {
+						peer.writer.AddHalo(BodyRecord::FromShape(obj));
+						haloSent++;
+					}
+				}
+			}
+			link->send_frame(peer.writer.Write(tick));
+			peer.writer.Clear();
+		}
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats.haloSent += haloSent;
+	}
+
+	// After Send, until it returns true: takes the exchanges of tick from the others, the bodies that came in and
+	// the neighbours' halo at the end of the world. Never waits, false while one is still missing (the room tries
+	// again a little later); after exchangeTimeout the tick goes on without it
+	bool Receive(ObjectsList& world, std::uint32_t tick) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (!waiting) {
+			waiting = true;
+			waitingSince = now;
+		}
+		bool stalled = false;
+		std::uint64_t stale = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			bool allThere = true;
+			for (int shard = 0; shard < static_cast<int>(peers.size()); shard++) {
+				Peer& peer = peers[shard];
+				while (!peer.inbox.empty() && InboxTick(peer.inbox.front()) < tick) {
+					late.push_back(std::move(peer.inbox.front()));
+					peer.inbox.pop_front();
+					stale++;
+				}
+				if (shard != index && peer.link && (peer.inbox.empty() || InboxTick(peer.inbox.front()) != tick)) {
+					allThere = false;
+				}
+			}
+			if (!allThere && now - waitingSince < exchangeTimeout) {
+				std::lock_guard<std::mutex> statsLock(statsMutex);
+				stats.stale += stale;
+				return false;
+			}
+			stalled = !allThere;
+			for (Peer& peer : peers) {
+				if (!peer.inbox.empty() && InboxTick(peer.inbox.front()) == tick) {
+					received.push_back(std::move(peer.inbox.front()));
+					peer.inbox.pop_front();
+				}
+			}
+			receivedLate.swap(late);
+		}
+		waiting = false;
+
+		std::uint64_t migratedIn = 0;
+		haloState.bodies.clear();
+		for (const std::vector<std::uint8_t>& payload : receivedLate) {
+			ShardExchangeReader reader;
+			if (reader.Parse(payload.data(), payload.size())) {
+				migratedIn += TakeMigrants(world, reader);
+			}
+		}
+		for (const std::vector<std::uint8_t>& payload : received) {
+			ShardExchangeReader reader;
+			if (!reader.Parse(payload.data(), payload.size())) {
+				continue;
+			}
+			for (std::uint32_t i = 0; i < reader.GetHaloCount(); i++) {
+				haloState.bodies.push_back(reader.GetHalo(i));
+			}
+			migratedIn += TakeMigrants(world, reader);
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (std::vector<std::uint8_t>& payload : received) {
+				spare.push_back(std::move(payload));
+			}
+			for (std::vector<std::uint8_t>& payload : receivedLate) {
+				spare.push_back(std::move(payload));
+			}
+		}
+		received.clear();
+		receivedLate.clear();
+
+		std::sort(haloState.bodies.begin(), haloState.bodies.end(),
+			[](const BodyRecord& a, const BodyRecord& b) { return a.id < b.id; });
+		ghostPool.Apply(haloState, ghosts);
+		world.objList.insert(world.objList.end(), ghosts.begin(), ghosts.end());
+
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats.haloReceived += ghosts.size();
+		stats.migratedIn += migratedIn;
+		stats.stalls += stalled ? 1 : 0;
+		stats.stale += stale;
+		return true;
+	}
+
+	// After the physics: takes the halo out again, sends the world to the coordinator when sendWorld, and hands the
+	// bodies that are now in another region to their shard (they go with the next Send). A link goes with them when
+	// both ends go to the same shard in the same tick, a link across the border is cut
+	void Settle(ObjectsList& world, std::uint32_t tick, bool sendWorld) {
+		// Nothing adds or removes bodies between Receive and here, the ghosts are still the last ones
+		world.objList.resize(world.objList.size() - std::min(ghosts.size(), world.objList.size()));
+
+		if (sendWorld) {
+			std::shared_ptr<ShardLink> link;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				link = coordinator;
+			}
+			if (link) {
+				link->send_frame(worldWriter.Write(tick, world.objList));
+			}
+		}
+
+		leaving.clear();
+		leavingOwner.clear();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (BaseShape* obj : world.objList) {
+				int owner = layout.ShardAt(obj->GetPosition());
+				// Planets stay, gravity is not sharded. A body for a shard that is not there stays until it is back
+				if (owner != index && obj->GetKind() != ShapeKind::Planet && peers[owner].link) {
+					leaving.emplace_back(obj, owner);
+					leavingOwner[obj] = owner;
+				}
+			}
+		}
+		std::uint64_t linksCut = 0;
+		for (const auto& [obj, owner] : leaving) {
+			ShardExchangeWriter& writer = peers[owner].writer;
+			writer.AddMigrant(MigrantRecord::FromShape(obj, world.IsFixedObj(obj)));
+			std::uint32_t id = static_cast<std::uint32_t>(obj->GetID());
+			world.connectedObjects.ForEachLinkOf(obj, [&](BaseShape* other, int type) {
+				std::uint32_t otherID = static_cast<std::uint32_t>(other->GetID());
+				auto otherOwner = leavingOwner.find(other);
+				if (otherOwner == leavingOwner.end()) {
+					linksCut++;
+				}
+				else if (id < otherID) { // Each link once, both ends see it
+					if (otherOwner->second == owner) {
+						writer.AddLink(id, otherID, type);
+					}
+					else {
+						linksCut++;
+					}
+				}
+				});
+		}
+		for (const auto& [obj, owner] : leaving) {
+			world.DetachObj(obj);
+			delete obj;
+		}
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats.migratedOut += leaving.size();
+		stats.linksCut += linksCut;
+	}
+
+private:
+	// Puts the bodies an exchange hands over into the world with the links between them, returns how many
+	std::uint64_t TakeMigrants(ObjectsList& world, const ShardExchangeReader& reader) {
+		arrivedBodies.clear();
+		for (std::uint32_t i = 0; i < reader.GetMigrantCount(); i++) {
+			MigrantRecord migrant = reader.GetMigrant(i);
+			BaseShape* obj = migrant.CreateShape();
+			world.InsertObj(obj, migrant.fixed);
+			arrivedBodies[migrant.body.id] = obj;
+		}
+		for (std::uint32_t i = 0; i < reader.GetLinkCount(); i++) {
+			MigrantLink link = reader.GetLink(i);
+			auto body = arrivedBodies.find(link.body);
+			auto other = arrivedBodies.find(link.other);
+			if (body != arrivedBodies.end() && other != arrivedBodies.end() && body != other) {
+				world.connectObjects(body->second, other->second, link.type);
+			}
+		}
+		return reader.GetMigrantCount();
+	}
+
+	// The exchanges of a link that went away are not waited for any more, the next Receive still takes their
+	// migrants. With the mutex held
+	void RetireInbox(Peer& peer) {
+		for (std::vector<std::uint8_t>& payload : peer.inbox) {
+			late.push_back(std::move(payload));
+		}
+		peer.inbox.clear();
+	}
+
+	// HandleFrame only keeps payloads of at least the exchange header
+	static std::uint32_t InboxTick(const std::vector<std::uint8_t>& payload) {
+		return Wire::GetU32(payload.data());
+	}
+
+	void Accept() {
+		acceptor.async_accept([this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
+			if (!ec) {
+				Open(std::move(socket));
+			}
+			Accept();
+			});
+	}
+
+	void Dial(int shard) {
+		boost::asio::ip::tcp::endpoint endpoint(host, static_cast<unsigned short>(basePort + shard));
+		DialShard(io_context, endpoint, [this, shard](boost::asio::ip::tcp::socket socket) {
+			auto link = std::make_shared<ShardLink>(std::move(socket));
+			Register(link, ShardRole::Shard, shard); // Before the first read, its exchanges may already be coming
+			Start(link);
+			link->send_frame(MakeShardHello(ShardRole::Shard, static_cast<std::uint32_t>(index)));
+			});
+	}
+
+	// A link that called this shard, it says who it is in its first frame
+	void Open(boost::asio::ip::tcp::socket socket) {
+		Start(std::make_shared<ShardLink>(std::move(socket)));
+	}
+
+	void Start(const std::shared_ptr<ShardLink>& link) {
+		link->start(
+			[this](ShardLink& from, NetMessageType type, const std::uint8_t* data, std::size_t size) { HandleFrame(from, type, data, size); },
+			[this](ShardLink& from) { HandleClose(from); });
+	}
+
+	void Register(const std::shared_ptr<ShardLink>& link, ShardRole role, int shard) {
+		link->role = role;
+		link->peer = shard;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (role == ShardRole::Coordinator) {
+			coordinator = link;
+			Log() << "Shard " << index << ": coordinator connected";
+			return;
+		}
+		peers[shard].link = link;
+		RetireInbox(peers[shard]);
+		Log() << "Shard " << index << ": shard " << shard << " connected";
+	}
+
+	void HandleFrame(ShardLink& from, NetMessageType type, const std::uint8_t* data, std::size_t size) {
+		switch (type) {
+		case NetMessageType::ShardHello: {
+			if (size < ShardFormat::HelloSize || from.peer >= 0) {
+				break;
+			}
+			ShardRole role = static_cast<ShardRole>(Wire::GetU8(data));
+			int shard = static_cast<int>(Wire::GetU32(data + 1));
+			if (role == ShardRole::Coordinator || (role == ShardRole::Shard && shard > index && shard < static_cast<int>(peers.size()))) {
+				Register(from.shared_from_this(), role, role == ShardRole::Coordinator ? 0 : shard);
+			}
+			else {
+				Log() << "Shard " << index << ": unexpected hello from shard " << shard << ", closing";
+				from.close();
+			}
+			break;
+		}
+		case NetMessageType::ShardExchange: {
+			if (from.peer < 0 || from.role != ShardRole::Shard || size < ShardFormat::ExchangeHeaderSize) {
+				break;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			std::vector<std::uint8_t> payload;
+			if (!spare.empty()) {
+				payload = std::move(spare.back());
+				spare.pop_back();
+			}
+			payload.assign(data, data + size);
+			peers[from.peer].inbox.push_back(std::move(payload));
+			break;
+		}
+		case NetMessageType::ShardCommands:
+			if (from.role == ShardRole::Coordinator && from.peer >= 0 && onCommands) {
+				onCommands(data, size);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	void HandleClose(ShardLink& from) {
+		bool redial = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (from.role == ShardRole::Coordinator && coordinator.get() == &from) {
+				coordinator = nullptr;
+				Log() << "Shard " << index << ": coordinator disconnected";
+			}
+			else if (from.peer >= 0 && peers[from.peer].link.get() == &from) {
+				peers[from.peer].link = nullptr;
+				RetireInbox(peers[from.peer]);
+				redial = from.peer < index;
+				Log() << "Shard " << index << ": shard " << from.peer << " disconnected";
+			}
+		}
+		if (redial) {
+			Dial(from.peer);
+		}
+	}
+};
+
+// This process runs no physics for the sharded world: it calls every shard, merges the worlds they send into one
+// for the clients, and sends every command to the shard that owns its body or its position
+class ShardCoordinator {
+public:
+	struct Stats
+	{
+		std::uint64_t merges = 0;
+		std::uint64_t routed = 0;
+		std::uint64_t unrouted = 0; // Commands for bodies no shard has (gone, or not merged yet)
+	};
+
+private:
+	boost::asio::io_context& io_context;
+	ShardLayout layout;
+	boost::asio::ip::address host;
+	unsigned short basePort;
+
+	// What each shard sent last, under the mutex. fresh until the next merge takes it
+	struct ShardWorld
+	{
+		std::shared_ptr<ShardLink> link;
+		std::vector<BodyRecord> bodies;
+		std::uint32_t tick = 0;
+		bool fresh = false;
+	};
+	std::mutex mutex;
+	std::vector<ShardWorld> shards;
+
+	// Only the simulation thread
+	std::vector<CommandWriter> commands; // By shard, sent once per tick
+	std::unordered_map<std::uint32_t, int> owners; // Body id -> shard, from the last merge
+	Stats stats;
+	std::mutex statsMutex;
+
+public:
+	ShardCoordinator(boost::asio::io_context& io_context, const ShardLayout& layout, const std::string& host, unsigned short basePort)
+		: io_context(io_context),
+		layout(layout),
+		host(boost::asio::ip::make_address(host)),
+		basePort(basePort),
+		shards(layout.Count()),
+		commands(layout.Count())
+	{
+	}
+
+	ShardCoordinator(const ShardCoordinator&) = delete;
+	ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+
+	void Start() {
+		for (int shard = 0; shard < static_cast<int>(shards.size()); shard++) {
+			Dial(shard);
+		}
+	}
+
+	const ShardLayout& Layout() const { return layout; }
+
+	int ConnectedCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return static_cast<int>(std::count_if(shards.begin(), shards.end(), [](const ShardWorld& world) { return world.link != nullptr; }));
+	}
+
+	Stats GetStats() {
+		std::lock_guard<std::mutex> lock(statsMutex);
+		return stats;
+	}
+
+	// Simulation thread. Bodies go to their owner, spawns at a position to the shard of that position and spawns
+	// without one to the first shard (the bodies migrate from there). A link between bodies of two shards is dropped
+	void Route(const Command& command) {
+		int shard = 0;
+		switch (command.op) {
+		case CommandOp::SpawnPlanet:
+		case CommandOp::Explosion:
+			shard = layout.ShardAt(command.position);
+			break;
+		case CommandOp::Delete:
+		case CommandOp::SetPosition:
+		case CommandOp::Scale:
+		case CommandOp::Link: {
+			auto owner = owners.find(command.body);
+			bool known = owner != owners.end();
+			if (known && command.op == CommandOp::Link) {
+				auto other = owners.find(command.otherBody);
+				known = other != owners.end() && other->second == owner->second;
+			}
+			if (!known) {
+				std::lock_guard<std::mutex> lock(statsMutex);
+				stats.unrouted++;
+				return;
+			}
+			shard = owner->second;
+			break;
+		}
+		default:
+			break;
+		}
+		if (!commands[shard].Add(command)) {
+			FlushCommands(); // Full message
+			commands[shard].Add(command);
+		}
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats.routed++;
+	}
+
+	// Simulation thread, once per tick
+	void FlushCommands() {
+		for (int shard = 0; shard < static_cast<int>(commands.size()); shard++) {
+			CommandWriter& writer = commands[shard];
+			if (writer.Empty()) {
+				continue;
+			}
+			const std::vector<std::uint8_t>& message = writer.Message();
+			auto frame = std::make_shared<std::vector<std::uint8_t>>(NetFrame::HeaderSize + message.size());
+			NetFrame::WriteHeader(frame->data(), NetMessageType::ShardCommands, static_cast<std::uint32_t>(message.size()));
+			std::copy(message.begin(), message.end(), frame->begin() + NetFrame::HeaderSize);
+			writer.Clear();
+			std::shared_ptr<ShardLink> link;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				link = shards[shard].link;
+			}
+			if (link) {
+				link->send_frame(std::move(frame));
+			}
+		}
+	}
+
+	// Simulation thread. Once every shard sent a world since the last merge, merged gets all of them (in id order)
+	// and tick the newest of their ticks. false while one is missing
+	bool TakeWorld(std::vector<BodyRecord>& merged, std::uint32_t& tick) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (const ShardWorld& world : shards) {
+				if (!world.link || !world.fresh) {
+					return false;
+				}
+			}
+			merged.clear();
+			owners.clear();
+			tick = 0;
+			for (int shard = 0; shard < static_cast<int>(shards.size()); shard++) {
+				ShardWorld& world = shards[shard];
+				for (const BodyRecord& record : world.bodies) {
+					merged.push_back(record);
+					owners[record.id] = shard;
+				}
+				tick = std::max(tick, world.tick);
+				world.fresh = false;
+			}
+		}
+		std::sort(merged.begin(), merged.end(), [](const BodyRecord& a, const BodyRecord& b) { return a.id < b.id; });
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats.merges++;
+		return true;
+	}
+
+private:
+	void Dial(int shard) {
+		boost::asio::ip::tcp::endpoint endpoint(host, static_cast<unsigned short>(basePort + shard));
+		DialShard(io_context, endpoint, [this, shard](boost::asio::ip::tcp::socket socket) {
+			auto link = std::make_shared<ShardLink>(std::move(socket));
+			link->role = ShardRole::Shard;
+			link->peer = shard;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				shards[shard].link = link;
+				shards[shard].fresh = false;
+			}
+			link->start(
+				[this](ShardLink& from, NetMessageType type, const std::uint8_t* data, std::size_t size) { HandleFrame(from, type, data, size); },
+				[this](ShardLink& from) { HandleClose(from); });
+			link->send_frame(MakeShardHello(ShardRole::Coordinator, 0));
+			Log() << "Coordinator: shard " << shard << " connected";
+			});
+	}
+
+	// A shard's world is a plain snapshot of the bodies it owns
+	void HandleFrame(ShardLink& from, NetMessageType type, const std::uint8_t* data, std::size_t size) {
+		if (type != NetMessageType::Snapshot) {
+			return;
+		}
+		SnapshotReader reader;
+		if (!reader.Parse(data, size)) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		ShardWorld& world = shards[from.peer];
+		world.bodies.clear();
+		for (std::uint32_t i = 0; i < reader.GetBodyCount(); i++) {
+			world.bodies.push_back(reader.GetBody(i));
+		}
+		world.tick = reader.GetTick();
+		world.fresh = true;
+	}
+
+	void HandleClose(ShardLink& from) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (shards[from.peer].link.get() != &from) {
+				return;
+			}
+			shards[from.peer].link = nullptr;
+			shards[from.peer].fresh = false;
+		}
+		Log() << "Coordinator: shard " << from.peer << " disconnected";
+		Dial(from.peer);
+	}
+};